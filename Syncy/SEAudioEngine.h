@@ -13,6 +13,8 @@ typedef void (*SEAudioEngineRenderCallback)(__unsafe_unretained id playable, con
 
 @protocol SEAudioEngineAudioProvider <NSObject>
 @property (nonatomic, readonly) SEAudioEngineRenderCallback renderCallback;
+@optional
+@property (nonatomic) double sampleRate;
 @end
 
 @interface SEAudioEngine : NSObject
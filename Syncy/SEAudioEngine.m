@@ -81,6 +81,10 @@ static inline BOOL _checkResult(OSStatus result, const char *operation, const ch
     checkResult(AudioUnitSetProperty(_audioUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0, &clientFormat, sizeof(clientFormat)),
                 "kAudioUnitProperty_StreamFormat");
     
+    if ( [_provider respondsToSelector:@selector(setSampleRate:)] ) {
+        _provider.sampleRate = clientFormat.mSampleRate;
+    }
+    
     // Set the render callback
     AURenderCallbackStruct rcbs = { .inputProc = audioUnitRenderCallback, .inputProcRefCon = (__bridge void *)(self) };
     checkResult(AudioUnitSetProperty(_audioUnit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Global, 0, &rcbs, sizeof(rcbs)),
@@ -28,5 +28,7 @@ extern NSString * const SENotificationTempoKey;
 
 @property (nonatomic) double tempo;
 @property (nonatomic, readonly) BOOL started;
+@property (nonatomic) double sampleRate;    // Default 44100
+@property (nonatomic) int subdivisions;     // Clicks per beat; default 1
 
 @end
@@ -18,46 +18,111 @@ NSString * const SENotificationTimestampKey = @"timestamp";
 NSString * const SENotificationPositionKey = @"position";
 NSString * const SENotificationTempoKey = @"tempo";
 
-static const double kMajorBeatFrequency = 1200;
-static const double kMinorBeatFrequency = 800;
+static const double kMajorBeatFrequency = 600;
+static const double kMinorBeatFrequency = 400;
+static const double kSubdivisionGain = 0.5;
 static const NSTimeInterval kTickDuration = 0.1;
+static const int kBeatsPerBar = 4;
+static const double kDefaultSampleRate = 44100.0;
+static const double kMaxCatchUpInterval = 0.5;  // Longest gap between buffers, in beats, for which we play a missed click late
 
-static const int kMaxTones = 2;
+static const int kMaxVoices = 16;
+static const int kWavetableSize = 1024;
 
 typedef struct {
-    double frequency;
-    float position;
+    float phase;
+    float phaseIncrement;
+    float gain;
+    float gainDecrement;
     UInt32 offset;
-    UInt32 duration;
     UInt32 remainingFrames;
-} SEMetronomeTone;
+} SEMetronomeVoice;
+
+typedef struct {
+    uint64_t timeBase;
+    SETempoConversion tempoConversion;
+    int subdivisions;
+    uint32_t resetCount;                // Advanced when the timeline jumps, so the render thread forgets the clicks it played
+    uint64_t resetTime;                 // Time from which to look for missed clicks after a reset, or zero
+} SEMetronomeTimeline;
+
+static float __wavetable[kWavetableSize+1];
 
 @interface SEMetronome () {
-    uint64_t _timeBase;
+    SEMetronomeTimeline _timeline;      // Written on the main thread; read by the render thread under the sequence counter
+    uint32_t _timelineSequence;
     double _positionAtStart;
+    double _hostTicksPerFrame;
+    
+    // Owned by the render thread
     uint64_t _lastRenderEnd;
-    int _lastPlayedBeat;
-    SEMetronomeTone _tones[kMaxTones];
+    int64_t _lastPlayedClick;
+    int _renderSubdivisions;
+    uint32_t _renderResetCount;
+    SEMetronomeVoice _voices[kMaxVoices];
 }
 @end
 
 @implementation SEMetronome
 @dynamic started;
 
++(void)initialize {
+    // Fill the wavetable with one period of our tone, plus a guard point for interpolation
+    for ( int i=0; i<=kWavetableSize; i++ ) {
+        float x = ((2.0 * i) / kWavetableSize) - 1.0;
+        x *= x; x -= 1.0; x *= x; x -= 0.5; x *= 0.4;
+        __wavetable[i] = x;
+    }
+}
+
 -(instancetype)init {
     if ( !(self = [super init]) ) return nil;
     
     _tempo = 120.0;
+    SETempoConversionSetTempo(&_timeline.tempoConversion, _tempo);
+    _subdivisions = 1;
+    _timeline.subdivisions = 1;
+    _renderSubdivisions = 1;
+    _lastPlayedClick = -1;
+    self.sampleRate = kDefaultSampleRate;
     
     return self;
 }
 
+static void SEMetronomeBeginTimelineUpdate(__unsafe_unretained SEMetronome * THIS) {
+    // Called on the main thread. Marks the timeline as being updated, for the render thread.
+    __atomic_store_n(&THIS->_timelineSequence, THIS->_timelineSequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void SEMetronomeEndTimelineUpdate(__unsafe_unretained SEMetronome * THIS) {
+    __atomic_store_n(&THIS->_timelineSequence, THIS->_timelineSequence + 1, __ATOMIC_RELEASE);
+}
+
+static SEMetronomeTimeline SEMetronomeReadTimeline(__unsafe_unretained SEMetronome * THIS) {
+    // Read a consistent copy of the timeline, retrying if it overlaps an update, so that the time base,
+    // tempo and conversion factors always belong together
+    while ( 1 ) {
+        uint32_t sequence = __atomic_load_n(&THIS->_timelineSequence, __ATOMIC_ACQUIRE);
+        if ( sequence & 1 ) {
+            continue;
+        }
+        SEMetronomeTimeline timeline = THIS->_timeline;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&THIS->_timelineSequence, __ATOMIC_RELAXED) == sequence ) {
+            return timeline;
+        }
+    }
+}
+
 -(void)startAtTime:(uint64_t)applyTime {
     [self willChangeValueForKey:@"started"];
     
-    _timeBase = applyTime - SEBeatsToHostTicks(_positionAtStart, _tempo);
-    _lastRenderEnd = _timeBase;
-    _lastPlayedBeat = -1;
+    SEMetronomeBeginTimelineUpdate(self);
+    _timeline.timeBase = applyTime - SETempoConversionBeatsToHostTicks(&_timeline.tempoConversion, _positionAtStart);
+    _timeline.resetCount++;
+    _timeline.resetTime = applyTime;
+    SEMetronomeEndTimelineUpdate(self);
     
     [self didChangeValueForKey:@"started"];
     [[NSNotificationCenter defaultCenter] postNotificationName:SEMetronomeDidStartNotification
@@ -69,26 +134,31 @@ typedef struct {
 
 -(void)stop {
     [self willChangeValueForKey:@"started"];
-    _timeBase = 0;
+    SEMetronomeBeginTimelineUpdate(self);
+    _timeline.timeBase = 0;
+    _timeline.resetCount++;
+    _timeline.resetTime = 0;
+    SEMetronomeEndTimelineUpdate(self);
     _positionAtStart = 0;
-    _lastRenderEnd = 0;
-    _lastPlayedBeat = -1;
     [self didChangeValueForKey:@"started"];
     
     [[NSNotificationCenter defaultCenter] postNotificationName:SEMetronomeDidStopNotification object:self];
 }
 
 -(BOOL)started {
-    return _timeBase != 0;
+    return _timeline.timeBase != 0;
 }
 
 -(void)setTimelinePosition:(double)timelinePosition atTime:(uint64_t)applyTime {
-    if ( !_timeBase ) {
+    SEMetronomeBeginTimelineUpdate(self);
+    if ( !_timeline.timeBase ) {
         _positionAtStart = timelinePosition;
     } else {
-        _timeBase = applyTime - SEBeatsToHostTicks(timelinePosition, _tempo);
+        _timeline.timeBase = applyTime - SETempoConversionBeatsToHostTicks(&_timeline.tempoConversion, timelinePosition);
     }
-    _lastPlayedBeat = -1;
+    _timeline.resetCount++;
+    _timeline.resetTime = 0;
+    SEMetronomeEndTimelineUpdate(self);
     [[NSNotificationCenter defaultCenter] postNotificationName:SEMetronomeDidChangeTimelineNotification
                                                         object:self
                                                       userInfo:@{ SENotificationPositionKey: @(timelinePosition),
@@ -96,7 +166,7 @@ typedef struct {
 }
 
 -(double)timelinePositionForTime:(uint64_t)timestamp {
-    if ( !_timeBase ) {
+    if ( !_timeline.timeBase ) {
         return _positionAtStart;
     }
     
@@ -104,118 +174,184 @@ typedef struct {
         timestamp = SECurrentTimeInHostTicks();
     }
     
-    if ( timestamp < _timeBase ) {
+    if ( timestamp < _timeline.timeBase ) {
         return 0.0;
     }
     
     // Calculate offset from our time base, and convert to beats using current tempo
-    return SEHostTicksToBeats(timestamp - _timeBase, _tempo);
+    return SETempoConversionHostTicksToBeats(&_timeline.tempoConversion, timestamp - _timeline.timeBase);
 }
 
 -(void)setTempo:(double)tempo {
-    if ( _timeBase ) {
+    SEMetronomeBeginTimelineUpdate(self);
+    if ( _timeline.timeBase ) {
         // Scale time base to new tempo, so our relative timeline position remains the same (as it is dependent on tempo)
         double ratio = _tempo / tempo;
         uint64_t now = SECurrentTimeInHostTicks();
-        _timeBase = now - ((now - _timeBase) * ratio);
+        _timeline.timeBase = now - ((now - _timeline.timeBase) * ratio);
     }
     
     _tempo = tempo;
+    SETempoConversionSetTempo(&_timeline.tempoConversion, tempo);
+    SEMetronomeEndTimelineUpdate(self);
     
     [[NSNotificationCenter defaultCenter] postNotificationName:SEMetronomeDidChangeTempoNotification
                                                         object:self
                                                       userInfo:@{ SENotificationTempoKey: @(tempo) }];
 }
 
+-(void)setSampleRate:(double)sampleRate {
+    _sampleRate = sampleRate;
+    _hostTicksPerFrame = (double)SESecondsToHostTicks(1.0) / sampleRate;
+}
+
+-(void)setSubdivisions:(int)subdivisions {
+    // The render thread carries its last played click over to the new subdivision, when it next sees it
+    _subdivisions = MAX(1, subdivisions);
+    SEMetronomeBeginTimelineUpdate(self);
+    _timeline.subdivisions = _subdivisions;
+    SEMetronomeEndTimelineUpdate(self);
+}
+
 -(SEAudioEngineRenderCallback)renderCallback {
     return render;
 }
 
 static void render(__unsafe_unretained SEMetronome * THIS, const AudioTimeStamp *time, AudioBufferList *ioData, UInt32 inNumberFrames) {
     
-    // Calculate relevant position, in beats at current tempo
-    uint64_t timeBase = THIS->_timeBase;
-    double tempo = THIS->_tempo;
-    double lastBufferPosition = THIS->_lastRenderEnd < timeBase ? -SEHostTicksToBeats(timeBase - THIS->_lastRenderEnd, tempo) : SEHostTicksToBeats(THIS->_lastRenderEnd - timeBase, tempo);
-    double bufferStartPosition = time->mHostTime < timeBase ? -SEHostTicksToBeats(timeBase - time->mHostTime, tempo) : SEHostTicksToBeats(time->mHostTime - timeBase, tempo);
-    uint64_t endTimestamp = time->mHostTime + SESecondsToHostTicks(inNumberFrames / 44100.0);
-    double bufferEndPosition = endTimestamp < timeBase ? -SEHostTicksToBeats(timeBase - endTimestamp, tempo) : SEHostTicksToBeats(endTimestamp - timeBase, tempo);
-    
-    if ( timeBase && bufferEndPosition > 0.0 ) {
-        // First catch up on any missed buffers
-        if ( bufferStartPosition > lastBufferPosition && bufferStartPosition-lastBufferPosition < 0.5 ) {
-            int beat;
-            if ( findBeatBoundary(lastBufferPosition, bufferStartPosition, NULL, &beat) && beat > THIS->_lastPlayedBeat ) {
-                addTone(THIS, (beat%4 == 0) ? kMajorBeatFrequency : kMinorBeatFrequency, kTickDuration * 44100.0, 0);
-                THIS->_lastPlayedBeat = beat;
+    SEMetronomeTimeline timeline = SEMetronomeReadTimeline(THIS);
+    if ( timeline.resetCount != THIS->_renderResetCount ) {
+        // The timeline jumped: forget the clicks played on the old one
+        THIS->_renderResetCount = timeline.resetCount;
+        THIS->_lastPlayedClick = -1;
+        if ( timeline.resetTime ) {
+            THIS->_lastRenderEnd = timeline.resetTime;
+        }
+    }
+    if ( timeline.subdivisions != THIS->_renderSubdivisions ) {
+        // Carry the last played click over to the new subdivision, so we neither repeat nor skip clicks
+        if ( THIS->_lastPlayedClick >= 0 ) {
+            THIS->_lastPlayedClick = (THIS->_lastPlayedClick * timeline.subdivisions) / THIS->_renderSubdivisions;
+        }
+        THIS->_renderSubdivisions = timeline.subdivisions;
+    }
+    
+    uint64_t timeBase = timeline.timeBase;
+    const SETempoConversion * conversion = &timeline.tempoConversion;
+    double tempo = conversion->tempo;
+    int subdivisions = timeline.subdivisions;
+    uint64_t bufferStart = time->mHostTime;
+    
+    if ( timeBase && tempo > 0.0 ) {
+        // Work in clicks (beat subdivisions), and place clicks by frame from the buffer start position,
+        // so only the start of the buffer needs converting from host ticks
+        double framesPerClick = (THIS->_sampleRate * 60.0) / (tempo * subdivisions);
+        double startPosition = (bufferStart >= timeBase ? SETempoConversionHostTicksToBeats(conversion, bufferStart - timeBase)
+                                                        : -SETempoConversionHostTicksToBeats(conversion, timeBase - bufferStart)) * subdivisions;
+        
+        // Look from half a frame before the buffer start, to pick up a click rounded up to the end of the last buffer
+        double searchStart = startPosition - (0.5 / framesPerClick);
+        
+        if ( THIS->_lastRenderEnd && bufferStart > THIS->_lastRenderEnd + (uint64_t)THIS->_hostTicksPerFrame ) {
+            // We missed some time: look back to the end of the last buffer, if it's recent, to pick up a missed click
+            double gap = SETempoConversionHostTicksToBeats(conversion, bufferStart - THIS->_lastRenderEnd);
+            if ( gap < kMaxCatchUpInterval ) {
+                searchStart = MIN(searchStart, startPosition - (gap * subdivisions));
             }
         }
         
-        // Now fill in any new tone in this buffer
-        double offset;
-        int beat;
-        if ( findBeatBoundary(bufferStartPosition, bufferEndPosition, &offset, &beat) && beat > THIS->_lastPlayedBeat ) {
-            addTone(THIS, (beat%4 == 0) ? kMajorBeatFrequency : kMinorBeatFrequency, kTickDuration * 44100.0, round(SEBeatsToSeconds(offset, tempo) * 44100.0));
-            THIS->_lastPlayedBeat = beat;
+        for ( int64_t click = MAX(0, (int64_t)ceil(searchStart)); ; click++ ) {
+            double frame = round((click - startPosition) * framesPerClick);
+            if ( frame >= inNumberFrames ) {
+                break;
+            }
+            
+            if ( click <= THIS->_lastPlayedClick ) {
+                continue;
+            }
+            
+            if ( frame < 0.0 ) {
+                // Click is overdue: play the most recent overdue click only, at the start of the buffer
+                if ( round((click + 1 - startPosition) * framesPerClick) < 0.0 ) {
+                    continue;
+                }
+                frame = 0.0;
+            }
+            
+            if ( click % subdivisions != 0 ) {
+                addVoice(THIS, kMinorBeatFrequency, kSubdivisionGain, (UInt32)frame);
+            } else {
+                addVoice(THIS, (click / subdivisions) % kBeatsPerBar == 0 ? kMajorBeatFrequency : kMinorBeatFrequency, 1.0, (UInt32)frame);
+            }
+            
+            THIS->_lastPlayedClick = click;
         }
     }
     
-    // Render tones
-    for ( int i=0; i<kMaxTones; i++ ) {
-        if ( THIS->_tones[i].frequency != 0.0 ) {
-            renderTone(&THIS->_tones[i], ioData, inNumberFrames);
+    // Render voices
+    for ( int i=0; i<kMaxVoices; i++ ) {
+        if ( THIS->_voices[i].remainingFrames ) {
+            renderVoice(&THIS->_voices[i], ioData, inNumberFrames);
         }
     }
     
-    THIS->_lastRenderEnd = time->mHostTime + SESecondsToHostTicks(inNumberFrames / 44100.0);
+    THIS->_lastRenderEnd = bufferStart + (uint64_t)(inNumberFrames * THIS->_hostTicksPerFrame);
 }
 
-static BOOL findBeatBoundary(double start, double end, double *outOffset, int *outBeatNumber) {
-    if ( floor(start) != floor(end) || fmod(start, 1.0) < 1.0e-5 ) {
-        // We straddle a boundary
-        if ( outOffset ) {
-            *outOffset = fmod(start, 1.0) < 1.0e-5 ? 0.0 : ceil(start) - start;
+static void addVoice(__unsafe_unretained SEMetronome * THIS, double frequency, float gain, UInt32 offset) {
+    // Take a free voice, or steal the one closest to finishing
+    SEMetronomeVoice * voice = &THIS->_voices[0];
+    for ( int i=0; i<kMaxVoices && voice->remainingFrames; i++ ) {
+        if ( THIS->_voices[i].remainingFrames < voice->remainingFrames ) {
+            voice = &THIS->_voices[i];
         }
-        *outBeatNumber = (int)round(start);
-        return YES;
-    } else {
-        return NO;
     }
+    
+    UInt32 duration = kTickDuration * THIS->_sampleRate;
+    *voice = (SEMetronomeVoice) {
+        .phase = 0,
+        .phaseIncrement = frequency / THIS->_sampleRate,
+        .gain = gain,
+        .gainDecrement = gain / duration,
+        .offset = offset,
+        .remainingFrames = duration
+    };
 }
 
-static void addTone(__unsafe_unretained SEMetronome * THIS, double frequency, UInt32 duration, UInt32 offset) {
-    for ( int i=0; i<kMaxTones; i++ ) {
-        if ( !THIS->_tones[i].frequency ) {
-            THIS->_tones[i] = (SEMetronomeTone) {
-                .frequency = frequency,
-                .duration = duration,
-                .remainingFrames = duration,
-                .offset = offset,
-                .position = 0
-            };
-        }
+static void renderVoice(SEMetronomeVoice * voice, AudioBufferList *ioData, UInt32 inNumberFrames) {
+    if ( voice->offset >= inNumberFrames ) {
+        voice->offset -= inNumberFrames;
+        return;
     }
-}
-
-static void renderTone(SEMetronomeTone * tone, AudioBufferList *ioData, UInt32 inNumberFrames) {
-    float oscillatorRate = tone->frequency / 44100.0;
-    int i = 0;
-    for ( ; tone->offset > 0; i++, tone->offset-- );
-    for ( ; tone->offset == 0 && i<inNumberFrames && tone->remainingFrames > 0; i++, tone->remainingFrames-- ) {
-        float x = tone->position;
-        x *= x; x -= 1.0; x *= x; x -= 0.5; x *= 0.4;
-        tone->position += oscillatorRate;
-        if ( tone->position > 1.0 ) tone->position -= 2.0;
+    
+    UInt32 frames = MIN(inNumberFrames - voice->offset, voice->remainingFrames);
+    float * left = (float*)ioData->mBuffers[0].mData + voice->offset;
+    float * right = ioData->mNumberBuffers > 1 ? (float*)ioData->mBuffers[1].mData + voice->offset : NULL;
+    
+    float phase = voice->phase;
+    float phaseIncrement = voice->phaseIncrement;
+    float gain = voice->gain;
+    float gainDecrement = voice->gainDecrement;
+    
+    for ( UInt32 i=0; i<frames; i++ ) {
+        // Linearly-interpolated wavetable lookup
+        float index = phase * kWavetableSize;
+        int integerIndex = (int)index;
+        float fraction = index - integerIndex;
+        float sample = (__wavetable[integerIndex] + fraction * (__wavetable[integerIndex+1] - __wavetable[integerIndex])) * gain;
         
-        float gain = (float)tone->remainingFrames / (float)tone->duration;
+        left[i] += sample;
+        if ( right ) right[i] += sample;
         
-        ((float*)ioData->mBuffers[0].mData)[i] += x * gain;
-        ((float*)ioData->mBuffers[1].mData)[i] += x * gain;
+        phase += phaseIncrement;
+        if ( phase >= 1.0f ) phase -= 1.0f;
+        gain -= gainDecrement;
     }
     
-    if ( !tone->remainingFrames ) {
-        memset(tone, 0, sizeof(SEMetronomeTone));
-    }
+    voice->phase = phase;
+    voice->gain = gain;
+    voice->offset = 0;
+    voice->remainingFrames -= frames;
 }
 
 @end
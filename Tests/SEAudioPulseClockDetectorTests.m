@@ -0,0 +1,89 @@
+//
+//  SEAudioPulseClockDetectorTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEAudioPulseClockDetector.h"
+#import "SEAudioPulseClockGenerator.h"
+#import "SEMIDIClockSenderLoopbackInterface.h"
+
+@interface SEAudioPulseClockDetectorTests : XCTestCase
+@end
+
+@implementation SEAudioPulseClockDetectorTests
+
+-(void)testFollowsGenerator {
+    for ( NSNumber * pulsesPerQuarterNote in @[ @1, @4, @24, @48 ] ) {
+        [self verifyLockWithPulsesPerQuarterNote:pulsesPerQuarterNote.intValue noise:0.0 polarity:SEAudioPulseClockPolarityPositive];
+    }
+}
+
+-(void)testNoisyInvertedSignal {
+    [self verifyLockWithPulsesPerQuarterNote:24 noise:0.08 polarity:SEAudioPulseClockPolarityNegative];
+}
+
+-(void)verifyLockWithPulsesPerQuarterNote:(int)pulsesPerQuarterNote noise:(float)noise polarity:(SEAudioPulseClockPolarity)polarity {
+    double tempo = 120.0;
+    double sampleRate = 44100.0;
+    UInt32 frames = 256;
+    
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:[[SEMIDIClockSenderLoopbackInterface alloc] initWithReceivers:@[]]];
+    sender.renderCallbackDriven = YES;
+    sender.tempo = tempo;
+    
+    SEAudioPulseClockGenerator * generator = [[SEAudioPulseClockGenerator alloc] initWithSender:sender];
+    generator.pulsesPerQuarterNote = pulsesPerQuarterNote;
+    generator.polarity = polarity;
+    generator.sampleRate = sampleRate;
+    
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    SEAudioPulseClockDetector * detector = [[SEAudioPulseClockDetector alloc] initWithReceiver:receiver];
+    detector.pulsesPerQuarterNote = pulsesPerQuarterNote;
+    detector.polarity = polarity;
+    detector.runStopChannel = 1;
+    detector.sampleRate = sampleRate;
+    
+    uint64_t renderStart = SECurrentTimeInHostTicks();
+    [sender startAtTime:renderStart + SESecondsToHostTicks(0.25)];
+    
+    // Loop the generator's output into the detector, for twenty seconds
+    float clock[frames];
+    float run[frames];
+    char bufferListSpace[sizeof(AudioBufferList) + sizeof(AudioBuffer)];
+    AudioBufferList * bufferList = (AudioBufferList*)bufferListSpace;
+    bufferList->mNumberBuffers = 2;
+    bufferList->mBuffers[0] = (AudioBuffer) { .mNumberChannels = 1, .mDataByteSize = sizeof(clock), .mData = clock };
+    bufferList->mBuffers[1] = (AudioBuffer) { .mNumberChannels = 1, .mDataByteSize = sizeof(run), .mData = run };
+    srandom(1);
+    uint64_t time = renderStart;
+    for ( UInt32 frame = 0; frame < 20.0 * sampleRate; frame += frames ) {
+        AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid, .mHostTime = renderStart + SESecondsToHostTicks(frame / sampleRate) };
+        SEAudioPulseClockGeneratorRender(generator, &timestamp, bufferList, frames);
+        for ( UInt32 i=0; i<frames && noise > 0.0; i++ ) {
+            clock[i] += noise * ((2.0 * random() / (double)RAND_MAX) - 1.0);
+            run[i] += noise * ((2.0 * random() / (double)RAND_MAX) - 1.0);
+        }
+        SEAudioPulseClockDetectorProcess(detector, &timestamp, bufferList, frames);
+        time = timestamp.mHostTime;
+    }
+    
+    XCTAssertTrue(SEMIDIClockReceiverIsClockRunning(receiver), @"%d PPQN", pulsesPerQuarterNote);
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), tempo, 0.01, @"%d PPQN", pulsesPerQuarterNote);
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(receiver, time),
+                               SEMIDIClockSenderGetTimelinePosition(sender, time),
+                               SESecondsToBeats(1.0e-3, tempo), @"%d PPQN", pulsesPerQuarterNote);
+    
+    // Stop, and verify the receiver follows
+    [sender stop];
+    AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid, .mHostTime = time + SESecondsToHostTicks(frames / sampleRate) };
+    SEAudioPulseClockGeneratorRender(generator, &timestamp, bufferList, frames);
+    SEAudioPulseClockDetectorProcess(detector, &timestamp, bufferList, frames);
+    XCTAssertFalse(SEMIDIClockReceiverIsClockRunning(receiver), @"%d PPQN", pulsesPerQuarterNote);
+}
+
+@end
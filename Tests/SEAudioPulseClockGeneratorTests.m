@@ -0,0 +1,90 @@
+//
+//  SEAudioPulseClockGeneratorTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEAudioPulseClockGenerator.h"
+#import "SEMIDIClockSenderLoopbackInterface.h"
+
+@interface SEAudioPulseClockGeneratorTests : XCTestCase
+@end
+
+@implementation SEAudioPulseClockGeneratorTests
+
+-(void)testPulsePlacement {
+    for ( NSNumber * pulsesPerQuarterNote in @[ @1, @2, @4, @24, @48 ] ) {
+        [self verifyPulsesWithPulsesPerQuarterNote:pulsesPerQuarterNote.intValue tempo:133.0 duration:60.0];
+    }
+}
+
+-(void)testHighTempoPulseWidth {
+    [self verifyPulsesWithPulsesPerQuarterNote:48 tempo:300.0 duration:10.0];
+}
+
+-(void)verifyPulsesWithPulsesPerQuarterNote:(int)pulsesPerQuarterNote tempo:(double)tempo duration:(NSTimeInterval)duration {
+    double sampleRate = 44100.0;
+    
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:[[SEMIDIClockSenderLoopbackInterface alloc] initWithReceivers:@[]]];
+    sender.renderCallbackDriven = YES;
+    sender.tempo = tempo;
+    
+    SEAudioPulseClockGenerator * generator = [[SEAudioPulseClockGenerator alloc] initWithSender:sender];
+    generator.pulsesPerQuarterNote = pulsesPerQuarterNote;
+    generator.sampleRate = sampleRate;
+    
+    uint64_t renderStart = SECurrentTimeInHostTicks();
+    uint64_t startTime = [sender startAtTime:renderStart + SESecondsToHostTicks(0.1234)];
+    
+    // Render offline, in a mixture of buffer sizes
+    UInt32 totalFrames = duration * sampleRate;
+    float * clock = calloc(totalFrames, sizeof(float));
+    float * run = calloc(totalFrames, sizeof(float));
+    UInt32 bufferSizes[] = { 512, 1024, 128, 512, 256 };
+    char bufferListSpace[sizeof(AudioBufferList) + sizeof(AudioBuffer)];
+    AudioBufferList * bufferList = (AudioBufferList*)bufferListSpace;
+    bufferList->mNumberBuffers = 2;
+    for ( UInt32 frame = 0, i = 0; frame < totalFrames; i++ ) {
+        UInt32 frames = MIN(bufferSizes[i % (sizeof(bufferSizes)/sizeof(UInt32))], totalFrames - frame);
+        AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid, .mHostTime = renderStart + SESecondsToHostTicks(frame / sampleRate) };
+        bufferList->mBuffers[0] = (AudioBuffer) { .mNumberChannels = 1, .mDataByteSize = frames * sizeof(float), .mData = clock + frame };
+        bufferList->mBuffers[1] = (AudioBuffer) { .mNumberChannels = 1, .mDataByteSize = frames * sizeof(float), .mData = run + frame };
+        SEAudioPulseClockGeneratorRender(generator, &timestamp, bufferList, frames);
+        frame += frames;
+    }
+    
+    // Verify each pulse's leading edge lands on the right frame
+    double startFrame = SEHostTicksToSeconds(startTime - renderStart) * sampleRate;
+    double framesPerPulse = (sampleRate * 60.0) / (tempo * pulsesPerQuarterNote);
+    int pulseCount = 0;
+    int misplacedPulses = 0;
+    UInt32 highFrames = 0;
+    for ( UInt32 i=0; i<totalFrames; i++ ) {
+        if ( clock[i] > 0.5 && (i == 0 || clock[i-1] < 0.5) ) {
+            if ( labs((long)i - lround(startFrame + pulseCount * framesPerPulse)) > 1 ) {
+                misplacedPulses++;
+            }
+            pulseCount++;
+        }
+        if ( clock[i] > 0.5 ) highFrames++;
+    }
+    
+    XCTAssertEqual(misplacedPulses, 0, @"%d PPQN", pulsesPerQuarterNote);
+    XCTAssertEqualWithAccuracy(pulseCount, (totalFrames - startFrame) / framesPerPulse, 1.0, @"%d PPQN", pulsesPerQuarterNote);
+    XCTAssertLessThanOrEqual((double)highFrames / pulseCount, MIN(generator.pulseWidth * sampleRate, framesPerPulse / 2.0) + 1.0);
+    
+    // Verify run/stop goes high at the start, and stays high
+    UInt32 runStart = 0;
+    while ( runStart < totalFrames && run[runStart] < 0.5 ) runStart++;
+    XCTAssertEqualWithAccuracy(runStart, startFrame, 1.0);
+    XCTAssertEqual(run[totalFrames-1], 1.0f);
+    
+    free(clock);
+    free(run);
+}
+
+@end
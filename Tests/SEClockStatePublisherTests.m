@@ -0,0 +1,211 @@
+//
+//  SEClockStatePublisherTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEClockStatePublisher.h"
+#import "SEClockStatePage.h"
+#import "SEMIDIClockSender.h"
+#import "SEMIDIClockReceiver.h"
+#import <CoreMIDI/CoreMIDI.h>
+#import <pthread.h>
+
+static void SEStatePageTestSendMessage(__unsafe_unretained SEMIDIClockReceiver * receiver, Byte message, uint64_t timestamp) {
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, timestamp, 1, &message);
+    SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+}
+
+@interface SEStatePageTestSenderInterface : NSObject <SEMIDIClockSenderInterface>
+@end
+
+@implementation SEStatePageTestSenderInterface
+-(void)sendMIDIPacketList:(const MIDIPacketList *)packetList {}
+@end
+
+static const int kTearTestIterations = 200000;
+
+typedef struct {
+    __unsafe_unretained SEClockStatePublisher * publisher;
+    BOOL exclusive;
+    volatile int finished;
+} SEStatePageTestWriterContext;
+
+static void * SEStatePageTestWriter(void * userInfo) {
+    SEStatePageTestWriterContext * context = (SEStatePageTestWriterContext*)userInfo;
+    for ( uint32_t i=1; i<=kTearTestIterations; i++ ) {
+        // Every field is derived from i, so a torn read shows up as a mismatch
+        if ( context->exclusive ) {
+            SEClockStatePublisherPublishExclusive(context->publisher, YES, 60.0 + (i % 1000), i * 1000ULL, (double)i, i);
+        } else {
+            SEClockStatePublisherPublish(context->publisher, YES, 60.0 + (i % 1000), i * 1000ULL, (double)i, i);
+        }
+    }
+    context->finished = 1;
+    return NULL;
+}
+
+@interface SEClockStatePublisherTests : XCTestCase
+@property (nonatomic, strong) NSString * path;
+@end
+
+@implementation SEClockStatePublisherTests
+
+-(void)setUp {
+    [super setUp];
+    self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+-(void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:NULL];
+    [super tearDown];
+}
+
+-(void)testSender {
+    SEClockStatePublisher * publisher = [[SEClockStatePublisher alloc] initWithPath:_path];
+    XCTAssertNotNil(publisher);
+    
+    const SEClockStatePage * page = SEClockStatePageMap(_path.UTF8String);
+    XCTAssertTrue(page != NULL);
+    
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:[SEStatePageTestSenderInterface new]];
+    sender.tempo = 130.0;
+    sender.timelinePosition = 4.0;
+    sender.statePublisher = publisher;
+    
+    SEClockState state;
+    XCTAssertTrue(SEClockStatePageRead(page, &state));
+    XCTAssertFalse(state.running);
+    XCTAssertEqualWithAccuracy(state.tempo, 130.0, 1.0e-9);
+    XCTAssertEqualWithAccuracy(SEClockStateGetTimelinePosition(&state, SECurrentTimeInHostTicks()), 4.0, 1.0e-9);
+    
+    uint32_t generation = state.generation;
+    [sender startAtTime:0];
+    
+    XCTAssertTrue(SEClockStatePageRead(page, &state));
+    XCTAssertTrue(state.running);
+    XCTAssertNotEqual(state.generation, generation);
+    
+    uint64_t time = SECurrentTimeInHostTicks();
+    for ( int i=0; i<10; i++, time += SESecondsToHostTicks(0.37) ) {
+        XCTAssertEqualWithAccuracy(SEClockStateGetTimelinePosition(&state, time),
+                                   SEMIDIClockSenderGetTimelinePosition(sender, time), 1.0e-6);
+    }
+    
+    // Tempo changes are published straight away
+    sender.tempo = 90.0;
+    XCTAssertTrue(SEClockStatePageRead(page, &state));
+    XCTAssertEqualWithAccuracy(state.tempo, 90.0, 1.0e-9);
+    XCTAssertEqualWithAccuracy(SEClockStateGetTimelinePosition(&state, time),
+                               SEMIDIClockSenderGetTimelinePosition(sender, time), 1.0e-6);
+    
+    [sender stop];
+    XCTAssertTrue(SEClockStatePageRead(page, &state));
+    XCTAssertFalse(state.running);
+    
+    SEClockStatePageUnmap(page);
+}
+
+-(void)testSenderTempoRamp {
+    SEClockStatePublisher * publisher = [[SEClockStatePublisher alloc] initWithPath:_path];
+    const SEClockStatePage * page = SEClockStatePageMap(_path.UTF8String);
+    XCTAssertTrue(page != NULL);
+    
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:[SEStatePageTestSenderInterface new]];
+    sender.tempo = 120.0;
+    sender.statePublisher = publisher;
+    [sender startAtTime:0];
+    XCTAssertTrue([sender scheduleTempo:180.0 atTime:SECurrentTimeInHostTicks() curve:SEMIDIClockSenderTempoRampLinear duration:2.0]);
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.0]];
+    
+    // Midway through the ramp, the page follows it, rather than extrapolating the tempo it started from
+    SEClockState state;
+    XCTAssertTrue(SEClockStatePageRead(page, &state));
+    uint64_t time = SECurrentTimeInHostTicks();
+    double tempo = SEMIDIClockSenderGetTempoAtTime(sender, time);
+    XCTAssertGreaterThan(tempo, 140.0);
+    XCTAssertEqualWithAccuracy(state.tempo, tempo, 2.0);
+    XCTAssertEqualWithAccuracy(SEClockStateGetTimelinePosition(&state, time),
+                               SEMIDIClockSenderGetTimelinePosition(sender, time), 0.01);
+    
+    [sender stop];
+    SEClockStatePageUnmap(page);
+}
+
+-(void)testReceiver {
+    SEClockStatePublisher * publisher = [[SEClockStatePublisher alloc] initWithPath:_path];
+    const SEClockStatePage * page = SEClockStatePageMap(_path.UTF8String);
+    XCTAssertTrue(page != NULL);
+    
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    receiver.statePublisher = publisher;
+    
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t time = SECurrentTimeInHostTicks();
+    
+    SEStatePageTestSendMessage(receiver, SEMIDIMessageClockStart, time-1);
+    for ( int i=0; i<SEMIDITicksPerBeat*4; i++, time += tickDuration ) {
+        SEStatePageTestSendMessage(receiver, SEMIDIMessageClock, time);
+    }
+    
+    SEClockState state;
+    XCTAssertTrue(SEClockStatePageRead(page, &state));
+    XCTAssertTrue(state.running);
+    XCTAssertEqualWithAccuracy(state.tempo, SEMIDIClockReceiverGetTempo(receiver), 1.0e-9);
+    XCTAssertEqualWithAccuracy(SEClockStateGetTimelinePosition(&state, time),
+                               SEMIDIClockReceiverGetTimelinePosition(receiver, time), 1.0e-6);
+    
+    SEStatePageTestSendMessage(receiver, SEMIDIMessageClockStop, time);
+    XCTAssertTrue(SEClockStatePageRead(page, &state));
+    XCTAssertFalse(state.running);
+    
+    SEClockStatePageUnmap(page);
+}
+
+-(void)testConsistentSnapshots {
+    [self verifyConsistentSnapshotsWithExclusiveWriter:NO];
+}
+
+-(void)testConsistentSnapshotsFromExclusiveWriter {
+    [self verifyConsistentSnapshotsWithExclusiveWriter:YES];
+}
+
+-(void)verifyConsistentSnapshotsWithExclusiveWriter:(BOOL)exclusive {
+    SEClockStatePublisher * publisher = [[SEClockStatePublisher alloc] initWithPath:_path];
+    const SEClockStatePage * page = SEClockStatePageMap(_path.UTF8String);
+    XCTAssertTrue(page != NULL);
+    
+    SEStatePageTestWriterContext context = { .publisher = publisher, .exclusive = exclusive, .finished = 0 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, SEStatePageTestWriter, &context);
+    
+    int reads = 0;
+    int tornReads = 0;
+    while ( !context.finished ) {
+        SEClockState state;
+        if ( !SEClockStatePageRead(page, &state) || state.generation == 0 ) continue;
+        reads++;
+        uint32_t i = state.generation;
+        if ( state.timeBase != i * 1000ULL || state.position != (double)i || state.tempo != 60.0 + (i % 1000) ) {
+            tornReads++;
+        }
+    }
+    
+    pthread_join(thread, NULL);
+    
+    XCTAssertGreaterThan(reads, 0);
+    XCTAssertEqual(tornReads, 0);
+    
+    SEClockStatePageUnmap(page);
+}
+
+@end
@@ -10,6 +10,7 @@
 #import <XCTest/XCTest.h>
 #import "SEMIDIClockReceiver.h"
 #import "SEMIDIClockSender.h"
+#import "SEMIDIClockRegenerator.h"
 #import "SETestObserver.h"
 
 @interface SEMIDIClockSenderPassthroughInterface : NSObject <SEMIDIClockSenderInterface>
@@ -141,6 +142,41 @@
     XCTAssertEqual(_receiver.error, 0);
 }
 
+- (void)testRegenerator {
+    SEMIDIClockSenderPassthroughInterface * downstreamInterface = [SEMIDIClockSenderPassthroughInterface new];
+    SEMIDIClockReceiver * downstreamReceiver = [SEMIDIClockReceiver new];
+    downstreamInterface.receiver = downstreamReceiver;
+    SEMIDIClockSender * downstreamSender = [[SEMIDIClockSender alloc] initWithInterface:downstreamInterface];
+    SEMIDIClockRegenerator * regenerator = [[SEMIDIClockRegenerator alloc] initWithReceiver:_receiver sender:downstreamSender];
+    
+    _sender.tempo = 125;
+    double initialTimelinePosition = 8;
+    _sender.timelinePosition = initialTimelinePosition;
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.0]];
+    
+    XCTAssertTrue(downstreamReceiver.receivingTempo);
+    XCTAssertFalse(downstreamReceiver.clockRunning);
+    XCTAssertEqualWithAccuracy(downstreamReceiver.tempo, _sender.tempo, 1.0e-2);
+    
+    uint64_t startTime = [_sender startAtTime:0];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:2.0]];
+    
+    // Downstream timeline should trail the upstream one by exactly the added latency
+    uint64_t latency = SESecondsToHostTicks(regenerator.latency);
+    uint64_t now = SECurrentTimeInHostTicks();
+    XCTAssertTrue(downstreamReceiver.clockRunning);
+    XCTAssertEqualWithAccuracy([downstreamReceiver timelinePositionForTime:startTime + latency], initialTimelinePosition, 1.0e-2);
+    XCTAssertEqualWithAccuracy([downstreamReceiver timelinePositionForTime:now + latency], [_receiver timelinePositionForTime:now], 1.0e-2);
+    XCTAssertEqualWithAccuracy(downstreamReceiver.tempo, _sender.tempo, 1.0e-2);
+    
+    [_sender stop];
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    
+    XCTAssertFalse(downstreamReceiver.clockRunning);
+    XCTAssertFalse(regenerator.sender.started);
+}
+
 @end
 
 @implementation SEMIDIClockSenderPassthroughInterface
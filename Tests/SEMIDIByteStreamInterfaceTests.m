@@ -0,0 +1,117 @@
+//
+//  SEMIDIByteStreamInterfaceTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEMIDIByteStreamInterface.h"
+#import <util.h>
+
+@interface SEMIDIByteStreamInterfaceTests : XCTestCase
+@property (nonatomic, strong) SEMIDIByteStreamInterface * master;
+@property (nonatomic, strong) SEMIDIByteStreamInterface * slave;
+@end
+
+@implementation SEMIDIByteStreamInterfaceTests
+
+-(void)setUp {
+    [super setUp];
+    
+    // A pseudo-terminal pair behaves like either end of a serial line
+    int master, slave;
+    XCTAssertEqual(openpty(&master, &slave, NULL, NULL, NULL), 0);
+    self.master = [[SEMIDIByteStreamInterface alloc] initWithFileDescriptor:master];
+    self.slave = [[SEMIDIByteStreamInterface alloc] initWithFileDescriptor:slave];
+}
+
+-(void)tearDown {
+    self.master = nil;
+    self.slave = nil;
+    [super tearDown];
+}
+
+-(void)testClockSender {
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    _slave.receiver = receiver;
+    
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:_master];
+    sender.tempo = 100.0;
+    [sender startAtTime:0];
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:2.0]];
+    
+    XCTAssertTrue(SEMIDIClockReceiverIsClockRunning(receiver));
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), 100.0, 0.5);
+    
+    uint64_t time = SECurrentTimeInHostTicks();
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(receiver, time),
+                               SEMIDIClockSenderGetTimelinePosition(sender, time), 0.01);
+    
+    [sender stop];
+}
+
+-(void)testInterleavedMessages {
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    _slave.receiver = receiver;
+    
+    // Schedule a start, then two beats of ticks at 120 BPM, amid notes using running status
+    // with ticks arriving mid-message, and system exclusive messages containing tick-like data
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t startTime = SECurrentTimeInHostTicks() + SESecondsToHostTicks(0.1);
+    int tickCount = 2 * SEMIDITicksPerBeat;
+    
+    MIDIPacketList packetList;
+    MIDIPacket * packet = MIDIPacketListInit(&packetList);
+    const Byte start[] = { SEMIDIMessageClockStart };
+    MIDIPacketListAdd(&packetList, sizeof(packetList), packet, startTime - 1, sizeof(start), start);
+    [_master sendMIDIPacketList:&packetList];
+    
+    for ( int i=0; i<tickCount; i++ ) {
+        const Byte plain[] = { SEMIDIMessageClock };
+        const Byte noteOn[] = { 0x90, 0x3C, SEMIDIMessageClock, 0x40 };
+        const Byte runningStatus[] = { 0x3E, SEMIDIMessageClock, 0x40 };
+        const Byte sysEx[] = { 0xF0, 0x7D, SEMIDIMessageClockStop & 0x7F, SEMIDIMessageClock, 0x01, 0xF7 };
+        const Byte * bytes[] = { plain, noteOn, runningStatus, sysEx };
+        const size_t lengths[] = { sizeof(plain), sizeof(noteOn), sizeof(runningStatus), sizeof(sysEx) };
+        
+        packet = MIDIPacketListInit(&packetList);
+        MIDIPacketListAdd(&packetList, sizeof(packetList), packet, startTime + i * tickDuration, lengths[i % 4], bytes[i % 4]);
+        [_master sendMIDIPacketList:&packetList];
+    }
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:SEHostTicksToSeconds(startTime + tickCount * tickDuration - SECurrentTimeInHostTicks()) + 0.1]];
+    
+    // Every tick arrived, on time, with nothing else mistaken for clock or transport
+    XCTAssertTrue(SEMIDIClockReceiverIsClockRunning(receiver));
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), tempo, 0.5);
+    uint64_t lastTickTime = startTime + (tickCount - 1) * tickDuration;
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(receiver, lastTickTime),
+                               (double)(tickCount - 1) / SEMIDITicksPerBeat, 0.02);
+}
+
+-(void)testClose {
+    __block BOOL closed = NO;
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName:SEMIDIByteStreamInterfaceDidCloseNotification
+                                                                    object:_master
+                                                                     queue:nil
+                                                                usingBlock:^(NSNotification *note) { closed = YES; }];
+    
+    // Closing one end ends the stream at the other
+    self.slave = nil;
+    
+    NSDate * deadline = [NSDate dateWithTimeIntervalSinceNow:2.0];
+    while ( !closed && [deadline timeIntervalSinceNow] > 0 ) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    
+    XCTAssertTrue(closed);
+    XCTAssertFalse(_master.open);
+    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
+@end
@@ -0,0 +1,128 @@
+//
+//  SEMIDIClockReceiverHubTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEMIDIClockReceiverHub.h"
+#import <CoreMIDI/CoreMIDI.h>
+
+static void SEHubTestSendMessage(__unsafe_unretained SEMIDIClockReceiver * receiver, Byte message, uint64_t timestamp) {
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, timestamp, 1, &message);
+    SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+}
+
+@interface SEMIDIClockReceiverHubTests : XCTestCase
+@end
+
+@implementation SEMIDIClockReceiverHubTests
+
+-(void)testFailover {
+    SEMIDIClockReceiverHub * hub = [SEMIDIClockReceiverHub new];
+    SEMIDIClockReceiver * primary = [hub addReceiverWithPriority:1];
+    SEMIDIClockReceiver * backup = [hub addReceiverWithPriority:0];
+    
+    // Backup feed arrives a little later than the primary one
+    double tempo = 125.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t backupLatency = SESecondsToHostTicks(2.0e-3);
+    uint64_t time = SECurrentTimeInHostTicks();
+    
+    SEHubTestSendMessage(primary, SEMIDIMessageClockStart, time-1);
+    SEHubTestSendMessage(backup, SEMIDIMessageClockStart, time-1 + backupLatency);
+    
+    // Run both sources, in real time
+    int tickCount = 24;
+    for ( int i=0; i<tickCount; i++, time += tickDuration ) {
+        SEHubTestSendMessage(primary, SEMIDIMessageClock, time);
+        SEHubTestSendMessage(backup, SEMIDIMessageClock, time + backupLatency);
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:SEHostTicksToSeconds(tickDuration)]];
+    }
+    
+    XCTAssertEqual(hub.activeReceiver, primary);
+    XCTAssertTrue(SEMIDIClockReceiverHubIsClockRunning(hub));
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverHubGetTempo(hub), tempo, 1.0e-9);
+    
+    uint64_t referenceTime = time + SEBeatsToHostTicks(8.0, tempo);
+    double referencePosition = SEMIDIClockReceiverHubGetTimelinePosition(hub, referenceTime);
+    
+    // Primary feed drops out; keep the backup going for long enough for the primary to time out
+    tickCount = 48;
+    for ( int i=0; i<tickCount; i++, time += tickDuration ) {
+        SEHubTestSendMessage(backup, SEMIDIMessageClock, time + backupLatency);
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:SEHostTicksToSeconds(tickDuration)]];
+    }
+    
+    // Verify handover, with no interruption and no jump in the timeline
+    XCTAssertEqual(hub.activeReceiver, backup);
+    XCTAssertEqual(SEMIDIClockReceiverHubGetActiveReceiver(hub), backup);
+    XCTAssertTrue(SEMIDIClockReceiverHubIsClockRunning(hub));
+    XCTAssertTrue(SEMIDIClockReceiverHubIsReceivingTempo(hub));
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverHubGetTempo(hub), tempo, 1.0e-9);
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverHubGetTimelinePosition(hub, referenceTime), referencePosition, 1.0e-3);
+    XCTAssertGreaterThan(fabs([backup timelinePositionForTime:referenceTime] - referencePosition), 1.0e-3);
+}
+
+-(void)testSelectsHigherPriority {
+    SEMIDIClockReceiverHub * hub = [SEMIDIClockReceiverHub new];
+    SEMIDIClockReceiver * low = [hub addReceiverWithPriority:0];
+    SEMIDIClockReceiver * high = [hub addReceiverWithPriority:5];
+    
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t time = SECurrentTimeInHostTicks();
+    for ( int i=0; i<24; i++, time += tickDuration ) {
+        SEHubTestSendMessage(low, SEMIDIMessageClock, time);
+        SEHubTestSendMessage(high, SEMIDIMessageClock, time);
+    }
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    XCTAssertEqual(hub.activeReceiver, high);
+    
+    [hub removeReceiver:high];
+    XCTAssertEqual(hub.activeReceiver, low);
+    XCTAssertEqual(hub.receivers.count, 1);
+}
+
+-(void)testRemoveReceiverWhenStopped {
+    SEMIDIClockReceiverHub * hub = [SEMIDIClockReceiverHub new];
+    SEMIDIClockReceiver * first = [hub addReceiverWithPriority:1];
+    SEMIDIClockReceiver * second = [hub addReceiverWithPriority:0];
+    
+    // Remove the first receiver from within its stop notification, which is posted while the hub polls its receivers
+    __block int stopCount = 0;
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName:SEMIDIClockReceiverDidStopNotification
+                                                                    object:first
+                                                                     queue:nil
+                                                                usingBlock:^(NSNotification *note) {
+                                                                    stopCount++;
+                                                                    [hub removeReceiver:first];
+                                                                }];
+    
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t time = SECurrentTimeInHostTicks();
+    SEHubTestSendMessage(first, SEMIDIMessageClockStart, time-1);
+    SEHubTestSendMessage(second, SEMIDIMessageClockStart, time-1);
+    for ( int i=0; i<24; i++, time += tickDuration ) {
+        SEHubTestSendMessage(first, SEMIDIMessageClock, time);
+        SEHubTestSendMessage(second, SEMIDIMessageClock, time);
+    }
+    SEHubTestSendMessage(first, SEMIDIMessageClockStop, time);
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.2]];
+    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+    
+    XCTAssertEqual(stopCount, 1);
+    XCTAssertEqualObjects(hub.receivers, @[second]);
+    XCTAssertEqual(hub.activeReceiver, second);
+}
+
+@end
@@ -369,6 +369,241 @@ static double TPMCGaussianRandomNext(TPMCGaussianRandom * gaussianRandom) {
     XCTAssertLessThanOrEqual(_observer.notifications.count, 3);
 }
 
+-(void)testArrivalTimestampSmoothing {
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    
+    // Start, then send ticks for 240 bpm without timestamps, each arriving up to 2ms late, as from a busy MIDI
+    // thread. The arrival times are synthetic, ending just before now, so the test needn't wait for them.
+    double tempo = 240.0;
+    int tickCount = 480;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t maxDelay = SESecondsToHostTicks(2.0e-3);
+    uint64_t startTime = SECurrentTimeInHostTicks() - (tickCount * tickDuration) - maxDelay;
+    uint64_t time = startTime;
+    
+    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    Byte startMessage[] = { SEMIDIMessageClockStart };
+    packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, 0, sizeof(startMessage), startMessage);
+    SEMIDIClockReceiverReceivePacketListAtTime(_receiver, packetList, startTime - tickDuration);
+    
+    srandom(1);
+    for ( int i=0; i<tickCount; i++, time += tickDuration ) {
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        Byte tickMessage[] = { SEMIDIMessageClock };
+        packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, 0, sizeof(tickMessage), tickMessage);
+        SEMIDIClockReceiverReceivePacketListAtTime(_receiver, packetList, time + (random() % maxDelay));
+    }
+    
+    XCTAssertFalse(_receiver.sourceProvidesTimestamps);
+    
+    // Raw arrival times deviate from the grid by around 0.6ms; smoothing leaves interval error well below that of the raw ticks (around 6%)
+    XCTAssertEqualWithAccuracy(_receiver.timestampJitter, 0.6e-3, 0.4e-3);
+    XCTAssertLessThan(_receiver.error, 1.5);
+    XCTAssertEqualWithAccuracy(_receiver.tempo, tempo, 0.1);
+    
+    // The average 1ms arrival delay is learned, and taken out of the time base
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetInputLatency(_receiver), 1.0e-3, 0.5e-3);
+    uint64_t lastTickTime = startTime + (tickCount - 1) * tickDuration;
+    double beatsPerSecond = tempo / 60.0;
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(_receiver, lastTickTime),
+                               (double)(tickCount - 1) / SEMIDITicksPerBeat, 0.5e-3 * beatsPerSecond);
+}
+
+-(void)testTimestampOffset {
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    
+    // Send ticks stamped 5ms before their arrival, as from a source whose clock lags ours
+    double tempo = 240.0;
+    int tickCount = 96;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t offset = SESecondsToHostTicks(5.0e-3);
+    uint64_t time = SECurrentTimeInHostTicks();
+    for ( int i=0; i<tickCount; i++, time += tickDuration ) {
+        mach_wait_until(time);
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        Byte tickMessage[] = { SEMIDIMessageClock };
+        packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time - offset, sizeof(tickMessage), tickMessage);
+        SEMIDIClockReceiverReceivePacketList(_receiver, packetList);
+    }
+    
+    // Timestamps are used as given, and their offset learned
+    XCTAssertTrue(_receiver.sourceProvidesTimestamps);
+    XCTAssertEqual(_receiver.inputLatency, 0.0);
+    XCTAssertEqualWithAccuracy(_receiver.timestampOffset, 5.0e-3, 0.5e-3);
+    XCTAssertLessThan(_receiver.timestampJitter, 1.0e-6);
+    XCTAssertEqualWithAccuracy(_receiver.tempo, tempo, 1.0e-6);
+}
+
+-(void)testFlywheel {
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    
+    _receiver.flywheelDuration = 2.0;
+    
+    // Start, then send a beat and a half of ticks for 240 bpm
+    double tempo = 240.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t startTime = SECurrentTimeInHostTicks();
+    uint64_t time = startTime;
+    
+    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    Byte startMessage[] = { SEMIDIMessageClockStart };
+    packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time-1, sizeof(startMessage), startMessage);
+    SEMIDIClockReceiverReceivePacketList(_receiver, packetList);
+    
+    int tick = 0;
+    for ( ; tick<36; tick++, time += tickDuration ) {
+        mach_wait_until(time);
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        Byte tickMessage[] = { SEMIDIMessageClock };
+        packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time, sizeof(tickMessage), tickMessage);
+        SEMIDIClockReceiverReceivePacketList(_receiver, packetList);
+    }
+    
+    XCTAssertTrue(_receiver.clockRunning);
+    XCTAssertFalse(_receiver.coasting);
+    XCTAssertEqualWithAccuracy(_receiver.tempo, tempo, 1.0e-6);
+    uint32_t discontinuityCount = SEMIDIClockReceiverGetDiscontinuityCount(_receiver);
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    [_observer reset];
+    
+    // Drop out for longer than the usual activity timeout: the receiver coasts, holding tempo and timeline
+    tick += 96;
+    time += 96 * tickDuration;
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:SEHostTicksToSeconds(time - SECurrentTimeInHostTicks()) - 0.1]];
+    
+    XCTAssertTrue(_receiver.coasting);
+    XCTAssertTrue(_receiver.clockRunning);
+    XCTAssertTrue(_receiver.receivingTempo);
+    XCTAssertEqual(_receiver.tempo, tempo);
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(_receiver, time), (double)tick / SEMIDITicksPerBeat, 1.0e-3);
+    XCTAssertEqual(_observer.notifications.count, 0);
+    
+    // Resume on the grid: the missed ticks are counted, without a discontinuity
+    for ( int i=0; i<24; i++, tick++, time += tickDuration ) {
+        mach_wait_until(time);
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        Byte tickMessage[] = { SEMIDIMessageClock };
+        packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time, sizeof(tickMessage), tickMessage);
+        SEMIDIClockReceiverReceivePacketList(_receiver, packetList);
+    }
+    
+    XCTAssertFalse(_receiver.coasting);
+    XCTAssertTrue(_receiver.clockRunning);
+    XCTAssertEqualWithAccuracy(_receiver.tempo, tempo, 1.0e-6);
+    XCTAssertEqual(SEMIDIClockReceiverGetDiscontinuityCount(_receiver), discontinuityCount);
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(_receiver, time - tickDuration), (double)(tick - 1) / SEMIDITicksPerBeat, 1.0e-3);
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    XCTAssertEqual(_observer.notifications.count, 0);
+    
+    // Beyond the flywheel duration, the receiver resets as usual
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:2.3]];
+    XCTAssertFalse(_receiver.coasting);
+    XCTAssertFalse(_receiver.clockRunning);
+    XCTAssertFalse(_receiver.receivingTempo);
+}
+
+-(void)testParameters {
+    XCTAssertEqual(_receiver.parameters.sampleBufferSize, SEMIDIClockReceiverDefaultParameters.sampleBufferSize);
+    XCTAssertEqual(_receiver.parameters.outlierThresholdRatio, SEMIDIClockReceiverDefaultParameters.outlierThresholdRatio);
+    
+    // Supported values are used as given, others clamped
+    SEMIDIClockReceiverParameters parameters = SEMIDIClockReceiverDefaultParameters;
+    parameters.sampleBufferSize = 48;
+    parameters.outliersBeforeReset = 100;
+    parameters.coarsestTempoRounding = 0.1;
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithParameters:parameters eventPollTimer:NO];
+    XCTAssertEqual(receiver.parameters.sampleBufferSize, 48);
+    XCTAssertEqual(receiver.parameters.outliersBeforeReset, 8);
+    XCTAssertEqual(receiver.parameters.coarsestTempoRounding, 0.1);
+    
+    // Send more ticks than the buffer holds, to wrap it around
+    uint64_t time = SECurrentTimeInHostTicks();
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    double tempo = 125.31;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    for ( int i=0; i<120; i++, time += tickDuration ) {
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        Byte tickMessage[] = { SEMIDIMessageClock };
+        packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time, sizeof(tickMessage), tickMessage);
+        SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+    }
+    
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), tempo, 1.0e-3);
+}
+
+-(void)testRobustOutlierDetection {
+    SEMIDIClockReceiverParameters parameters = SEMIDIClockReceiverDefaultParameters;
+    parameters.robustOutlierDetection = YES;
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithParameters:parameters eventPollTimer:NO];
+    XCTAssertTrue(receiver.parameters.robustOutlierDetection);
+    
+    // Send ticks for 120 bpm, with every eighth held up 4ms, as from a bursty source
+    uint64_t time = SECurrentTimeInHostTicks();
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t delay = SESecondsToHostTicks(4.0e-3);
+    for ( int i=0; i<480; i++, time += tickDuration ) {
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        Byte tickMessage[] = { SEMIDIMessageClock };
+        packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, i % 8 == 7 ? time + delay : time, sizeof(tickMessage), tickMessage);
+        SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+    }
+    
+    // The long and short intervals either side of each late tick don't disturb the tempo, or the error estimate
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), tempo, 1.0e-3);
+    XCTAssertLessThan(receiver.error, 0.01);
+}
+
+-(void)testBulkConversion {
+    uint64_t time = SECurrentTimeInHostTicks();
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    
+    int count = 100;
+    uint64_t times[count];
+    double positions[count];
+    for ( int i=0; i<count; i++ ) {
+        times[i] = time + SESecondsToHostTicks(0.01) + i * SESecondsToHostTicks(0.05);
+    }
+    
+    // Before the clock starts, everything is at the song position
+    SEMIDIClockReceiverGetTimelinePositions(_receiver, times, positions, count);
+    XCTAssertEqual(positions[count-1], 0.0);
+    
+    // Start, and send a couple of beats of ticks
+    double tempo = 125.31;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    Byte startMessage[] = { SEMIDIMessageClockStart };
+    MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time-1, sizeof(startMessage), startMessage);
+    SEMIDIClockReceiverReceivePacketList(_receiver, packetList);
+    for ( int i=0; i<48; i++, time += tickDuration ) {
+        packet = MIDIPacketListInit(packetList);
+        Byte tickMessage[] = { SEMIDIMessageClock };
+        MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time, sizeof(tickMessage), tickMessage);
+        SEMIDIClockReceiverReceivePacketList(_receiver, packetList);
+    }
+    
+    // Conversions match those made one at a time, and invert
+    SEMIDIClockReceiverGetTimelinePositions(_receiver, times, positions, count);
+    for ( int i=0; i<count; i++ ) {
+        XCTAssertEqualWithAccuracy(positions[i], SEMIDIClockReceiverGetTimelinePosition(_receiver, times[i]), 1.0e-12, @"Position %d", i);
+    }
+    
+    uint64_t convertedTimes[count];
+    SEMIDIClockReceiverGetTimesForTimelinePositions(_receiver, positions, convertedTimes, count);
+    for ( int i=0; i<count; i++ ) {
+        XCTAssertEqualWithAccuracy(convertedTimes[i], times[i], 1, @"Time %d", i);
+    }
+}
+
 -(void)testNonIntegralTempo {
     uint64_t time = SECurrentTimeInHostTicks();
     char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
@@ -617,4 +852,37 @@ static double TPMCGaussianRandomNext(TPMCGaussianRandom * gaussianRandom) {
 
 }
 
+-(void)testManyReceiversPerformance {
+    // One receiver per input port on a 32-port interface, with ticks arriving interleaved across all of them,
+    // so that each receiver's sample buffers have to be brought back into cache for every tick
+    int receiverCount = 32;
+    NSMutableArray * receivers = [NSMutableArray array];
+    for ( int i=0; i<receiverCount; i++ ) {
+        [receivers addObject:[SEMIDIClockReceiver new]];
+    }
+    
+    double tempo = 125.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    TPMCGaussianRandom gauss;
+    TPMCGaussianRandomInit(&gauss, 0, tickDuration * (1.0 / 100.0), 0, DBL_MAX);
+    __block uint64_t time = SECurrentTimeInHostTicks();
+    
+    [self measureBlock:^{
+        char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+        MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+        for ( int i=0; i<SEMIDITicksPerBeat*16; i++, time += tickDuration ) {
+            for ( SEMIDIClockReceiver * receiver in receivers ) {
+                MIDIPacket *packet = MIDIPacketListInit(packetList);
+                Byte tickMessage[] = { SEMIDIMessageClock };
+                packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time + TPMCGaussianRandomNext(&gauss), sizeof(tickMessage), tickMessage);
+                SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+            }
+        }
+    }];
+    
+    for ( SEMIDIClockReceiver * receiver in receivers ) {
+        XCTAssertEqualWithAccuracy(receiver.tempo, tempo, 1.0e-9);
+    }
+}
+
 @end
@@ -0,0 +1,182 @@
+//
+//  SEMIDIClockSenderLoopbackInterfaceTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEMIDIClockSenderLoopbackInterface.h"
+#import <CoreMIDI/CoreMIDI.h>
+
+static void SELoopbackTestSendMessage(SEMIDIClockSenderLoopbackInterface * interface, Byte message, uint64_t timestamp) {
+    MIDIPacketList packetList;
+    MIDIPacket *packet = MIDIPacketListInit(&packetList);
+    MIDIPacketListAdd(&packetList, sizeof(packetList), packet, timestamp, 1, &message);
+    [interface sendMIDIPacketList:&packetList];
+}
+
+typedef struct {
+    double meanError;
+    double maximumError;
+    int unsyncedSessions;
+} SELoopbackBenchmarkResult;
+
+@interface SEMIDIClockSenderLoopbackInterfaceTests : XCTestCase
+@end
+
+@implementation SEMIDIClockSenderLoopbackInterfaceTests
+
+-(void)testLatency {
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    SEMIDIClockSenderLoopbackInterface * interface = [[SEMIDIClockSenderLoopbackInterface alloc] initWithReceivers:@[receiver]];
+    interface.latency = 0.01;
+    
+    double tempo = 125.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t latency = SESecondsToHostTicks(interface.latency);
+    uint64_t time = SECurrentTimeInHostTicks();
+    for ( int i=0; i<24; i++, time += tickDuration ) {
+        SELoopbackTestSendMessage(interface, SEMIDIMessageClock, time);
+    }
+    uint64_t startTime = time;
+    SELoopbackTestSendMessage(interface, SEMIDIMessageClockStart, time-1);
+    for ( int i=0; i<24; i++, time += tickDuration ) {
+        SELoopbackTestSendMessage(interface, SEMIDIMessageClock, time);
+    }
+    
+    XCTAssertTrue(SEMIDIClockReceiverIsClockRunning(receiver));
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), tempo, 1.0e-9);
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(receiver, startTime + latency), 0.0, 1.0e-6);
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(receiver, time + latency), 1.0, 1.0e-6);
+}
+
+-(void)testDropsAndReordering {
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    SEMIDIClockSenderLoopbackInterface * interface = [[SEMIDIClockSenderLoopbackInterface alloc] initWithReceivers:@[receiver]];
+    
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / 120.0) / SEMIDITicksPerBeat);
+    uint64_t time = SECurrentTimeInHostTicks();
+    
+    // Every tick dropped: transport messages still get through
+    interface.dropProbability = 1.0;
+    SELoopbackTestSendMessage(interface, SEMIDIMessageClockStart, time-1);
+    for ( int i=0; i<24; i++, time += tickDuration ) {
+        SELoopbackTestSendMessage(interface, SEMIDIMessageClock, time);
+    }
+    XCTAssertEqual(interface.droppedPacketCount, 24);
+    XCTAssertFalse(SEMIDIClockReceiverIsReceivingTempo(receiver));
+    
+    // Every other tick swapped with the one after it
+    interface.dropProbability = 0.0;
+    interface.reorderProbability = 1.0;
+    for ( int i=0; i<24; i++, time += tickDuration ) {
+        SELoopbackTestSendMessage(interface, SEMIDIMessageClock, time);
+    }
+    XCTAssertEqual(interface.reorderedPacketCount, 12);
+    XCTAssertTrue(SEMIDIClockReceiverIsClockRunning(receiver));
+}
+
+-(void)testRandomSeed {
+    NSMutableArray * results = [NSMutableArray array];
+    for ( int run=0; run<2; run++ ) {
+        SEMIDIClockSenderLoopbackInterface * interface = [[SEMIDIClockSenderLoopbackInterface alloc] initWithReceivers:@[]];
+        interface.randomSeed = 1234;
+        interface.dropProbability = 0.5;
+        for ( int i=0; i<100; i++ ) {
+            SELoopbackTestSendMessage(interface, SEMIDIMessageClock, 1000 + i);
+        }
+        [results addObject:@(interface.droppedPacketCount)];
+    }
+    XCTAssertEqualObjects(results[0], results[1]);
+    XCTAssertGreaterThan([results[0] integerValue], 0);
+    XCTAssertLessThan([results[0] integerValue], 100);
+}
+
+-(void)testSyncErrorBenchmark {
+    // Thousands of short sessions, each at a random tempo, through each transport model
+    SELoopbackBenchmarkResult result = [self runBenchmarkWithSessions:1000 configuration:nil];
+    NSLog(@"Ideal transport: mean error %.3lf ms, maximum %.3lf ms", result.meanError, result.maximumError);
+    XCTAssertLessThan(result.maximumError, 0.5);
+    XCTAssertEqual(result.unsyncedSessions, 0);
+    
+    result = [self runBenchmarkWithSessions:1000 configuration:^(SEMIDIClockSenderLoopbackInterface *interface) {
+        interface.latency = 0.005;
+        interface.jitter = 0.001;
+    }];
+    NSLog(@"Gaussian jitter: mean error %.3lf ms, maximum %.3lf ms", result.meanError, result.maximumError);
+    XCTAssertLessThan(result.meanError, 2.0);
+    XCTAssertEqual(result.unsyncedSessions, 0);
+    
+    result = [self runBenchmarkWithSessions:1000 configuration:^(SEMIDIClockSenderLoopbackInterface *interface) {
+        interface.latency = 0.005;
+        interface.jitter = 0.0005;
+        interface.jitterDistribution = SEMIDIClockLoopbackJitterHeavyTailed;
+    }];
+    NSLog(@"Heavy-tailed jitter: mean error %.3lf ms, maximum %.3lf ms", result.meanError, result.maximumError);
+    XCTAssertLessThan(result.meanError, 5.0);
+    XCTAssertEqual(result.unsyncedSessions, 0);
+    
+    result = [self runBenchmarkWithSessions:1000 configuration:^(SEMIDIClockSenderLoopbackInterface *interface) {
+        interface.bunchingInterval = 0.004;
+    }];
+    NSLog(@"Bunching: mean error %.3lf ms, maximum %.3lf ms", result.meanError, result.maximumError);
+    XCTAssertLessThan(result.meanError, 5.0);
+    XCTAssertEqual(result.unsyncedSessions, 0);
+    
+    result = [self runBenchmarkWithSessions:1000 configuration:^(SEMIDIClockSenderLoopbackInterface *interface) {
+        interface.jitter = 0.0005;
+        interface.dropProbability = 0.01;
+        interface.reorderProbability = 0.01;
+    }];
+    NSLog(@"Drops and reordering: mean error %.3lf ms, maximum %.3lf ms", result.meanError, result.maximumError);
+    XCTAssertLessThan(result.meanError, 10.0);
+}
+
+-(SELoopbackBenchmarkResult)runBenchmarkWithSessions:(int)sessionCount configuration:(void(^)(SEMIDIClockSenderLoopbackInterface * interface))configuration {
+    SELoopbackBenchmarkResult result = {};
+    srandom(1);
+    
+    for ( int session=0; session<sessionCount; session++ ) {
+        @autoreleasepool {
+            SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+            SEMIDIClockSenderLoopbackInterface * interface = [[SEMIDIClockSenderLoopbackInterface alloc] initWithReceivers:@[receiver]];
+            interface.randomSeed = session + 1;
+            if ( configuration ) configuration(interface);
+            
+            // Ideal sender timeline: a beat of tempo ticks, then start, then eight beats
+            double tempo = round(600.0 + 1200.0 * ((double)random() / (double)RAND_MAX)) / 10.0;
+            double tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+            uint64_t origin = SECurrentTimeInHostTicks();
+            int tick = 0;
+            for ( ; tick<SEMIDITicksPerBeat; tick++ ) {
+                SELoopbackTestSendMessage(interface, SEMIDIMessageClock, origin + round(tick * tickDuration));
+            }
+            uint64_t startTime = origin + round(tick * tickDuration);
+            SELoopbackTestSendMessage(interface, SEMIDIMessageClockStart, startTime-1);
+            for ( ; tick<SEMIDITicksPerBeat * 9; tick++ ) {
+                SELoopbackTestSendMessage(interface, SEMIDIMessageClock, origin + round(tick * tickDuration));
+            }
+            [interface flush];
+            
+            if ( !SEMIDIClockReceiverIsClockRunning(receiver) ) {
+                result.unsyncedSessions++;
+                continue;
+            }
+            
+            // Compare the receiver's timeline, allowing for the known latency, with the sender's
+            uint64_t time = origin + round(tick * tickDuration);
+            double idealPosition = SEHostTicksToBeats(time - startTime, tempo);
+            double position = SEMIDIClockReceiverGetTimelinePosition(receiver, time + SESecondsToHostTicks(interface.latency));
+            double error = fabs(SEBeatsToSeconds(position - idealPosition, tempo)) * 1000.0;
+            result.meanError += error / sessionCount;
+            result.maximumError = MAX(result.maximumError, error);
+        }
+    }
+    
+    return result;
+}
+
+@end
@@ -16,6 +16,16 @@
 @property (nonatomic) NSArray * sentMessages;
 @end
 
+static const int kCallbackInterfaceCapacity = 1024;
+
+@interface SEMIDIClockSenderTestCallbackInterface : NSObject <SEMIDIClockSenderInterface> {
+@public
+    uint64_t _tickTimes[kCallbackInterfaceCapacity];
+    int _tickCount;
+    int _messageCallCount;
+}
+@end
+
 @interface SEMIDIClockSenderTests : XCTestCase
 
 @end
@@ -480,6 +490,313 @@
 }
 
 
+-(void)testRenderCallbackDriven {
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    double sampleRate = 44100.0;
+    UInt32 frames = 512;
+    uint64_t bufferDuration = SESecondsToHostTicks(frames / sampleRate);
+    
+    SEMIDIClockSenderTestInterface * interface = [SEMIDIClockSenderTestInterface new];
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:interface];
+    sender.renderCallbackDriven = YES;
+    sender.sampleRate = sampleRate;
+    sender.tempo = tempo;
+    
+    uint64_t time = SECurrentTimeInHostTicks();
+    uint64_t startTime = [sender startAtTime:time + SESecondsToHostTicks(0.1)];
+    
+    // Nothing goes out until the render callback asks for it
+    XCTAssertEqual(interface.sentMessages.count, 0);
+    
+    // Simulate two seconds' worth of render cycles
+    AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid };
+    NSUInteger sentCount = 0;
+    for ( ; time < startTime + SESecondsToHostTicks(2.0); time += bufferDuration ) {
+        timestamp.mHostTime = time;
+        SEMIDIClockSenderRender(sender, &timestamp, frames);
+        
+        // Verify everything sent this cycle falls within this buffer
+        for ( ; sentCount < interface.sentMessages.count; sentCount++ ) {
+            const MIDIPacketList * packetList = [interface.sentMessages[sentCount] bytes];
+            XCTAssertLessThan(packetList->packet[0].timeStamp, time + bufferDuration, @"Message %d sent too early", (int)sentCount);
+            XCTAssertGreaterThanOrEqual(packetList->packet[0].timeStamp + 1, time, @"Message %d sent too late", (int)sentCount);
+        }
+    }
+    
+    // Verify the start message, then a continuous, exact run of ticks
+    XCTAssertGreaterThan(interface.sentMessages.count, 1);
+    const MIDIPacketList * packetList = [interface.sentMessages[0] bytes];
+    XCTAssertEqual((SEMIDIMessage)packetList->packet[0].data[0], SEMIDIMessageClockStart);
+    XCTAssertEqual(packetList->packet[0].timeStamp, startTime - 1);
+    
+    for ( int i=1; i<interface.sentMessages.count; i++ ) {
+        const MIDIPacketList * packetList = [interface.sentMessages[i] bytes];
+        XCTAssertEqual((SEMIDIMessage)packetList->packet[0].data[0], SEMIDIMessageClock, @"Message %d has wrong type", i);
+        XCTAssertEqual(packetList->packet[0].timeStamp, startTime + (i-1) * tickDuration, @"Tick %d has wrong time", i);
+    }
+    XCTAssertEqual(interface.sentMessages.count - 1, (time - startTime + tickDuration - 1) / tickDuration);
+    
+    // Stop: goes out immediately, and ticks cease
+    [sender stop];
+    [interface clear];
+    timestamp.mHostTime = time;
+    SEMIDIClockSenderRender(sender, &timestamp, frames);
+    XCTAssertEqual(interface.sentMessages.count, 0);
+}
+
+-(void)testScheduledTempoChanges {
+    double sampleRate = 44100.0;
+    UInt32 frames = 512;
+    uint64_t bufferDuration = SESecondsToHostTicks(frames / sampleRate);
+    
+    SEMIDIClockSenderTestInterface * interface = [SEMIDIClockSenderTestInterface new];
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:interface];
+    sender.renderCallbackDriven = YES;
+    sender.sampleRate = sampleRate;
+    sender.tempo = 120.0;
+    
+    uint64_t time = SECurrentTimeInHostTicks();
+    uint64_t startTime = [sender startAtTime:time + SESecondsToHostTicks(0.1)];
+    
+    // Ramp up to 180 over a second, starting half a second in, then drop to 90 at beat 8
+    uint64_t rampTime = startTime + SESecondsToHostTicks(0.5);
+    XCTAssertTrue([sender scheduleTempo:180.0 atTime:rampTime curve:SEMIDIClockSenderTempoRampLinear duration:1.0]);
+    XCTAssertTrue([sender scheduleTempo:90.0 atTimelinePosition:8.0 curve:SEMIDIClockSenderTempoStep durationInBeats:0]);
+    
+    // Overlapping changes are refused
+    XCTAssertFalse([sender scheduleTempo:60.0 atTime:rampTime + SESecondsToHostTicks(0.5) curve:SEMIDIClockSenderTempoStep duration:0]);
+    
+    XCTAssertEqualWithAccuracy(SEMIDIClockSenderGetTempoAtTime(sender, rampTime + SESecondsToHostTicks(0.5)), 150.0, 1.0e-6);
+    
+    AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid };
+    for ( ; time < startTime + SESecondsToHostTicks(5.0); time += bufferDuration ) {
+        timestamp.mHostTime = time;
+        SEMIDIClockSenderRender(sender, &timestamp, frames);
+    }
+    
+    // Ticks lie on the tempo curve: one beat at 120 to the ramp, then the ramp's integral (2.5 beats)
+    NSArray * sentMessages = interface.sentMessages;
+    XCTAssertGreaterThan(sentMessages.count, 1 + 10 * SEMIDITicksPerBeat);
+    const MIDIPacketList * packetList = [sentMessages[0] bytes];
+    XCTAssertEqual((SEMIDIMessage)packetList->packet[0].data[0], SEMIDIMessageClockStart);
+    
+    // Tick times are whole host ticks, and at a constant tempo each follows the last by a whole number of host
+    // ticks, so allow a host tick's worth of beats (at the fastest tempo) for each tick sent
+    double hostTickInBeats = SEHostTicksToBeats(1, 180.0);
+    uint64_t lastTickTime = 0;
+    for ( int i=1; i<sentMessages.count; i++ ) {
+        packetList = [sentMessages[i] bytes];
+        XCTAssertEqual((SEMIDIMessage)packetList->packet[0].data[0], SEMIDIMessageClock, @"Message %d has wrong type", i);
+        double position = (double)(i-1) / SEMIDITicksPerBeat;
+        XCTAssertEqualWithAccuracy(SEMIDIClockSenderGetTimelinePosition(sender, packetList->packet[0].timeStamp), position, i * hostTickInBeats, @"Tick %d off curve", i);
+        if ( lastTickTime ) {
+            XCTAssertGreaterThan(packetList->packet[0].timeStamp, lastTickTime, @"Tick %d out of order", i);
+        }
+        lastTickTime = packetList->packet[0].timeStamp;
+    }
+    
+    const MIDIPacketList * rampStartTick = [sentMessages[1 + SEMIDITicksPerBeat] bytes];
+    XCTAssertEqualWithAccuracy(rampStartTick->packet[0].timeStamp, rampTime, 1);
+    const MIDIPacketList * rampEndTick = [sentMessages[1 + (int)(3.5 * SEMIDITicksPerBeat)] bytes];
+    XCTAssertEqualWithAccuracy(rampEndTick->packet[0].timeStamp, rampTime + SESecondsToHostTicks(1.0), 1);
+    
+    // The step to 90 takes place at beat 8
+    uint64_t fastTickDuration = SESecondsToHostTicks((60.0 / 180.0) / SEMIDITicksPerBeat);
+    uint64_t slowTickDuration = SESecondsToHostTicks((60.0 / 90.0) / SEMIDITicksPerBeat);
+    const MIDIPacketList * beforeStep = [sentMessages[8 * SEMIDITicksPerBeat] bytes];
+    const MIDIPacketList * atStep = [sentMessages[1 + 8 * SEMIDITicksPerBeat] bytes];
+    const MIDIPacketList * afterStep = [sentMessages[2 + 8 * SEMIDITicksPerBeat] bytes];
+    XCTAssertEqualWithAccuracy(atStep->packet[0].timeStamp - beforeStep->packet[0].timeStamp, fastTickDuration, 2);
+    XCTAssertEqualWithAccuracy(afterStep->packet[0].timeStamp - atStep->packet[0].timeStamp, slowTickDuration, 2);
+    
+    // Completed changes are folded into the tempo
+    XCTAssertEqual(sender.tempo, 90.0);
+    XCTAssertEqual(SEMIDIClockSenderGetTempo(sender), 90.0);
+    
+    [sender stop];
+}
+
+-(void)testScheduledEvents {
+    double sampleRate = 44100.0;
+    UInt32 frames = 512;
+    uint64_t bufferDuration = SESecondsToHostTicks(frames / sampleRate);
+    
+    SEMIDIClockSenderTestInterface * interface = [SEMIDIClockSenderTestInterface new];
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:interface];
+    sender.renderCallbackDriven = YES;
+    sender.sampleRate = sampleRate;
+    sender.tempo = 120.0;
+    
+    uint64_t time = SECurrentTimeInHostTicks();
+    [sender startAtTime:time + SESecondsToHostTicks(0.1)];
+    
+    // A note across a ramp, scheduled out of order; and two events either side of a later seek
+    const uint8_t noteOn[] = { 0x90, 60, 100 };
+    const uint8_t noteOff[] = { 0x80, 60, 0 };
+    const uint8_t skipped[] = { 0xB0, 1, 1 };
+    const uint8_t resolved[] = { 0xB0, 1, 2 };
+    XCTAssertTrue(SEMIDIClockSenderScheduleEvent(sender, 2.5, noteOff, sizeof(noteOff)));
+    XCTAssertTrue(SEMIDIClockSenderScheduleEvent(sender, 1.0, noteOn, sizeof(noteOn)));
+    XCTAssertTrue([sender scheduleEvent:skipped length:sizeof(skipped) atTimelinePosition:20.0]);
+    XCTAssertTrue([sender scheduleEvent:resolved length:sizeof(resolved) atTimelinePosition:30.0]);
+    XCTAssertFalse(SEMIDIClockSenderScheduleEvent(sender, 1.0, (uint8_t[32]){ 0xF0 }, 32));
+    XCTAssertTrue([sender scheduleTempo:180.0 atTimelinePosition:2.0 curve:SEMIDIClockSenderTempoRampLinear durationInBeats:1.0]);
+    
+    AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid };
+    uint64_t endTime = time + SESecondsToHostTicks(3.0);
+    for ( ; time < endTime; time += bufferDuration ) {
+        timestamp.mHostTime = time;
+        SEMIDIClockSenderRender(sender, &timestamp, frames);
+    }
+    
+    [sender setActiveTimelinePosition:25.0 atTime:0];
+    
+    endTime = time + SESecondsToHostTicks(2.5);
+    for ( ; time < endTime; time += bufferDuration ) {
+        timestamp.mHostTime = time;
+        SEMIDIClockSenderRender(sender, &timestamp, frames);
+    }
+    
+    NSMutableArray * tickTimes = [NSMutableArray array];
+    uint64_t noteOnTime = 0, noteOffTime = 0, resolvedTime = 0;
+    BOOL sentSkipped = NO;
+    for ( NSData * message in interface.sentMessages ) {
+        const MIDIPacketList * packetList = message.bytes;
+        const MIDIPacket * packet = &packetList->packet[0];
+        for ( int i=0; i<packetList->numPackets; i++, packet = MIDIPacketNext(packet) ) {
+            if ( packet->data[0] == SEMIDIMessageClock ) [tickTimes addObject:@(packet->timeStamp)];
+            else if ( packet->data[0] == 0x90 ) noteOnTime = packet->timeStamp;
+            else if ( packet->data[0] == 0x80 ) noteOffTime = packet->timeStamp;
+            else if ( packet->data[0] == 0xB0 && packet->data[2] == 1 ) sentSkipped = YES;
+            else if ( packet->data[0] == 0xB0 && packet->data[2] == 2 ) resolvedTime = packet->timeStamp;
+        }
+    }
+    
+    // Events go out with the ticks for their positions, whether at constant tempo or along the ramp
+    XCTAssertGreaterThan(tickTimes.count, 61);
+    XCTAssertEqual(noteOnTime, [tickTimes[24] unsignedLongLongValue]);
+    XCTAssertEqual(noteOffTime, [tickTimes[60] unsignedLongLongValue]);
+    
+    // The seek passed over one event, and placed the other on the new timeline
+    XCTAssertFalse(sentSkipped);
+    XCTAssertNotEqual(resolvedTime, 0);
+    XCTAssertEqualWithAccuracy(SEMIDIClockSenderGetTimelinePosition(sender, resolvedTime), 30.0, 1.0e-6);
+    XCTAssertTrue([tickTimes containsObject:@(resolvedTime)]);
+    
+    [sender stop];
+}
+
+-(void)testScheduleEventsWhileStopped {
+    double sampleRate = 44100.0;
+    UInt32 frames = 512;
+    uint64_t bufferDuration = SESecondsToHostTicks(frames / sampleRate);
+    
+    SEMIDIClockSenderTestInterface * interface = [SEMIDIClockSenderTestInterface new];
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:interface];
+    sender.renderCallbackDriven = YES;
+    sender.sampleRate = sampleRate;
+    sender.tempo = 120.0;
+    
+    // While stopped, the C function can only fill the intake queue
+    const uint8_t event[] = { 0xB0, 1, 0 };
+    int scheduled = 0;
+    for ( ; scheduled < 256; scheduled++ ) {
+        XCTAssertTrue(SEMIDIClockSenderScheduleEvent(sender, scheduled * 0.01, event, sizeof(event)));
+    }
+    XCTAssertFalse(SEMIDIClockSenderScheduleEvent(sender, scheduled * 0.01, event, sizeof(event)));
+    
+    // The method moves queued events into the schedule, making room
+    for ( ; scheduled < 300; scheduled++ ) {
+        XCTAssertTrue([sender scheduleEvent:event length:sizeof(event) atTimelinePosition:scheduled * 0.01]);
+    }
+    
+    uint64_t time = SECurrentTimeInHostTicks();
+    [sender startAtTime:time + SESecondsToHostTicks(0.1)];
+    
+    AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid };
+    uint64_t endTime = time + SESecondsToHostTicks(2.0);
+    for ( ; time < endTime; time += bufferDuration ) {
+        timestamp.mHostTime = time;
+        SEMIDIClockSenderRender(sender, &timestamp, frames);
+    }
+    
+    int sent = 0;
+    for ( NSData * message in interface.sentMessages ) {
+        const MIDIPacketList * packetList = message.bytes;
+        const MIDIPacket * packet = &packetList->packet[0];
+        for ( int i=0; i<packetList->numPackets; i++, packet = MIDIPacketNext(packet) ) {
+            if ( packet->data[0] == 0xB0 ) sent++;
+        }
+    }
+    XCTAssertEqual(sent, scheduled);
+    
+    [sender stop];
+}
+
+-(void)testBulkConversion {
+    SEMIDIClockSenderTestInterface * interface = [SEMIDIClockSenderTestInterface new];
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:interface];
+    sender.renderCallbackDriven = YES;
+    sender.tempo = 120.0;
+    
+    uint64_t startTime = [sender startAtTime:SECurrentTimeInHostTicks() + SESecondsToHostTicks(0.1)];
+    XCTAssertTrue([sender scheduleTempo:180.0 atTime:startTime + SESecondsToHostTicks(0.5) curve:SEMIDIClockSenderTempoRampLinear duration:1.0]);
+    XCTAssertTrue([sender scheduleTempo:90.0 atTimelinePosition:8.0 curve:SEMIDIClockSenderTempoStep durationInBeats:0]);
+    XCTAssertTrue([sender scheduleTempo:60.0 atTimelinePosition:12.0 curve:SEMIDIClockSenderTempoRampExponential durationInBeats:4.0]);
+    
+    // Times spanning the whole tempo curve, mostly in order, with some out of order
+    int count = 1000;
+    uint64_t times[count];
+    for ( int i=0; i<count; i++ ) {
+        times[i] = startTime - SESecondsToHostTicks(0.1) + (i % 10 == 5 ? count - i : i) * SESecondsToHostTicks(0.01);
+    }
+    
+    double positions[count];
+    SEMIDIClockSenderGetTimelinePositions(sender, times, positions, count);
+    for ( int i=0; i<count; i++ ) {
+        XCTAssertEqualWithAccuracy(positions[i], SEMIDIClockSenderGetTimelinePosition(sender, times[i]), 1.0e-9, @"Position %d", i);
+    }
+    
+    // And back again
+    uint64_t convertedTimes[count];
+    SEMIDIClockSenderGetTimesForTimelinePositions(sender, positions, convertedTimes, count);
+    for ( int i=0; i<count; i++ ) {
+        XCTAssertEqualWithAccuracy(convertedTimes[i], MAX(times[i], startTime), 2, @"Time %d", i);
+    }
+    
+    [sender stop];
+    
+    // Stopped, the timeline stays put
+    SEMIDIClockSenderGetTimelinePositions(sender, times, positions, count);
+    XCTAssertEqual(positions[count-1], SEMIDIClockSenderGetTimelinePosition(sender, 0));
+}
+
+-(void)testSendCallback {
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    
+    SEMIDIClockSenderTestCallbackInterface * interface = [SEMIDIClockSenderTestCallbackInterface new];
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:interface];
+    sender.tempo = tempo;
+    [sender startAtTime:0];
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    
+    // Ticks from the sender thread all went through the callback, evenly spaced
+    int tickCount = __atomic_load_n(&interface->_tickCount, __ATOMIC_ACQUIRE);
+    XCTAssertEqualWithAccuracy(tickCount, SESecondsToHostTicks(0.5) / tickDuration, 4);
+    XCTAssertEqual(interface->_messageCallCount, 0);
+    for ( int i=1; i<tickCount; i++ ) {
+        XCTAssertEqualWithAccuracy(interface->_tickTimes[i] - interface->_tickTimes[i-1], tickDuration, 1, @"Tick %d", i);
+    }
+    
+    // Release the sender with its thread still winding down
+    [sender stop];
+    sender = nil;
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+}
+
 @end
 
 
@@ -522,3 +839,28 @@
 }
 
 @end
+
+
+@implementation SEMIDIClockSenderTestCallbackInterface
+
+static void SEMIDIClockSenderTestCallback(void * context, const MIDIPacketList * packetList) {
+    __unsafe_unretained SEMIDIClockSenderTestCallbackInterface * THIS = (__bridge SEMIDIClockSenderTestCallbackInterface*)context;
+    const MIDIPacket * packet = &packetList->packet[0];
+    for ( int i=0; i<packetList->numPackets; i++, packet = MIDIPacketNext(packet) ) {
+        if ( packet->data[0] == SEMIDIMessageClock && THIS->_tickCount < kCallbackInterfaceCapacity ) {
+            THIS->_tickTimes[THIS->_tickCount] = packet->timeStamp;
+            __atomic_store_n(&THIS->_tickCount, THIS->_tickCount + 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+-(SEMIDIClockSenderSendCallback)sendCallbackWithContext:(void **)context {
+    *context = (__bridge void*)self;
+    return SEMIDIClockSenderTestCallback;
+}
+
+-(void)sendMIDIPacketList:(const MIDIPacketList *)packetList {
+    _messageCallCount++;
+}
+
+@end
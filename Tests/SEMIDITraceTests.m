@@ -0,0 +1,163 @@
+//
+//  SEMIDITraceTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEMIDITrace.h"
+#import "SEMIDIClockReceiver.h"
+
+@interface SEMIDITraceTests : XCTestCase
+@property (nonatomic, strong) NSString * path;
+@end
+
+@implementation SEMIDITraceTests
+
+-(void)setUp {
+    [super setUp];
+    self.path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SEMIDITraceTests.trace"];
+}
+
+-(void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtPath:_path error:NULL];
+    [super tearDown];
+}
+
+-(void)testRecordAndReplay {
+    SEMIDIClockReceiver * receiver = [SEMIDIClockReceiver new];
+    SEMIDITraceRecorder * recorder = [[SEMIDITraceRecorder alloc] initWithPath:_path];
+    XCTAssertNotNil(recorder);
+    receiver.traceRecorder = recorder;
+    
+    // Send a jittery clock, with a start and a live seek
+    uint64_t lastTimestamp = [self sendClockToReceiver:receiver tickCount:24*16 tempo:123.0];
+    double liveTempo = receiver.tempo;
+    double livePosition = [receiver timelinePositionForTime:lastTimestamp];
+    
+    [recorder finish];
+    XCTAssertEqual(recorder.droppedMessageCount, 0);
+    
+    SEMIDITracePlayer * player = [[SEMIDITracePlayer alloc] initWithPath:_path];
+    XCTAssertNotNil(player);
+    XCTAssertEqual(player.messageCount, 24*16 + 3);
+    
+    // Replay twice; output should match exactly, and match the live receiver
+    NSData * firstOutput = [self replay:player realTime:NO];
+    NSData * secondOutput = [self replay:player realTime:NO];
+    XCTAssertEqualObjects(firstOutput, secondOutput);
+    
+    struct { uint64_t timestamp; double tempo; double position; } lastOutput;
+    [firstOutput getBytes:&lastOutput range:NSMakeRange(firstOutput.length - sizeof(lastOutput), sizeof(lastOutput))];
+    XCTAssertEqual(lastOutput.timestamp, lastTimestamp);
+    XCTAssertEqual(lastOutput.tempo, liveTempo);
+    XCTAssertEqual(lastOutput.position, livePosition);
+}
+
+-(void)testRealTimeReplayMatchesFastReplay {
+    SEMIDIClockReceiver * receiver = [SEMIDIClockReceiver new];
+    SEMIDITraceRecorder * recorder = [[SEMIDITraceRecorder alloc] initWithPath:_path];
+    receiver.traceRecorder = recorder;
+    [self sendClockToReceiver:receiver tickCount:48 tempo:120.0];
+    [recorder finish];
+    
+    SEMIDITracePlayer * player = [[SEMIDITracePlayer alloc] initWithPath:_path];
+    NSTimeInterval start = SECurrentTimeInSeconds();
+    NSData * realTimeOutput = [self replay:player realTime:YES];
+    NSTimeInterval duration = SECurrentTimeInSeconds() - start;
+    
+    XCTAssertEqualObjects(realTimeOutput, [self replay:player realTime:NO]);
+    XCTAssertGreaterThanOrEqual(duration, 47 * (60.0 / 120.0) / SEMIDITicksPerBeat);
+    XCTAssertLessThan(duration, 47 * (60.0 / 120.0) / SEMIDITicksPerBeat + 1.1);
+}
+
+-(void)testEnumerateMessages {
+    SEMIDIClockReceiver * receiver = [SEMIDIClockReceiver new];
+    SEMIDITraceRecorder * recorder = [[SEMIDITraceRecorder alloc] initWithPath:_path];
+    receiver.traceRecorder = recorder;
+    uint64_t lastTimestamp = [self sendClockToReceiver:receiver tickCount:48 tempo:120.0];
+    [recorder finish];
+    
+    // Messages come out in order, with the timestamps they were recorded with
+    SEMIDITracePlayer * player = [[SEMIDITracePlayer alloc] initWithPath:_path];
+    NSMutableData * messages = [NSMutableData data];
+    __block uint64_t lastEnumeratedTimestamp = 0;
+    __block int tickCount = 0;
+    [player enumerateMessagesWithBlock:^(uint64_t timestamp, const uint8_t * message, uint16_t length) {
+        XCTAssertGreaterThanOrEqual(timestamp, lastEnumeratedTimestamp);
+        lastEnumeratedTimestamp = timestamp;
+        if ( message[0] == SEMIDIMessageClock ) tickCount++;
+        [messages appendBytes:message length:1];
+    }];
+    
+    XCTAssertEqual(messages.length, player.messageCount);
+    XCTAssertEqual(((const uint8_t*)messages.bytes)[0], SEMIDIMessageClockStart);
+    XCTAssertEqual(((const uint8_t*)messages.bytes)[messages.length-1], SEMIDIMessageClockStop);
+    XCTAssertEqual(tickCount, 48);
+    XCTAssertEqual(lastEnumeratedTimestamp, lastTimestamp);
+}
+
+-(void)testReplacedRecorderIsFinished {
+    SEMIDIClockReceiver * receiver = [SEMIDIClockReceiver new];
+    SEMIDITraceRecorder * recorder = [[SEMIDITraceRecorder alloc] initWithPath:_path];
+    receiver.traceRecorder = recorder;
+    [self sendClockToReceiver:receiver tickCount:48 tempo:120.0];
+    
+    // With no receive call under way, the receiver finishes the recorder as soon as it's removed
+    receiver.traceRecorder = nil;
+    
+    SEMIDITracePlayer * player = [[SEMIDITracePlayer alloc] initWithPath:_path];
+    XCTAssertNotNil(player);
+    XCTAssertEqual(player.messageCount, 48 + 3);
+}
+
+-(uint64_t)sendClockToReceiver:(SEMIDIClockReceiver*)receiver tickCount:(int)tickCount tempo:(double)tempo {
+    char packetListSpace[sizeof(MIDIPacketList) + sizeof(MIDIPacket)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t jitter = SESecondsToHostTicks(0.5e-3);
+    uint64_t time = SECurrentTimeInHostTicks();
+    uint64_t timestamp = 0;
+    srand48(1);
+    
+    MIDIPacket *packet = MIDIPacketListInit(packetList);
+    MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time, 1, (Byte[]){ SEMIDIMessageClockStart });
+    SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+    
+    for ( int i=0; i<tickCount; i++ ) {
+        timestamp = time + i*tickDuration + (uint64_t)(drand48() * jitter);
+        
+        if ( i == tickCount / 2 ) {
+            // Seek to bar 8
+            packet = MIDIPacketListInit(packetList);
+            MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, timestamp-1, 3, (Byte[]){ SEMIDIMessageSongPosition, 32*4 & 0x7F, (32*4 >> 7) & 0x7F });
+            SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+        }
+        
+        packet = MIDIPacketListInit(packetList);
+        MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, timestamp, 1, (Byte[]){ SEMIDIMessageClock });
+        SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+    }
+    
+    packet = MIDIPacketListInit(packetList);
+    MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, timestamp, 1, (Byte[]){ SEMIDIMessageClockStop });
+    SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+    
+    return timestamp;
+}
+
+-(NSData*)replay:(SEMIDITracePlayer*)player realTime:(BOOL)realTime {
+    SEMIDIClockReceiver * receiver = [SEMIDIClockReceiver new];
+    NSMutableData * output = [NSMutableData data];
+    [player replayIntoReceiver:receiver realTime:realTime outputHandler:^(uint64_t timestamp, double tempo, double timelinePosition) {
+        struct { uint64_t timestamp; double tempo; double position; } entry = { timestamp, tempo, timelinePosition };
+        [output appendBytes:&entry length:sizeof(entry)];
+    }];
+    return output;
+}
+
+@end
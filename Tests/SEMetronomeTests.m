@@ -0,0 +1,158 @@
+//
+//  SEMetronomeTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEMetronome.h"
+#import "SECommon.h"
+
+@interface SEMetronomeTests : XCTestCase
+@end
+
+@implementation SEMetronomeTests
+
+-(void)testOfflineClickTiming {
+    [self verifyClickTimingWithTempo:120.0 subdivisions:2 sampleRate:48000.0 duration:2*60*60];
+    [self verifyClickTimingWithTempo:137.0 subdivisions:4 sampleRate:44100.0 duration:60*60];
+    [self verifyClickTimingWithTempo:300.0 subdivisions:1 sampleRate:96000.0 duration:30*60];
+}
+
+-(void)verifyClickTimingWithTempo:(double)tempo subdivisions:(int)subdivisions sampleRate:(double)sampleRate duration:(NSTimeInterval)duration {
+    SEMetronome * metronome = [SEMetronome new];
+    metronome.sampleRate = sampleRate;
+    metronome.tempo = tempo;
+    metronome.subdivisions = subdivisions;
+    
+    uint64_t startTime = SECurrentTimeInHostTicks() + SESecondsToHostTicks(1.0);
+    [metronome startAtTime:startTime];
+    
+    SEAudioEngineRenderCallback render = metronome.renderCallback;
+    
+    const UInt32 maxFrames = 4096;
+    const UInt32 bufferSizes[] = { 64, 256, 441, 1024, 4096, 37, 1, 2048 };
+    const int bufferSizeCount = sizeof(bufferSizes) / sizeof(UInt32);
+    float * left = malloc(maxFrames * sizeof(float));
+    float * right = malloc(maxFrames * sizeof(float));
+    AudioBufferList bufferList = {
+        .mNumberBuffers = 2,
+        .mBuffers = {
+            { .mNumberChannels = 1, .mDataByteSize = maxFrames * sizeof(float), .mData = left },
+            { .mNumberChannels = 1, .mDataByteSize = maxFrames * sizeof(float), .mData = right } }
+    };
+    
+    double framesPerClick = (sampleRate * 60.0) / (tempo * subdivisions);
+    int64_t totalFrames = duration * sampleRate;
+    int64_t frame = -sampleRate / 10;
+    int64_t silentFrames = INT32_MAX;
+    int64_t clickCount = 0;
+    int64_t mistimedClicks = 0;
+    int bufferIndex = 0;
+    
+    while ( frame < totalFrames ) {
+        // Render the next buffer, with timestamps derived from the frame count, as an audio device would
+        UInt32 frames = bufferSizes[bufferIndex++ % bufferSizeCount];
+        AudioTimeStamp timestamp = {
+            .mFlags = kAudioTimeStampHostTimeValid,
+            .mHostTime = frame >= 0 ? startTime + SESecondsToHostTicks(frame / sampleRate) : startTime - SESecondsToHostTicks(-frame / sampleRate)
+        };
+        
+        memset(left, 0, frames * sizeof(float));
+        memset(right, 0, frames * sizeof(float));
+        render(metronome, &timestamp, &bufferList, frames);
+        
+        // Find click onsets: the first sound after a stretch of silence
+        for ( UInt32 i=0; i<frames; i++ ) {
+            if ( left[i] == 0.0f ) {
+                silentFrames++;
+                continue;
+            }
+            if ( silentFrames > 100 ) {
+                int64_t expectedFrame = round(clickCount * framesPerClick);
+                if ( llabs(frame + i - expectedFrame) > 1 ) {
+                    mistimedClicks++;
+                }
+                clickCount++;
+            }
+            silentFrames = 0;
+        }
+        
+        frame += frames;
+    }
+    
+    free(left);
+    free(right);
+    
+    XCTAssertEqual(clickCount, (int64_t)ceil(frame / framesPerClick));
+    XCTAssertEqual(mistimedClicks, 0);
+}
+
+-(void)testSubdivisionChangeWhilePlaying {
+    double sampleRate = 48000.0;
+    SEMetronome * metronome = [SEMetronome new];
+    metronome.sampleRate = sampleRate;
+    metronome.tempo = 120.0;
+    metronome.subdivisions = 4;
+    
+    uint64_t startTime = SECurrentTimeInHostTicks() + SESecondsToHostTicks(1.0);
+    [metronome startAtTime:startTime];
+    
+    SEAudioEngineRenderCallback render = metronome.renderCallback;
+    
+    float left[512], right[512];
+    const UInt32 frames = sizeof(left) / sizeof(float);
+    AudioBufferList bufferList = {
+        .mNumberBuffers = 2,
+        .mBuffers = {
+            { .mNumberChannels = 1, .mDataByteSize = sizeof(left), .mData = left },
+            { .mNumberChannels = 1, .mDataByteSize = sizeof(right), .mData = right } }
+    };
+    
+    // Play two seconds of quarter-beat clicks, then drop to one click per beat for four seconds
+    int64_t framesPerBeat = sampleRate / 2;
+    int64_t changeFrame = 2 * sampleRate;
+    int64_t endFrame = 6 * sampleRate;
+    int64_t silentFrames = INT32_MAX;
+    int64_t clickCount = 0;
+    int64_t offBeatClicks = 0;
+    int64_t frame = 0;
+    int64_t changedFrame = 0;
+    BOOL changed = NO;
+    for ( ; frame < endFrame; frame += frames ) {
+        if ( !changed && frame >= changeFrame ) {
+            metronome.subdivisions = 1;
+            changedFrame = frame;
+            changed = YES;
+        }
+        
+        AudioTimeStamp timestamp = { .mFlags = kAudioTimeStampHostTimeValid, .mHostTime = startTime + SESecondsToHostTicks(frame / sampleRate) };
+        memset(left, 0, sizeof(left));
+        memset(right, 0, sizeof(right));
+        render(metronome, &timestamp, &bufferList, frames);
+        
+        for ( UInt32 i=0; i<frames; i++ ) {
+            if ( left[i] == 0.0f ) {
+                silentFrames++;
+                continue;
+            }
+            if ( silentFrames > 100 && changed ) {
+                int64_t offset = (frame + i) % framesPerBeat;
+                if ( MIN(offset, framesPerBeat - offset) > 1 ) {
+                    offBeatClicks++;
+                }
+                clickCount++;
+            }
+            silentFrames = 0;
+        }
+    }
+    
+    // Every beat after the change is played, and only beats
+    XCTAssertEqual(clickCount, (frame - 1) / framesPerBeat - (changedFrame - 1) / framesPerBeat);
+    XCTAssertEqual(offBeatClicks, 0);
+}
+
+@end
@@ -0,0 +1,99 @@
+//
+//  SEPeerSessionTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SEPeerSession.h"
+
+@interface SEPeerSessionTests : XCTestCase
+@end
+
+@implementation SEPeerSessionTests
+
+// Each session has its own socket, exactly as it would in a separate process
+-(NSArray*)sessionsWithCount:(int)count {
+    uint16_t basePort = 40000 + arc4random_uniform(20000);
+    NSMutableArray * sessions = [NSMutableArray array];
+    for ( int i=0; i<count; i++ ) {
+        SEPeerSession * session = [[SEPeerSession alloc] initWithPort:basePort + i];
+        XCTAssertNotNil(session);
+        for ( int j=0; j<count; j++ ) {
+            if ( j != i ) {
+                [session addPeerWithHost:@"127.0.0.1" port:basePort + j];
+            }
+        }
+        [sessions addObject:session];
+    }
+    return sessions;
+}
+
+-(BOOL)waitFor:(BOOL(^)())condition {
+    NSDate * deadline = [NSDate dateWithTimeIntervalSinceNow:3.0];
+    while ( !condition() && [deadline timeIntervalSinceNow] > 0 ) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    return condition();
+}
+
+-(void)assertSession:(SEPeerSession*)session matchesSession:(SEPeerSession*)reference {
+    XCTAssertEqual(SEPeerSessionIsClockRunning(session), SEPeerSessionIsClockRunning(reference));
+    XCTAssertEqualWithAccuracy(SEPeerSessionGetTempo(session), SEPeerSessionGetTempo(reference), 1.0e-9);
+    uint64_t time = SECurrentTimeInHostTicks();
+    for ( int i=0; i<10; i++, time += SESecondsToHostTicks(0.5) ) {
+        // Same host clock here, so any difference is offset estimation error
+        XCTAssertEqualWithAccuracy(SEPeerSessionGetTimelinePosition(session, time),
+                                   SEPeerSessionGetTimelinePosition(reference, time), 1.0e-3);
+    }
+}
+
+-(void)testSharedTimeline {
+    NSArray * sessions = [self sessionsWithCount:2];
+    SEPeerSession * a = sessions[0];
+    SEPeerSession * b = sessions[1];
+    
+    XCTAssertTrue([self waitFor:^BOOL{ return a.peers.count == 1 && b.peers.count == 1; }]);
+    XCTAssertEqualObjects(a.peers.firstObject, @(b.peerID));
+    XCTAssertEqualWithAccuracy([a clockOffsetForPeer:@(b.peerID)], 0.0, 1.0e-3);
+    
+    a.tempo = 133.0;
+    a.timelinePosition = 8.0;
+    uint64_t startTime = [a startAtTime:0];
+    XCTAssertTrue([self waitFor:^BOOL{ return SEPeerSessionIsClockRunning(b); }]);
+    [self assertSession:b matchesSession:a];
+    XCTAssertEqualWithAccuracy(SEPeerSessionGetTimelinePosition(b, startTime), 8.0, 1.0e-3);
+    
+    // Either peer may make changes
+    b.tempo = 97.5;
+    XCTAssertTrue([self waitFor:^BOOL{ return SEPeerSessionGetTempo(a) == 97.5; }]);
+    [self assertSession:a matchesSession:b];
+    
+    [a stop];
+    XCTAssertTrue([self waitFor:^BOOL{ return !SEPeerSessionIsClockRunning(b); }]);
+    [self assertSession:b matchesSession:a];
+}
+
+-(void)testLateJoiner {
+    uint16_t basePort = 40000 + arc4random_uniform(20000);
+    SEPeerSession * a = [[SEPeerSession alloc] initWithPort:basePort];
+    a.tempo = 110.0;
+    [a startAtTime:0];
+    
+    // A joins the session with the new peer, which picks up the running timeline
+    SEPeerSession * b = [[SEPeerSession alloc] initWithPort:basePort + 1];
+    [a addPeerWithHost:@"127.0.0.1" port:basePort + 1];
+    [b addPeerWithHost:@"127.0.0.1" port:basePort];
+    
+    XCTAssertTrue([self waitFor:^BOOL{ return SEPeerSessionIsClockRunning(b); }]);
+    [self assertSession:b matchesSession:a];
+    
+    // The new peer's defaults don't override the session
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    XCTAssertEqualWithAccuracy(SEPeerSessionGetTempo(a), 110.0, 1.0e-9);
+}
+
+@end
@@ -0,0 +1,119 @@
+//
+//  SERTPMIDISessionTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SERTPMIDISession.h"
+
+@interface SERTPMIDISessionTests : XCTestCase
+@property (nonatomic, strong) SERTPMIDISession * initiator;
+@property (nonatomic, strong) SERTPMIDISession * responder;
+@end
+
+@implementation SERTPMIDISessionTests
+
+-(BOOL)waitFor:(BOOL(^)())condition {
+    NSDate * deadline = [NSDate dateWithTimeIntervalSinceNow:5.0];
+    while ( !condition() && [deadline timeIntervalSinceNow] > 0 ) {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+    return condition();
+}
+
+-(void)setUp {
+    [super setUp];
+    
+    // Each session has its own sockets, exactly as it would in a separate process
+    uint16_t port = 40000 + 2 * arc4random_uniform(10000);
+    self.initiator = [[SERTPMIDISession alloc] initWithName:@"Initiator" port:port];
+    self.responder = [[SERTPMIDISession alloc] initWithName:@"Responder" port:port + 2];
+    XCTAssertNotNil(_initiator);
+    XCTAssertNotNil(_responder);
+    
+    XCTAssertTrue([_initiator connectToHost:@"127.0.0.1" port:port + 2]);
+    
+    SERTPMIDISession * initiator = _initiator;
+    SERTPMIDISession * responder = _responder;
+    XCTAssertTrue([self waitFor:^BOOL{
+        SERTPMIDIParticipant * a = initiator.participants.firstObject;
+        SERTPMIDIParticipant * b = responder.participants.firstObject;
+        return a.synchronized && b.synchronized;
+    }]);
+}
+
+-(void)tearDown {
+    [_initiator disconnect];
+    self.initiator = nil;
+    self.responder = nil;
+    [super tearDown];
+}
+
+-(void)testHandshake {
+    SERTPMIDIParticipant * responderParticipant = _initiator.participants.firstObject;
+    XCTAssertEqualObjects(responderParticipant.name, @"Responder");
+    XCTAssertEqualObjects(responderParticipant.host, @"127.0.0.1");
+    XCTAssertTrue(responderParticipant.connected);
+    XCTAssertLessThan(responderParticipant.latency, 1.0e-3);
+    XCTAssertGreaterThanOrEqual(responderParticipant.roundTripTime, 0.0);
+    
+    SERTPMIDIParticipant * initiatorParticipant = _responder.participants.firstObject;
+    XCTAssertEqualObjects(initiatorParticipant.name, @"Initiator");
+    XCTAssertTrue(initiatorParticipant.connected);
+    
+    [_initiator disconnect];
+    SERTPMIDISession * responder = _responder;
+    XCTAssertTrue([self waitFor:^BOOL{ return responder.participants.count == 0; }]);
+}
+
+-(void)testSenderTimingPreserved {
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    _responder.receiver = receiver;
+    
+    // Send two beats' worth of ticks in bursts, as a congested network would deliver them;
+    // stamped with their sender-side times, they still describe a steady tempo
+    double tempo = 120.0;
+    uint64_t tickDuration = SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat);
+    uint64_t time = SECurrentTimeInHostTicks();
+    for ( int burst=0; burst<8; burst++ ) {
+        for ( int i=0; i<6; i++, time += tickDuration ) {
+            MIDIPacketList packetList;
+            MIDIPacket * packet = MIDIPacketListInit(&packetList);
+            Byte message = SEMIDIMessageClock;
+            MIDIPacketListAdd(&packetList, sizeof(packetList), packet, time, 1, &message);
+            [_initiator sendMIDIPacketList:&packetList];
+        }
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:SEHostTicksToSeconds(tickDuration * 6)]];
+    }
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    
+    // Allow for the session clock's 0.1ms resolution
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), tempo, 0.5);
+}
+
+-(void)testClockSender {
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    _responder.receiver = receiver;
+    
+    SEMIDIClockSender * sender = [[SEMIDIClockSender alloc] initWithInterface:_initiator];
+    sender.tempo = 100.0;
+    [sender startAtTime:0];
+    
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:2.0]];
+    
+    XCTAssertTrue(SEMIDIClockReceiverIsClockRunning(receiver));
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTempo(receiver), 100.0, 0.5);
+    
+    uint64_t time = SECurrentTimeInHostTicks();
+    XCTAssertEqualWithAccuracy(SEMIDIClockReceiverGetTimelinePosition(receiver, time),
+                               SEMIDIClockSenderGetTimelinePosition(sender, time), 0.01);
+    
+    [sender stop];
+}
+
+@end
@@ -0,0 +1,77 @@
+//
+//  SETimelineFollowerTests.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import "SETimelineFollower.h"
+
+@interface SETimelineFollowerTests : XCTestCase
+@end
+
+@implementation SETimelineFollowerTests
+
+-(void)testAbsorbsSmallPhaseErrors {
+    SETimelineFollower follower;
+    SETimelineFollowerInit(&follower);
+    
+    double tempo = 120.0;
+    uint64_t startTime = SECurrentTimeInHostTicks();
+    uint64_t bufferDuration = SESecondsToHostTicks(256.0 / 44100.0);
+    double lastPosition = -1.0;
+    
+    for ( int i=0; i<2000; i++ ) {
+        uint64_t time = startTime + i*bufferDuration;
+        
+        // Source timeline steps forward a little, then back a little
+        double sourcePosition = SEHostTicksToBeats(time - startTime, tempo) + (i >= 500 ? 0.02 : 0.0) - (i >= 1200 ? 0.05 : 0.0);
+        double position = SETimelineFollowerUpdate(&follower, time, sourcePosition, tempo, 0);
+        double ratio = SETimelineFollowerGetCorrectionRatio(&follower);
+        
+        XCTAssertGreaterThan(position, lastPosition);
+        XCTAssertLessThanOrEqual(fabs(ratio - 1.0), follower.maximumCorrection + 1.0e-12);
+        lastPosition = position;
+        
+        if ( i == 500 ) {
+            // Step is not followed straight away
+            XCTAssertGreaterThan(sourcePosition - position, 0.01);
+            XCTAssertGreaterThan(ratio, 1.0);
+        } else if ( i == 1199 || i == 1999 ) {
+            // ...but is absorbed after a few correction windows
+            XCTAssertEqualWithAccuracy(position, sourcePosition, 1.0e-4);
+        }
+    }
+}
+
+-(void)testJumpsOnDiscontinuity {
+    SETimelineFollower follower;
+    SETimelineFollowerInit(&follower);
+    
+    double tempo = 120.0;
+    uint64_t time = SECurrentTimeInHostTicks();
+    uint64_t bufferDuration = SESecondsToHostTicks(256.0 / 44100.0);
+    
+    SETimelineFollowerUpdate(&follower, time, 4.0, tempo, 0);
+    time += bufferDuration;
+    
+    // Small step with a new discontinuity count is followed exactly
+    double sourcePosition = 4.0 + SEHostTicksToBeats(bufferDuration, tempo) + 0.01;
+    XCTAssertEqual(SETimelineFollowerUpdate(&follower, time, sourcePosition, tempo, 1), sourcePosition);
+    XCTAssertEqual(SETimelineFollowerGetCorrectionRatio(&follower), 1.0);
+    time += bufferDuration;
+    
+    // Large step is followed exactly, too
+    sourcePosition = 16.0;
+    XCTAssertEqual(SETimelineFollowerUpdate(&follower, time, sourcePosition, tempo, 1), sourcePosition);
+    XCTAssertEqual(SETimelineFollowerGetCorrectionRatio(&follower), 1.0);
+    time += bufferDuration;
+    
+    // Stopped timeline is followed exactly
+    XCTAssertEqual(SETimelineFollowerUpdate(&follower, time, 8.0, 0.0, 1), 8.0);
+}
+
+@end
@@ -0,0 +1,121 @@
+//
+//  SEAudioPulseClockDetector.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import <CoreAudio/CoreAudioTypes.h>
+#import "SEMIDIClockReceiver.h"
+#import "SEAudioPulseClockGenerator.h"
+
+/*!
+ * Audio pulse clock detector
+ *
+ *  This class follows an analog clock signal arriving on an audio input, such as
+ *  that from a modular synthesizer, a DIN sync box or SEAudioPulseClockGenerator,
+ *  and drives a SEMIDIClockReceiver with it. This lets the receiver lock to analog
+ *  sources, with timestamps precise to within a sample.
+ *
+ *  Call SEAudioPulseClockDetectorProcess with each buffer of input audio. The
+ *  detector finds the leading edge of each pulse in the clock channel using a
+ *  threshold with hysteresis, timestamps it from the buffer's host time, and passes
+ *  the corresponding MIDI clock ticks to the receiver. For sources with fewer than
+ *  24 pulses per quarter note, the ticks between pulses are interpolated evenly,
+ *  once the following pulse arrives.
+ *
+ *  If you provide a run/stop channel, the receiver is also started when the run
+ *  signal goes high - with the next pulse marking the start of the timeline, as
+ *  with DIN sync - and stopped when it goes low.
+ */
+@interface SEAudioPulseClockDetector : NSObject
+
+/*!
+ * Initialise
+ *
+ * @param receiver The receiver to drive
+ */
+-(instancetype)initWithReceiver:(SEMIDIClockReceiver*)receiver;
+
+/*!
+ * Process a buffer of input audio
+ *
+ *  Call this C function from your realtime audio thread, with each input buffer.
+ *  The buffer list must be in non-interleaved floating-point format.
+ *
+ * @param detector The detector
+ * @param timestamp The buffer's timestamp, giving the time of its first frame
+ * @param bufferList The input audio
+ * @param frames The number of frames in the buffer
+ */
+void SEAudioPulseClockDetectorProcess(__unsafe_unretained SEAudioPulseClockDetector * detector,
+                                      const AudioTimeStamp * timestamp,
+                                      const AudioBufferList * bufferList,
+                                      UInt32 frames);
+
+/*!
+ * Reset
+ *
+ *  Forget the previous pulse and run/stop state; do this when changing sources.
+ */
+-(void)reset;
+
+/*!
+ * The receiver, passed during initialisation
+ */
+@property (nonatomic, strong, readonly) SEMIDIClockReceiver * receiver;
+
+/*!
+ * Clock pulses per quarter note of the source (default: 24)
+ *
+ *  One of 1, 2, 4, 24 (DIN sync) or 48.
+ */
+@property (nonatomic) int pulsesPerQuarterNote;
+
+/*!
+ * Detection threshold (default: 0.5)
+ *
+ *  A pulse begins when the signal rises above the threshold plus half the
+ *  hysteresis, and ends when it falls below the threshold minus half the hysteresis.
+ */
+@property (nonatomic) float threshold;
+
+/*!
+ * Hysteresis (default: 0.2)
+ */
+@property (nonatomic) float hysteresis;
+
+/*!
+ * Pulse polarity (default: SEAudioPulseClockPolarityPositive)
+ *
+ *  With negative polarity, pulses and the run signal are expected to go negative,
+ *  and the threshold applies to the inverted signal.
+ */
+@property (nonatomic) SEAudioPulseClockPolarity polarity;
+
+/*!
+ * Index of the buffer carrying clock pulses (default: 0)
+ */
+@property (nonatomic) int clockChannel;
+
+/*!
+ * Index of the buffer carrying the run/stop signal (default: -1, for none)
+ */
+@property (nonatomic) int runStopChannel;
+
+/*!
+ * Sample rate of the input audio (default: 44100)
+ */
+@property (nonatomic) double sampleRate;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
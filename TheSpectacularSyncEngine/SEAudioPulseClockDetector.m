@@ -0,0 +1,222 @@
+//
+//  SEAudioPulseClockDetector.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEAudioPulseClockDetector.h"
+#import "SECommon.h"
+#import <Accelerate/Accelerate.h>
+
+static const int kDefaultPulsesPerQuarterNote        = 24;
+static const float kDefaultThreshold                 = 0.5;
+static const float kDefaultHysteresis                = 0.2;
+static const double kDefaultSampleRate               = 44100.0;
+static const int kMaxEdgesPerBuffer                  = 256;    // Max edges per channel we'll handle in one buffer
+static const NSTimeInterval kMaxInterpolationInterval = 2.5;   // Longest interval between pulses across which we'll interpolate ticks
+
+typedef struct {
+    UInt32 frame;
+    double fraction;
+    BOOL rising;
+} SEAudioPulseClockDetectorEdge;
+
+typedef struct {
+    BOOL high;
+    float lastSample;
+} SEAudioPulseClockDetectorChannelState;
+
+@interface SEAudioPulseClockDetector () {
+    SEAudioPulseClockDetectorChannelState _clockState;
+    SEAudioPulseClockDetectorChannelState _runState;
+    uint64_t _lastPulseTime;
+    uint64_t _pulseIndex;
+    BOOL _startPending;
+    double _hostTicksPerFrame;
+}
+@property (nonatomic, strong, readwrite) SEMIDIClockReceiver * receiver;
+@end
+
+static int SEAudioPulseClockDetectorFindEdges(__unsafe_unretained SEAudioPulseClockDetector * THIS,
+                                              SEAudioPulseClockDetectorChannelState * state,
+                                              const float * samples,
+                                              UInt32 frames,
+                                              SEAudioPulseClockDetectorEdge * edges);
+static uint64_t SEAudioPulseClockDetectorEdgeTime(__unsafe_unretained SEAudioPulseClockDetector * THIS, uint64_t bufferStart, const SEAudioPulseClockDetectorEdge * edge);
+static void SEAudioPulseClockDetectorHandlePulse(__unsafe_unretained SEAudioPulseClockDetector * THIS, uint64_t time);
+static void SEAudioPulseClockDetectorSendMessage(__unsafe_unretained SEAudioPulseClockDetector * THIS, Byte message, uint64_t time);
+
+@implementation SEAudioPulseClockDetector
+
+-(instancetype)initWithReceiver:(SEMIDIClockReceiver *)receiver {
+    if ( !(self = [super init]) ) return nil;
+    
+    self.receiver = receiver;
+    _pulsesPerQuarterNote = kDefaultPulsesPerQuarterNote;
+    _threshold = kDefaultThreshold;
+    _hysteresis = kDefaultHysteresis;
+    _clockChannel = 0;
+    _runStopChannel = -1;
+    self.sampleRate = kDefaultSampleRate;
+    
+    return self;
+}
+
+-(void)reset {
+    memset(&_clockState, 0, sizeof(_clockState));
+    memset(&_runState, 0, sizeof(_runState));
+    _lastPulseTime = 0;
+    _pulseIndex = 0;
+    _startPending = NO;
+}
+
+-(void)setPulsesPerQuarterNote:(int)pulsesPerQuarterNote {
+    NSAssert(pulsesPerQuarterNote == 1 || pulsesPerQuarterNote == 2 || pulsesPerQuarterNote == 4
+             || pulsesPerQuarterNote == 24 || pulsesPerQuarterNote == 48, @"Unsupported pulses per quarter note");
+    _pulsesPerQuarterNote = pulsesPerQuarterNote;
+}
+
+-(void)setSampleRate:(double)sampleRate {
+    _sampleRate = sampleRate;
+    _hostTicksPerFrame = (double)SESecondsToHostTicks(1.0) / sampleRate;
+}
+
+void SEAudioPulseClockDetectorProcess(__unsafe_unretained SEAudioPulseClockDetector * THIS,
+                                      const AudioTimeStamp * timestamp,
+                                      const AudioBufferList * bufferList,
+                                      UInt32 frames) {
+    
+    uint64_t bufferStart = timestamp && (timestamp->mFlags & kAudioTimeStampHostTimeValid)
+                                ? timestamp->mHostTime : SECurrentTimeInHostTicks() - (uint64_t)(frames * THIS->_hostTicksPerFrame);
+    
+    // Find the edges in each channel
+    SEAudioPulseClockDetectorEdge clockEdges[kMaxEdgesPerBuffer];
+    SEAudioPulseClockDetectorEdge runEdges[kMaxEdgesPerBuffer];
+    int clockEdgeCount = 0;
+    int runEdgeCount = 0;
+    
+    if ( THIS->_clockChannel >= 0 && THIS->_clockChannel < bufferList->mNumberBuffers ) {
+        clockEdgeCount = SEAudioPulseClockDetectorFindEdges(THIS, &THIS->_clockState,
+                                                            (const float*)bufferList->mBuffers[THIS->_clockChannel].mData,
+                                                            frames, clockEdges);
+    }
+    if ( THIS->_runStopChannel >= 0 && THIS->_runStopChannel < bufferList->mNumberBuffers ) {
+        runEdgeCount = SEAudioPulseClockDetectorFindEdges(THIS, &THIS->_runState,
+                                                          (const float*)bufferList->mBuffers[THIS->_runStopChannel].mData,
+                                                          frames, runEdges);
+    }
+    
+    // Handle edges in time order, run/stop changes first where they coincide with a pulse
+    for ( int clockIndex = 0, runIndex = 0; clockIndex < clockEdgeCount || runIndex < runEdgeCount; ) {
+        if ( runIndex < runEdgeCount && (clockIndex == clockEdgeCount || runEdges[runIndex].frame <= clockEdges[clockIndex].frame) ) {
+            SEAudioPulseClockDetectorEdge * edge = &runEdges[runIndex++];
+            if ( edge->rising ) {
+                // Run: the next pulse marks the start of the timeline
+                THIS->_startPending = YES;
+                THIS->_pulseIndex = 0;
+            } else {
+                THIS->_startPending = NO;
+                SEAudioPulseClockDetectorSendMessage(THIS, SEMIDIMessageClockStop, SEAudioPulseClockDetectorEdgeTime(THIS, bufferStart, edge));
+            }
+        } else {
+            SEAudioPulseClockDetectorEdge * edge = &clockEdges[clockIndex++];
+            if ( edge->rising ) {
+                SEAudioPulseClockDetectorHandlePulse(THIS, SEAudioPulseClockDetectorEdgeTime(THIS, bufferStart, edge));
+            }
+        }
+    }
+}
+
+static int SEAudioPulseClockDetectorFindEdges(__unsafe_unretained SEAudioPulseClockDetector * THIS,
+                                              SEAudioPulseClockDetectorChannelState * state,
+                                              const float * samples,
+                                              UInt32 frames,
+                                              SEAudioPulseClockDetectorEdge * edges) {
+    
+    float sign = THIS->_polarity == SEAudioPulseClockPolarityNegative ? -1.0f : 1.0f;
+    float highThreshold = THIS->_threshold + (THIS->_hysteresis / 2.0f);
+    float lowThreshold = THIS->_threshold - (THIS->_hysteresis / 2.0f);
+    
+    // Most buffers contain no crossing at all: check the extremes first, so we only scan those that do
+    float maximum, minimum;
+    vDSP_maxv(samples, 1, &maximum, frames);
+    vDSP_minv(samples, 1, &minimum, frames);
+    float peak = sign > 0.0f ? maximum : -minimum;
+    float trough = sign > 0.0f ? minimum : -maximum;
+    if ( (!state->high && peak < highThreshold) || (state->high && trough > lowThreshold) ) {
+        state->lastSample = sign * samples[frames-1];
+        return 0;
+    }
+    
+    int edgeCount = 0;
+    float lastSample = state->lastSample;
+    BOOL high = state->high;
+    for ( UInt32 i=0; i<frames; i++ ) {
+        float sample = sign * samples[i];
+        if ( !high ? sample >= highThreshold : sample <= lowThreshold ) {
+            high = !high;
+            if ( edgeCount < kMaxEdgesPerBuffer ) {
+                // Interpolate the crossing between this sample and the last, for a sub-sample timestamp
+                float crossing = high ? highThreshold : lowThreshold;
+                double fraction = sample != lastSample ? (sample - crossing) / (sample - lastSample) : 0.0;
+                edges[edgeCount++] = (SEAudioPulseClockDetectorEdge) {
+                    .frame = i,
+                    .fraction = MAX(0.0, MIN(1.0, fraction)),
+                    .rising = high
+                };
+            }
+        }
+        lastSample = sample;
+    }
+    
+    state->high = high;
+    state->lastSample = lastSample;
+    return edgeCount;
+}
+
+static uint64_t SEAudioPulseClockDetectorEdgeTime(__unsafe_unretained SEAudioPulseClockDetector * THIS, uint64_t bufferStart, const SEAudioPulseClockDetectorEdge * edge) {
+    // The crossing may fall just before the first frame, between it and the last sample of the previous buffer
+    return (uint64_t)((int64_t)bufferStart + (int64_t)round((edge->frame - edge->fraction) * THIS->_hostTicksPerFrame));
+}
+
+static void SEAudioPulseClockDetectorHandlePulse(__unsafe_unretained SEAudioPulseClockDetector * THIS, uint64_t time) {
+    int pulsesPerQuarterNote = THIS->_pulsesPerQuarterNote;
+    
+    if ( pulsesPerQuarterNote > SEMIDITicksPerBeat ) {
+        // More pulses than ticks: send a tick for every few pulses, counting from the start
+        if ( THIS->_pulseIndex++ % (pulsesPerQuarterNote / SEMIDITicksPerBeat) != 0 ) {
+            return;
+        }
+    } else if ( pulsesPerQuarterNote < SEMIDITicksPerBeat ) {
+        // Fewer pulses than ticks: fill in the ticks since the last pulse, evenly spaced
+        uint64_t lastPulseTime = THIS->_lastPulseTime;
+        if ( lastPulseTime && time > lastPulseTime && time - lastPulseTime < SESecondsToHostTicks(kMaxInterpolationInterval) ) {
+            int ticksPerPulse = SEMIDITicksPerBeat / pulsesPerQuarterNote;
+            double interval = (double)(time - lastPulseTime) / ticksPerPulse;
+            for ( int i=1; i<ticksPerPulse; i++ ) {
+                SEAudioPulseClockDetectorSendMessage(THIS, SEMIDIMessageClock, lastPulseTime + (uint64_t)round(i * interval));
+            }
+        }
+    }
+    
+    THIS->_lastPulseTime = time;
+    
+    if ( THIS->_startPending ) {
+        // This pulse marks the start of the timeline
+        THIS->_startPending = NO;
+        SEAudioPulseClockDetectorSendMessage(THIS, SEMIDIMessageClockStart, time-1);
+    }
+    
+    SEAudioPulseClockDetectorSendMessage(THIS, SEMIDIMessageClock, time);
+}
+
+static void SEAudioPulseClockDetectorSendMessage(__unsafe_unretained SEAudioPulseClockDetector * THIS, Byte message, uint64_t time) {
+    MIDIPacketList packetList;
+    MIDIPacket *packet = MIDIPacketListInit(&packetList);
+    MIDIPacketListAdd(&packetList, sizeof(packetList), packet, time, 1, &message);
+    SEMIDIClockReceiverReceivePacketList(THIS->_receiver, &packetList);
+}
+
+@end
@@ -0,0 +1,115 @@
+//
+//  SEAudioPulseClockGenerator.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import <CoreAudio/CoreAudioTypes.h>
+#import "SEMIDIClockSender.h"
+
+/*!
+ * Pulse polarity
+ */
+typedef enum {
+    SEAudioPulseClockPolarityPositive,      //!< Pulses and run level go positive from a resting level of zero
+    SEAudioPulseClockPolarityNegative       //!< Pulses and run level go negative from a resting level of zero
+} SEAudioPulseClockPolarity;
+
+/*!
+ * Audio pulse clock generator
+ *
+ *  This class renders an analog clock signal into an audio buffer, following the
+ *  timeline of a SEMIDIClockSender. Use it to drive modular synthesizers, DIN sync
+ *  boxes and other devices that take a pulse clock from an audio output.
+ *
+ *  Call SEAudioPulseClockGeneratorRender from your render callback, once per render
+ *  cycle. While the sender's clock is running, it writes a pulse for each clock step
+ *  into the clock channel, on the exact frame at which that step falls, and holds the
+ *  run/stop channel high. Both channels are otherwise silent. The channels are
+ *  overwritten, not mixed with any existing audio.
+ *
+ *  Pulses are placed according to the sender's timeline at the start of each buffer,
+ *  so the sender's tempo and timeline changes are followed. Stops take effect from
+ *  the next buffer.
+ */
+@interface SEAudioPulseClockGenerator : NSObject
+
+/*!
+ * Initialise
+ *
+ * @param sender The sender whose timeline to follow
+ */
+-(instancetype)initWithSender:(SEMIDIClockSender*)sender;
+
+/*!
+ * Render the clock signal
+ *
+ *  Call this C function from your realtime audio thread's render callback. The
+ *  buffer list must be in non-interleaved floating-point format.
+ *
+ * @param generator The generator
+ * @param timestamp The buffer's timestamp, as passed to your render callback
+ * @param ioData The buffer list to write to
+ * @param frames The number of frames in the buffer
+ */
+void SEAudioPulseClockGeneratorRender(__unsafe_unretained SEAudioPulseClockGenerator * generator,
+                                      const AudioTimeStamp * timestamp,
+                                      AudioBufferList * ioData,
+                                      UInt32 frames);
+
+/*!
+ * The sender, passed during initialisation
+ */
+@property (nonatomic, strong, readonly) SEMIDIClockSender * sender;
+
+/*!
+ * Clock pulses per quarter note (default: 24)
+ *
+ *  One of 1, 2, 4, 24 (DIN sync) or 48.
+ */
+@property (nonatomic) int pulsesPerQuarterNote;
+
+/*!
+ * Pulse width, in seconds (default: 0.005)
+ *
+ *  Pulses are shortened to at most half the pulse interval, at high tempos.
+ */
+@property (nonatomic) NSTimeInterval pulseWidth;
+
+/*!
+ * Pulse polarity (default: SEAudioPulseClockPolarityPositive)
+ */
+@property (nonatomic) SEAudioPulseClockPolarity polarity;
+
+/*!
+ * Pulse amplitude, from 0 to 1 (default: 1)
+ */
+@property (nonatomic) float amplitude;
+
+/*!
+ * Index of the buffer to write clock pulses to (default: 0), or -1 for none
+ */
+@property (nonatomic) int clockChannel;
+
+/*!
+ * Index of the buffer to write the run/stop signal to (default: 1), or -1 for none
+ */
+@property (nonatomic) int runStopChannel;
+
+/*!
+ * Sample rate of your audio (default: 44100)
+ */
+@property (nonatomic) double sampleRate;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,128 @@
+//
+//  SEAudioPulseClockGenerator.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEAudioPulseClockGenerator.h"
+#import "SECommon.h"
+#import <Accelerate/Accelerate.h>
+
+static const int kDefaultPulsesPerQuarterNote        = 24;
+static const NSTimeInterval kDefaultPulseWidth       = 0.005;
+static const double kDefaultSampleRate               = 44100.0;
+static const int kDefaultRunStopChannel              = 1;
+static const double kDiscontinuityThreshold          = 0.5;    // Deviation from the expected timeline, in pulses, beyond which we treat the timeline as having jumped
+
+@interface SEAudioPulseClockGenerator () {
+    int64_t _lastPulse;
+    double _expectedPosition;
+    UInt32 _remainingPulseFrames;
+}
+@property (nonatomic, strong, readwrite) SEMIDIClockSender * sender;
+@end
+
+@implementation SEAudioPulseClockGenerator
+
+-(instancetype)initWithSender:(SEMIDIClockSender *)sender {
+    if ( !(self = [super init]) ) return nil;
+    
+    self.sender = sender;
+    _pulsesPerQuarterNote = kDefaultPulsesPerQuarterNote;
+    _pulseWidth = kDefaultPulseWidth;
+    _amplitude = 1.0;
+    _clockChannel = 0;
+    _runStopChannel = kDefaultRunStopChannel;
+    _sampleRate = kDefaultSampleRate;
+    _lastPulse = -1;
+    _expectedPosition = NAN;
+    
+    return self;
+}
+
+-(void)setPulsesPerQuarterNote:(int)pulsesPerQuarterNote {
+    NSAssert(pulsesPerQuarterNote == 1 || pulsesPerQuarterNote == 2 || pulsesPerQuarterNote == 4
+             || pulsesPerQuarterNote == 24 || pulsesPerQuarterNote == 48, @"Unsupported pulses per quarter note");
+    _pulsesPerQuarterNote = pulsesPerQuarterNote;
+}
+
+void SEAudioPulseClockGeneratorRender(__unsafe_unretained SEAudioPulseClockGenerator * THIS,
+                                      const AudioTimeStamp * timestamp,
+                                      AudioBufferList * ioData,
+                                      UInt32 frames) {
+    
+    float * clock = THIS->_clockChannel >= 0 && THIS->_clockChannel < ioData->mNumberBuffers
+                        ? (float*)ioData->mBuffers[THIS->_clockChannel].mData : NULL;
+    float * run = THIS->_runStopChannel >= 0 && THIS->_runStopChannel < ioData->mNumberBuffers
+                        ? (float*)ioData->mBuffers[THIS->_runStopChannel].mData : NULL;
+    float level = THIS->_polarity == SEAudioPulseClockPolarityNegative ? -THIS->_amplitude : THIS->_amplitude;
+    
+    if ( clock ) vDSP_vclr(clock, 1, frames);
+    if ( run ) vDSP_vclr(run, 1, frames);
+    
+    // Finish off a pulse begun in the last buffer
+    if ( THIS->_remainingPulseFrames ) {
+        UInt32 pulseFrames = MIN(THIS->_remainingPulseFrames, frames);
+        if ( clock ) vDSP_vfill(&level, clock, 1, pulseFrames);
+        THIS->_remainingPulseFrames -= pulseFrames;
+    }
+    
+    __unsafe_unretained SEMIDIClockSender * sender = THIS->_sender;
+    double tempo = SEMIDIClockSenderGetTempo(sender);
+    if ( !SEMIDIClockSenderIsStarted(sender) || tempo <= 0.0 ) {
+        THIS->_lastPulse = -1;
+        THIS->_expectedPosition = NAN;
+        return;
+    }
+    
+    // Work in pulses, and place pulses by frame from the buffer start position, so only
+    // the start of the buffer needs converting from host ticks
+    int pulsesPerQuarterNote = THIS->_pulsesPerQuarterNote;
+    double framesPerPulse = (THIS->_sampleRate * 60.0) / (tempo * pulsesPerQuarterNote);
+    double bufferPulses = frames / framesPerPulse;
+    uint64_t bufferStart = timestamp->mHostTime;
+    double startPosition = SEMIDIClockSenderGetTimelinePosition(sender, bufferStart) * pulsesPerQuarterNote;
+    if ( startPosition == 0.0 ) {
+        // The sender reports zero for all times before its timeline began: place the start within or
+        // before this buffer, from the position at the end of the buffer
+        uint64_t bufferEnd = bufferStart + SESecondsToHostTicks(frames / THIS->_sampleRate);
+        startPosition = (SEMIDIClockSenderGetTimelinePosition(sender, bufferEnd) * pulsesPerQuarterNote) - bufferPulses;
+    }
+    
+    // Look from half a frame before the buffer start, to pick up a pulse rounded up to the end of the last buffer
+    double searchStart = startPosition - (0.5 / framesPerPulse);
+    
+    if ( isnan(THIS->_expectedPosition) || fabs(startPosition - THIS->_expectedPosition) > kDiscontinuityThreshold ) {
+        // Timeline started or jumped: begin afresh from here
+        THIS->_lastPulse = (int64_t)ceil(searchStart) - 1;
+    }
+    THIS->_expectedPosition = startPosition + bufferPulses;
+    
+    UInt32 pulseFrames = MAX(1, MIN(round(THIS->_pulseWidth * THIS->_sampleRate), floor(framesPerPulse / 2.0)));
+    
+    for ( int64_t pulse = MAX(0, MAX(THIS->_lastPulse + 1, (int64_t)ceil(searchStart))); ; pulse++ ) {
+        double frame = round((pulse - startPosition) * framesPerPulse);
+        if ( frame >= frames ) {
+            break;
+        }
+        if ( frame < 0.0 ) {
+            frame = 0.0;
+        }
+        
+        UInt32 offset = (UInt32)frame;
+        UInt32 length = MIN(pulseFrames, frames - offset);
+        if ( clock ) vDSP_vfill(&level, clock + offset, 1, length);
+        THIS->_remainingPulseFrames = pulseFrames - length;
+        THIS->_lastPulse = pulse;
+    }
+    
+    if ( run && startPosition + bufferPulses > 0.0 ) {
+        // Hold the run line high from the start of the timeline
+        UInt32 offset = startPosition >= 0.0 ? 0 : (UInt32)MIN(frames, round(-startPosition * framesPerPulse));
+        vDSP_vfill(&level, run + offset, 1, frames - offset);
+    }
+}
+
+@end
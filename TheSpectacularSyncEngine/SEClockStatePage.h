@@ -0,0 +1,151 @@
+//
+//  SEClockStatePage.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+//  Read-only client interface to the shared clock state page published by
+//  SEClockStatePublisher. This header is plain C, with no dependencies on the
+//  rest of the engine, so it can be dropped into plugin hosts, visualisers and
+//  other processes on the same machine.
+//
+//  Usage:
+//
+//      const SEClockStatePage * page = SEClockStatePageMap("/path/to/clock.state");
+//      SEClockState state;
+//      if ( page && SEClockStatePageRead(page, &state) ) {
+//          double position = SEClockStateGetTimelinePosition(&state, mach_absolute_time());
+//      }
+//
+//  Reads make no system calls: the page is updated with a sequence lock, and a
+//  read simply retries if it overlaps with an update.
+//
+
+#ifndef SEClockStatePage_h
+#define SEClockStatePage_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define SEClockStatePageMagic       0x53454353  // "SECS"
+#define SEClockStatePageVersion     1
+#define SEClockStatePageSize        4096
+#define SEClockStatePageMaxRetries  1000
+
+/*!
+ * Layout of the shared page
+ *
+ *  The timeline position at host time t, while running, is
+ *  position + (t - timeBase) * beatsPerHostTick, for t after timeBase, and
+ *  position otherwise. While stopped, it is simply position.
+ */
+typedef struct {
+    uint32_t magic;                     //!< SEClockStatePageMagic
+    uint32_t version;                   //!< SEClockStatePageVersion
+    uint32_t timebaseNumerator;         //!< Publisher's host timebase numerator (as per mach_timebase_info)
+    uint32_t timebaseDenominator;       //!< Publisher's host timebase denominator
+    uint32_t sequence;                  //!< Sequence lock: odd while an update is in progress
+    uint32_t generation;                //!< Increments whenever the timeline jumps: start, stop or seek
+    uint32_t running;                   //!< Whether the timeline is advancing
+    uint32_t reserved;
+    double tempo;                       //!< Tempo, in beats per minute
+    double beatsPerHostTick;            //!< Tempo, in beats per host tick
+    uint64_t timeBase;                  //!< Host time at which the timeline was at 'position'
+    double position;                    //!< Timeline position at timeBase while running, or the current position while stopped, in beats
+} SEClockStatePage;
+
+/*!
+ * A consistent snapshot of the clock state
+ */
+typedef struct {
+    int running;
+    uint32_t generation;
+    double tempo;
+    double beatsPerHostTick;
+    uint64_t timeBase;
+    double position;
+} SEClockState;
+
+/*!
+ * Map a clock state page, read-only
+ *
+ * @param path Path of the page file, as given to the publisher
+ * @return The page, or NULL on error
+ */
+static inline const SEClockStatePage * SEClockStatePageMap(const char * path) {
+    int fd = open(path, O_RDONLY);
+    if ( fd < 0 ) return NULL;
+    void * page = mmap(NULL, SEClockStatePageSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return page == MAP_FAILED ? NULL : (const SEClockStatePage *)page;
+}
+
+/*!
+ * Unmap a clock state page
+ *
+ * @param page The page
+ */
+static inline void SEClockStatePageUnmap(const SEClockStatePage * page) {
+    munmap((void *)page, SEClockStatePageSize);
+}
+
+/*!
+ * Read a consistent snapshot of the clock state
+ *
+ * @param page The page
+ * @param state On output, the state
+ * @return 1 on success, or 0 if the page isn't valid, or is being updated continuously
+ */
+static inline int SEClockStatePageRead(const SEClockStatePage * page, SEClockState * state) {
+    if ( page->magic != SEClockStatePageMagic || page->version != SEClockStatePageVersion ) {
+        return 0;
+    }
+    
+    for ( int i=0; i<SEClockStatePageMaxRetries; i++ ) {
+        uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if ( sequence & 1 ) {
+            continue;
+        }
+        
+        state->running = page->running != 0;
+        state->generation = page->generation;
+        state->tempo = page->tempo;
+        state->beatsPerHostTick = page->beatsPerHostTick;
+        state->timeBase = page->timeBase;
+        state->position = page->position;
+        
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == sequence ) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/*!
+ * Get the timeline position for a host time
+ *
+ * @param state The state, from SEClockStatePageRead
+ * @param hostTime The host time, in host ticks
+ * @return The timeline position, in beats
+ */
+static inline double SEClockStateGetTimelinePosition(const SEClockState * state, uint64_t hostTime) {
+    if ( !state->running || hostTime <= state->timeBase ) {
+        return state->position;
+    }
+    return state->position + (double)(hostTime - state->timeBase) * state->beatsPerHostTick;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+//
+//  SEClockStatePublisher.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import "SEClockStatePage.h"
+
+/*!
+ * Clock state publisher
+ *
+ *  This class publishes the transport state - whether the timeline is running, the
+ *  tempo, time base and position - into a memory-mapped page, so that other processes
+ *  on the same machine can follow the timeline without running their own MIDI clock
+ *  receiver. Those processes use the plain C header SEClockStatePage.h to map the
+ *  page and compute the timeline position for any host time, without system calls.
+ *
+ *  To publish the state of a SEMIDIClockSender or SEMIDIClockReceiver, assign a
+ *  publisher to its statePublisher property. Otherwise, publish state yourself with
+ *  SEClockStatePublisherPublish.
+ *
+ *  The page is a file: place it somewhere all the processes involved can reach, such
+ *  as a shared app group container.
+ */
+@interface SEClockStatePublisher : NSObject
+
+/*!
+ * Initialise
+ *
+ *  Creates the page file, or takes over an existing one, and publishes a stopped state.
+ *
+ * @param path Path of the page file
+ * @return The publisher, or nil if the file couldn't be created
+ */
+-(instancetype)initWithPath:(NSString*)path;
+
+/*!
+ * Publish state
+ *
+ *  This C function may be used from any thread, including realtime threads; it
+ *  does not block, except briefly to wait for another thread's update of the page to finish.
+ *
+ * @param publisher The publisher
+ * @param running Whether the timeline is advancing
+ * @param tempo The tempo, in beats per minute
+ * @param timeBase The host time at which the timeline was at the given position, if running
+ * @param position The timeline position at timeBase if running, or the current position otherwise, in beats
+ * @param generation A count that increases whenever the timeline jumps
+ */
+void SEClockStatePublisherPublish(__unsafe_unretained SEClockStatePublisher * publisher,
+                                  BOOL running,
+                                  double tempo,
+                                  uint64_t timeBase,
+                                  double position,
+                                  uint32_t generation);
+
+/*!
+ * Publish state, as the only writer
+ *
+ *  Equivalent to SEClockStatePublisherPublish, but wait-free, for when only one thread
+ *  publishes at a time, such as when all updates are made under the same lock. It must
+ *  not overlap with any other update to the same publisher.
+ *
+ *  SEMIDIClockSender uses this for its statePublisher, so don't publish to a publisher
+ *  from elsewhere while it's assigned to a sender.
+ *
+ * @param publisher The publisher
+ * @param running Whether the timeline is advancing
+ * @param tempo The tempo, in beats per minute
+ * @param timeBase The host time at which the timeline was at the given position, if running
+ * @param position The timeline position at timeBase if running, or the current position otherwise, in beats
+ * @param generation A count that increases whenever the timeline jumps
+ */
+void SEClockStatePublisherPublishExclusive(__unsafe_unretained SEClockStatePublisher * publisher,
+                                           BOOL running,
+                                           double tempo,
+                                           uint64_t timeBase,
+                                           double position,
+                                           uint32_t generation);
+
+/*!
+ * The page file path
+ */
+@property (nonatomic, strong, readonly) NSString * path;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,133 @@
+//
+//  SEClockStatePublisher.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEClockStatePublisher.h"
+#import "SECommon.h"
+#import <mach/mach_time.h>
+#import <sys/mman.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+@interface SEClockStatePublisher () {
+    SEClockStatePage * _page;
+}
+@property (nonatomic, strong, readwrite) NSString * path;
+@end
+
+@implementation SEClockStatePublisher
+
+-(instancetype)initWithPath:(NSString *)path {
+    if ( !(self = [super init]) ) return nil;
+    
+    self.path = path;
+    
+    int fd = open(path.UTF8String, O_RDWR | O_CREAT, 0644);
+    if ( fd < 0 || ftruncate(fd, SEClockStatePageSize) != 0 ) {
+        NSLog(@"Couldn't create clock state page at %@: %s", path, strerror(errno));
+        if ( fd >= 0 ) close(fd);
+        return nil;
+    }
+    
+    void * page = mmap(NULL, SEClockStatePageSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( page == MAP_FAILED ) {
+        NSLog(@"Couldn't map clock state page at %@: %s", path, strerror(errno));
+        return nil;
+    }
+    _page = page;
+    
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    _page->timebaseNumerator = timebase.numer;
+    _page->timebaseDenominator = timebase.denom;
+    _page->version = SEClockStatePageVersion;
+    
+    // Leave an in-progress update from an earlier publisher behind
+    if ( _page->sequence & 1 ) {
+        _page->sequence++;
+    }
+    
+    SEClockStatePublisherPublish(self, NO, 0.0, 0, 0.0, 0);
+    
+    // Mark the page valid last, once it's complete
+    __atomic_store_n(&_page->magic, SEClockStatePageMagic, __ATOMIC_RELEASE);
+    
+    return self;
+}
+
+-(void)dealloc {
+    if ( _page ) {
+        // Leave the page showing a stopped clock, for any clients still watching
+        SEClockStatePublisherPublish(self, NO, 0.0, 0, 0.0, _page->generation + 1);
+        munmap(_page, SEClockStatePageSize);
+    }
+}
+
+static void SEClockStatePublisherWritePage(SEClockStatePage * page,
+                                           BOOL running,
+                                           double tempo,
+                                           double beatsPerHostTick,
+                                           uint64_t timeBase,
+                                           double position,
+                                           uint32_t generation) {
+    // Called while the sequence is odd
+    page->running = running ? 1 : 0;
+    page->generation = generation;
+    page->tempo = tempo;
+    page->beatsPerHostTick = beatsPerHostTick;
+    page->timeBase = timeBase;
+    page->position = position;
+}
+
+void SEClockStatePublisherPublish(__unsafe_unretained SEClockStatePublisher * THIS,
+                                  BOOL running,
+                                  double tempo,
+                                  uint64_t timeBase,
+                                  double position,
+                                  uint32_t generation) {
+    SEClockStatePage * page = THIS->_page;
+    
+    // Use the same conversion as the engine, so clients compute identical positions
+    SETempoConversion conversion;
+    SETempoConversionSetTempo(&conversion, MAX(0.0, tempo));
+    
+    // Take the sequence lock, by moving the sequence from even to odd
+    uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+    while ( (sequence & 1) || !__atomic_compare_exchange_n(&page->sequence, &sequence, sequence + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ) {
+        sequence = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    
+    SEClockStatePublisherWritePage(page, running, tempo, conversion.beatsPerHostTick, timeBase, position, generation);
+    
+    // Release the lock
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void SEClockStatePublisherPublishExclusive(__unsafe_unretained SEClockStatePublisher * THIS,
+                                           BOOL running,
+                                           double tempo,
+                                           uint64_t timeBase,
+                                           double position,
+                                           uint32_t generation) {
+    SEClockStatePage * page = THIS->_page;
+    
+    SETempoConversion conversion;
+    SETempoConversionSetTempo(&conversion, MAX(0.0, tempo));
+    
+    // We're the only writer, so just mark the page as being updated, without contending for it
+    uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    
+    SEClockStatePublisherWritePage(page, running, tempo, conversion.beatsPerHostTick, timeBase, position, generation);
+    
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+@end
@@ -100,6 +100,85 @@ double SEHostTicksToBeats(uint64_t ticks, double tempo);
  */
 uint64_t SEBeatsToHostTicks(double beats, double tempo);
 
+/*!
+ * Tempo conversion context
+ *
+ *  Holds the factors for converting between host ticks and beats at a given
+ *  tempo, so that conversions on a realtime thread are a single multiplication.
+ *  Results match SEHostTicksToBeats and SEBeatsToHostTicks, to within rounding.
+ *
+ *  Refresh the context with SETempoConversionSetTempo whenever the tempo changes.
+ */
+typedef struct {
+    double tempo;               //!< The tempo, in beats per minute
+    double hostTicksPerBeat;    //!< Host ticks per beat, at this tempo
+    double beatsPerHostTick;    //!< Beats per host tick, at this tempo
+} SETempoConversion;
+
+/*!
+ * Set the tempo of a conversion context
+ *
+ * @param conversion The conversion context
+ * @param tempo The tempo, in beats per minute; zero gives zero for all conversions
+ */
+void SETempoConversionSetTempo(SETempoConversion * conversion, double tempo);
+
+/*!
+ * Convert host ticks to beats (quarter notes), using a conversion context
+ *
+ * @param conversion The conversion context
+ * @param ticks The time in host ticks
+ * @return The time in beats for the context's tempo
+ */
+static inline double SETempoConversionHostTicksToBeats(const SETempoConversion * conversion, uint64_t ticks) {
+    return ticks * conversion->beatsPerHostTick;
+}
+
+/*!
+ * Convert beats (quarter notes) to host ticks, using a conversion context
+ *
+ * @param conversion The conversion context
+ * @param beats The time in beats
+ * @return The time in host ticks for the context's tempo
+ */
+static inline uint64_t SETempoConversionBeatsToHostTicks(const SETempoConversion * conversion, double beats) {
+    return beats * conversion->hostTicksPerBeat;
+}
+
+/*!
+ * Convert an array of host times to beats, using a conversion context
+ *
+ *  Gives the position in beats of each time along a timeline that is at originBeats at
+ *  the origin time, and advances at the context's tempo; times before the origin give
+ *  originBeats. Uses vector arithmetic, so it's much faster than converting times one
+ *  by one, for use on the realtime thread.
+ *
+ * @param conversion The conversion context
+ * @param origin The origin time, in host ticks
+ * @param originBeats The position at the origin time, in beats
+ * @param times The times to convert, in host ticks
+ * @param beats On output, the position of each time, in beats
+ * @param count The number of times
+ */
+void SETempoConversionHostTicksToBeatsArray(const SETempoConversion * conversion, uint64_t origin, double originBeats,
+                                            const uint64_t * times, double * beats, int count);
+
+/*!
+ * Convert an array of beats to host times, using a conversion context
+ *
+ *  The inverse of SETempoConversionHostTicksToBeatsArray: positions before originBeats
+ *  give the origin time.
+ *
+ * @param conversion The conversion context
+ * @param originBeats The position at the origin time, in beats
+ * @param origin The origin time, in host ticks
+ * @param beats The positions to convert, in beats
+ * @param times On output, the time of each position, in host ticks
+ * @param count The number of positions
+ */
+void SETempoConversionBeatsToHostTicksArray(const SETempoConversion * conversion, double originBeats, uint64_t origin,
+                                            const double * beats, uint64_t * times, int count);
+
 /*!
  * Weak-retaining proxy for retain cycle-free use of NSTimer
  */
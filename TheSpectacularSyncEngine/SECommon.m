@@ -9,6 +9,9 @@
 #include "SECommon.h"
 #include <dispatch/dispatch.h>
 #include <assert.h>
+#import <Accelerate/Accelerate.h>
+
+static const int kConversionChunkSize = 256; // Number of values converted at a time, in array conversions
 
 static double __hostTicksToSeconds = 0.0;
 static double __secondsToHostTicks = 0.0;
@@ -23,6 +26,11 @@ static void SEMIDIInit(void) {
     });
 }
 
+__attribute__((constructor)) static void SECommonInit(void) {
+    // Initialise timebase conversion at load time, so it's ready before any realtime thread needs it
+    SEMIDIInit();
+}
+
 uint64_t SECurrentTimeInHostTicks(void) {
     return mach_absolute_time();
 }
@@ -59,6 +67,46 @@ uint64_t SEBeatsToHostTicks(double beats, double tempo) {
     return beats * (SESecondsToHostTicks(60.0) / tempo);
 }
 
+void SETempoConversionSetTempo(SETempoConversion * conversion, double tempo) {
+    conversion->tempo = tempo;
+    if ( tempo == 0.0 ) {
+        conversion->hostTicksPerBeat = 0.0;
+        conversion->beatsPerHostTick = 0.0;
+        return;
+    }
+    conversion->hostTicksPerBeat = SESecondsToHostTicks(60.0) / tempo;
+    conversion->beatsPerHostTick = 1.0 / conversion->hostTicksPerBeat;
+}
+
+void SETempoConversionHostTicksToBeatsArray(const SETempoConversion * conversion, uint64_t origin, double originBeats,
+                                            const uint64_t * times, double * beats, int count) {
+    if ( count <= 0 ) return;
+    
+    // Take offsets from the origin, exactly, in integer arithmetic; then scale and offset them all at once
+    for ( int i=0; i<count; i++ ) {
+        beats[i] = times[i] > origin ? (double)(times[i] - origin) : 0.0;
+    }
+    vDSP_vsmsaD(beats, 1, &conversion->beatsPerHostTick, &originBeats, beats, 1, count);
+}
+
+void SETempoConversionBeatsToHostTicksArray(const SETempoConversion * conversion, double originBeats, uint64_t origin,
+                                            const double * beats, uint64_t * times, int count) {
+    double offset = -originBeats;
+    double zero = 0.0;
+    double ticks[kConversionChunkSize];
+    for ( int start=0; start<count; start+=kConversionChunkSize ) {
+        int length = MIN(kConversionChunkSize, count - start);
+        
+        // Offset from the origin, clamp to the origin, and scale to host ticks; then integer offset from the origin time
+        vDSP_vsaddD(beats + start, 1, &offset, ticks, 1, length);
+        vDSP_vthrD(ticks, 1, &zero, ticks, 1, length);
+        vDSP_vsmulD(ticks, 1, &conversion->hostTicksPerBeat, ticks, 1, length);
+        for ( int i=0; i<length; i++ ) {
+            times[start + i] = origin + (uint64_t)ticks[i];
+        }
+    }
+}
+
 
 #pragma mark - Weak retaining proxy for timers
 
@@ -0,0 +1,98 @@
+//
+//  SEMIDIByteStreamInterface.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import "SEMIDIClockSender.h"
+#import "SEMIDIClockReceiver.h"
+
+extern NSString * const SEMIDIByteStreamInterfaceDidCloseNotification; ///< Notification sent on main thread when the stream reached its end, or failed
+
+/*!
+ * Raw MIDI byte stream interface
+ *
+ *  This class sends and receives MIDI as a raw byte stream on a file descriptor,
+ *  without Core MIDI's drivers or endpoints: a serial port connected to a DIN MIDI
+ *  UART, a pseudo-terminal, a pipe or a socket. Messages are still exchanged with the
+ *  sender and receiver as Core MIDI packet lists, though the byte stream parser itself
+ *  is plain C.
+ *
+ *  Use an instance as the interface for an SEMIDIClockSender, and assign a receiver
+ *  to have incoming messages passed to it.
+ *
+ *  The descriptor is serviced by a non-blocking event loop on a background queue.
+ *  Incoming bytes are stamped with the host clock as they are read, and parsed into
+ *  messages, with running status and realtime messages interleaved within other
+ *  messages. System exclusive messages are skipped.
+ *
+ *  Outgoing packets are held until the time given by their timestamp, then written,
+ *  so messages leave at the time the sender scheduled them, rather than when the
+ *  sender passed them over. Packets with a timestamp of zero are written straight
+ *  away. Packets are passed over through a fixed-size queue, without allocating or
+ *  locking, so sendMIDIPacketList: may be called from a realtime thread, but only
+ *  from one thread at a time; packets sent while the queue is full are dropped.
+ */
+@interface SEMIDIByteStreamInterface : NSObject <SEMIDIClockSenderInterface>
+
+/*!
+ * Initialise with a file descriptor
+ *
+ *  The interface takes ownership of the descriptor, and closes it when deallocated.
+ *  If the descriptor refers to a terminal, it is put into raw mode, leaving the line
+ *  speed as it is.
+ *
+ * @param fd An open, readable and writable file descriptor
+ */
+-(instancetype)initWithFileDescriptor:(int)fd;
+
+/*!
+ * Initialise with a device path
+ *
+ *  Opens the given device, such as a serial port or the slave side of a
+ *  pseudo-terminal, for reading and writing.
+ *
+ * @param path The device path
+ * @return The interface, or nil if the device couldn't be opened
+ */
+-(instancetype)initWithDevicePath:(NSString*)path;
+
+/*!
+ * The file descriptor
+ */
+@property (nonatomic, readonly) int fileDescriptor;
+
+/*!
+ * The receiver incoming messages are passed to, if any
+ *
+ *  Messages are passed from the interface's background queue.
+ */
+@property (nonatomic, strong) SEMIDIClockReceiver * receiver;
+
+/*!
+ * The line rate, in bits per second (default 0)
+ *
+ *  Bytes that arrive together in one read are back-dated by their transmission
+ *  time at this rate, ten bits per byte, so that each is stamped with the time it
+ *  finished arriving rather than the time the last one did. Use 31250 for DIN MIDI.
+ *  With zero, all bytes are stamped with the time they were read.
+ */
+@property (nonatomic) double lineRate;
+
+/*!
+ * Whether the stream is still open for reading
+ */
+@property (nonatomic, readonly) BOOL open;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,416 @@
+//
+//  SEMIDIByteStreamInterface.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEMIDIByteStreamInterface.h"
+#import <fcntl.h>
+#import <unistd.h>
+#import <termios.h>
+
+NSString * const SEMIDIByteStreamInterfaceDidCloseNotification = @"SEMIDIByteStreamInterfaceDidCloseNotification";
+
+static const size_t kReadBufferSize                 = 1024;
+static const size_t kPacketListSize                 = 1024;
+static const double kBitsPerByte                    = 10.0;   // Start bit, eight data bits and stop bit, on a serial line
+static const NSTimeInterval kWriteTolerance         = 1.0e-4; // Write packets due within this time straight away, rather than waiting again
+static const uint32_t kOutputIntakeSize             = 256;    // Size of the queue of packets passed over by the sender; must be a power of two
+static const int kMaxScheduledPackets               = 512;    // Size of the schedule of packets waiting for their time
+static const int kMaxOutputPacketLength             = 16;     // Longer packets are split across several records
+
+typedef struct {
+    uint64_t timeStamp;
+    uint8_t length;
+    uint8_t data[kMaxOutputPacketLength];
+} SEMIDIByteStreamOutputPacket;
+
+/*
+ * Byte stream parser
+ *
+ *  Plain C, free of Core MIDI: turns a run of bytes read at a given time into complete messages,
+ *  each passed to the callback with the time its last byte arrived.
+ */
+
+typedef void (*SEMIDIByteStreamParserCallback)(void * context, const uint8_t * message, int length, uint64_t time);
+
+typedef struct {
+    uint8_t runningStatus;
+    uint8_t message[3];
+    int messageLength;
+    int expectedLength;
+    int inSysEx;
+    uint64_t lastByteTime;
+} SEMIDIByteStreamParser;
+
+@interface SEMIDIByteStreamInterface () {
+    SEMIDIByteStreamParser _parser;
+    BOOL _writeSourceSuspended;
+    SEMIDIByteStreamOutputPacket _outputIntake[kOutputIntakeSize];
+    uint32_t _outputIntakeHead;
+    uint32_t _outputIntakeTail;
+    SEMIDIByteStreamOutputPacket _scheduledPackets[kMaxScheduledPackets];
+    int _scheduledPacketCount;
+}
+@property (nonatomic, readwrite) int fileDescriptor;
+@property (nonatomic, readwrite) BOOL open;
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) dispatch_source_t readSource;
+@property (nonatomic, strong) dispatch_source_t writeSource;
+@property (nonatomic, strong) dispatch_source_t intakeSource;
+@property (nonatomic, strong) dispatch_source_t timer;
+@property (nonatomic, strong) NSMutableData * outputBuffer;
+@end
+
+@implementation SEMIDIByteStreamInterface
+
+-(instancetype)initWithFileDescriptor:(int)fd {
+    if ( !(self = [super init]) ) return nil;
+    
+    self.fileDescriptor = fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    
+    if ( isatty(fd) ) {
+        // No line editing, echo or character translation - MIDI is binary
+        struct termios attributes;
+        if ( tcgetattr(fd, &attributes) == 0 ) {
+            cfmakeraw(&attributes);
+            attributes.c_cc[VMIN] = 1;
+            attributes.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &attributes);
+        }
+    }
+    
+    self.open = YES;
+    self.outputBuffer = [NSMutableData data];
+    
+    // Service the descriptor on a background queue
+    self.queue = dispatch_queue_create("com.atastypixel.SEMIDIByteStreamInterface", DISPATCH_QUEUE_SERIAL);
+    __weak SEMIDIByteStreamInterface * weakSelf = self;
+    
+    // Close the descriptor once both sources are finished with it
+    __block int activeSources = 2;
+    dispatch_block_t sourceCancelled = ^{
+        if ( --activeSources == 0 ) {
+            close(fd);
+        }
+    };
+    
+    self.readSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, _queue);
+    dispatch_source_set_event_handler(_readSource, ^{
+        [weakSelf readAvailableBytes];
+    });
+    dispatch_source_set_cancel_handler(_readSource, sourceCancelled);
+    dispatch_resume(_readSource);
+    
+    // Resumed only while there's output waiting for the descriptor to accept it
+    self.writeSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_WRITE, fd, 0, _queue);
+    dispatch_source_set_event_handler(_writeSource, ^{
+        [weakSelf writeOutputBuffer];
+    });
+    dispatch_source_set_cancel_handler(_writeSource, sourceCancelled);
+    _writeSourceSuspended = YES;
+    
+    // Signalled by the sender when it has added packets to the intake
+    self.intakeSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR, 0, 0, _queue);
+    dispatch_source_set_event_handler(_intakeSource, ^{
+        [weakSelf takeIntakePackets];
+    });
+    dispatch_resume(_intakeSource);
+    
+    self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    dispatch_source_set_event_handler(_timer, ^{
+        [weakSelf writeDuePackets];
+    });
+    dispatch_resume(_timer);
+    
+    return self;
+}
+
+-(instancetype)initWithDevicePath:(NSString *)path {
+    int fd = open(path.fileSystemRepresentation, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ( fd < 0 ) {
+        NSLog(@"Couldn't open MIDI device %@: %s", path, strerror(errno));
+        return nil;
+    }
+    return [self initWithFileDescriptor:fd];
+}
+
+-(void)dealloc {
+    if ( _intakeSource ) {
+        dispatch_source_cancel(_intakeSource);
+    }
+    if ( _timer ) {
+        dispatch_source_cancel(_timer);
+    }
+    if ( _writeSource ) {
+        dispatch_source_cancel(_writeSource);
+        if ( _writeSourceSuspended ) {
+            dispatch_resume(_writeSource);
+        }
+    }
+    if ( _readSource ) {
+        dispatch_source_cancel(_readSource);
+    }
+}
+
+-(void)setReceiver:(SEMIDIClockReceiver *)receiver {
+    dispatch_sync(_queue, ^{
+        _receiver = receiver;
+    });
+}
+
+-(void)sendMIDIPacketList:(const MIDIPacketList *)packetList {
+    // Called on the sender's thread: copy the packets, timestamp and all, into the intake, without allocating
+    // or locking, then signal the queue. Packets that don't fit while the intake is full are dropped.
+    uint32_t head = _outputIntakeHead;
+    uint32_t tail = __atomic_load_n(&_outputIntakeTail, __ATOMIC_ACQUIRE);
+    const MIDIPacket * packet = &packetList->packet[0];
+    for ( int i=0; i<packetList->numPackets; i++, packet = MIDIPacketNext(packet) ) {
+        for ( int offset = 0; offset < packet->length && head - tail < kOutputIntakeSize; offset += kMaxOutputPacketLength ) {
+            SEMIDIByteStreamOutputPacket * record = &_outputIntake[head & (kOutputIntakeSize-1)];
+            record->timeStamp = packet->timeStamp;
+            record->length = MIN(packet->length - offset, kMaxOutputPacketLength);
+            memcpy(record->data, packet->data + offset, record->length);
+            head++;
+        }
+    }
+    
+    // Ensure the packets are complete before the queue can see them
+    __atomic_store_n(&_outputIntakeHead, head, __ATOMIC_RELEASE);
+    dispatch_source_merge_data(_intakeSource, 1);
+}
+
+#pragma mark - Writing
+
+-(void)takeIntakePackets {
+    // Move newly sent packets into the schedule, in time order; packets with the same time keep the order they
+    // were sent in
+    uint32_t tail = _outputIntakeTail;
+    uint32_t head = __atomic_load_n(&_outputIntakeHead, __ATOMIC_ACQUIRE);
+    for ( ; tail != head && _scheduledPacketCount < kMaxScheduledPackets; tail++ ) {
+        const SEMIDIByteStreamOutputPacket * record = &_outputIntake[tail & (kOutputIntakeSize-1)];
+        int index = _scheduledPacketCount;
+        while ( index > 0 && _scheduledPackets[index-1].timeStamp > record->timeStamp ) {
+            index--;
+        }
+        memmove(&_scheduledPackets[index+1], &_scheduledPackets[index], (_scheduledPacketCount - index) * sizeof(SEMIDIByteStreamOutputPacket));
+        _scheduledPackets[index] = *record;
+        _scheduledPacketCount++;
+    }
+    __atomic_store_n(&_outputIntakeTail, tail, __ATOMIC_RELEASE);
+    
+    [self writeDuePackets];
+}
+
+-(void)writeDuePackets {
+    uint64_t now = SECurrentTimeInHostTicks();
+    uint64_t horizon = now + SESecondsToHostTicks(kWriteTolerance);
+    
+    int count = 0;
+    for ( ; count < _scheduledPacketCount && _scheduledPackets[count].timeStamp <= horizon; count++ ) {
+        [_outputBuffer appendBytes:_scheduledPackets[count].data length:_scheduledPackets[count].length];
+    }
+    
+    if ( count > 0 ) {
+        _scheduledPacketCount -= count;
+        memmove(&_scheduledPackets[0], &_scheduledPackets[count], _scheduledPacketCount * sizeof(SEMIDIByteStreamOutputPacket));
+        [self writeOutputBuffer];
+        
+        if ( _outputIntakeTail != __atomic_load_n(&_outputIntakeHead, __ATOMIC_ACQUIRE) ) {
+            // Packets held back while the schedule was full now have room
+            dispatch_source_merge_data(_intakeSource, 1);
+        }
+    }
+    
+    // Wake for the next packet
+    if ( _scheduledPacketCount > 0 ) {
+        uint64_t next = _scheduledPackets[0].timeStamp;
+        dispatch_source_set_timer(_timer,
+                                  dispatch_time(DISPATCH_TIME_NOW, (int64_t)(SEHostTicksToSeconds(next - now) * NSEC_PER_SEC)),
+                                  DISPATCH_TIME_FOREVER,
+                                  0);
+    } else {
+        dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    }
+}
+
+-(void)writeOutputBuffer {
+    while ( _outputBuffer.length > 0 ) {
+        ssize_t written = write(_fileDescriptor, _outputBuffer.bytes, _outputBuffer.length);
+        if ( written > 0 ) {
+            [_outputBuffer replaceBytesInRange:NSMakeRange(0, written) withBytes:NULL length:0];
+            continue;
+        }
+        if ( written < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( written < 0 && errno != EAGAIN ) {
+            NSLog(@"Couldn't write to MIDI byte stream: %s", strerror(errno));
+            _outputBuffer.length = 0;
+        }
+        break;
+    }
+    
+    // Wait for the descriptor to accept the rest, if it's full
+    BOOL waiting = _outputBuffer.length > 0;
+    if ( waiting && _writeSourceSuspended ) {
+        dispatch_resume(_writeSource);
+        _writeSourceSuspended = NO;
+    } else if ( !waiting && !_writeSourceSuspended ) {
+        dispatch_suspend(_writeSource);
+        _writeSourceSuspended = YES;
+    }
+}
+
+#pragma mark - Reading
+
+-(void)readAvailableBytes {
+    uint8_t bytes[kReadBufferSize];
+    while ( 1 ) {
+        ssize_t count = read(_fileDescriptor, bytes, sizeof(bytes));
+        uint64_t time = SECurrentTimeInHostTicks();
+        
+        if ( count > 0 ) {
+            [self handleBytes:bytes count:count readTime:time];
+            continue;
+        }
+        if ( count < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( count < 0 && errno == EAGAIN ) {
+            break;
+        }
+        
+        // End of stream, or a failure such as a disconnected device
+        if ( count < 0 ) {
+            NSLog(@"Couldn't read from MIDI byte stream: %s", strerror(errno));
+        }
+        dispatch_source_cancel(_readSource);
+        self.open = NO;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [[NSNotificationCenter defaultCenter] postNotificationName:SEMIDIByteStreamInterfaceDidCloseNotification object:self];
+        });
+        break;
+    }
+}
+
+static int SEMIDIByteStreamMessageLength(uint8_t status) {
+    switch ( status & 0xF0 ) {
+        case 0xC0:
+        case 0xD0:
+            return 2;
+        case 0xF0:
+            switch ( status ) {
+                case 0xF1:
+                case 0xF3:
+                    return 2;
+                case 0xF2:
+                    return 3;
+                default:
+                    return 1;
+            }
+        default:
+            return 3;
+    }
+}
+
+static void SEMIDIByteStreamParserParse(SEMIDIByteStreamParser * parser, const uint8_t * bytes, size_t count,
+                                        uint64_t readTime, uint64_t byteDuration,
+                                        SEMIDIByteStreamParserCallback callback, void * context) {
+    for ( size_t i=0; i<count; i++ ) {
+        // Back-date earlier bytes by their transmission time, though never before the last byte we saw
+        uint64_t backdate = (count - 1 - i) * byteDuration;
+        uint64_t time = backdate < readTime - parser->lastByteTime ? readTime - backdate : parser->lastByteTime;
+        parser->lastByteTime = time;
+        
+        const uint8_t * message = NULL;
+        int messageLength = 0;
+        uint8_t byte = bytes[i];
+        
+        if ( byte >= 0xF8 ) {
+            // Realtime messages stand alone, and may appear between the bytes of any other message
+            message = &bytes[i];
+            messageLength = 1;
+            
+        } else if ( byte & 0x80 ) {
+            parser->messageLength = 0;
+            parser->inSysEx = byte == 0xF0;
+            if ( byte >= 0xF0 ) {
+                // System messages cancel running status
+                parser->runningStatus = 0;
+            } else {
+                parser->runningStatus = byte;
+            }
+            if ( byte != 0xF0 && byte != 0xF7 ) {
+                parser->message[parser->messageLength++] = byte;
+                parser->expectedLength = SEMIDIByteStreamMessageLength(byte);
+            }
+            
+        } else if ( !parser->inSysEx ) {
+            if ( parser->messageLength == 0 && parser->runningStatus ) {
+                // Data bytes following a complete channel message reuse its status
+                parser->message[parser->messageLength++] = parser->runningStatus;
+                parser->expectedLength = SEMIDIByteStreamMessageLength(parser->runningStatus);
+            }
+            if ( parser->messageLength > 0 ) {
+                parser->message[parser->messageLength++] = byte;
+            }
+        }
+        
+        if ( !message && parser->messageLength > 0 && parser->messageLength == parser->expectedLength ) {
+            message = parser->message;
+            messageLength = parser->messageLength;
+            parser->messageLength = 0;
+        }
+        
+        if ( message ) {
+            callback(context, message, messageLength, time);
+        }
+    }
+}
+
+typedef struct {
+    __unsafe_unretained SEMIDIClockReceiver * receiver;
+    MIDIPacketList * packetList;
+    MIDIPacket * packet;
+    size_t size;
+} SEMIDIByteStreamPacketListBuilder;
+
+static void SEMIDIByteStreamAddMessage(void * context, const uint8_t * message, int length, uint64_t time) {
+    SEMIDIByteStreamPacketListBuilder * builder = context;
+    if ( !builder->receiver ) {
+        return;
+    }
+    
+    builder->packet = MIDIPacketListAdd(builder->packetList, builder->size, builder->packet, time, length, message);
+    if ( !builder->packet ) {
+        // List is full: pass it on, and start another
+        SEMIDIClockReceiverReceivePacketList(builder->receiver, builder->packetList);
+        builder->packet = MIDIPacketListInit(builder->packetList);
+        builder->packet = MIDIPacketListAdd(builder->packetList, builder->size, builder->packet, time, length, message);
+    }
+}
+
+-(void)handleBytes:(const uint8_t *)bytes count:(size_t)count readTime:(uint64_t)readTime {
+    // Parse the bytes into messages, and pass them to the receiver in a packet list
+    char packetListSpace[sizeof(MIDIPacketList) + kPacketListSize];
+    SEMIDIByteStreamPacketListBuilder builder = {
+        .receiver = _receiver,
+        .packetList = (MIDIPacketList*)packetListSpace,
+        .size = sizeof(packetListSpace)
+    };
+    builder.packet = MIDIPacketListInit(builder.packetList);
+    
+    uint64_t byteDuration = _lineRate > 0 ? SESecondsToHostTicks(kBitsPerByte / _lineRate) : 0;
+    SEMIDIByteStreamParserParse(&_parser, bytes, count, readTime, byteDuration, SEMIDIByteStreamAddMessage, &builder);
+    
+    if ( builder.receiver && builder.packetList->numPackets > 0 ) {
+        SEMIDIClockReceiverReceivePacketList(builder.receiver, builder.packetList);
+    }
+}
+
+@end
@@ -21,9 +21,32 @@ extern NSString * const SEMIDIClockReceiverDidStopNotification;         ///< Not
 extern NSString * const SEMIDIClockReceiverDidLiveSeekNotification;     ///< Notification sent on main thread when remote clock changed timeline position while playing
 extern NSString * const SEMIDIClockReceiverDidChangeTempoNotification;  ///< Notification sent on main thread when remote clock changed tempo
 
+@class SEMIDITraceRecorder;
+@class SEClockStatePublisher;
+
 extern NSString * const SEMIDIClockReceiverTimestampKey;               ///< Notification userinfo key containing global timestamp, in host ticks, for event
 extern NSString * const SEMIDIClockReceiverTempoKey;                   ///< Notification userinfo key containing tempo, in beats per minute
     
+/*!
+ * Receiver tuning parameters
+ *
+ *  These control the trade-off between how quickly the receiver locks on to a
+ *  clock, and how steady it is once locked. The defaults suit most sources;
+ *  use a tool like SEReceiverTuner to find values suited to a particular source.
+ */
+typedef struct {
+    int sampleBufferSize;                          //!< Number of samples to average over (up to 384). Higher is steadier, but slower to converge
+    double outlierThresholdRatio;                  //!< Number of standard deviations beyond which a sample is considered an outlier
+    int outliersBeforeReset;                       //!< Number of consecutive outliers to see before converging to a new value (up to 8)
+    int minContiguousSamplesBeforeReportingTempo;  //!< Number of consistent samples to see before reporting tempo, while clock is stopped
+    double coarsestTempoRounding;                  //!< Coarsest tempo rounding to apply, in BPM (one of 0.0001, 0.001, 0.01, 0.1, 0.5 or 1.0)
+    double tickGridBandwidth;                      //!< Bandwidth of the loop smoothing arrival-stamped ticks, in cycles per tick
+    BOOL robustOutlierDetection;                   //!< Judge tick intervals by their sliding median and median absolute deviation, rather than mean
+                                                   //!< and standard deviation. Steadier with bursty sources, such as those behind USB hubs or networks
+} SEMIDIClockReceiverParameters;
+
+extern const SEMIDIClockReceiverParameters SEMIDIClockReceiverDefaultParameters; ///< The default tuning parameters
+
 /*!
  * MIDI Clock Receiver
  *
@@ -48,6 +71,36 @@ extern NSString * const SEMIDIClockReceiverTempoKey;                   ///< Noti
  */
 -(instancetype)init;
 
+/*!
+ * Initialise without an event poll timer
+ *
+ *  By default, each receiver schedules its own timer on the main thread to deliver
+ *  notifications and key-value observing updates, and to detect when the source goes
+ *  idle. Receivers created with this initialiser leave this to their owner, which must
+ *  call pollForEvents regularly (every 50ms or so) on the main thread instead.
+ *
+ *  SEMIDIClockReceiverHub uses this to service many receivers from one timer.
+ */
+-(instancetype)initWithoutEventPollTimer;
+
+/*!
+ * Initialise with tuning parameters
+ *
+ *  Values outside the supported range are clamped.
+ *
+ * @param parameters The tuning parameters to use
+ * @param eventPollTimer Whether to schedule an event poll timer (see initWithoutEventPollTimer)
+ */
+-(instancetype)initWithParameters:(SEMIDIClockReceiverParameters)parameters eventPollTimer:(BOOL)eventPollTimer;
+
+/*!
+ * Deliver pending events
+ *
+ *  Only call this yourself if you created the receiver with initWithoutEventPollTimer.
+ *  Must be called on the main thread.
+ */
+-(void)pollForEvents;
+
 /*!
  * Receive a packet list
  *
@@ -64,6 +117,19 @@ extern NSString * const SEMIDIClockReceiverTempoKey;                   ///< Noti
  */
 void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceiver * receiver, const MIDIPacketList * packetList);
 
+/*!
+ * Receive a packet list that arrived at a given time
+ *
+ *  As SEMIDIClockReceiverReceivePacketList, but messages without timestamps are
+ *  taken to have arrived at the given time, rather than when this is called. Use
+ *  this to feed in captured or simulated input.
+ *
+ * @param receiver The receiver
+ * @param packetList The incoming MIDI packet list
+ * @param time The time the messages arrived, in host ticks, or 0 for now
+ */
+void SEMIDIClockReceiverReceivePacketListAtTime(__unsafe_unretained SEMIDIClockReceiver * receiver, const MIDIPacketList * packetList, uint64_t time);
+
 /*!
  * Reset
  *
@@ -95,6 +161,19 @@ BOOL SEMIDIClockReceiverIsReceivingTempo(__unsafe_unretained SEMIDIClockReceiver
  */
 BOOL SEMIDIClockReceiverIsClockRunning(__unsafe_unretained SEMIDIClockReceiver * receiver);
 
+/*!
+ * Determine if the receiver is coasting through a dropout
+ *
+ *  Use this C function from the realtime audio thread to determine if, in flywheel
+ *  mode, clock messages have stopped arriving for a few ticks, and the receiver is
+ *  holding its last tempo and extrapolating the timeline, waiting for them to resume.
+ *  See the flywheelDuration property.
+ *
+ * @param receiver The receiver
+ * @return Whether the receiver is coasting
+ */
+BOOL SEMIDIClockReceiverIsCoasting(__unsafe_unretained SEMIDIClockReceiver * receiver);
+
 /*!
  * Get the current timeline position, in beats
  *
@@ -108,6 +187,38 @@ BOOL SEMIDIClockReceiverIsClockRunning(__unsafe_unretained SEMIDIClockReceiver *
  */
 double SEMIDIClockReceiverGetTimelinePosition(__unsafe_unretained SEMIDIClockReceiver * receiver, uint64_t time);
 
+/*!
+ * Get the timeline positions for an array of times
+ *
+ *  Use this C function from the realtime audio thread to convert many timestamps at
+ *  once, such as all the events in a render cycle. All times are converted against
+ *  the same timeline state, with vector arithmetic, which is much faster than calling
+ *  SEMIDIClockReceiverGetTimelinePosition for each.
+ *
+ * @param receiver The receiver
+ * @param times The global timestamps to convert, in host ticks
+ * @param positions On output, the timeline position for each timestamp, in beats
+ * @param count The number of timestamps
+ */
+void SEMIDIClockReceiverGetTimelinePositions(__unsafe_unretained SEMIDIClockReceiver * receiver,
+                                             const uint64_t * times, double * positions, int count);
+
+/*!
+ * Get the times for an array of timeline positions
+ *
+ *  The inverse of SEMIDIClockReceiverGetTimelinePositions, for scheduling events at
+ *  timeline positions. Positions before the start of the timeline give the time it
+ *  started. If the remote clock isn't running, or the tempo isn't yet known, all times
+ *  are zero.
+ *
+ * @param receiver The receiver
+ * @param positions The timeline positions to convert, in beats
+ * @param times On output, the global timestamp for each position, in host ticks
+ * @param count The number of positions
+ */
+void SEMIDIClockReceiverGetTimesForTimelinePositions(__unsafe_unretained SEMIDIClockReceiver * receiver,
+                                                     const double * positions, uint64_t * times, int count);
+
 /*!
  * Get the current timeline position, in beats
  *
@@ -129,6 +240,33 @@ double SEMIDIClockReceiverGetTimelinePosition(__unsafe_unretained SEMIDIClockRec
  */
 double SEMIDIClockReceiverGetTempo(__unsafe_unretained SEMIDIClockReceiver * receiver);
 
+/*!
+ * Get the timeline discontinuity count
+ *
+ *  This count increases each time the remote clock starts, stops or seeks - that is,
+ *  whenever the timeline jumps deliberately, as opposed to the small corrections
+ *  made as the timeline estimate is refined. Compare it with a previously seen value
+ *  to tell the two apart; SETimelineFollower uses this.
+ *
+ * @param receiver The receiver
+ * @return The discontinuity count
+ */
+uint32_t SEMIDIClockReceiverGetDiscontinuityCount(__unsafe_unretained SEMIDIClockReceiver * receiver);
+
+/*!
+ * Get the estimated input latency
+ *
+ *  For sources that don't timestamp their messages, each tick is stamped when the
+ *  receiver processes it, which is always somewhat after it arrived. This gives the
+ *  receiver's estimate of the average delay, beyond the shortest seen, learned from
+ *  how far ticks stray from the source's regular tick grid. The receiver's time base
+ *  already allows for it.
+ *
+ * @param receiver The receiver
+ * @return The estimated input latency, in seconds, or 0 for sources that timestamp their messages
+ */
+NSTimeInterval SEMIDIClockReceiverGetInputLatency(__unsafe_unretained SEMIDIClockReceiver * receiver);
+
 /*!
  * The current tempo
  *
@@ -160,6 +298,32 @@ double SEMIDIClockReceiverGetTempo(__unsafe_unretained SEMIDIClockReceiver * rec
  */
 @property (nonatomic, readonly) BOOL clockRunning;
 
+/*!
+ * Flywheel duration, in seconds (default 0)
+ *
+ *  When set, the receiver rides through dropouts in the incoming clock of up to this
+ *  length, such as those common with Bluetooth and network MIDI sources, rather than
+ *  resetting once clock messages have been missing for half a second. Throughout the
+ *  dropout, the tempo is held, and the timeline continues at that tempo.
+ *
+ *  When ticks resume on the tick grid extrapolated at the held tempo, the missed ticks
+ *  are counted, and the receiver carries on without a discontinuity. Ticks that resume
+ *  off the grid are treated as they would be without flywheel mode.
+ *
+ *  Zero disables flywheel mode.
+ */
+@property (nonatomic) NSTimeInterval flywheelDuration;
+
+/*!
+ * Whether the receiver is coasting through a dropout
+ *
+ *  This is an Objective-C convenience property equivalent to SEMIDIClockReceiverIsCoasting;
+ *  do not use this property on a realtime audio thread.
+ *
+ *  This property does not provide key-value observing updates.
+ */
+@property (nonatomic, readonly) BOOL coasting;
+
 /*!
  * Error indication for the incoming clock signal
  *
@@ -183,6 +347,73 @@ double SEMIDIClockReceiverGetTempo(__unsafe_unretained SEMIDIClockReceiver * rec
  */
 @property (nonatomic, readonly) double error;
 
+/*!
+ * Whether the source timestamps its messages
+ *
+ *  Ticks from sources that don't (that is, with zero timestamps) are stamped on
+ *  arrival, then smoothed against the source's estimated tick grid, which removes
+ *  most of the scheduling jitter of the thread delivering them.
+ *
+ *  This and the timing properties that follow describe the receiver's source as a
+ *  whole: packet lists don't identify their source, so everything passed to a
+ *  receiver is taken to come from one source. Use one receiver per source, with
+ *  SEMIDIClockReceiverHub to choose between them, and reset a receiver when its
+ *  source changes.
+ */
+@property (nonatomic, readonly) BOOL sourceProvidesTimestamps;
+
+/*!
+ * Timestamp jitter, in seconds
+ *
+ *  The typical deviation of incoming tick timestamps from the source's estimated
+ *  tick grid, before smoothing: a measure of the quality of the source's timestamps.
+ */
+@property (nonatomic, readonly) NSTimeInterval timestampJitter;
+
+/*!
+ * Estimated input latency, in seconds
+ *
+ *  This is an Objective-C convenience property equivalent to SEMIDIClockReceiverGetInputLatency.
+ */
+@property (nonatomic, readonly) NSTimeInterval inputLatency;
+
+/*!
+ * Timestamp offset, in seconds
+ *
+ *  For sources that timestamp their messages, the shortest recent delay between a
+ *  tick's timestamp and its arrival. A negative value means the source stamps ticks
+ *  with times that haven't yet happened: either it schedules them ahead, or its clock
+ *  is offset from the host clock. A value that moves steadily indicates the source's
+ *  clock drifts against the host clock. Zero for sources that don't timestamp their
+ *  messages.
+ */
+@property (nonatomic, readonly) NSTimeInterval timestampOffset;
+
+/*!
+ * The tuning parameters in use, after clamping
+ */
+@property (nonatomic, readonly) SEMIDIClockReceiverParameters parameters;
+
+/*!
+ * Trace recorder
+ *
+ *  Assign a SEMIDITraceRecorder to record every incoming message, with the
+ *  timestamp the receiver used for it, for later replay with SEMIDITracePlayer.
+ *  A recorder that is replaced or removed is finished once the MIDI thread has
+ *  left any receive call it was in at the time, on the next poll for events.
+ */
+@property (nonatomic, strong) SEMIDITraceRecorder * traceRecorder;
+
+/*!
+ * Clock state publisher
+ *
+ *  Assign a SEClockStatePublisher to publish this receiver's tempo, time base and
+ *  transport state to other processes, updated as each message is received.
+ *  A publisher that is replaced or removed is released in the same way as a
+ *  trace recorder.
+ */
+@property (nonatomic, strong) SEClockStatePublisher * statePublisher;
+
 @end
 
 #ifdef __cplusplus
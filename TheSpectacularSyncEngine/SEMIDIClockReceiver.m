@@ -7,6 +7,8 @@
 //
 
 #import "SEMIDIClockReceiver.h"
+#import "SEMIDITrace.h"
+#import "SEClockStatePublisher.h"
 #import "SECommon.h"
 #import <libkern/OSAtomic.h>
 
@@ -25,25 +27,31 @@ NSString * const SEMIDIClockReceiverDidChangeTempoNotification = @"SEMIDIClockRe
 NSString * const SEMIDIClockReceiverTimestampKey = @"timestamp";
 NSString * const SEMIDIClockReceiverTempoKey = @"tempo";
 
+const SEMIDIClockReceiverParameters SEMIDIClockReceiverDefaultParameters = {
+    .sampleBufferSize = 384,
+    .outlierThresholdRatio = 3.0,
+    .outliersBeforeReset = 3,
+    .minContiguousSamplesBeforeReportingTempo = 15,
+    .coarsestTempoRounding = 1.0,
+    .tickGridBandwidth = 0.02,
+    .robustOutlierDetection = NO,
+};
+
 static const NSTimeInterval kIdlePollInterval        = 0.1;    // How often to poll on the main thread for events, while idle
 static const NSTimeInterval kActivePollInterval      = 0.05;   // How often to poll on the main thread for events, while actively receiving
 static const NSTimeInterval kActivityTimeout         = 0.5;    // Length of time past last seen tick beyond which we consider ourselves idle
 static const int kEventBufferSize                    = 10;     // Size of event buffer, used to notify main thread about events
-static const int kSampleBufferSize                   = 384;    // Number of samples to keep at a time. A higher value runs the risk of a longer
-                                                               // time to converge to new values; a lower value runs the risk of not converging to
-                                                               // constant values.
+static const int kSampleBufferSize                   = 384;    // Max number of samples to keep at a time
+static const int64_t kMaxSampleOffset                = 1LL << 26; // Max distance of a stored sample from the buffer anchor. Keeps samples within 32 bits
+                                                               // and the running sums of squares exact within 64 bits, for a full buffer
 static double kTempoChangeUpdateThreshold            = 1.0e-4; // Only issue tempo updates when change is greater than this
-static const int kMinContiguousSamplesBeforeReportingTempo = 15;// Don't report tempo if we've seen less than this number of identical samples (unless clock running)
 static const double kForcedTempoChangeThreshold  = 3.0;        // Change in tempo (in BPM) before triggering a forced tempo update
 static const int kSamplesBeforeForcedTempoChange = 384;        // If we haven't seen any significant changes in this time, and we haven't reported a tempo change, report
 static const int kMinSamplesBeforeEvaluatingOutliers = 10;     // Min samples to observe before we can start identifying outlier samples
 static const int kMinSamplesBeforeTrustingZeroStdDev = 3;      // Min samples to observe before we trust a zero standard deviation
-static const double kOutlierThresholdRatio           = 3.0;    // Number of standard deviations beyond which we consider a sample an outlier
-                                                               // A lower value lets us converge quickly to closer new values, but runs the risk of
-                                                               // excluding useful samples in the presence of high jitter, causing convergence issues
 static const NSTimeInterval kMinimumEarlyOutlierThreshold = 1.0e-3; // Minimum threshold beyond which we consider a sample an outlier, if we've seen less
                                                                // than kMinSamplesBeforeEvaluatingOutliers samples
-static const int kOutliersBeforeReset                = 3;      // We need to see this many outliers before we reset to converge to the new value
+static const int kMaxOutliersBeforeReset             = 8;      // Max number of outliers to see before we reset to converge to the new value
 static const int kMinSamplesBeforeStoringStandardDeviation = 24; // Min samples to observe before we can start storing standard deviation history
 static const int kStandardDeviationHistorySamples    = 10;     // How many standard deviation history entries to keep
 static const int kStandardDeviationHistoryEntryDuration = 24;  // How many samples each history item contains
@@ -51,22 +59,76 @@ static const double kTrustedStandardDeviation        = 1.0e-4; // Standard devia
 static const int kMinSamplesBeforeRecordingTempoHistory = 13;  // Don't record tempo history if we've seen less than this number of (possibly unsteady) samples
 static const int kTempoHistoryLength                 = 10;     // Number of historical 1-second tempo bounds samples to keep, for picking the optimal stable rounding
 static const double kRoundingCoefficients[] = { 0.0001, 0.001, 0.01, 0.1, 0.5, 1.0 }; // Precisions to round to, depending on signal stability
+static const int kTickGridFitTicks                   = 24;     // Number of ticks to fit the tick grid to directly, before tracking it
+static const double kMaxTickGridBandwidth            = 0.25;   // Max bandwidth of the loop tracking the tick grid, beyond which it would be unstable
+static const double kTickGridResetThreshold          = 0.5;    // Deviation from the tick grid, in ticks, beyond which we find the grid again
+static const double kEnvelopeRiseRate                = 1.0e-3; // Rate at which lower envelopes of delays rise, in ticks per tick, to follow drift
+static const double kTimingAveragingFactor           = 1.0 / 64.0; // Weight of each new tick in the timestamp quality averages
+static const int kCoastingTickThreshold              = 3;      // Number of tick intervals without a tick, in flywheel mode, after which we're coasting
+static const double kFlywheelGridTolerance           = 0.25;   // Deviation, in ticks, from the extrapolated tick grid within which ticks ending a dropout are counted on
+static const double kMedianAbsoluteDeviationScale    = 1.4826; // Scales the median absolute deviation to the standard deviation, for normally distributed samples
+static const NSTimeInterval kMinimumRobustOutlierThreshold = 1.0e-5; // Floor on the outlier threshold in robust mode, for sources whose samples barely vary
+
+// Host tick equivalents of the above, worked out once in +initialize so the per-tick paths don't convert
+static double __hostTicksPerMinute;
+static uint64_t __hostTicksPerSecond;
+static uint64_t __activityTimeout;
+static uint64_t __minimumEarlyOutlierThreshold;
+static uint64_t __minimumRobustOutlierThreshold;
+
+typedef struct {
+    int32_t value;                      // Sample, as offset from the buffer anchor
+    uint32_t priority;                  // Random heap priority, keeping the tree balanced
+    uint16_t left;                      // Child nodes, as ring slot + 1, or 0 for none
+    uint16_t right;
+    uint16_t size;                      // Number of nodes in this subtree
+    int64_t sum;                        // Sum of values in this subtree
+} SEOrderStatisticNode;
 
 typedef struct {
-    uint64_t samples[kSampleBufferSize+1];
-    int head;
-    int tail;
-    uint64_t accumulator;
-    uint64_t standardDeviation;
+    // Fields touched on every sample, packed into the first 64 bytes, the size of a cache line
+    uint64_t anchor;                    // Reference value that stored samples are offsets from
+    int64_t accumulator;                // Sum of stored offsets
+    int64_t squaredAccumulator;         // Sum of squares of stored offsets
     uint64_t mean;
-    uint64_t outliers[kOutliersBeforeReset];
-    int contiguousOutlierCount;
+    double outlierThresholdRatio;
+    uint32_t standardDeviation;         // Stored samples are within kMaxSampleOffset of the anchor, so this fits 32 bits
     int seenSamples;
     int sampleCountSinceLastSignificantChange;
+    uint16_t head;
+    uint16_t tail;
+    uint16_t capacity;                  // Ring size, up to kSampleBufferSize
+    uint8_t contiguousOutlierCount;
     BOOL significantChange;
-    uint64_t standardDeviationHistory[kStandardDeviationHistorySamples];
+    BOOL robust;                        // Whether to use the median and median absolute deviation, rather than mean and standard deviation
+    
+    // Robust mode only
+    SEOrderStatisticNode * orderNodes;  // Order statistic tree nodes, one per ring slot, owned by the receiver
+    uint64_t median;
+    uint16_t orderRoot;                 // Root of the order statistic tree over the stored samples
+    uint32_t priorityState;
+    
+    // Less frequently accessed fields
+    uint8_t outliersBeforeReset;
+    uint64_t outliers[kMaxOutliersBeforeReset];
+    uint32_t standardDeviationHistory[kStandardDeviationHistorySamples];
+    int32_t samples[kSampleBufferSize]; // Samples, as offsets from anchor
 } SESampleBuffer;
 
+typedef struct {
+    BOOL arrivalStamped;                // Whether the source leaves timestamps to us, so that ticks are stamped on arrival
+    int count;                          // Ticks fitted so far, up to kTickGridFitTicks, after which the grid is tracked
+    uint64_t firstTick;                 // Timestamp of the first tick fitted
+    double sumX, sumY, sumXX, sumXY;    // Running sums for the least-squares fit
+    uint64_t estimate;                  // Estimated time of the latest tick, on the grid
+    double period;                      // Estimated tick interval, in host ticks
+    double meanSquaredResidual;         // Average squared deviation of timestamps from the grid
+    double residualEnvelope;            // Lower envelope of deviations from the grid
+    double latency;                     // Average deviation above the lower envelope, in host ticks
+    BOOL hasOffset;
+    double offsetEnvelope;              // Lower envelope of arrival time minus timestamp, for sources with their own timestamps
+} SETickGrid;
+
 typedef enum {
     SEActionNone,
     SEActionStart,
@@ -103,49 +165,184 @@ typedef struct {
     int _contiguousSampleCount;
     SESampleBuffer _tickSampleBuffer;
     SESampleBuffer _timeBaseSampleBuffer;
+    SEOrderStatisticNode * _tickOrderNodes;
+    SETickGrid _tickGrid;
+    SEMIDIClockReceiverParameters _parameters;
+    int _coarsestRoundingCoefficient;
     double _error;
     struct { double min; double max; } _tempoHistory[kTempoHistoryLength];
     int _lastTempoHistoryBucket;
+    BOOL _usesEventPollTimer;
+    uint32_t _discontinuityCount;
+    SETempoConversion _tempoConversion;
+    uint32_t _tempoConversionSequence;
+    uint64_t _flywheelDuration;
+    uint32_t _receiveEpoch;             // Advanced on entering and leaving the receive path, so it's odd while the MIDI thread is inside
+    uint32_t _retireEpoch;              // Receive epoch when objects were last retired
 }
 @property (nonatomic) NSTimer * eventPollTimer;
+@property (nonatomic, strong) NSMutableArray * retiredTraceRecorders;
+@property (nonatomic, strong) NSMutableArray * retiredStatePublishers;
 @end
 
 @implementation SEMIDIClockReceiver
 @dynamic receivingTempo;
 @dynamic clockRunning;
+@dynamic coasting;
+
++(void)initialize {
+    __hostTicksPerMinute = (double)SESecondsToHostTicks(60.0);
+    __hostTicksPerSecond = SESecondsToHostTicks(1.0);
+    __activityTimeout = SESecondsToHostTicks(kActivityTimeout);
+    __minimumEarlyOutlierThreshold = SESecondsToHostTicks(kMinimumEarlyOutlierThreshold);
+    __minimumRobustOutlierThreshold = SESecondsToHostTicks(kMinimumRobustOutlierThreshold);
+}
 
 -(instancetype)init {
+    return [self initWithParameters:SEMIDIClockReceiverDefaultParameters eventPollTimer:YES];
+}
+
+-(instancetype)initWithoutEventPollTimer {
+    return [self initWithParameters:SEMIDIClockReceiverDefaultParameters eventPollTimer:NO];
+}
+
+-(instancetype)initWithParameters:(SEMIDIClockReceiverParameters)parameters eventPollTimer:(BOOL)usesEventPollTimer {
     if ( !(self = [super init]) ) return nil;
     
-    SESampleBufferClear(&_tickSampleBuffer);
-    SESampleBufferClear(&_timeBaseSampleBuffer);
+    // Keep parameters within the range our buffers and filters can accommodate
+    parameters.sampleBufferSize = MAX(kMinSamplesBeforeEvaluatingOutliers + 2, MIN(kSampleBufferSize, parameters.sampleBufferSize));
+    parameters.outliersBeforeReset = MAX(1, MIN(kMaxOutliersBeforeReset, parameters.outliersBeforeReset));
+    parameters.tickGridBandwidth = MAX(DBL_EPSILON, MIN(kMaxTickGridBandwidth, parameters.tickGridBandwidth));
+    _coarsestRoundingCoefficient = 0;
+    while ( _coarsestRoundingCoefficient < (sizeof(kRoundingCoefficients)/sizeof(double))-1
+            && kRoundingCoefficients[_coarsestRoundingCoefficient+1] <= parameters.coarsestTempoRounding ) {
+        _coarsestRoundingCoefficient++;
+    }
+    parameters.coarsestTempoRounding = kRoundingCoefficients[_coarsestRoundingCoefficient];
+    _parameters = parameters;
+    
+    if ( _parameters.robustOutlierDetection ) {
+        // Only the tick interval buffer uses robust mode, which needs tree nodes for its samples
+        _tickOrderNodes = calloc(_parameters.sampleBufferSize, sizeof(SEOrderStatisticNode));
+    }
+    SESampleBufferConfigure(&_tickSampleBuffer, &_parameters, _tickOrderNodes);
+    SESampleBufferConfigure(&_timeBaseSampleBuffer, &_parameters, NULL);
+    SETickGridClear(&_tickGrid);
     for ( int i=0; i<kTempoHistoryLength; i++ ) { _tempoHistory[i].max = 0.0; _tempoHistory[i].min = DBL_MAX; }
-    self.eventPollTimer = [NSTimer scheduledTimerWithTimeInterval:kIdlePollInterval
-                                                           target:[[SEWeakRetainingProxy alloc] initWithTarget:self]
-                                                         selector:@selector(pollForEvents)
-                                                         userInfo:nil
-                                                          repeats:YES];
+    _usesEventPollTimer = usesEventPollTimer;
+    self.retiredTraceRecorders = [NSMutableArray array];
+    self.retiredStatePublishers = [NSMutableArray array];
+    [self setEventPollInterval:kIdlePollInterval];
     
     return self;
 }
 
 -(void)dealloc {
     [_eventPollTimer invalidate];
+    if ( _tickOrderNodes ) {
+        free(_tickOrderNodes);
+    }
+}
+
+static void SEMIDIClockReceiverMarkRetirement(__unsafe_unretained SEMIDIClockReceiver * THIS) {
+    // Called on the main thread, after swapping out an object the MIDI thread uses. Notes where the MIDI thread is:
+    // once it has left the receive path it was in, if any, it can no longer be holding the old object.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    THIS->_retireEpoch = __atomic_load_n(&THIS->_receiveEpoch, __ATOMIC_ACQUIRE);
+}
+
+-(void)setTraceRecorder:(SEMIDITraceRecorder *)traceRecorder {
+    SEMIDITraceRecorder * oldTraceRecorder = _traceRecorder;
+    _traceRecorder = traceRecorder;
+    
+    if ( oldTraceRecorder ) {
+        // The MIDI thread may still be recording to the old recorder: finish it once it's left the receive path
+        [_retiredTraceRecorders addObject:oldTraceRecorder];
+        SEMIDIClockReceiverMarkRetirement(self);
+        [self releaseRetiredObjects];
+    }
+}
+
+-(void)setStatePublisher:(SEClockStatePublisher *)statePublisher {
+    SEClockStatePublisher * oldStatePublisher = _statePublisher;
+    _statePublisher = statePublisher;
+    
+    SEMIDIClockReceiverPublishState(self);
+    
+    if ( oldStatePublisher ) {
+        // The MIDI thread may still be publishing to the old publisher: keep it until it's left the receive path
+        [_retiredStatePublishers addObject:oldStatePublisher];
+        SEMIDIClockReceiverMarkRetirement(self);
+        [self releaseRetiredObjects];
+    }
+}
+
+-(void)releaseRetiredObjects {
+    if ( _retiredTraceRecorders.count == 0 && _retiredStatePublishers.count == 0 ) {
+        return;
+    }
+    
+    if ( (_retireEpoch & 1) && __atomic_load_n(&_receiveEpoch, __ATOMIC_ACQUIRE) == _retireEpoch ) {
+        // Still inside the receive path it was in when we retired them; try again at the next poll
+        return;
+    }
+    
+    for ( SEMIDITraceRecorder * traceRecorder in _retiredTraceRecorders ) {
+        [traceRecorder finish];
+    }
+    [_retiredTraceRecorders removeAllObjects];
+    [_retiredStatePublishers removeAllObjects];
+}
+
+static void SEMIDIClockReceiverPublishState(__unsafe_unretained SEMIDIClockReceiver * THIS) {
+    __unsafe_unretained SEClockStatePublisher * statePublisher = THIS->_statePublisher;
+    if ( !statePublisher ) {
+        return;
+    }
+    
+    uint64_t timeBase = THIS->_timeBase;
+    double tempo = THIS->_tempo;
+    BOOL running = timeBase && tempo;
+    SEClockStatePublisherPublish(statePublisher,
+                                 running,
+                                 tempo,
+                                 timeBase,
+                                 running ? 0.0 : (double)THIS->_savedSongPosition / (double)SEMIDITicksPerBeat,
+                                 __atomic_load_n(&THIS->_discontinuityCount, __ATOMIC_ACQUIRE));
 }
 
 void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceiver * THIS, const MIDIPacketList * packetList) {
+    SEMIDIClockReceiverReceivePacketListAtTime(THIS, packetList, 0);
+}
+
+void SEMIDIClockReceiverReceivePacketListAtTime(__unsafe_unretained SEMIDIClockReceiver * THIS, const MIDIPacketList * packetList, uint64_t time) {
+    // Mark the receive path as in use before looking at the trace recorder or state publisher, so the main thread
+    // knows when objects it has swapped out are no longer in use
+    __atomic_add_fetch(&THIS->_receiveEpoch, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    
     const MIDIPacket *packet = &packetList->packet[0];
     for ( int index = 0; index < packetList->numPackets; index++, packet = MIDIPacketNext(packet) ) {
 
-        MIDITimeStamp timestamp = packet->timeStamp;
-        if ( !timestamp ) {
-            timestamp = SECurrentTimeInHostTicks();
-        }
+        uint64_t arrivalTime = time ? time : SECurrentTimeInHostTicks();
+        MIDITimeStamp timestamp = packet->timeStamp ? packet->timeStamp : arrivalTime;
         
         if ( packet->length == 0 ) {
             continue;
         }
         
+        // Record the timestamp as it came in, before smoothing, so traces replay what the source actually gave us
+        __unsafe_unretained SEMIDITraceRecorder * traceRecorder = THIS->_traceRecorder;
+        if ( traceRecorder ) {
+            SEMIDITraceRecorderRecordMessage(traceRecorder, timestamp, packet->data, packet->length);
+        }
+        
+        if ( packet->data[0] == SEMIDIMessageClock ) {
+            // Learn the source's timing, and smooth ticks stamped on arrival against its tick grid
+            timestamp = SETickGridIntegrateTick(&THIS->_tickGrid, THIS->_parameters.tickGridBandwidth, timestamp, arrivalTime,
+                                                !packet->timeStamp, THIS->_flywheelDuration != 0);
+        }
+        
 #ifdef DEBUG_ALL_MESSAGES
         NSLog(@"%llu: Incoming %@",
               timestamp,
@@ -180,6 +377,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                 THIS->_timeBase = 0;
                 THIS->_tickCount = 0;
                 THIS->_clockRunning = NO;
+                __atomic_add_fetch(&THIS->_discontinuityCount, 1, __ATOMIC_RELEASE);
                 
                 SEMIDIClockReceiverPushEvent(THIS, SEEventTypeStop, timestamp);
                 break;
@@ -204,7 +402,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                 
                 uint64_t previousTick = THIS->_lastTick;
                 THIS->_lastTick = timestamp;
-                THIS->_lastTickReceiveTime = SECurrentTimeInHostTicks();
+                THIS->_lastTickReceiveTime = arrivalTime;
                 
                 if ( !previousTick ) {
                     // No prior tick - don't do anything until the next one
@@ -262,13 +460,27 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                 // Determine interval since last tick, and calculate corresponding tempo
                 uint64_t interval = timestamp - previousTick;
                 
+                if ( THIS->_flywheelDuration && THIS->_tempo && !THIS->_primedAction && SESampleBufferCalculatedValue(&THIS->_tickSampleBuffer) ) {
+                    // Flywheel mode: if this tick ends a dropout on the grid extrapolated from the held tempo, count the missed ticks
+                    // and carry on, rather than taking the gap as a sample
+                    double elapsedTicks = (double)interval / (double)SESampleBufferCalculatedValue(&THIS->_tickSampleBuffer);
+                    int missedTicks = (int)round(elapsedTicks) - 1;
+                    if ( missedTicks >= kCoastingTickThreshold && fabs(elapsedTicks - (missedTicks + 1)) <= kFlywheelGridTolerance ) {
+                        if ( THIS->_clockRunning ) {
+                            THIS->_tickCount += missedTicks;
+                            THIS->_savedSongPosition = THIS->_tickCount;
+                        }
+                        interval /= missedTicks + 1;
+                    }
+                }
+                
                 // Add to collected samples
                 SESampleBufferIntegrateSample(&THIS->_tickSampleBuffer, interval);
                 int samplesSinceChange = SESampleBufferSamplesSinceLastSignificantChange(&THIS->_tickSampleBuffer);
                 
                 // Calculate true interval from samples, and convert to tempo
                 interval = SESampleBufferCalculatedValue(&THIS->_tickSampleBuffer);
-                double tempo = (double)SESecondsToHostTicks(60.0) / (double)(interval * SEMIDITicksPerBeat);
+                double tempo = __hostTicksPerMinute / (double)(interval * SEMIDITicksPerBeat);
                 
                 // Determine source's relative standard deviation
                 double relativeStandardDeviation = ((double)SESampleBufferStandardDeviation(&THIS->_tickSampleBuffer) / (double)interval) * 100.0;
@@ -281,8 +493,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                     
                 } else if ( samplesSinceChange >= kMinSamplesBeforeRecordingTempoHistory ) {
                     // Add to history
-                    uint64_t tempoHistoryBucketDuration = SESecondsToHostTicks(1.0);
-                    int tempoHistoryBucket = (timestamp / tempoHistoryBucketDuration) % kTempoHistoryLength;
+                    int tempoHistoryBucket = (timestamp / __hostTicksPerSecond) % kTempoHistoryLength;
                     if ( tempoHistoryBucket != THIS->_lastTempoHistoryBucket ) {
                         // Clear this old bucket
                         THIS->_tempoHistory[tempoHistoryBucket].max = 0.0;
@@ -294,7 +505,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                 }
                 
                 // Determine how much rounding to perform on tempo, to achieve a stable value
-                int roundingCoefficient = 5;
+                int roundingCoefficient = THIS->_coarsestRoundingCoefficient;
                 if ( relativeStandardDeviation <= kTrustedStandardDeviation
                         && SESampleBufferSamplesSeen(&THIS->_tickSampleBuffer) > kMinSamplesBeforeTrustingZeroStdDev ) {
                     
@@ -304,7 +515,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                     
                     // Untrusted source
                     roundingCoefficient = 0;
-                    for ( ; roundingCoefficient < (sizeof(kRoundingCoefficients)/sizeof(double))-1; roundingCoefficient++ ) {
+                    for ( ; roundingCoefficient < THIS->_coarsestRoundingCoefficient; roundingCoefficient++ ) {
                         // For each rounding coefficient (starting small), compare the rounded tempo entries with each other.
                         // If, for a given rounding coefficient, the rounded tempo entries all match, then we'll round using this coefficient.
                         BOOL acceptableRounding = YES;
@@ -360,7 +571,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                         // Trust the source - it's very accurate - so report any change immediately
                         reportUpdate = YES;
                         
-                    } else if ( THIS->_contiguousSampleCount >= kMinContiguousSamplesBeforeReportingTempo ) {
+                    } else if ( THIS->_contiguousSampleCount >= THIS->_parameters.minContiguousSamplesBeforeReportingTempo ) {
                         // Report when we've seen a number of consistent values
                         reportUpdate = YES;
                         
@@ -376,6 +587,8 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                         NSLog(@"Tempo is now %lf (was %lf)", tempo, THIS->_tempo);
 #endif
                         
+                        SEMIDIClockReceiverSetTempoConversion(THIS, tempo);
+                        OSMemoryBarrier();
                         THIS->_tempo = tempo;
                         THIS->_sampleCountSinceLastTempoUpdate = 0;
                         
@@ -385,7 +598,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                 
                 if ( THIS->_clockRunning && THIS->_tempo ) {
                     // Calculate new timebase
-                    uint64_t timeBase = timestamp - SEBeatsToHostTicks((double)THIS->_tickCount / (double)SEMIDITicksPerBeat, THIS->_tempo);
+                    uint64_t timeBase = timestamp - SETempoConversionBeatsToHostTicks(&THIS->_tempoConversion, (double)THIS->_tickCount / (double)SEMIDITicksPerBeat);
                     
                     // Add to collected samples
                     SESampleBufferIntegrateSample(&THIS->_timeBaseSampleBuffer, timeBase);
@@ -396,6 +609,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
                 
                 if ( THIS->_primedAction ) {
                     // Finalise primed actions
+                    __atomic_add_fetch(&THIS->_discontinuityCount, 1, __ATOMIC_RELEASE);
                     uint64_t actionTimestamp = THIS->_primedActionTimestamp ? THIS->_primedActionTimestamp : timestamp;
                     switch ( THIS->_primedAction ) {
                         case SEActionStart:
@@ -420,6 +634,10 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
             }
         }
     }
+    
+    SEMIDIClockReceiverPublishState(THIS);
+    
+    __atomic_add_fetch(&THIS->_receiveEpoch, 1, __ATOMIC_RELEASE);
 }
 
 -(void)reset {
@@ -435,6 +653,7 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
     _contiguousSampleCount = 0;
     SESampleBufferClear(&_tickSampleBuffer);
     SESampleBufferClear(&_timeBaseSampleBuffer);
+    SETickGridClear(&_tickGrid);
     for ( int i=0; i<kTempoHistoryLength; i++ ) { _tempoHistory[i].max = 0.0; _tempoHistory[i].min = DBL_MAX; }
     _lastTempoHistoryBucket = 0;
     _error = 0.0;
@@ -448,16 +667,32 @@ void SEMIDIClockReceiverReceivePacketList(__unsafe_unretained SEMIDIClockReceive
         [self willChangeValueForKey:@"clockRunning"];
         _timeBase = 0;
         _clockRunning = NO;
+        __atomic_add_fetch(&_discontinuityCount, 1, __ATOMIC_RELEASE);
         [self didChangeValueForKey:@"clockRunning"];
         
         [[NSNotificationCenter defaultCenter] postNotificationName:SEMIDIClockReceiverDidStopNotification
                                                             object:self
                                                           userInfo:@{ SEMIDIClockReceiverTimestampKey: @(SECurrentTimeInHostTicks()) }];
     }
+    
+    SEMIDIClockReceiverPublishState(self);
 }
 
 BOOL SEMIDIClockReceiverIsReceivingTempo(__unsafe_unretained SEMIDIClockReceiver * receiver) {
-    return receiver->_lastTickReceiveTime && receiver->_lastTickReceiveTime >= SECurrentTimeInHostTicks() - SESecondsToHostTicks(kActivityTimeout);
+    return receiver->_lastTickReceiveTime && receiver->_lastTickReceiveTime >= SECurrentTimeInHostTicks() - SEMIDIClockReceiverActivityTimeout(receiver);
+}
+
+BOOL SEMIDIClockReceiverIsCoasting(__unsafe_unretained SEMIDIClockReceiver * receiver) {
+    uint64_t lastTickReceiveTime = receiver->_lastTickReceiveTime;
+    double tempo = receiver->_tempo;
+    if ( !receiver->_flywheelDuration || !lastTickReceiveTime || !tempo ) {
+        return NO;
+    }
+    
+    uint64_t now = SECurrentTimeInHostTicks();
+    uint64_t silence = now > lastTickReceiveTime ? now - lastTickReceiveTime : 0;
+    uint64_t tickDuration = __hostTicksPerMinute / (tempo * SEMIDITicksPerBeat);
+    return silence > kCoastingTickThreshold * tickDuration && silence <= SEMIDIClockReceiverActivityTimeout(receiver);
 }
 
 BOOL SEMIDIClockReceiverIsClockRunning(__unsafe_unretained SEMIDIClockReceiver * receiver) {
@@ -469,23 +704,64 @@ double SEMIDIClockReceiverGetTimelinePosition(__unsafe_unretained SEMIDIClockRec
         time = SECurrentTimeInHostTicks();
     }
     uint64_t timeBase = receiver->_timeBase;
-    double tempo = receiver->_tempo;
+    SETempoConversion conversion = SEMIDIClockReceiverReadTempoConversion(receiver);
     double savedSongPosition = receiver->_savedSongPosition;
 
     double position;
-    if ( !timeBase || !tempo ) {
+    if ( !timeBase || !conversion.tempo ) {
         position = (double)savedSongPosition / (double)SEMIDITicksPerBeat;
     } else {
-        position = time > timeBase ? SEHostTicksToBeats(time - timeBase, tempo) : 0;
+        position = time > timeBase ? SETempoConversionHostTicksToBeats(&conversion, time - timeBase) : 0;
     }
     
     return position;
 }
 
+void SEMIDIClockReceiverGetTimelinePositions(__unsafe_unretained SEMIDIClockReceiver * receiver,
+                                             const uint64_t * times, double * positions, int count) {
+    uint64_t timeBase = receiver->_timeBase;
+    SETempoConversion conversion = SEMIDIClockReceiverReadTempoConversion(receiver);
+    double savedSongPosition = receiver->_savedSongPosition;
+    
+    if ( !timeBase || !conversion.tempo ) {
+        double position = (double)savedSongPosition / (double)SEMIDITicksPerBeat;
+        for ( int i=0; i<count; i++ ) {
+            positions[i] = position;
+        }
+        return;
+    }
+    
+    SETempoConversionHostTicksToBeatsArray(&conversion, timeBase, 0.0, times, positions, count);
+}
+
+void SEMIDIClockReceiverGetTimesForTimelinePositions(__unsafe_unretained SEMIDIClockReceiver * receiver,
+                                                     const double * positions, uint64_t * times, int count) {
+    uint64_t timeBase = receiver->_timeBase;
+    SETempoConversion conversion = SEMIDIClockReceiverReadTempoConversion(receiver);
+    
+    if ( !timeBase || !conversion.tempo ) {
+        memset(times, 0, count * sizeof(uint64_t));
+        return;
+    }
+    
+    SETempoConversionBeatsToHostTicksArray(&conversion, 0.0, timeBase, positions, times, count);
+}
+
 double SEMIDIClockReceiverGetTempo(__unsafe_unretained SEMIDIClockReceiver * receiver) {
     return receiver->_tempo;
 }
 
+uint32_t SEMIDIClockReceiverGetDiscontinuityCount(__unsafe_unretained SEMIDIClockReceiver * receiver) {
+    return __atomic_load_n(&receiver->_discontinuityCount, __ATOMIC_ACQUIRE);
+}
+
+NSTimeInterval SEMIDIClockReceiverGetInputLatency(__unsafe_unretained SEMIDIClockReceiver * receiver) {
+    if ( !receiver->_tickGrid.arrivalStamped ) {
+        return 0.0;
+    }
+    return SEHostTicksToSeconds((uint64_t)llround(receiver->_tickGrid.latency));
+}
+
 -(double)timelinePositionForTime:(uint64_t)time {
     return SEMIDIClockReceiverGetTimelinePosition(self, time);
 }
@@ -498,6 +774,71 @@ double SEMIDIClockReceiverGetTempo(__unsafe_unretained SEMIDIClockReceiver * rec
     return SEMIDIClockReceiverIsClockRunning(self);
 }
 
+-(BOOL)coasting {
+    return SEMIDIClockReceiverIsCoasting(self);
+}
+
+-(NSTimeInterval)flywheelDuration {
+    return SEHostTicksToSeconds(_flywheelDuration);
+}
+
+-(void)setFlywheelDuration:(NSTimeInterval)flywheelDuration {
+    _flywheelDuration = SESecondsToHostTicks(MAX(0.0, flywheelDuration));
+}
+
+-(NSTimeInterval)inputLatency {
+    return SEMIDIClockReceiverGetInputLatency(self);
+}
+
+-(NSTimeInterval)timestampJitter {
+    return SEHostTicksToSeconds((uint64_t)llround(sqrt(_tickGrid.meanSquaredResidual)));
+}
+
+-(NSTimeInterval)timestampOffset {
+    if ( _tickGrid.arrivalStamped || !_tickGrid.hasOffset ) {
+        return 0.0;
+    }
+    double offset = _tickGrid.offsetEnvelope;
+    return offset < 0 ? -SEHostTicksToSeconds((uint64_t)llround(-offset)) : SEHostTicksToSeconds((uint64_t)llround(offset));
+}
+
+-(SEMIDIClockReceiverParameters)parameters {
+    return _parameters;
+}
+
+-(BOOL)sourceProvidesTimestamps {
+    return !_tickGrid.arrivalStamped;
+}
+
+
+static void SEMIDIClockReceiverSetTempoConversion(__unsafe_unretained SEMIDIClockReceiver * THIS, double tempo) {
+    // Called on the MIDI thread. Marks the conversion context as being updated, for lock-free readers.
+    __atomic_store_n(&THIS->_tempoConversionSequence, THIS->_tempoConversionSequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    SETempoConversionSetTempo(&THIS->_tempoConversion, tempo);
+    __atomic_store_n(&THIS->_tempoConversionSequence, THIS->_tempoConversionSequence + 1, __ATOMIC_RELEASE);
+}
+
+static SETempoConversion SEMIDIClockReceiverReadTempoConversion(__unsafe_unretained SEMIDIClockReceiver * THIS) {
+    // Read a consistent copy of the conversion context, retrying if it overlaps an update, so that its tempo and
+    // factors always belong together
+    while ( 1 ) {
+        uint32_t sequence = __atomic_load_n(&THIS->_tempoConversionSequence, __ATOMIC_ACQUIRE);
+        if ( sequence & 1 ) {
+            continue;
+        }
+        SETempoConversion conversion = THIS->_tempoConversion;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&THIS->_tempoConversionSequence, __ATOMIC_RELAXED) == sequence ) {
+            return conversion;
+        }
+    }
+}
+
+static uint64_t SEMIDIClockReceiverActivityTimeout(__unsafe_unretained SEMIDIClockReceiver * THIS) {
+    // In flywheel mode, we hold on through dropouts up to the flywheel duration
+    return MAX(__activityTimeout, THIS->_flywheelDuration);
+}
 
 static void SEMIDIClockReceiverPushEvent(__unsafe_unretained SEMIDIClockReceiver * THIS, SEEventType type, uint64_t timestamp) {
     for ( int i=0; i<kEventBufferSize; i++ ) {
@@ -511,6 +852,8 @@ static void SEMIDIClockReceiverPushEvent(__unsafe_unretained SEMIDIClockReceiver
 }
 
 -(void)pollForEvents {
+    [self releaseRetiredObjects];
+    
     for ( int i=0; i<kEventBufferSize; i++ ) {
         if ( _eventBuffer[i].type == SEEventTypeNone ) {
             continue;
@@ -518,14 +861,7 @@ static void SEMIDIClockReceiverPushEvent(__unsafe_unretained SEMIDIClockReceiver
         
         switch ( _eventBuffer[i].type ) {
             case SEEventTypeStop:
-                if ( fabs(_eventPollTimer.timeInterval - kIdlePollInterval) > DBL_EPSILON ) {
-                    [_eventPollTimer invalidate];
-                    self.eventPollTimer = [NSTimer scheduledTimerWithTimeInterval:kIdlePollInterval
-                                                                           target:[[SEWeakRetainingProxy alloc] initWithTarget:self]
-                                                                         selector:@selector(pollForEvents)
-                                                                         userInfo:nil
-                                                                          repeats:YES];
-                }
+                [self setEventPollInterval:kIdlePollInterval];
                 [self willChangeValueForKey:@"clockRunning"];
                 [self didChangeValueForKey:@"clockRunning"];
                 [[NSNotificationCenter defaultCenter] postNotificationName:SEMIDIClockReceiverDidStopNotification
@@ -534,14 +870,7 @@ static void SEMIDIClockReceiverPushEvent(__unsafe_unretained SEMIDIClockReceiver
                 break;
             case SEEventTypeTempo:
                 if ( !_receivingTempo ) {
-                    if ( fabs(_eventPollTimer.timeInterval - kActivePollInterval) > DBL_EPSILON ) {
-                        [_eventPollTimer invalidate];
-                        self.eventPollTimer = [NSTimer scheduledTimerWithTimeInterval:kActivePollInterval
-                                                                               target:[[SEWeakRetainingProxy alloc] initWithTarget:self]
-                                                                             selector:@selector(pollForEvents)
-                                                                             userInfo:nil
-                                                                              repeats:YES];
-                    }
+                    [self setEventPollInterval:kActivePollInterval];
                     
                     [self willChangeValueForKey:@"receivingTempo"];
                     _receivingTempo = YES;
@@ -581,25 +910,122 @@ static void SEMIDIClockReceiverPushEvent(__unsafe_unretained SEMIDIClockReceiver
         _eventBuffer[i].type = SEEventTypeNone;
     }
     
-    if ( _lastTickReceiveTime && _lastTickReceiveTime < SECurrentTimeInHostTicks() - SESecondsToHostTicks(kActivityTimeout) ) {
+    if ( _lastTickReceiveTime && _lastTickReceiveTime < SECurrentTimeInHostTicks() - SEMIDIClockReceiverActivityTimeout(self) ) {
 #ifdef DEBUG_LOGGING
         NSLog(@"Timed out");
 #endif
         
         // Timed out
-        if ( fabs(_eventPollTimer.timeInterval - kIdlePollInterval) > DBL_EPSILON ) {
-            [_eventPollTimer invalidate];
-            self.eventPollTimer = [NSTimer scheduledTimerWithTimeInterval:kIdlePollInterval
-                                                                   target:[[SEWeakRetainingProxy alloc] initWithTarget:self]
-                                                                 selector:@selector(pollForEvents)
-                                                                 userInfo:nil
-                                                                  repeats:YES];
-        }
+        [self setEventPollInterval:kIdlePollInterval];
         
         [self reset];
     }
 }
 
+-(void)setEventPollInterval:(NSTimeInterval)interval {
+    if ( !_usesEventPollTimer ) {
+        // Our owner polls on our behalf
+        return;
+    }
+    
+    if ( !_eventPollTimer || fabs(_eventPollTimer.timeInterval - interval) > DBL_EPSILON ) {
+        [_eventPollTimer invalidate];
+        self.eventPollTimer = [NSTimer scheduledTimerWithTimeInterval:interval
+                                                               target:[[SEWeakRetainingProxy alloc] initWithTarget:self]
+                                                             selector:@selector(pollForEvents)
+                                                             userInfo:nil
+                                                              repeats:YES];
+    }
+}
+
+#pragma mark - Tick grid estimation
+
+// Ticks from a clock source lie on a regular grid, so we can tell how far each timestamp strays from
+// it. We fit a line through the first few ticks, then follow the grid with a second-order loop, which
+// tracks both the time of each tick and the interval between them (Adriaensen, "Using a DLL to filter
+// time"). For sources that leave timestamps to us, the arrival time carries all the scheduling delay
+// of the MIDI thread, which is always late and never early: so we use the grid in place of the
+// arrival time, moved back towards the lower envelope of arrival delays by their average excess.
+
+static uint64_t SETickGridIntegrateTick(SETickGrid *grid, double bandwidth, uint64_t timestamp, uint64_t arrivalTime, BOOL arrivalStamped, BOOL bridgeGaps) {
+    if ( arrivalStamped != grid->arrivalStamped ) {
+        // Source changed how it timestamps: start learning again
+        SETickGridClear(grid);
+        grid->arrivalStamped = arrivalStamped;
+    }
+    
+    if ( !arrivalStamped ) {
+        // Track the shortest recent delay between timestamps and arrival, which reveals an offset, or drift, in the source's clock
+        double delay = (double)(int64_t)(arrivalTime - timestamp);
+        grid->offsetEnvelope = grid->hasOffset ? MIN(delay, grid->offsetEnvelope + kEnvelopeRiseRate * grid->period) : delay;
+        grid->hasOffset = YES;
+    }
+    
+    if ( grid->count == kTickGridFitTicks ) {
+        double residual = (double)(int64_t)(timestamp - grid->estimate) - grid->period;
+        if ( bridgeGaps && residual > kTickGridResetThreshold * grid->period ) {
+            // Ticks went missing: if this one lands on the grid further along, carry the grid forward over the gap
+            double missedTicks = round(residual / grid->period);
+            if ( fabs(residual - missedTicks * grid->period) <= kFlywheelGridTolerance * grid->period ) {
+                grid->estimate += llround(missedTicks * grid->period);
+                residual -= missedTicks * grid->period;
+            }
+        }
+        if ( fabs(residual) <= kTickGridResetThreshold * grid->period ) {
+            // Follow the grid
+            double omega = 2.0 * M_PI * bandwidth;
+            grid->estimate += llround(grid->period + M_SQRT2 * omega * residual);
+            grid->period += omega * omega * residual;
+            
+            // Gauge the source's timestamp quality
+            grid->meanSquaredResidual += kTimingAveragingFactor * (residual * residual - grid->meanSquaredResidual);
+            grid->residualEnvelope = MIN(residual, grid->residualEnvelope + kEnvelopeRiseRate * grid->period);
+            grid->latency += kTimingAveragingFactor * ((residual - grid->residualEnvelope) - grid->latency);
+            
+            if ( !arrivalStamped ) {
+                return timestamp;
+            }
+            
+            return grid->estimate - (uint64_t)llround(grid->latency);
+        }
+        
+        // Tempo jumped, or ticks went missing: find the grid again, from this tick
+        grid->count = 0;
+    }
+    
+    // Fit a line through the ticks seen so far
+    if ( grid->count == 0 ) {
+        grid->firstTick = timestamp;
+        grid->sumX = grid->sumY = grid->sumXX = grid->sumXY = 0.0;
+    }
+    double x = grid->count;
+    double y = (double)(int64_t)(timestamp - grid->firstTick);
+    grid->sumX += x;
+    grid->sumY += y;
+    grid->sumXX += x * x;
+    grid->sumXY += x * y;
+    grid->count++;
+    
+    if ( grid->count > 1 ) {
+        double n = grid->count;
+        double period = (n * grid->sumXY - grid->sumX * grid->sumY) / (n * grid->sumXX - grid->sumX * grid->sumX);
+        if ( period <= 0.0 ) {
+            // Ticks out of order; not a grid
+            grid->count = 0;
+            return timestamp;
+        }
+        double intercept = (grid->sumY - period * grid->sumX) / n;
+        grid->period = period;
+        grid->estimate = grid->firstTick + llround(intercept + period * (n - 1));
+    }
+    
+    return timestamp;
+}
+
+static void SETickGridClear(SETickGrid *grid) {
+    memset(grid, 0, sizeof(SETickGrid));
+}
+
 #pragma mark - Ring buffer utilities
 
 static void SESampleBufferIntegrateSample(SESampleBuffer *buffer, uint64_t sample) {
@@ -609,26 +1035,33 @@ static void SESampleBufferIntegrateSample(SESampleBuffer *buffer, uint64_t sampl
     // as an outlier), and to identify consecutive outliers which represent a new value, so we can converge faster upon that.
     
     BOOL outlier = NO;
+    BOOL outOfRange = SESampleBufferFillCount(buffer) > 0 && !_SESampleBufferIsWithinRange(buffer->mean, sample);
     if ( SESampleBufferFillCount(buffer) < kMinSamplesBeforeEvaluatingOutliers ) {
         
-        // Not enough samples seen yet
-        outlier = NO;
+        // Not enough samples seen yet, so only a sample too far from the others to store alongside them is an outlier
+        outlier = outOfRange;
         
     } else {
         
         // It's an outlier if it's outside our threshold past the observed average
-        uint64_t outlierThreshold = kOutlierThresholdRatio * buffer->standardDeviation;
-        if ( buffer->seenSamples < kMinSamplesBeforeEvaluatingOutliers && outlierThreshold < SESecondsToHostTicks(kMinimumEarlyOutlierThreshold) ) {
-            outlierThreshold = SESecondsToHostTicks(kMinimumEarlyOutlierThreshold);
+        uint64_t center = buffer->mean;
+        uint64_t outlierThreshold = buffer->outlierThresholdRatio * buffer->standardDeviation;
+        if ( buffer->robust ) {
+            // Measure from the median, by the median absolute deviation, neither of which a few outliers can inflate
+            center = buffer->median;
+            outlierThreshold = MAX(outlierThreshold, __minimumRobustOutlierThreshold);
+        } else if ( buffer->seenSamples < kMinSamplesBeforeEvaluatingOutliers && outlierThreshold < __minimumEarlyOutlierThreshold ) {
+            outlierThreshold = __minimumEarlyOutlierThreshold;
         }
-        outlier = sample > buffer->mean + outlierThreshold
-                    || sample < (buffer->mean < outlierThreshold ? 0 : buffer->mean - outlierThreshold);
+        outlier = outOfRange
+                    || sample > center + outlierThreshold
+                    || sample < (center < outlierThreshold ? 0 : center - outlierThreshold);
         
         // Make sure other outliers we've seen lie on the same side of the current range
         if ( outlier && buffer->contiguousOutlierCount > 0 ) {
-            BOOL greaterThanRange = sample > buffer->mean + outlierThreshold;
+            BOOL greaterThanRange = sample > center + outlierThreshold;
             for ( int i=0; i<buffer->contiguousOutlierCount; i++ ) {
-                if ( greaterThanRange == (buffer->outliers[i] < buffer->mean + outlierThreshold) ) {
+                if ( greaterThanRange == (buffer->outliers[i] < center + outlierThreshold) ) {
                     // This outlier is on the other side of the range, which means we're not looking at
                     // outliers representing a new value, but outlying samples.
                     outlier = NO;
@@ -642,10 +1075,12 @@ static void SESampleBufferIntegrateSample(SESampleBuffer *buffer, uint64_t sampl
         // Handle outliers
         buffer->outliers[buffer->contiguousOutlierCount++] = sample;
         
-        if ( buffer->contiguousOutlierCount == kOutliersBeforeReset ) {
+        if ( buffer->contiguousOutlierCount == buffer->outliersBeforeReset ) {
             // Reset our sample buffer
             buffer->head = buffer->tail = 0;
+            buffer->orderRoot = 0;
             buffer->accumulator = 0;
+            buffer->squaredAccumulator = 0;
             buffer->standardDeviation = 0;
             buffer->sampleCountSinceLastSignificantChange = 0;
             buffer->significantChange = YES;
@@ -675,7 +1110,7 @@ static void SESampleBufferIntegrateSample(SESampleBuffer *buffer, uint64_t sampl
               SESecondsToHostTicks(60.0) / ((double)sample * SEMIDITicksPerBeat),
               buffer->mean,
               SESecondsToHostTicks(60.0) / ((double)buffer->mean * SEMIDITicksPerBeat),
-              buffer->standardDeviation,
+              (uint64_t)buffer->standardDeviation,
               ((double)buffer->standardDeviation / (double)buffer->mean) * 100.0);
     } else {
         // Absolute timestamp
@@ -685,7 +1120,7 @@ static void SESampleBufferIntegrateSample(SESampleBuffer *buffer, uint64_t sampl
               SEHostTicksToSeconds(sample),
               buffer->mean,
               SEHostTicksToSeconds(buffer->mean),
-              buffer->standardDeviation,
+              (uint64_t)buffer->standardDeviation,
               SEHostTicksToSeconds(buffer->standardDeviation),
               ((double)buffer->standardDeviation / (double)buffer->mean) * 0.5 * 100.0);
     }
@@ -723,52 +1158,321 @@ static BOOL SESampleBufferSignificantChangeHappened(SESampleBuffer *buffer) {
 }
 
 static void SESampleBufferClear(SESampleBuffer *buffer) {
+    // Clear everything but the configuration
+    uint16_t capacity = buffer->capacity;
+    uint8_t outliersBeforeReset = buffer->outliersBeforeReset;
+    double outlierThresholdRatio = buffer->outlierThresholdRatio;
+    SEOrderStatisticNode * orderNodes = buffer->orderNodes;
     memset(buffer, 0, sizeof(SESampleBuffer));
+    buffer->capacity = capacity;
+    buffer->outliersBeforeReset = outliersBeforeReset;
+    buffer->outlierThresholdRatio = outlierThresholdRatio;
+    buffer->orderNodes = orderNodes;
+    buffer->robust = orderNodes != NULL;
     buffer->significantChange = YES;
 }
 
+static void SESampleBufferConfigure(SESampleBuffer *buffer, const SEMIDIClockReceiverParameters * parameters, SEOrderStatisticNode * orderNodes) {
+    // Pass tree nodes for each slot of the buffer to use robust mode, or NULL
+    buffer->capacity = parameters->sampleBufferSize;
+    buffer->outliersBeforeReset = parameters->outliersBeforeReset;
+    buffer->outlierThresholdRatio = parameters->outlierThresholdRatio;
+    buffer->orderNodes = orderNodes;
+    SESampleBufferClear(buffer);
+}
+
 static int SESampleBufferFillCount(SESampleBuffer *buffer) {
     return buffer->head >= buffer->tail
         ? buffer->head - buffer->tail
-        : (buffer->head + kSampleBufferSize) - buffer->tail;
+        : (buffer->head + buffer->capacity) - buffer->tail;
 }
 
 static void _SESampleBufferAddSampleToBuffer(SESampleBuffer *buffer, uint64_t sample) {
-    if ( (buffer->head + 1) % kSampleBufferSize == buffer->tail ) {
+    if ( buffer->head == buffer->tail ) {
+        // Empty buffer: anchor to this sample, so that we can store samples as small offsets
+        buffer->anchor = sample;
+    }
+    
+    if ( !_SESampleBufferIsWithinRange(buffer->anchor, sample) ) {
+        // Too far from the anchor to store, as the samples drift: move the anchor to this sample
+        _SESampleBufferRebase(buffer, sample);
+    }
+    int64_t offset = (int64_t)(sample - buffer->anchor);
+    
+    if ( (buffer->head + 1) % buffer->capacity == buffer->tail ) {
         // Buffer is full, slide along: factor out last sample
-        buffer->accumulator -= buffer->samples[buffer->tail];
+        int64_t lastSample = buffer->samples[buffer->tail];
+        buffer->accumulator -= lastSample;
+        buffer->squaredAccumulator -= lastSample * lastSample;
+        if ( buffer->robust ) {
+            buffer->orderRoot = SEOrderStatisticTreeRemove(buffer, buffer->orderRoot, buffer->tail + 1);
+        }
         
         // Move up tail
-        buffer->tail = (buffer->tail + 1) % kSampleBufferSize;
+        buffer->tail = (buffer->tail + 1) % buffer->capacity;
     }
     
     // Add new sample, move up head
-    buffer->samples[buffer->head] = sample;
-    buffer->head = (buffer->head + 1) % kSampleBufferSize;
+    buffer->samples[buffer->head] = (int32_t)offset;
+    if ( buffer->robust ) {
+        SEOrderStatisticTreeInsert(buffer, buffer->head + 1, (int32_t)offset);
+    }
+    buffer->head = (buffer->head + 1) % buffer->capacity;
     buffer->sampleCountSinceLastSignificantChange++;
     buffer->seenSamples++;
     
     // Integrate new value
-    buffer->accumulator += sample;
+    buffer->accumulator += offset;
+    buffer->squaredAccumulator += offset * offset;
     
-    // Calculate new mean
-    buffer->mean = buffer->accumulator / SESampleBufferFillCount(buffer);
+    // Calculate new mean (rounding down, including for offsets below the anchor)
+    int64_t count = SESampleBufferFillCount(buffer);
+    int64_t meanOffset = buffer->accumulator / count;
+    if ( buffer->accumulator % count < 0 ) meanOffset--;
+    buffer->mean = buffer->anchor + meanOffset;
     
-    // Calculate new standard deviation
-    uint64_t sum = 0;
-    for ( int i=buffer->tail; i != buffer->head; i = (i+1) % kSampleBufferSize ) {
-        uint64_t absDifference = buffer->samples[i] > buffer->mean ? buffer->samples[i] - buffer->mean : buffer->mean - buffer->samples[i];
-        sum += absDifference*absDifference;
+    // Calculate new standard deviation from the running sums: sum((x-m)^2) = sum(x^2) - 2m*sum(x) + n*m^2
+    int64_t sum = buffer->squaredAccumulator - 2 * meanOffset * buffer->accumulator + count * meanOffset * meanOffset;
+    buffer->standardDeviation = sqrt((double)sum / (double)count);
+    
+    if ( buffer->robust ) {
+        // Use robust estimates instead
+        _SESampleBufferCalculateRobustStatistics(buffer);
     }
-    buffer->standardDeviation = sqrt((double)sum / (double)SESampleBufferFillCount(buffer));
     
     if ( buffer->sampleCountSinceLastSignificantChange > kMinSamplesBeforeStoringStandardDeviation ) {
         int standardDeviationHistoryBucket = (buffer->sampleCountSinceLastSignificantChange / kStandardDeviationHistoryEntryDuration) % kStandardDeviationHistorySamples;
         if ( buffer->sampleCountSinceLastSignificantChange % kStandardDeviationHistoryEntryDuration == 0 ) {
             buffer->standardDeviationHistory[standardDeviationHistoryBucket] = 0;
         }
-        buffer->standardDeviationHistory[standardDeviationHistoryBucket] = MAX(buffer->standardDeviationHistory[standardDeviationHistoryBucket], buffer->standardDeviation);
+        buffer->standardDeviationHistory[standardDeviationHistoryBucket] = (uint32_t)MAX(buffer->standardDeviationHistory[standardDeviationHistoryBucket], buffer->standardDeviation);
+    }
+}
+
+static BOOL _SESampleBufferIsWithinRange(uint64_t reference, uint64_t sample) {
+    int64_t offset = (int64_t)(sample - reference);
+    return offset <= kMaxSampleOffset && offset >= -kMaxSampleOffset;
+}
+
+static void _SESampleBufferRebase(SESampleBuffer *buffer, uint64_t anchor) {
+    // Store the samples as offsets from the new anchor, in order from the oldest, dropping any too far from it to store
+    int count = SESampleBufferFillCount(buffer);
+    int32_t samples[kSampleBufferSize];
+    for ( int i=0; i<count; i++ ) {
+        samples[i] = buffer->samples[(buffer->tail + i) % buffer->capacity];
+    }
+    
+    int64_t delta = (int64_t)(anchor - buffer->anchor);
+    buffer->anchor = anchor;
+    buffer->head = buffer->tail = 0;
+    buffer->orderRoot = 0;
+    buffer->accumulator = 0;
+    buffer->squaredAccumulator = 0;
+    for ( int i=0; i<count; i++ ) {
+        int64_t offset = samples[i] - delta;
+        if ( offset > kMaxSampleOffset || offset < -kMaxSampleOffset ) continue;
+        buffer->samples[buffer->head] = (int32_t)offset;
+        if ( buffer->robust ) {
+            SEOrderStatisticTreeInsert(buffer, buffer->head + 1, (int32_t)offset);
+        }
+        buffer->head++;
+        buffer->accumulator += offset;
+        buffer->squaredAccumulator += offset * offset;
+    }
+}
+
+static void _SESampleBufferCalculateRobustStatistics(SESampleBuffer *buffer) {
+    int count = SESampleBufferFillCount(buffer);
+    
+    // Median (the lower one, for an even count)
+    int32_t median = SEOrderStatisticTreeSelect(buffer, (count - 1) / 2);
+    
+    // Median absolute deviation: the middle of the distances from the median. The distances of the samples below
+    // the median ascend as we walk down from it, and those above as we walk up, so we take the k-th smallest of
+    // the two sorted runs, by binary search on how many come from the run below.
+    int belowCount = SEOrderStatisticTreeCountLess(buffer, median);
+    int aboveCount = count - belowCount;
+    int k = (count - 1) / 2 + 1;
+    int low = MAX(0, k - aboveCount);
+    int high = MIN(k, belowCount);
+    while ( low < high ) {
+        int i = (low + high) / 2;
+        int64_t below = (int64_t)median - SEOrderStatisticTreeSelect(buffer, belowCount - 1 - i);
+        int64_t above = (int64_t)SEOrderStatisticTreeSelect(buffer, belowCount + (k - i) - 1) - median;
+        if ( below < above ) {
+            low = i + 1;
+        } else {
+            high = i;
+        }
+    }
+    int64_t deviation = 0;
+    if ( low > 0 ) {
+        deviation = MAX(deviation, (int64_t)median - SEOrderStatisticTreeSelect(buffer, belowCount - low));
+    }
+    if ( k - low > 0 ) {
+        deviation = MAX(deviation, (int64_t)SEOrderStatisticTreeSelect(buffer, belowCount + (k - low) - 1) - median);
+    }
+    
+    // Central value: the mean of the middle half of the samples, which keeps most of the averaging of the mean
+    // without letting stray samples pull it
+    int lowerQuartile = count / 4;
+    int upperQuartile = count - count / 4;
+    int64_t middleSum = SEOrderStatisticTreeSumOfSmallest(buffer, upperQuartile) - SEOrderStatisticTreeSumOfSmallest(buffer, lowerQuartile);
+    int64_t middleCount = upperQuartile - lowerQuartile;
+    int64_t meanOffset = middleSum / middleCount;
+    if ( middleSum % middleCount < 0 ) meanOffset--;
+    
+    buffer->median = buffer->anchor + (int64_t)median;
+    buffer->mean = buffer->anchor + meanOffset;
+    buffer->standardDeviation = llround(kMedianAbsoluteDeviationScale * deviation);
+}
+
+#pragma mark - Order statistic tree
+
+// A treap over the samples in the ring, with a node per ring slot, ordered by value (then slot), and each node
+// holding the size and sum of its subtree. Inserting and removing samples, and finding a sample by rank, take
+// O(log n) time. Nodes are referred to by slot + 1, so that zero means no node.
+
+static inline SEOrderStatisticNode * SEOrderStatisticTreeNode(SESampleBuffer *buffer, uint16_t node) {
+    return &buffer->orderNodes[node - 1];
+}
+
+static inline int SEOrderStatisticTreeSize(SESampleBuffer *buffer, uint16_t node) {
+    return node ? SEOrderStatisticTreeNode(buffer, node)->size : 0;
+}
+
+static inline int64_t SEOrderStatisticTreeSum(SESampleBuffer *buffer, uint16_t node) {
+    return node ? SEOrderStatisticTreeNode(buffer, node)->sum : 0;
+}
+
+static inline BOOL SEOrderStatisticTreeLess(SESampleBuffer *buffer, uint16_t a, uint16_t b) {
+    int32_t valueA = SEOrderStatisticTreeNode(buffer, a)->value;
+    int32_t valueB = SEOrderStatisticTreeNode(buffer, b)->value;
+    return valueA < valueB || (valueA == valueB && a < b);
+}
+
+static void SEOrderStatisticTreeUpdate(SESampleBuffer *buffer, uint16_t node) {
+    SEOrderStatisticNode * n = SEOrderStatisticTreeNode(buffer, node);
+    n->size = 1 + SEOrderStatisticTreeSize(buffer, n->left) + SEOrderStatisticTreeSize(buffer, n->right);
+    n->sum = n->value + SEOrderStatisticTreeSum(buffer, n->left) + SEOrderStatisticTreeSum(buffer, n->right);
+}
+
+static uint16_t SEOrderStatisticTreeMerge(SESampleBuffer *buffer, uint16_t left, uint16_t right) {
+    // Joins two trees, all of whose nodes in the left tree order before those in the right
+    if ( !left ) return right;
+    if ( !right ) return left;
+    if ( SEOrderStatisticTreeNode(buffer, left)->priority > SEOrderStatisticTreeNode(buffer, right)->priority ) {
+        SEOrderStatisticTreeNode(buffer, left)->right = SEOrderStatisticTreeMerge(buffer, SEOrderStatisticTreeNode(buffer, left)->right, right);
+        SEOrderStatisticTreeUpdate(buffer, left);
+        return left;
+    } else {
+        SEOrderStatisticTreeNode(buffer, right)->left = SEOrderStatisticTreeMerge(buffer, left, SEOrderStatisticTreeNode(buffer, right)->left);
+        SEOrderStatisticTreeUpdate(buffer, right);
+        return right;
+    }
+}
+
+static void SEOrderStatisticTreeSplit(SESampleBuffer *buffer, uint16_t tree, uint16_t node, uint16_t *left, uint16_t *right) {
+    // Splits a tree into the nodes ordering before the given node, and the rest
+    if ( !tree ) {
+        *left = *right = 0;
+        return;
+    }
+    if ( SEOrderStatisticTreeLess(buffer, tree, node) ) {
+        SEOrderStatisticTreeSplit(buffer, SEOrderStatisticTreeNode(buffer, tree)->right, node, &SEOrderStatisticTreeNode(buffer, tree)->right, right);
+        *left = tree;
+    } else {
+        SEOrderStatisticTreeSplit(buffer, SEOrderStatisticTreeNode(buffer, tree)->left, node, left, &SEOrderStatisticTreeNode(buffer, tree)->left);
+        *right = tree;
+    }
+    SEOrderStatisticTreeUpdate(buffer, tree);
+}
+
+static void SEOrderStatisticTreeInsert(SESampleBuffer *buffer, uint16_t node, int32_t value) {
+    // Random priority (xorshift)
+    uint32_t state = buffer->priorityState ? buffer->priorityState : 2463534242u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    buffer->priorityState = state;
+    
+    SEOrderStatisticNode * n = SEOrderStatisticTreeNode(buffer, node);
+    n->value = value;
+    n->priority = state;
+    n->left = n->right = 0;
+    SEOrderStatisticTreeUpdate(buffer, node);
+    
+    uint16_t left, right;
+    SEOrderStatisticTreeSplit(buffer, buffer->orderRoot, node, &left, &right);
+    buffer->orderRoot = SEOrderStatisticTreeMerge(buffer, SEOrderStatisticTreeMerge(buffer, left, node), right);
+}
+
+static uint16_t SEOrderStatisticTreeRemove(SESampleBuffer *buffer, uint16_t tree, uint16_t node) {
+    // Removes the node from the tree, returning the new root
+    if ( !tree ) return 0;
+    SEOrderStatisticNode * n = SEOrderStatisticTreeNode(buffer, tree);
+    if ( tree == node ) {
+        return SEOrderStatisticTreeMerge(buffer, n->left, n->right);
+    }
+    if ( SEOrderStatisticTreeLess(buffer, node, tree) ) {
+        n->left = SEOrderStatisticTreeRemove(buffer, n->left, node);
+    } else {
+        n->right = SEOrderStatisticTreeRemove(buffer, n->right, node);
+    }
+    SEOrderStatisticTreeUpdate(buffer, tree);
+    return tree;
+}
+
+static int32_t SEOrderStatisticTreeSelect(SESampleBuffer *buffer, int rank) {
+    // Finds the value of the given rank, counting from zero
+    uint16_t tree = buffer->orderRoot;
+    while ( tree ) {
+        SEOrderStatisticNode * n = SEOrderStatisticTreeNode(buffer, tree);
+        int leftSize = SEOrderStatisticTreeSize(buffer, n->left);
+        if ( rank < leftSize ) {
+            tree = n->left;
+        } else if ( rank == leftSize ) {
+            return n->value;
+        } else {
+            rank -= leftSize + 1;
+            tree = n->right;
+        }
+    }
+    return 0;
+}
+
+static int SEOrderStatisticTreeCountLess(SESampleBuffer *buffer, int32_t value) {
+    // Counts the values less than the given value
+    int count = 0;
+    uint16_t tree = buffer->orderRoot;
+    while ( tree ) {
+        SEOrderStatisticNode * n = SEOrderStatisticTreeNode(buffer, tree);
+        if ( n->value < value ) {
+            count += SEOrderStatisticTreeSize(buffer, n->left) + 1;
+            tree = n->right;
+        } else {
+            tree = n->left;
+        }
+    }
+    return count;
+}
+
+static int64_t SEOrderStatisticTreeSumOfSmallest(SESampleBuffer *buffer, int count) {
+    // Sums the given number of smallest values
+    int64_t sum = 0;
+    uint16_t tree = buffer->orderRoot;
+    while ( tree && count > 0 ) {
+        SEOrderStatisticNode * n = SEOrderStatisticTreeNode(buffer, tree);
+        int leftSize = SEOrderStatisticTreeSize(buffer, n->left);
+        if ( count <= leftSize ) {
+            tree = n->left;
+        } else {
+            sum += SEOrderStatisticTreeSum(buffer, n->left) + n->value;
+            count -= leftSize + 1;
+            tree = n->right;
+        }
     }
+    return sum;
 }
 
 @end
@@ -0,0 +1,151 @@
+//
+//  SEMIDIClockReceiverHub.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import "SEMIDIClockReceiver.h"
+
+extern NSString * const SEMIDIClockReceiverHubDidChangeActiveReceiverNotification; ///< Notification sent on main thread when the hub hands over to another receiver
+extern NSString * const SEMIDIClockReceiverHubReceiverKey;                         ///< Notification userinfo key containing the newly active receiver
+
+/*!
+ * Multi-source receiver hub
+ *
+ *  This class runs several SEMIDIClockReceiver instances in parallel, one per
+ *  candidate clock source, and presents the timeline of the best of them. Use it
+ *  when you have redundant clock feeds and need to fail over from one to another
+ *  without losing sync.
+ *
+ *  Create a receiver for each source with addReceiverWithPriority:, and pass each
+ *  source's incoming MIDI messages to its receiver via SEMIDIClockReceiverReceivePacketList,
+ *  as usual. All receivers stay locked to their own source at all times, and are
+ *  serviced on the main thread by a single timer belonging to the hub.
+ *
+ *  The hub selects the active receiver from those that are currently receiving tempo
+ *  with an error (see SEMIDIClockReceiver's error property) no greater than maximumError,
+ *  preferring higher priority values, then lower error. If the active receiver's source
+ *  stops or degrades, the hub hands over to the best remaining receiver straight away,
+ *  as that receiver is already locked. A higher-priority receiver that recovers takes
+ *  over again once it has stayed healthy for a short time.
+ *
+ *  On handover, the hub measures the difference between the outgoing and incoming
+ *  timelines, and applies it to the incoming timeline so that the position reported
+ *  by SEMIDIClockReceiverHubGetTimelinePosition continues without a jump. This offset
+ *  is dropped when the incoming source's clock stops, so the next start or continue
+ *  from that source is followed exactly.
+ */
+@interface SEMIDIClockReceiverHub : NSObject
+
+/*!
+ * Default initialiser
+ */
+-(instancetype)init;
+
+/*!
+ * Add a receiver for a new candidate source
+ *
+ *  The returned receiver is serviced by the hub; pass it the messages from its source.
+ *
+ * @param priority Priority of the source; higher values are preferred
+ * @return The new receiver
+ */
+-(SEMIDIClockReceiver*)addReceiverWithPriority:(int)priority;
+
+/*!
+ * Remove a receiver
+ *
+ *  Stop passing messages to the receiver before removing it. If the receiver is
+ *  active, the hub hands over to the best remaining receiver.
+ *
+ * @param receiver The receiver to remove
+ */
+-(void)removeReceiver:(SEMIDIClockReceiver*)receiver;
+
+/*!
+ * Set the priority of a receiver
+ *
+ * @param priority Priority of the source; higher values are preferred
+ * @param receiver The receiver
+ */
+-(void)setPriority:(int)priority forReceiver:(SEMIDIClockReceiver*)receiver;
+
+/*!
+ * Get the active receiver
+ *
+ *  Use this C function from the realtime audio thread to get the receiver the
+ *  hub is currently following.
+ *
+ * @param hub The hub
+ * @return The active receiver, or nil if there are no receivers
+ */
+__unsafe_unretained SEMIDIClockReceiver * SEMIDIClockReceiverHubGetActiveReceiver(__unsafe_unretained SEMIDIClockReceiverHub * hub);
+
+/*!
+ * Determine if the active receiver is receiving tempo synchronisation messages
+ *
+ * @param hub The hub
+ * @return Whether the tempo is actively being synchronized
+ */
+BOOL SEMIDIClockReceiverHubIsReceivingTempo(__unsafe_unretained SEMIDIClockReceiverHub * hub);
+
+/*!
+ * Determine if the active source's clock is running
+ *
+ * @param hub The hub
+ * @return Whether the clock is running, and the timeline is advancing
+ */
+BOOL SEMIDIClockReceiverHubIsClockRunning(__unsafe_unretained SEMIDIClockReceiverHub * hub);
+
+/*!
+ * Get the current timeline position, in beats
+ *
+ *  Use this C function from the realtime audio thread to determine the timeline
+ *  position for the given global timestamp. This is the active receiver's timeline,
+ *  adjusted to remain continuous across handovers.
+ *
+ * @param hub The hub
+ * @param time The global timestamp to retrieve the corresponding timeline position for
+ * @return The position in the remote timeline for the provided global timestamp, in beats
+ */
+double SEMIDIClockReceiverHubGetTimelinePosition(__unsafe_unretained SEMIDIClockReceiverHub * hub, uint64_t time);
+
+/*!
+ * Get the current remote tempo
+ *
+ * @param hub The hub
+ * @return The active source's tempo, in beats per minute
+ */
+double SEMIDIClockReceiverHubGetTempo(__unsafe_unretained SEMIDIClockReceiverHub * hub);
+
+/*!
+ * The receivers, an array of SEMIDIClockReceiver
+ */
+@property (nonatomic, strong, readonly) NSArray * receivers;
+
+/*!
+ * The active receiver
+ *
+ *  This property provides key-value observing updates.
+ */
+@property (nonatomic, strong, readonly) SEMIDIClockReceiver * activeReceiver;
+
+/*!
+ * Maximum error, as a percentage, beyond which a source is considered degraded (default 5.0)
+ *
+ *  See SEMIDIClockReceiver's error property.
+ */
+@property (nonatomic) double maximumError;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,240 @@
+//
+//  SEMIDIClockReceiverHub.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEMIDIClockReceiverHub.h"
+#import "SECommon.h"
+#import <libkern/OSAtomic.h>
+
+NSString * const SEMIDIClockReceiverHubDidChangeActiveReceiverNotification = @"SEMIDIClockReceiverHubDidChangeActiveReceiverNotification";
+NSString * const SEMIDIClockReceiverHubReceiverKey = @"receiver";
+
+static const NSTimeInterval kPollInterval            = 0.05;   // How often to poll receivers and re-evaluate the active receiver, on the main thread
+static const NSTimeInterval kRecoveryHoldTime        = 2.0;    // How long a higher-priority source must be healthy before we hand back to it
+static const double kDefaultMaximumError             = 5.0;    // Default error (relative standard deviation, %) beyond which we consider a source degraded
+
+typedef struct {
+    __unsafe_unretained SEMIDIClockReceiver * receiver;
+    double positionOffset;
+} SEMIDIClockReceiverHubMaster;
+
+@interface SEMIDIClockReceiverHubEntry : NSObject
+@property (nonatomic, strong) SEMIDIClockReceiver * receiver;
+@property (nonatomic) int priority;
+@property (nonatomic) uint64_t healthySince;
+@end
+
+@interface SEMIDIClockReceiverHub () {
+    SEMIDIClockReceiverHubMaster _masters[2];
+    SEMIDIClockReceiverHubMaster * _master;
+}
+@property (nonatomic, strong) NSMutableArray * entries;
+@property (nonatomic, strong) NSMutableArray * retiredReceivers;
+@property (nonatomic, strong, readwrite) SEMIDIClockReceiver * activeReceiver;
+@property (nonatomic, strong) NSTimer * pollTimer;
+@end
+
+@implementation SEMIDIClockReceiverHub
+
+-(instancetype)init {
+    if ( !(self = [super init]) ) return nil;
+    
+    self.entries = [NSMutableArray array];
+    self.retiredReceivers = [NSMutableArray array];
+    _master = &_masters[0];
+    _maximumError = kDefaultMaximumError;
+    
+    self.pollTimer = [NSTimer scheduledTimerWithTimeInterval:kPollInterval
+                                                      target:[[SEWeakRetainingProxy alloc] initWithTarget:self]
+                                                    selector:@selector(poll)
+                                                    userInfo:nil
+                                                     repeats:YES];
+    
+    return self;
+}
+
+-(void)dealloc {
+    [_pollTimer invalidate];
+}
+
+-(SEMIDIClockReceiver *)addReceiverWithPriority:(int)priority {
+    SEMIDIClockReceiverHubEntry * entry = [SEMIDIClockReceiverHubEntry new];
+    entry.receiver = [[SEMIDIClockReceiver alloc] initWithoutEventPollTimer];
+    entry.priority = priority;
+    
+    [self willChangeValueForKey:@"receivers"];
+    [_entries addObject:entry];
+    [self didChangeValueForKey:@"receivers"];
+    
+    [self arbitrate];
+    
+    return entry.receiver;
+}
+
+-(void)removeReceiver:(SEMIDIClockReceiver *)receiver {
+    SEMIDIClockReceiverHubEntry * entry = [self entryForReceiver:receiver];
+    if ( !entry ) return;
+    
+    [self willChangeValueForKey:@"receivers"];
+    [_entries removeObject:entry];
+    [self didChangeValueForKey:@"receivers"];
+    
+    // Keep the receiver alive until the next poll, in case the realtime thread is still looking at it
+    [_retiredReceivers addObject:receiver];
+    
+    if ( receiver == _activeReceiver ) {
+        [self arbitrate];
+    }
+}
+
+-(void)setPriority:(int)priority forReceiver:(SEMIDIClockReceiver *)receiver {
+    [self entryForReceiver:receiver].priority = priority;
+    [self arbitrate];
+}
+
+-(NSArray *)receivers {
+    return [_entries valueForKey:@"receiver"];
+}
+
+__unsafe_unretained SEMIDIClockReceiver * SEMIDIClockReceiverHubGetActiveReceiver(__unsafe_unretained SEMIDIClockReceiverHub * hub) {
+    return hub->_master->receiver;
+}
+
+BOOL SEMIDIClockReceiverHubIsReceivingTempo(__unsafe_unretained SEMIDIClockReceiverHub * hub) {
+    __unsafe_unretained SEMIDIClockReceiver * receiver = hub->_master->receiver;
+    return receiver && SEMIDIClockReceiverIsReceivingTempo(receiver);
+}
+
+BOOL SEMIDIClockReceiverHubIsClockRunning(__unsafe_unretained SEMIDIClockReceiverHub * hub) {
+    __unsafe_unretained SEMIDIClockReceiver * receiver = hub->_master->receiver;
+    return receiver && SEMIDIClockReceiverIsClockRunning(receiver);
+}
+
+double SEMIDIClockReceiverHubGetTimelinePosition(__unsafe_unretained SEMIDIClockReceiverHub * hub, uint64_t time) {
+    SEMIDIClockReceiverHubMaster * master = hub->_master;
+    __unsafe_unretained SEMIDIClockReceiver * receiver = master->receiver;
+    double positionOffset = master->positionOffset;
+    
+    if ( !receiver ) {
+        return 0.0;
+    }
+    
+    if ( !time ) {
+        time = SECurrentTimeInHostTicks();
+    }
+    
+    double position = SEMIDIClockReceiverGetTimelinePosition(receiver, time);
+    return SEMIDIClockReceiverIsClockRunning(receiver) ? position + positionOffset : position;
+}
+
+double SEMIDIClockReceiverHubGetTempo(__unsafe_unretained SEMIDIClockReceiverHub * hub) {
+    __unsafe_unretained SEMIDIClockReceiver * receiver = hub->_master->receiver;
+    return receiver ? SEMIDIClockReceiverGetTempo(receiver) : 0.0;
+}
+
+-(void)poll {
+    [_retiredReceivers removeAllObjects];
+    
+    // Choose the active receiver first: a source that has just gone idle will be reset when
+    // its receiver is polled, and we want its timeline to hand over from
+    [self arbitrate];
+    
+    // Poll from a copy of the entries, as observers of the events posted may remove receivers
+    for ( SEMIDIClockReceiverHubEntry * entry in [_entries copy] ) {
+        [entry.receiver pollForEvents];
+    }
+}
+
+-(void)arbitrate {
+    uint64_t now = SECurrentTimeInHostTicks();
+    
+    // Find the best healthy receiver, by priority and then error
+    SEMIDIClockReceiverHubEntry * current = nil;
+    SEMIDIClockReceiverHubEntry * best = nil;
+    for ( SEMIDIClockReceiverHubEntry * entry in _entries ) {
+        if ( entry.receiver == _activeReceiver ) {
+            current = entry;
+        }
+        
+        BOOL healthy = SEMIDIClockReceiverIsReceivingTempo(entry.receiver) && entry.receiver.error <= _maximumError;
+        if ( !healthy ) {
+            entry.healthySince = 0;
+            continue;
+        }
+        
+        if ( !entry.healthySince ) {
+            entry.healthySince = now;
+        }
+        
+        if ( !best || entry.priority > best.priority || (entry.priority == best.priority && entry.receiver.error < best.receiver.error) ) {
+            best = entry;
+        }
+    }
+    
+    SEMIDIClockReceiverHubEntry * selected = current;
+    if ( !current ) {
+        // No active receiver: take the best one, or any at all so we have something to follow
+        selected = best ? best : _entries.firstObject;
+    } else if ( !current.healthySince ) {
+        // Active source stopped or degraded: hand over to the best healthy one, if there is one
+        if ( best ) {
+            selected = best;
+        }
+    } else if ( best && best.priority > current.priority
+                && (best.healthySince <= current.healthySince || now - best.healthySince >= SESecondsToHostTicks(kRecoveryHoldTime)) ) {
+        // A higher-priority source is available, and has been healthy for at least as long as the active one,
+        // or long enough to trust it again after recovering: hand over to it
+        selected = best;
+    }
+    
+    if ( selected.receiver != _activeReceiver ) {
+        [self handOverToReceiver:selected.receiver atTime:now];
+    } else if ( _master->positionOffset != 0.0 && !SEMIDIClockReceiverIsClockRunning(_master->receiver) ) {
+        // The active source's clock stopped: drop the continuity offset, so we follow its next start exactly
+        [self setMasterReceiver:_master->receiver positionOffset:0.0];
+    }
+}
+
+-(void)handOverToReceiver:(SEMIDIClockReceiver*)receiver atTime:(uint64_t)time {
+    double positionOffset = 0.0;
+    __unsafe_unretained SEMIDIClockReceiver * outgoing = _master->receiver;
+    if ( outgoing && receiver && SEMIDIClockReceiverIsClockRunning(outgoing) && SEMIDIClockReceiverIsClockRunning(receiver) ) {
+        // Carry the outgoing timeline position across, so the timeline doesn't jump
+        double outgoingPosition = SEMIDIClockReceiverGetTimelinePosition(outgoing, time) + _master->positionOffset;
+        positionOffset = outgoingPosition - SEMIDIClockReceiverGetTimelinePosition(receiver, time);
+    }
+    
+    [self setMasterReceiver:receiver positionOffset:positionOffset];
+    self.activeReceiver = receiver;
+    
+    [[NSNotificationCenter defaultCenter] postNotificationName:SEMIDIClockReceiverHubDidChangeActiveReceiverNotification
+                                                        object:self
+                                                      userInfo:receiver ? @{ SEMIDIClockReceiverHubReceiverKey: receiver } : @{}];
+}
+
+-(void)setMasterReceiver:(SEMIDIClockReceiver*)receiver positionOffset:(double)positionOffset {
+    // Fill in the slot not in use, then swap it in, so the realtime thread always sees a consistent pair
+    SEMIDIClockReceiverHubMaster * master = _master == &_masters[0] ? &_masters[1] : &_masters[0];
+    master->receiver = receiver;
+    master->positionOffset = positionOffset;
+    OSMemoryBarrier();
+    _master = master;
+}
+
+-(SEMIDIClockReceiverHubEntry*)entryForReceiver:(SEMIDIClockReceiver*)receiver {
+    for ( SEMIDIClockReceiverHubEntry * entry in _entries ) {
+        if ( entry.receiver == receiver ) {
+            return entry;
+        }
+    }
+    return nil;
+}
+
+@end
+
+@implementation SEMIDIClockReceiverHubEntry
+@end
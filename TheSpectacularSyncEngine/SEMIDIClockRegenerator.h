@@ -0,0 +1,71 @@
+//
+//  SEMIDIClockRegenerator.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import "SEMIDIClockReceiver.h"
+#import "SEMIDIClockSender.h"
+
+/*!
+ * MIDI Clock Regenerator
+ *
+ *  This class slaves a SEMIDIClockSender to a SEMIDIClockReceiver, so that a jittery
+ *  incoming clock is retransmitted as a clean one. Outgoing ticks are generated by the
+ *  sender from the receiver's tempo and timeline estimate, rather than forwarded as
+ *  they arrive.
+ *
+ *  Start, stop, continue and song position messages are forwarded with the timestamps
+ *  at which they took effect on the incoming clock, plus the configured latency. The
+ *  outgoing timeline trails the incoming one by exactly this latency.
+ *
+ *  Tempo changes are followed smoothly: the outgoing tempo tracks the receiver's, with a
+ *  small, bounded adjustment applied to pull the outgoing timeline back into phase with
+ *  the incoming one. Only a large discrepancy results in a song position message.
+ *
+ *  The regenerator takes control of the sender's sendClockTicksWhileTimelineStopped
+ *  property, sending ticks for as long as the receiver is receiving tempo. Don't drive
+ *  the sender yourself while it is attached.
+ */
+@interface SEMIDIClockRegenerator : NSObject
+
+/*!
+ * Initialise
+ *
+ * @param receiver The receiver for the incoming clock
+ * @param sender The sender for the regenerated clock
+ */
+-(instancetype)initWithReceiver:(SEMIDIClockReceiver*)receiver sender:(SEMIDIClockSender*)sender;
+
+/*!
+ * Added latency, in seconds (default 0.1)
+ *
+ *  The delay between an event on the incoming clock and the corresponding event on the
+ *  outgoing clock. Receiver events are delivered on the main thread, up to around 50ms
+ *  after they take place; with latencies shorter than this plus main thread delays,
+ *  transport messages may be sent late, although the outgoing timeline remains aligned.
+ */
+@property (nonatomic) NSTimeInterval latency;
+
+/*!
+ * The receiver
+ */
+@property (nonatomic, strong, readonly) SEMIDIClockReceiver * receiver;
+
+/*!
+ * The sender
+ */
+@property (nonatomic, strong, readonly) SEMIDIClockSender * sender;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,138 @@
+//
+//  SEMIDIClockRegenerator.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEMIDIClockRegenerator.h"
+#import "SECommon.h"
+
+static const NSTimeInterval kDefaultLatency          = 0.1;    // Default added latency
+static const NSTimeInterval kCorrectionInterval      = 0.1;    // How often to update the outgoing tempo, on the main thread
+static const NSTimeInterval kPhaseCorrectionTime     = 1.0;    // Time over which to pull out a phase error
+static const double kMaxTempoCorrection              = 0.005;  // Maximum tempo adjustment for phase correction, relative to the tempo
+static const double kRealignThreshold                = 0.25;   // Phase error, in beats, beyond which we realign with a song position message
+static const double kTempoChangeThreshold            = 1.0e-9; // Tempo changes smaller than this are ignored
+
+@interface SEMIDIClockRegenerator () {
+    uint64_t _correctionHoldTime;
+}
+@property (nonatomic, strong, readwrite) SEMIDIClockReceiver * receiver;
+@property (nonatomic, strong, readwrite) SEMIDIClockSender * sender;
+@property (nonatomic, strong) NSTimer * correctionTimer;
+@end
+
+@implementation SEMIDIClockRegenerator
+
+-(instancetype)initWithReceiver:(SEMIDIClockReceiver *)receiver sender:(SEMIDIClockSender *)sender {
+    if ( !(self = [super init]) ) return nil;
+    
+    self.receiver = receiver;
+    self.sender = sender;
+    _latency = kDefaultLatency;
+    
+    NSNotificationCenter * center = [NSNotificationCenter defaultCenter];
+    [center addObserver:self selector:@selector(update) name:SEMIDIClockReceiverDidStartTempoSyncNotification object:receiver];
+    [center addObserver:self selector:@selector(update) name:SEMIDIClockReceiverDidChangeTempoNotification object:receiver];
+    [center addObserver:self selector:@selector(receiverDidStopTempoSync:) name:SEMIDIClockReceiverDidStopTempoSyncNotification object:receiver];
+    [center addObserver:self selector:@selector(receiverDidStart:) name:SEMIDIClockReceiverDidStartNotification object:receiver];
+    [center addObserver:self selector:@selector(receiverDidStop:) name:SEMIDIClockReceiverDidStopNotification object:receiver];
+    [center addObserver:self selector:@selector(receiverDidLiveSeek:) name:SEMIDIClockReceiverDidLiveSeekNotification object:receiver];
+    
+    self.correctionTimer = [NSTimer scheduledTimerWithTimeInterval:kCorrectionInterval
+                                                            target:[[SEWeakRetainingProxy alloc] initWithTarget:self]
+                                                          selector:@selector(update)
+                                                          userInfo:nil
+                                                           repeats:YES];
+    
+    [self update];
+    
+    return self;
+}
+
+-(void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [_correctionTimer invalidate];
+}
+
+-(void)update {
+    if ( !SEMIDIClockReceiverIsReceivingTempo(_receiver) ) {
+        return;
+    }
+    
+    double tempo = SEMIDIClockReceiverGetTempo(_receiver);
+    if ( tempo == 0.0 ) {
+        return;
+    }
+    
+    uint64_t now = SECurrentTimeInHostTicks();
+    uint64_t latency = SESecondsToHostTicks(_latency);
+    double targetTempo = tempo;
+    
+    if ( SEMIDIClockReceiverIsClockRunning(_receiver) && SEMIDIClockSenderIsStarted(_sender) && now + latency >= _correctionHoldTime ) {
+        // Compare the outgoing timeline with the incoming one, delayed by our latency
+        double phaseError = SEMIDIClockReceiverGetTimelinePosition(_receiver, now) - SEMIDIClockSenderGetTimelinePosition(_sender, now + latency);
+        
+        if ( fabs(phaseError) > kRealignThreshold ) {
+            // Too far out to correct smoothly: realign
+            _correctionHoldTime = [_sender setActiveTimelinePosition:SEMIDIClockReceiverGetTimelinePosition(_receiver, now)
+                                                              atTime:now + latency];
+        } else {
+            // Adjust the tempo a little, to pull the error out over the correction time
+            double correction = (phaseError * 60.0) / kPhaseCorrectionTime;
+            double maxCorrection = tempo * kMaxTempoCorrection;
+            targetTempo = tempo + MAX(-maxCorrection, MIN(maxCorrection, correction));
+        }
+    }
+    
+    if ( fabs(_sender.tempo - targetTempo) > kTempoChangeThreshold ) {
+        _sender.tempo = targetTempo;
+    }
+    
+    if ( !_sender.sendClockTicksWhileTimelineStopped ) {
+        _sender.sendClockTicksWhileTimelineStopped = YES;
+    }
+}
+
+-(void)receiverDidStopTempoSync:(NSNotification*)notification {
+    if ( _sender.started ) {
+        [_sender stop];
+    }
+    _sender.sendClockTicksWhileTimelineStopped = NO;
+}
+
+-(void)receiverDidStart:(NSNotification*)notification {
+    [self update];
+    if ( _sender.tempo == 0.0 || _sender.started ) {
+        return;
+    }
+    
+    uint64_t timestamp = [notification.userInfo[SEMIDIClockReceiverTimestampKey] unsignedLongLongValue];
+    
+    // Cue the incoming position, so the sender sends a song position and continue if we're not at the start
+    _sender.timelinePosition = SEMIDIClockReceiverGetTimelinePosition(_receiver, timestamp);
+    _correctionHoldTime = [_sender startAtTime:timestamp + SESecondsToHostTicks(_latency)];
+}
+
+-(void)receiverDidStop:(NSNotification*)notification {
+    if ( !_sender.started ) {
+        return;
+    }
+    
+    uint64_t timestamp = [notification.userInfo[SEMIDIClockReceiverTimestampKey] unsignedLongLongValue];
+    [_sender stopAtTime:timestamp + SESecondsToHostTicks(_latency)];
+}
+
+-(void)receiverDidLiveSeek:(NSNotification*)notification {
+    if ( !_sender.started ) {
+        return;
+    }
+    
+    uint64_t timestamp = [notification.userInfo[SEMIDIClockReceiverTimestampKey] unsignedLongLongValue];
+    _correctionHoldTime = [_sender setActiveTimelinePosition:SEMIDIClockReceiverGetTimelinePosition(_receiver, timestamp)
+                                                      atTime:timestamp + SESecondsToHostTicks(_latency)];
+}
+
+@end
@@ -12,9 +12,31 @@ extern "C" {
 
 #import <Foundation/Foundation.h>
 #import <CoreMIDI/CoreMIDI.h>
+#import <CoreAudio/CoreAudioTypes.h>
 #import "SECommon.h"
 
 @protocol SEMIDIClockSenderInterface;
+@class SEClockStatePublisher;
+
+/*!
+ * Send callback
+ *
+ *  A plain C function that transmits a MIDI packet list, as an alternative to
+ *  the sendMIDIPacketList: method of SEMIDIClockSenderInterface.
+ *
+ * @param context The context pointer provided along with the callback
+ * @param packetList The MIDI packet list to send
+ */
+typedef void (*SEMIDIClockSenderSendCallback)(void * context, const MIDIPacketList * packetList);
+
+/*!
+ * Tempo change curves
+ */
+typedef enum {
+    SEMIDIClockSenderTempoStep,             //!< Change tempo instantly
+    SEMIDIClockSenderTempoRampLinear,       //!< Ramp tempo linearly over time
+    SEMIDIClockSenderTempoRampExponential,  //!< Ramp tempo by a constant ratio per unit time, which sounds even to the ear
+} SEMIDIClockSenderTempoCurve;
 
 /*!
  * MIDI Clock Sender
@@ -37,6 +59,13 @@ extern "C" {
  *  Note that, due to the general lack of acceptable support for Song Position and
  *  Continue messages in apps and some hardware, use of the timeline position facilities
  *  of this class may have no effect in receivers with a limited implementation.
+ *
+ *  Changes made from the main thread are made under a lock, which the sender thread
+ *  and SEMIDIClockSenderRender take with pthread_mutex_trylock, so that they never
+ *  block: while the main thread holds it, the sender thread tries again 0.1ms later,
+ *  and the render callback sends what it missed on the next cycle. That try-lock is
+ *  the only lock on the tick path; with an interface that provides a C send callback,
+ *  the tick path sends no Objective-C messages either.
  */
 @interface SEMIDIClockSender : NSObject
 
@@ -86,6 +115,20 @@ extern "C" {
  */
 -(void)stop;
 
+/*!
+ * Stop clock at a given time
+ *
+ *  As for stop, but the stop message is timestamped with the given time. If the time is
+ *  in the future, the sendClockTicksWhileTimelineStopped property is set to YES, and ticks are
+ *  being sent, the message is queued and sent along with the ticks around that time; otherwise
+ *  it is sent straight away.
+ *
+ *  Note that the timeline is considered stopped as soon as this method is called.
+ *
+ * @param applyTime The global timestamp at which the clock stops, in host ticks, or zero for now
+ */
+-(void)stopAtTime:(uint64_t)applyTime;
+
 /*!
  * Move in the timeline while clock is running
  *
@@ -127,6 +170,99 @@ extern "C" {
  */
 -(double)timelinePositionForTime:(uint64_t)timestamp;
 
+/*!
+ * Schedule a tempo change at a given time
+ *
+ *  The tempo will change, or begin ramping, at exactly the given time. Clock ticks
+ *  are placed by integrating the tempo curve, so ramps are followed smoothly, and
+ *  SEMIDIClockSenderGetTimelinePosition evaluates the same curve.
+ *
+ *  Changes may not overlap. Assigning the tempo property, or moving in the timeline,
+ *  ends any ramp in progress at the tempo it has reached; later changes still apply.
+ *  While the clock is stopped, ramps aren't followed: the tempo changes at the end of
+ *  each ramp.
+ *
+ * @param tempo The new tempo, in beats per minute
+ * @param applyTime The global timestamp at which to begin the change, in host ticks, or zero for now
+ * @param curve The shape of the change
+ * @param duration The duration of the ramp, in seconds; ignored for steps
+ * @return YES if the change was scheduled, or NO if it overlaps another, or too many are scheduled
+ */
+-(BOOL)scheduleTempo:(double)tempo atTime:(uint64_t)applyTime curve:(SEMIDIClockSenderTempoCurve)curve duration:(NSTimeInterval)duration;
+
+/*!
+ * Schedule a tempo change at a given timeline position
+ *
+ *  As for scheduleTempo:atTime:curve:duration:, but the change begins when the timeline
+ *  reaches the given position, and ramps last for the given number of beats. The time
+ *  is determined again whenever the timeline moves, or the tempo changes.
+ *
+ *  Changes scheduled by position only take place while the clock is running.
+ *
+ * @param tempo The new tempo, in beats per minute
+ * @param position The timeline position at which to begin the change, in beats
+ * @param curve The shape of the change
+ * @param beats The duration of the ramp, in beats; ignored for steps
+ * @return YES if the change was scheduled, or NO if it overlaps another, or too many are scheduled
+ */
+-(BOOL)scheduleTempo:(double)tempo atTimelinePosition:(double)position curve:(SEMIDIClockSenderTempoCurve)curve durationInBeats:(double)beats;
+
+/*!
+ * Cancel scheduled tempo changes
+ *
+ *  Any ramp in progress ends at the tempo it has reached.
+ */
+-(void)cancelScheduledTempoChanges;
+
+/*!
+ * Schedule a MIDI event at a timeline position
+ *
+ *  Use this C function to have the sender send an event, such as a note, at a
+ *  position in the timeline. Events are kept in a queue owned by the sender, and
+ *  sent alongside the clock ticks, through the same interface. Each event is placed
+ *  on the timeline just before it is sent, with the same calculations as the ticks,
+ *  so events stay locked to the clock across tempo changes and ramps: an event on a
+ *  beat is sent with the same timestamp as the tick for that beat.
+ *
+ *  When the timeline moves, events before the new position are cancelled, and the
+ *  rest are placed on the new timeline. Events are only sent while the clock is started.
+ *
+ *  This function doesn't lock or allocate, so it's safe to use from the realtime
+ *  audio thread. Should only be called from one thread at a time.
+ *
+ *  New events pass through a queue of 256 entries, which the sender empties as it
+ *  sends ticks. While the clock is stopped, nothing empties it, so at most 256 events
+ *  can be scheduled with this function until the clock starts; use the
+ *  scheduleEvent:length:atTimelinePosition: method from the main thread to schedule
+ *  more in advance.
+ *
+ * @param sender The sender
+ * @param position The timeline position at which to send the event, in beats
+ * @param data The MIDI message bytes
+ * @param length The number of bytes, up to 16
+ * @return YES if the event was scheduled, or NO if it's too long or the queue is full
+ */
+BOOL SEMIDIClockSenderScheduleEvent(__unsafe_unretained SEMIDIClockSender * sender, double position, const uint8_t * data, int length);
+
+/*!
+ * Schedule a MIDI event at a timeline position
+ *
+ *  An Objective-C convenience method, equivalent to SEMIDIClockSenderScheduleEvent,
+ *  except that while the clock is stopped it first moves queued events into the
+ *  sender's schedule, which holds up to 512 events. Not for use on the realtime thread.
+ *
+ * @param data The MIDI message bytes
+ * @param length The number of bytes, up to 16
+ * @param position The timeline position at which to send the event, in beats
+ * @return YES if the event was scheduled, or NO if it's too long or the queue is full
+ */
+-(BOOL)scheduleEvent:(const uint8_t *)data length:(int)length atTimelinePosition:(double)position;
+
+/*!
+ * Cancel all scheduled events that haven't yet been sent
+ */
+-(void)cancelScheduledEvents;
+
 /*!
  * Get the current timeline position, in beats
  *
@@ -144,6 +280,41 @@ extern "C" {
  */
 double SEMIDIClockSenderGetTimelinePosition(__unsafe_unretained SEMIDIClockSender * sender, uint64_t time);
 
+/*!
+ * Get the timeline positions for an array of times
+ *
+ *  Use this C function from the realtime audio thread to convert many timestamps at
+ *  once, such as all the events in a render cycle. All times are converted against one
+ *  snapshot of the timeline, including any scheduled tempo changes they span. Times
+ *  within constant-tempo stretches are converted with vector arithmetic, which is much
+ *  faster than calling SEMIDIClockSenderGetTimelinePosition for each.
+ *
+ *  Times needn't be in order, but runs of ascending times are converted fastest.
+ *
+ * @param sender The sender
+ * @param times The global timestamps to convert, in host ticks
+ * @param positions On output, the timeline position for each timestamp, in beats
+ * @param count The number of timestamps
+ */
+void SEMIDIClockSenderGetTimelinePositions(__unsafe_unretained SEMIDIClockSender * sender,
+                                           const uint64_t * times, double * positions, int count);
+
+/*!
+ * Get the times for an array of timeline positions
+ *
+ *  The inverse of SEMIDIClockSenderGetTimelinePositions, for scheduling events at
+ *  timeline positions. Positions before the start of the timeline give the time it
+ *  started. If the clock isn't started, or a position can't be reached because the
+ *  tempo drops to zero before it, the time is zero.
+ *
+ * @param sender The sender
+ * @param positions The timeline positions to convert, in beats
+ * @param times On output, the global timestamp for each position, in host ticks
+ * @param count The number of positions
+ */
+void SEMIDIClockSenderGetTimesForTimelinePositions(__unsafe_unretained SEMIDIClockSender * sender,
+                                                   const double * positions, uint64_t * times, int count);
+
 /*!
  * Determine whether clock is started
  *
@@ -152,6 +323,48 @@ double SEMIDIClockSenderGetTimelinePosition(__unsafe_unretained SEMIDIClockSende
  */
 BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * sender);
 
+/*!
+ * Get the current tempo
+ *
+ *  Use this C function from the realtime audio thread to determine the tempo, including
+ *  the progress of any scheduled tempo ramp.
+ *
+ * @param sender The sender
+ * @return The tempo, in beats per minute
+ */
+double SEMIDIClockSenderGetTempo(__unsafe_unretained SEMIDIClockSender * sender);
+
+/*!
+ * Get the tempo at a given time
+ *
+ *  Use this C function from the realtime audio thread to determine the tempo at the
+ *  given global timestamp, according to the scheduled tempo changes.
+ *
+ * @param sender The sender
+ * @param time The global timestamp, in host ticks
+ * @return The tempo, in beats per minute
+ */
+double SEMIDIClockSenderGetTempoAtTime(__unsafe_unretained SEMIDIClockSender * sender, uint64_t time);
+
+/*!
+ * Send messages for a render cycle
+ *
+ *  If you have set the renderCallbackDriven property to YES, call this C function from
+ *  your realtime audio thread's render callback, once per render cycle. It sends all
+ *  clock ticks and transport messages due between the time of the buffer and its end,
+ *  plus the look-ahead time, timestamped precisely, so that the outgoing clock stays
+ *  aligned with your audio.
+ *
+ *  This function won't block: if the main thread is making changes to the sender at
+ *  the time, it will do nothing, and send the messages it missed on the next cycle.
+ *
+ * @param sender The sender
+ * @param timestamp The buffer's timestamp, as passed to your render callback. If its
+ *      host time is invalid, the current time is used
+ * @param frames The number of frames in the buffer
+ */
+void SEMIDIClockSenderRender(__unsafe_unretained SEMIDIClockSender * sender, const AudioTimeStamp * timestamp, UInt32 frames);
+
 /*!
  * The current position in the timeline (in beats)
  *
@@ -180,7 +393,9 @@ BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * sender);
  * The current tempo (beats per minute)
  *
  *  Use this property to assign a tempo - be sure to assign a tempo prior to starting the
- *  clock.
+ *  clock. Scheduled tempo changes are folded into this property by the sender's thread
+ *  as it passes them, without key-value observing notifications. To follow the tempo
+ *  as it changes, including during ramps, use SEMIDIClockSenderGetTempo.
  */
 @property (nonatomic) double tempo;
 
@@ -207,6 +422,50 @@ BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * sender);
  */
 @property (nonatomic) BOOL sendClockTicksWhileTimelineStopped;
 
+/*!
+ * Whether messages are sent from your render callback (default: NO)
+ *
+ *  By default, this class sends messages from its own thread, which is scheduled
+ *  independently of your audio. Set this property to YES to send messages from
+ *  your render callback instead, via SEMIDIClockSenderRender, so that the clock
+ *  follows the audio clock exactly. No thread is used in this mode.
+ *
+ *  Messages are only sent while you call SEMIDIClockSenderRender, so make sure
+ *  your audio is running whenever the clock is.
+ */
+@property (nonatomic) BOOL renderCallbackDriven;
+
+/*!
+ * Look-ahead time, in seconds (default: 0)
+ *
+ *  In render-callback-driven mode, messages due up to this long after the end
+ *  of the current buffer are sent during that buffer's render cycle. Use this to
+ *  allow for interfaces that need messages in advance.
+ */
+@property (nonatomic) NSTimeInterval lookAheadTime;
+
+/*!
+ * Sample rate of your audio, in render-callback-driven mode (default: 44100)
+ *
+ *  Used to determine the duration of each buffer passed to SEMIDIClockSenderRender.
+ */
+@property (nonatomic) double sampleRate;
+
+/*!
+ * Clock state publisher
+ *
+ *  Assign a SEClockStatePublisher to publish this sender's tempo, time base and
+ *  transport state to other processes, updated whenever they change.
+ *
+ *  The published state describes a constant tempo, so while a scheduled tempo change
+ *  is under way, the tempo and timeline position reached are republished each time
+ *  the sender sends a batch of ticks, until the change completes.
+ *
+ *  The sender is the only writer to the publisher while it's assigned, and publishes
+ *  with SEClockStatePublisherPublishExclusive, so publishing never waits.
+ */
+@property (nonatomic, strong) SEClockStatePublisher * statePublisher;
+
 /*!
  * The interface, passed during initialisation
  */
@@ -236,6 +495,25 @@ BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * sender);
  */
 -(void)sendMIDIPacketList:(const MIDIPacketList *)packetList;
 
+@optional
+
+/*!
+ * Provide a C send callback
+ *
+ *  Implement this method to give SEMIDIClockSender a plain C function to send with,
+ *  in place of sendMIDIPacketList:. This keeps Objective-C messaging off the sender
+ *  thread and render callback, which send clock ticks in realtime.
+ *
+ *  The callback is subject to the same rules as sendMIDIPacketList:, and should avoid
+ *  Objective-C messaging, locks and memory allocation. The sender asks for it once,
+ *  when initialised, and holds on to the interface, so a context pointer to the
+ *  interface itself remains valid.
+ *
+ * @param context On output, the context pointer to pass to the callback
+ * @return The callback
+ */
+-(SEMIDIClockSenderSendCallback)sendCallbackWithContext:(void **)context;
+
 @end
 
 #ifdef __cplusplus
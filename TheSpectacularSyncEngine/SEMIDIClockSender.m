@@ -8,37 +8,323 @@
 
 #import "SEMIDIClockSender.h"
 #import "SECommon.h"
+#import "SEClockStatePublisher.h"
+#import <pthread.h>
 
 static const int kTicksPerSendInterval                      = 4;      // Max MIDI ticks to send per interval
 static const NSTimeInterval kFirstBeatSyncThreshold         = 1.0e-3; // Wait to send first beat if it's further away than this
-static const NSTimeInterval kTickResyncThreshold            = 1.0e-6; // If tick is beyond this threshold out of sync, resync
 static const double kThreadPriority                         = 0.8;    // Priority of the sender thread
 static const int kMaxPendingMessages                        = 10;     // Size of pending message buffer
+static const double kDefaultSampleRate                      = 44100.0; // Default sample rate, for render-callback-driven mode
+static const NSTimeInterval kMaxRenderCatchUpTime           = 0.5;    // In render-callback-driven mode, skip missed ticks rather than sending them late, beyond this
+static const int kMaxTempoEvents                            = 16;     // Size of the tempo schedule
+static const double kTickPositionTolerance                   = 1.0e-3; // Fraction of a tick by which a tick time may be early, through rounding
+static const uint64_t kUnresolvedTime                       = UINT64_MAX; // Start time of position-scheduled changes while the clock is stopped
+static const uint32_t kEventIntakeSize                      = 256;    // Size of the queue of newly scheduled events; must be a power of two
+static const int kMaxScheduledEvents                        = 512;    // Size of the event schedule
+static const int kMaxScheduledEventLength                   = 16;     // Max length of a scheduled event, in bytes
+static const NSTimeInterval kLockRetryInterval              = 1.0e-4; // How long the sender thread waits before trying again, when the main thread holds the lock
+
+// Host tick equivalents, worked out once in +initialize so the render path doesn't convert
+static double __hostTicksPerSecond;
+static uint64_t __maxRenderCatchUpTime;
+
+typedef struct {
+    SEMIDIClockSenderTempoCurve curve;
+    double tempo;               // Tempo at the end of the change
+    uint64_t startTime;         // In host ticks
+    uint64_t duration;          // In host ticks; zero for steps
+    BOOL scheduledByPosition;   // Whether the start time is resolved from the position, below
+    double position;            // Timeline position of the start, in beats, if scheduled by position
+    double durationInBeats;     // Duration in beats, if scheduled by position
+} SEMIDIClockSenderTempoEvent;
+
+typedef struct {
+    uint64_t timeBase;
+    SETempoConversion conversion;
+    double beatsPerHostTickPerBPM;
+    int eventCount;
+    const SEMIDIClockSenderTempoEvent * events;
+} SEMIDIClockSenderTempoSchedule;
+
+typedef struct {
+    double position;            // Timeline position, in beats
+    uint8_t length;
+    uint8_t data[kMaxScheduledEventLength];
+} SEMIDIClockSenderScheduledEvent;
 
 @interface SEMIDIClockSenderThread : NSThread
-@property (nonatomic, weak) SEMIDIClockSender * sender;
+-(instancetype)initWithSender:(SEMIDIClockSender*)sender;
 @end
 
 @interface SEMIDIClockSender () {
     double   _positionAtStart;
     MIDIPacketList _pendingMessages[kMaxPendingMessages];
+    SETempoConversion _tempoConversion;
+    pthread_mutex_t _mutex;
+    uint32_t _generation;
+    SEMIDIClockSenderTempoEvent _tempoEvents[kMaxTempoEvents];
+    int _tempoEventCount;
+    double _beatsPerHostTickPerBPM;
+    uint32_t _timelineSequence;
+    int _timelineUpdateDepth;
+    SEMIDIClockSenderScheduledEvent _eventIntake[kEventIntakeSize];
+    uint32_t _eventIntakeHead;
+    uint32_t _eventIntakeTail;
+    SEMIDIClockSenderScheduledEvent _scheduledEvents[kMaxScheduledEvents];
+    int _scheduledEventCount;
+    uint64_t _nextTickTime;
+    uint64_t _timeBase;
+    uint64_t _tickDuration;
+    SEMIDIClockSenderSendCallback _sendCallback;
+    void * _sendCallbackContext;
+    int32_t _threadCount;
 }
 @property (nonatomic, strong, readwrite) id<SEMIDIClockSenderInterface> senderInterface;
 @property (nonatomic, strong) SEMIDIClockSenderThread *thread;
 @property (nonatomic, readwrite) BOOL started;
-@property (nonatomic) uint64_t nextTickTime;
-@property (nonatomic) uint64_t timeBase;
-@property (nonatomic) MIDIPacketList * pendingMessages;
 @end
 
+static void SEMIDIClockSenderLock(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderUnlock(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderSend(__unsafe_unretained SEMIDIClockSender * THIS, const MIDIPacketList * packetList);
+static uint64_t SEMIDIClockSenderThreadSendTicks(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderThreadFinished(__unsafe_unretained SEMIDIClockSender * THIS);
+static uint64_t SEMIDIClockSenderSendTicks(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t start, uint64_t end);
+static void SEMIDIClockSenderPublishState(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderBeginTimelineUpdate(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderEndTimelineUpdate(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderSetBaseTempo(__unsafe_unretained SEMIDIClockSender * THIS, double tempo);
+static void SEMIDIClockSenderApplyTempoEvents(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t time, BOOL endRampInProgress);
+static void SEMIDIClockSenderResolveTempoEvents(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderTakeScheduledEvents(__unsafe_unretained SEMIDIClockSender * THIS);
+static void SEMIDIClockSenderDropScheduledEventsBefore(__unsafe_unretained SEMIDIClockSender * THIS, double position);
+
+#pragma mark - Tempo curve
+
+// The tempo curve is a constant tempo from the time base, followed by the scheduled changes in
+// order. Ramps are integrated exactly: a linear ramp from T0 to T1 over D gives
+// T0.t + (T1-T0).t^2/2D beats after t, and an exponential ramp T0.D.(r^(t/D) - 1)/ln(r), where
+// r = T1/T0 (with tempo scaled to beats per host tick). Both invert in closed form.
+
+static double SEMIDIClockSenderRampTempo(const SEMIDIClockSenderTempoEvent * event, double startTempo, double elapsed) {
+    double fraction = elapsed / (double)event->duration;
+    if ( event->curve == SEMIDIClockSenderTempoRampExponential && startTempo > 0.0 && event->tempo > 0.0 ) {
+        return startTempo * pow(event->tempo / startTempo, fraction);
+    }
+    return startTempo + (event->tempo - startTempo) * fraction;
+}
+
+static double SEMIDIClockSenderRampBeats(const SEMIDIClockSenderTempoEvent * event, double startTempo, double scale, double elapsed) {
+    double duration = (double)event->duration;
+    if ( event->curve == SEMIDIClockSenderTempoRampExponential && startTempo > 0.0 && event->tempo > 0.0 && event->tempo != startTempo ) {
+        double logRatio = log(event->tempo / startTempo);
+        return scale * startTempo * duration * expm1(logRatio * elapsed / duration) / logRatio;
+    }
+    return scale * elapsed * (startTempo + (event->tempo - startTempo) * elapsed / (2.0 * duration));
+}
+
+static double SEMIDIClockSenderRampTime(const SEMIDIClockSenderTempoEvent * event, double startTempo, double scale, double beats) {
+    double duration = (double)event->duration;
+    if ( event->curve == SEMIDIClockSenderTempoRampExponential && startTempo > 0.0 && event->tempo > 0.0 && event->tempo != startTempo ) {
+        double logRatio = log(event->tempo / startTempo);
+        return duration * log1p(beats * logRatio / (scale * startTempo * duration)) / logRatio;
+    }
+    // Positive root of the quadratic, in a form that's stable when the ramp is shallow
+    double a = scale * (event->tempo - startTempo) / (2.0 * duration);
+    double b = scale * startTempo;
+    return 2.0 * beats / (b + sqrt(MAX(0.0, b*b + 4.0*a*beats)));
+}
+
+static uint64_t SEMIDIClockSenderRampDurationForBeats(SEMIDIClockSenderTempoCurve curve, double startTempo, double endTempo, double scale, double beats) {
+    if ( curve == SEMIDIClockSenderTempoRampExponential && startTempo > 0.0 && endTempo > 0.0 && endTempo != startTempo ) {
+        double ratio = endTempo / startTempo;
+        return beats * log(ratio) / (scale * startTempo * (ratio - 1.0));
+    }
+    return startTempo + endTempo > 0.0 ? 2.0 * beats / (scale * (startTempo + endTempo)) : 0;
+}
+
+static double SEMIDIClockSenderTempoScheduleTempoAtTime(const SEMIDIClockSenderTempoSchedule * schedule, uint64_t time) {
+    double tempo = schedule->conversion.tempo;
+    for ( int i=0; i<schedule->eventCount; i++ ) {
+        const SEMIDIClockSenderTempoEvent * event = &schedule->events[i];
+        if ( event->startTime >= time ) break;
+        if ( event->duration == 0 || time >= event->startTime + event->duration ) {
+            tempo = event->tempo;
+        } else {
+            return SEMIDIClockSenderRampTempo(event, tempo, time - event->startTime);
+        }
+    }
+    return tempo;
+}
+
+// The curve is walked as a series of pieces, each either a constant tempo or a ramp. Constant
+// pieces convert with vector arithmetic for bulk conversion; ramps are evaluated one value at a time.
+
+typedef struct {
+    uint64_t startTime;     // In host ticks
+    double startPosition;   // In beats
+    uint64_t endTime;       // In host ticks; UINT64_MAX for the last piece
+    double endPosition;     // In beats; INFINITY for the last piece
+    double tempo;           // Tempo throughout, or at the start of a ramp
+    const SEMIDIClockSenderTempoEvent * ramp; // The ramp, or NULL for a constant tempo
+} SEMIDIClockSenderTempoPiece;
+
+typedef struct {
+    const SEMIDIClockSenderTempoSchedule * schedule;
+    int eventIndex;
+    uint64_t time;          // Start of the next piece
+    double position;
+    double tempo;
+    BOOL finished;
+} SEMIDIClockSenderTempoPieceIterator;
+
+static SEMIDIClockSenderTempoPieceIterator SEMIDIClockSenderTempoPieceIteratorMake(const SEMIDIClockSenderTempoSchedule * schedule) {
+    return (SEMIDIClockSenderTempoPieceIterator) {
+        .schedule = schedule,
+        .time = schedule->timeBase,
+        .tempo = schedule->conversion.tempo
+    };
+}
+
+static BOOL SEMIDIClockSenderTempoPieceIteratorNext(SEMIDIClockSenderTempoPieceIterator * iterator, SEMIDIClockSenderTempoPiece * piece) {
+    if ( iterator->finished ) {
+        return NO;
+    }
+    
+    double scale = iterator->schedule->beatsPerHostTickPerBPM;
+    while ( iterator->eventIndex < iterator->schedule->eventCount ) {
+        const SEMIDIClockSenderTempoEvent * event = &iterator->schedule->events[iterator->eventIndex];
+        if ( event->startTime == kUnresolvedTime ) break;
+        uint64_t start = MAX(event->startTime, iterator->time);
+        if ( start > iterator->time ) {
+            // Constant tempo up to the change
+            *piece = (SEMIDIClockSenderTempoPiece) {
+                .startTime = iterator->time,
+                .startPosition = iterator->position,
+                .endTime = start,
+                .endPosition = iterator->position + (start - iterator->time) * scale * iterator->tempo,
+                .tempo = iterator->tempo };
+        } else if ( event->duration == 0 ) {
+            iterator->tempo = event->tempo;
+            iterator->eventIndex++;
+            continue;
+        } else {
+            *piece = (SEMIDIClockSenderTempoPiece) {
+                .startTime = start,
+                .startPosition = iterator->position,
+                .endTime = start + event->duration,
+                .endPosition = iterator->position + SEMIDIClockSenderRampBeats(event, iterator->tempo, scale, event->duration),
+                .tempo = iterator->tempo,
+                .ramp = event };
+            iterator->tempo = event->tempo;
+            iterator->eventIndex++;
+        }
+        iterator->time = piece->endTime;
+        iterator->position = piece->endPosition;
+        return YES;
+    }
+    
+    // Constant tempo from the last change onwards
+    *piece = (SEMIDIClockSenderTempoPiece) {
+        .startTime = iterator->time,
+        .startPosition = iterator->position,
+        .endTime = UINT64_MAX,
+        .endPosition = INFINITY,
+        .tempo = iterator->tempo };
+    iterator->finished = YES;
+    return YES;
+}
+
+static double SEMIDIClockSenderTempoSchedulePositionAtTime(const SEMIDIClockSenderTempoSchedule * schedule, uint64_t time) {
+    if ( time < schedule->timeBase ) {
+        return 0.0;
+    }
+    
+    if ( schedule->eventCount == 0 || schedule->events[0].startTime >= time ) {
+        return SETempoConversionHostTicksToBeats(&schedule->conversion, time - schedule->timeBase);
+    }
+    
+    // Find the piece containing the time
+    SEMIDIClockSenderTempoPiece piece;
+    SEMIDIClockSenderTempoPieceIterator iterator = SEMIDIClockSenderTempoPieceIteratorMake(schedule);
+    while ( SEMIDIClockSenderTempoPieceIteratorNext(&iterator, &piece) && time >= piece.endTime );
+    
+    double scale = schedule->beatsPerHostTickPerBPM;
+    if ( piece.ramp ) {
+        return piece.startPosition + SEMIDIClockSenderRampBeats(piece.ramp, piece.tempo, scale, time - piece.startTime);
+    }
+    return piece.startPosition + (time - piece.startTime) * scale * piece.tempo;
+}
+
+static uint64_t SEMIDIClockSenderTempoScheduleTimeAtPosition(const SEMIDIClockSenderTempoSchedule * schedule, double position) {
+    if ( position <= 0.0 ) {
+        return schedule->timeBase;
+    }
+    
+    // Find the piece containing the position
+    SEMIDIClockSenderTempoPiece piece;
+    SEMIDIClockSenderTempoPieceIterator iterator = SEMIDIClockSenderTempoPieceIteratorMake(schedule);
+    while ( SEMIDIClockSenderTempoPieceIteratorNext(&iterator, &piece) && position > piece.endPosition );
+    
+    double scale = schedule->beatsPerHostTickPerBPM;
+    if ( piece.ramp ) {
+        return piece.startTime + (uint64_t)llround(SEMIDIClockSenderRampTime(piece.ramp, piece.tempo, scale, position - piece.startPosition));
+    }
+    if ( piece.tempo <= 0.0 ) {
+        return kUnresolvedTime;
+    }
+    return piece.startTime + (uint64_t)llround((position - piece.startPosition) / (scale * piece.tempo));
+}
+
+static int SEMIDIClockSenderTempoScheduleGetPieces(const SEMIDIClockSenderTempoSchedule * schedule, SEMIDIClockSenderTempoPiece * pieces) {
+    int count = 0;
+    SEMIDIClockSenderTempoPieceIterator iterator = SEMIDIClockSenderTempoPieceIteratorMake(schedule);
+    while ( SEMIDIClockSenderTempoPieceIteratorNext(&iterator, &pieces[count]) ) {
+        count++;
+    }
+    return count;
+}
+
+static void SEMIDIClockSenderTempoPieceConversion(const SEMIDIClockSenderTempoSchedule * schedule,
+                                                  const SEMIDIClockSenderTempoPiece * piece,
+                                                  SETempoConversion * conversion) {
+    if ( piece->tempo == schedule->conversion.tempo ) {
+        *conversion = schedule->conversion;
+    } else {
+        SETempoConversionSetTempo(conversion, piece->tempo);
+    }
+}
+
 @implementation SEMIDIClockSender
 @dynamic timelinePosition;
-@dynamic pendingMessages;
+
++(void)initialize {
+    __hostTicksPerSecond = (double)SESecondsToHostTicks(1.0);
+    __maxRenderCatchUpTime = SESecondsToHostTicks(kMaxRenderCatchUpTime);
+}
 
 -(instancetype)initWithInterface:(id<SEMIDIClockSenderInterface>)senderInterface {
     if ( !(self = [super init]) ) return nil;
     
     self.senderInterface = senderInterface;
+    _sampleRate = kDefaultSampleRate;
+    
+    if ( [senderInterface respondsToSelector:@selector(sendCallbackWithContext:)] ) {
+        // Use the interface's C send callback, to keep Objective-C messaging off the tick path
+        _sendCallback = [senderInterface sendCallbackWithContext:&_sendCallbackContext];
+    }
+    
+    // Recursive, as this lock stands in for @synchronized, but can also be tried without blocking from the render thread
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&_mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    
+    SETempoConversion conversion;
+    SETempoConversionSetTempo(&conversion, 1.0);
+    _beatsPerHostTickPerBPM = conversion.beatsPerHostTick;
     
     return self;
 }
@@ -46,12 +332,12 @@ static const int kMaxPendingMessages                        = 10;     // Size of
 -(void)dealloc {
     [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(sendSongPositionDelayed) object:nil];
     [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(startThread) object:nil];
-    if ( _thread ) {
-        [_thread cancel];
-        while ( !_thread.isFinished ) {
-            [NSThread sleepForTimeInterval:0.01];
-        }
+    [_thread cancel];
+    while ( __atomic_load_n(&_threadCount, __ATOMIC_ACQUIRE) > 0 ) {
+        // Wait for sender threads, including any already cancelled, to let go of us
+        [NSThread sleepForTimeInterval:0.01];
     }
+    pthread_mutex_destroy(&_mutex);
 }
 
 -(uint64_t)startAtTime:(uint64_t)startTime {
@@ -60,17 +346,36 @@ static const int kMaxPendingMessages                        = 10;     // Size of
 }
 
 -(void)stop {
-    @synchronized ( self ) {
-        // Send stop message
-        MIDIPacketList packetList;
-        MIDIPacket *packet = MIDIPacketListInit(&packetList);
-        unsigned char message[1] = { SEMIDIMessageClockStop };
-        MIDIPacketListAdd(&packetList, sizeof(packetList), packet, SECurrentTimeInHostTicks(), sizeof(message), message);
-        [_senderInterface sendMIDIPacketList:&packetList];
-        
+    [self stopAtTime:0];
+}
+
+-(void)stopAtTime:(uint64_t)applyTime {
+    if ( applyTime > SECurrentTimeInHostTicks() && (_thread || _renderCallbackDriven) && _sendClockTicksWhileTimelineStopped ) {
+        SEMIDIClockSenderLock(self);
+        // Leave the stop message to the sender thread or render callback, to go out at the requested time
+        [self enqueueMessage:(unsigned char[1]){ SEMIDIMessageClockStop } length:1 time:applyTime];
         self.started = NO;
+        SEMIDIClockSenderResolveTempoEvents(self);
+        _generation++;
+        SEMIDIClockSenderPublishState(self);
+        SEMIDIClockSenderUnlock(self);
+        return;
     }
     
+    SEMIDIClockSenderLock(self);
+    // Send stop message
+    MIDIPacketList packetList;
+    MIDIPacket *packet = MIDIPacketListInit(&packetList);
+    unsigned char message[1] = { SEMIDIMessageClockStop };
+    MIDIPacketListAdd(&packetList, sizeof(packetList), packet, SECurrentTimeInHostTicks(), sizeof(message), message);
+    SEMIDIClockSenderSend(self, &packetList);
+    
+    self.started = NO;
+    SEMIDIClockSenderResolveTempoEvents(self);
+    _generation++;
+    SEMIDIClockSenderPublishState(self);
+    SEMIDIClockSenderUnlock(self);
+    
     if ( !_sendClockTicksWhileTimelineStopped && _thread ) {
         // Stop the thread
         [_thread cancel];
@@ -86,27 +391,161 @@ static const int kMaxPendingMessages                        = 10;     // Size of
     return SEMIDIClockSenderGetTimelinePosition(self, timestamp);
 }
 
+static SEMIDIClockSenderTempoSchedule SEMIDIClockSenderGetTempoSchedule(__unsafe_unretained SEMIDIClockSender * THIS) {
+    // Called with the lock held
+    return (SEMIDIClockSenderTempoSchedule) {
+        .timeBase = THIS->_timeBase,
+        .conversion = THIS->_tempoConversion,
+        .beatsPerHostTickPerBPM = THIS->_beatsPerHostTickPerBPM,
+        .eventCount = THIS->_tempoEventCount,
+        .events = THIS->_tempoEvents
+    };
+}
+
+static void SEMIDIClockSenderReadTimeline(__unsafe_unretained SEMIDIClockSender * THIS,
+                                          BOOL * started,
+                                          double * positionAtStart,
+                                          SEMIDIClockSenderTempoSchedule * schedule,
+                                          SEMIDIClockSenderTempoEvent * events) {
+    // Read a consistent snapshot without the lock, for the realtime thread, retrying if it overlaps an update
+    while ( 1 ) {
+        uint32_t sequence = __atomic_load_n(&THIS->_timelineSequence, __ATOMIC_ACQUIRE);
+        if ( sequence & 1 ) {
+            continue;
+        }
+        *started = THIS->_started;
+        *positionAtStart = THIS->_positionAtStart;
+        *schedule = SEMIDIClockSenderGetTempoSchedule(THIS);
+        memcpy(events, THIS->_tempoEvents, MIN(MAX(schedule->eventCount, 0), kMaxTempoEvents) * sizeof(SEMIDIClockSenderTempoEvent));
+        schedule->events = events;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&THIS->_timelineSequence, __ATOMIC_RELAXED) == sequence ) {
+            return;
+        }
+    }
+}
+
 double SEMIDIClockSenderGetTimelinePosition(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t time) {
-    if ( !THIS->_started ) {
-        return THIS->_positionAtStart;
+    BOOL started;
+    double positionAtStart;
+    SEMIDIClockSenderTempoSchedule schedule;
+    SEMIDIClockSenderTempoEvent events[kMaxTempoEvents];
+    SEMIDIClockSenderReadTimeline(THIS, &started, &positionAtStart, &schedule, events);
+    
+    if ( !started ) {
+        return positionAtStart;
     }
     
     if ( !time ) {
         time = SECurrentTimeInHostTicks();
     }
     
-    if ( time < THIS->_timeBase ) {
-        return 0.0;
+    // Evaluate the tempo curve from our time base
+    return SEMIDIClockSenderTempoSchedulePositionAtTime(&schedule, time);
+}
+
+void SEMIDIClockSenderGetTimelinePositions(__unsafe_unretained SEMIDIClockSender * THIS,
+                                           const uint64_t * times, double * positions, int count) {
+    BOOL started;
+    double positionAtStart;
+    SEMIDIClockSenderTempoSchedule schedule;
+    SEMIDIClockSenderTempoEvent events[kMaxTempoEvents];
+    SEMIDIClockSenderReadTimeline(THIS, &started, &positionAtStart, &schedule, events);
+    
+    if ( !started ) {
+        for ( int i=0; i<count; i++ ) {
+            positions[i] = positionAtStart;
+        }
+        return;
+    }
+    
+    SEMIDIClockSenderTempoPiece pieces[2*kMaxTempoEvents + 1];
+    int pieceCount = SEMIDIClockSenderTempoScheduleGetPieces(&schedule, pieces);
+    
+    for ( int i=0; i<count; ) {
+        // Find the piece containing this time, then the run of following times also within it
+        int piece = pieceCount - 1;
+        while ( piece > 0 && times[i] < pieces[piece].startTime ) piece--;
+        uint64_t end = piece < pieceCount - 1 ? pieces[piece+1].startTime : UINT64_MAX;
+        int runEnd = i + 1;
+        while ( runEnd < count && (piece == 0 || times[runEnd] >= pieces[piece].startTime) && times[runEnd] < end ) runEnd++;
+        
+        const SEMIDIClockSenderTempoPiece * p = &pieces[piece];
+        if ( !p->ramp ) {
+            SETempoConversion conversion;
+            SEMIDIClockSenderTempoPieceConversion(&schedule, p, &conversion);
+            SETempoConversionHostTicksToBeatsArray(&conversion, p->startTime, p->startPosition, times + i, positions + i, runEnd - i);
+        } else {
+            for ( int j=i; j<runEnd; j++ ) {
+                positions[j] = times[j] < schedule.timeBase ? 0.0
+                    : p->startPosition + SEMIDIClockSenderRampBeats(p->ramp, p->tempo, schedule.beatsPerHostTickPerBPM, times[j] - p->startTime);
+            }
+        }
+        i = runEnd;
+    }
+}
+
+void SEMIDIClockSenderGetTimesForTimelinePositions(__unsafe_unretained SEMIDIClockSender * THIS,
+                                                   const double * positions, uint64_t * times, int count) {
+    BOOL started;
+    double positionAtStart;
+    SEMIDIClockSenderTempoSchedule schedule;
+    SEMIDIClockSenderTempoEvent events[kMaxTempoEvents];
+    SEMIDIClockSenderReadTimeline(THIS, &started, &positionAtStart, &schedule, events);
+    
+    if ( !started ) {
+        memset(times, 0, count * sizeof(uint64_t));
+        return;
     }
     
-    // Calculate offset from our time base, and convert to beats using current tempo
-    return SEHostTicksToBeats(time - THIS->_timeBase, THIS->_tempo);
+    SEMIDIClockSenderTempoPiece pieces[2*kMaxTempoEvents + 1];
+    int pieceCount = SEMIDIClockSenderTempoScheduleGetPieces(&schedule, pieces);
+    
+    for ( int i=0; i<count; ) {
+        // Find the piece containing this position, then the run of following positions also within it
+        int piece = pieceCount - 1;
+        while ( piece > 0 && positions[i] <= pieces[piece].startPosition ) piece--;
+        double end = piece < pieceCount - 1 ? pieces[piece+1].startPosition : INFINITY;
+        int runEnd = i + 1;
+        while ( runEnd < count && (piece == 0 || positions[runEnd] > pieces[piece].startPosition) && positions[runEnd] <= end ) runEnd++;
+        
+        const SEMIDIClockSenderTempoPiece * p = &pieces[piece];
+        if ( p->ramp ) {
+            for ( int j=i; j<runEnd; j++ ) {
+                times[j] = positions[j] <= 0.0 ? schedule.timeBase
+                    : p->startTime + (uint64_t)llround(SEMIDIClockSenderRampTime(p->ramp, p->tempo, schedule.beatsPerHostTickPerBPM, positions[j] - p->startPosition));
+            }
+        } else if ( p->tempo <= 0.0 ) {
+            // The timeline stops here, so later positions are never reached
+            for ( int j=i; j<runEnd; j++ ) {
+                times[j] = positions[j] <= p->startPosition ? p->startTime : 0;
+            }
+        } else {
+            SETempoConversion conversion;
+            SEMIDIClockSenderTempoPieceConversion(&schedule, p, &conversion);
+            SETempoConversionBeatsToHostTicksArray(&conversion, p->startPosition, p->startTime, positions + i, times + i, runEnd - i);
+        }
+        i = runEnd;
+    }
 }
 
 BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * THIS) {
     return THIS->_started;
 }
 
+double SEMIDIClockSenderGetTempo(__unsafe_unretained SEMIDIClockSender * THIS) {
+    return SEMIDIClockSenderGetTempoAtTime(THIS, SECurrentTimeInHostTicks());
+}
+
+double SEMIDIClockSenderGetTempoAtTime(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t time) {
+    BOOL started;
+    double positionAtStart;
+    SEMIDIClockSenderTempoSchedule schedule;
+    SEMIDIClockSenderTempoEvent events[kMaxTempoEvents];
+    SEMIDIClockSenderReadTimeline(THIS, &started, &positionAtStart, &schedule, events);
+    return SEMIDIClockSenderTempoScheduleTempoAtTime(&schedule, time);
+}
+
 -(void)setTimelinePosition:(double)timelinePosition {
     [self setActiveTimelinePosition:timelinePosition atTime:SECurrentTimeInHostTicks()];
 }
@@ -116,7 +555,7 @@ BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * THIS) {
 }
 
 -(void)setTempo:(double)tempo {
-    if ( _tempo == tempo ) {
+    if ( _tempo == tempo && _tempoEventCount == 0 ) {
         return;
     }
     
@@ -124,17 +563,25 @@ BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * THIS) {
         [self stop];
     }
     
-    @synchronized ( self ) {
-        if ( _timeBase ) {
-            // Scale time base to new tempo, so our relative timeline position remains the same (as it is dependent on tempo)
-            double ratio = _tempo / tempo;
-            uint64_t now = SECurrentTimeInHostTicks();
-            _timeBase = now - ((now - _timeBase) * ratio);
-        }
-        
-        _tempo = tempo;
+    SEMIDIClockSenderLock(self);
+    SEMIDIClockSenderBeginTimelineUpdate(self);
+    
+    // Take over from any ramp in progress, at the tempo it has reached
+    SEMIDIClockSenderApplyTempoEvents(self, SECurrentTimeInHostTicks(), YES);
+    
+    if ( _timeBase ) {
+        // Scale time base to new tempo, so our relative timeline position remains the same (as it is dependent on tempo)
+        double ratio = _tempo / tempo;
+        uint64_t now = SECurrentTimeInHostTicks();
+        _timeBase = now - ((now - _timeBase) * ratio);
     }
     
+    SEMIDIClockSenderSetBaseTempo(self, tempo);
+    SEMIDIClockSenderResolveTempoEvents(self);
+    SEMIDIClockSenderEndTimelineUpdate(self);
+    SEMIDIClockSenderPublishState(self);
+    SEMIDIClockSenderUnlock(self);
+    
     if ( _sendClockTicksWhileTimelineStopped ) {
         if ( tempo != 0.0 && !_thread ) {
             // Start the thread which will send out the ticks - in a moment, in case clock is started next
@@ -147,111 +594,302 @@ BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * THIS) {
     }
 }
 
+-(void)setSendClockTicksWhileTimelineStopped:(BOOL)sendClockTicksWhileTimelineStopped {
+    _sendClockTicksWhileTimelineStopped = sendClockTicksWhileTimelineStopped;
+    
+    if ( sendClockTicksWhileTimelineStopped && _tempo != 0.0 && !_thread ) {
+        // Start sending ticks - in a moment, in case clock is started next
+        [self performSelector:@selector(startThread) withObject:nil afterDelay:0.0];
+    } else if ( !sendClockTicksWhileTimelineStopped && !_started && _thread ) {
+        // Stop the thread
+        [_thread cancel];
+        self.thread = nil;
+    }
+}
+
 -(uint64_t)startOrSeekWithPosition:(double)timelinePosition atTime:(uint64_t)applyTime startClock:(BOOL)start {
-    @synchronized ( self ) {
-        uint64_t tickDuration = SESecondsToHostTicks((60.0 / _tempo) / SEMIDITicksPerBeat);
-        uint64_t MIDIBeatDuration = tickDuration * SEMIDITicksPerSongPositionBeat;
-        double beatsToMIDIBeats = (double)SEMIDITicksPerBeat / (double)SEMIDITicksPerSongPositionBeat;
-        uint64_t beatSyncThreshold = SESecondsToHostTicks(kFirstBeatSyncThreshold);
-        
-        if ( !_started && !start ) {
-            // Cue this position for when we start
-            _positionAtStart = timelinePosition;
-            
-            // Send song position in next run loop (delayed, in case we're just about to start the clock,
-            // in which case we want to send the song position at the same timestamp
-            [self performSelector:@selector(sendSongPositionDelayed) withObject:nil afterDelay:0];
-            
-            return applyTime;
-        }
+    SEMIDIClockSenderLock(self);
+    if ( _started ) {
+        // Moving within the timeline ends any ramp in progress, at the tempo it has reached
+        SEMIDIClockSenderApplyTempoEvents(self, MAX(applyTime, SECurrentTimeInHostTicks()), YES);
+    }
+    
+    uint64_t tickDuration = _tickDuration;
+    uint64_t MIDIBeatDuration = tickDuration * SEMIDITicksPerSongPositionBeat;
+    double beatsToMIDIBeats = (double)SEMIDITicksPerBeat / (double)SEMIDITicksPerSongPositionBeat;
+    uint64_t beatSyncThreshold = SESecondsToHostTicks(kFirstBeatSyncThreshold);
+    
+    if ( !_started && !start ) {
+        // Cue this position for when we start
+        _positionAtStart = timelinePosition;
         
-        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(sendSongPositionDelayed) object:nil];
+        // Send song position in next run loop (delayed, in case we're just about to start the clock,
+        // in which case we want to send the song position at the same timestamp
+        [self performSelector:@selector(sendSongPositionDelayed) withObject:nil afterDelay:0];
         
-        if ( !applyTime ) {
-            // We've been left to choose an apply time ourselves: choose the next tick time,
-            // to give us the best chance of a smooth transition.
-            applyTime = _nextTickTime ? _nextTickTime : SECurrentTimeInHostTicks();
-        } else if ( _nextTickTime ) {
-            // Find the next tick time after the given apply time
-            uint64_t originalApplyTime = applyTime;
-            if ( applyTime < _nextTickTime ) {
-                applyTime = _nextTickTime;
-            } else {
-                uint64_t modulus = (applyTime - _nextTickTime) % tickDuration;
-                if ( modulus > beatSyncThreshold && (tickDuration - modulus) > beatSyncThreshold ) {
-                    applyTime += tickDuration - modulus;
-                }
-            }
-            if ( applyTime > originalApplyTime ) {
-                // Need to adjust the timeline position accordingly
-                timelinePosition += SEHostTicksToBeats(applyTime - originalApplyTime, _tempo);
+        SEMIDIClockSenderPublishState(self);
+        SEMIDIClockSenderUnlock(self);
+        return applyTime;
+    }
+    
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(sendSongPositionDelayed) object:nil];
+    
+    if ( !applyTime ) {
+        // We've been left to choose an apply time ourselves: choose the next tick time,
+        // to give us the best chance of a smooth transition.
+        applyTime = _nextTickTime ? _nextTickTime : SECurrentTimeInHostTicks();
+    } else if ( _nextTickTime ) {
+        // Find the next tick time after the given apply time
+        uint64_t originalApplyTime = applyTime;
+        if ( applyTime < _nextTickTime ) {
+            applyTime = _nextTickTime;
+        } else {
+            uint64_t modulus = (applyTime - _nextTickTime) % tickDuration;
+            if ( modulus > beatSyncThreshold && (tickDuration - modulus) > beatSyncThreshold ) {
+                applyTime += tickDuration - modulus;
             }
         }
-        
-        // Calculate time base, and determine relative position in host ticks
-        uint64_t timeBase = applyTime - SEBeatsToHostTicks(timelinePosition, _tempo);
-        
-        if ( _nextTickTime && applyTime <= (_nextTickTime-tickDuration) ) {
-            // If our apply time is before the last tick we sent, we'll need to move up the timeline.
-            // Work out when the next MIDI beat is, and use that as our apply time
-            uint64_t latestPosition = _nextTickTime - timeBase;
-            uint64_t timeUntilNextMIDIBeat = MIDIBeatDuration - (latestPosition % MIDIBeatDuration);
-            applyTime = timeBase + latestPosition + timeUntilNextMIDIBeat;
-            timelinePosition = SEHostTicksToBeats(applyTime - timeBase, _tempo);
+        if ( applyTime > originalApplyTime ) {
+            // Need to adjust the timeline position accordingly
+            timelinePosition += SETempoConversionHostTicksToBeats(&_tempoConversion, applyTime - originalApplyTime);
         }
+    }
+    
+    // Calculate time base, and determine relative position in host ticks
+    uint64_t timeBase = applyTime - SETempoConversionBeatsToHostTicks(&_tempoConversion, timelinePosition);
+    
+    if ( _nextTickTime && applyTime <= (_nextTickTime-tickDuration) ) {
+        // If our apply time is before the last tick we sent, we'll need to move up the timeline.
+        // Work out when the next MIDI beat is, and use that as our apply time
+        uint64_t latestPosition = _nextTickTime - timeBase;
+        uint64_t timeUntilNextMIDIBeat = MIDIBeatDuration - (latestPosition % MIDIBeatDuration);
+        applyTime = timeBase + latestPosition + timeUntilNextMIDIBeat;
+        timelinePosition = SETempoConversionHostTicksToBeats(&_tempoConversion, applyTime - timeBase);
+    }
+    
+    // Calculate time, in our new timeline, to the closest MIDI Beat (16th note)
+    uint64_t timeUntilNextMIDIBeat = 0;
+    uint64_t position = applyTime - timeBase;
+    uint64_t modulus = position % MIDIBeatDuration;
+    if ( modulus > beatSyncThreshold && MIDIBeatDuration - modulus > beatSyncThreshold ) {
+        timeUntilNextMIDIBeat = MIDIBeatDuration - modulus;
+    }
+    
+    // Determine number of MIDI Beats to report
+    int totalBeats = round((timelinePosition + SETempoConversionHostTicksToBeats(&_tempoConversion, timeUntilNextMIDIBeat)) * beatsToMIDIBeats);
+    
+    if ( _started || totalBeats > 0 ) {
+        // Send song position
+        [self enqueueMessage:(unsigned char[3]){SEMIDIMessageSongPosition, totalBeats & 0x7F, (totalBeats >> 7) & 0x7F}
+                      length:3
+                        time:applyTime + timeUntilNextMIDIBeat - 1 /* force ordering before tick */];
+    }
+    
+    if ( _started || start) {
+        // Update the timebase
+        SEMIDIClockSenderBeginTimelineUpdate(self);
+        _timeBase = timeBase;
+        SEMIDIClockSenderEndTimelineUpdate(self);
         
-        // Calculate time, in our new timeline, to the closest MIDI Beat (16th note)
-        uint64_t timeUntilNextMIDIBeat = 0;
-        uint64_t position = applyTime - timeBase;
-        uint64_t modulus = position % MIDIBeatDuration;
-        if ( modulus > beatSyncThreshold && MIDIBeatDuration - modulus > beatSyncThreshold ) {
-            timeUntilNextMIDIBeat = MIDIBeatDuration - modulus;
-        }
+        // Events before the new position have been skipped over; later ones will be placed on the new timeline
+        SEMIDIClockSenderTakeScheduledEvents(self);
+        SEMIDIClockSenderDropScheduledEventsBefore(self, timelinePosition);
+    }
+    
+    if ( !_started && start ) {
+        [self enqueueMessage:(unsigned char[1]){ totalBeats > 0.0 ? SEMIDIMessageContinue : SEMIDIMessageClockStart }
+                      length:1
+                        time:applyTime + timeUntilNextMIDIBeat - 1 /* force ordering before tick */];
         
-        // Determine number of MIDI Beats to report
-        int totalBeats = round((timelinePosition + SEHostTicksToBeats(timeUntilNextMIDIBeat, _tempo)) * beatsToMIDIBeats);
+        _positionAtStart = 0;
+        self.started = YES;
+        _nextTickTime = applyTime + timeUntilNextMIDIBeat;
         
-        if ( _started || totalBeats > 0 ) {
-            // Send song position
-            [self enqueueMessage:(unsigned char[3]){SEMIDIMessageSongPosition, totalBeats & 0x7F, (totalBeats >> 7) & 0x7F}
-                          length:3
-                            time:applyTime + timeUntilNextMIDIBeat - 1 /* force ordering before tick */];
+        if ( !_thread ) {
+            [self startThread];
         }
-        
-        if ( _started || start) {
-            // Update the timebase
-            _timeBase = timeBase;
+    }
+    
+    // Changes scheduled by timeline position happen at new times now
+    SEMIDIClockSenderResolveTempoEvents(self);
+    
+    _generation++;
+    SEMIDIClockSenderPublishState(self);
+    SEMIDIClockSenderUnlock(self);
+    return applyTime;
+}
+
+-(BOOL)scheduleTempo:(double)tempo atTime:(uint64_t)applyTime curve:(SEMIDIClockSenderTempoCurve)curve duration:(NSTimeInterval)duration {
+    SEMIDIClockSenderTempoEvent event = {
+        .curve = curve,
+        .tempo = tempo,
+        .startTime = MAX(applyTime, SECurrentTimeInHostTicks()),
+        .duration = curve == SEMIDIClockSenderTempoStep ? 0 : SESecondsToHostTicks(MAX(0.0, duration))
+    };
+    return [self addTempoEvent:event];
+}
+
+-(BOOL)scheduleTempo:(double)tempo atTimelinePosition:(double)position curve:(SEMIDIClockSenderTempoCurve)curve durationInBeats:(double)beats {
+    SEMIDIClockSenderTempoEvent event = {
+        .curve = curve,
+        .tempo = tempo,
+        .startTime = kUnresolvedTime,
+        .scheduledByPosition = YES,
+        .position = position,
+        .durationInBeats = curve == SEMIDIClockSenderTempoStep ? 0.0 : MAX(0.0, beats)
+    };
+    return [self addTempoEvent:event];
+}
+
+-(BOOL)addTempoEvent:(SEMIDIClockSenderTempoEvent)event {
+    NSAssert(event.tempo > 0.0, @"Scheduled tempo must be positive");
+    
+    SEMIDIClockSenderLock(self);
+    if ( _tempoEventCount == kMaxTempoEvents ) {
+        SEMIDIClockSenderUnlock(self);
+        return NO;
+    }
+    
+    SEMIDIClockSenderBeginTimelineUpdate(self);
+    SEMIDIClockSenderTempoEvent savedEvents[kMaxTempoEvents];
+    int savedEventCount = _tempoEventCount;
+    memcpy(savedEvents, _tempoEvents, sizeof(savedEvents));
+    
+    _tempoEvents[_tempoEventCount++] = event;
+    SEMIDIClockSenderResolveTempoEvents(self);
+    
+    // Changes may not overlap
+    BOOL overlapping = NO;
+    for ( int i=1; i<_tempoEventCount && _tempoEvents[i].startTime != kUnresolvedTime; i++ ) {
+        if ( _tempoEvents[i].startTime < _tempoEvents[i-1].startTime + _tempoEvents[i-1].duration ) {
+            overlapping = YES;
         }
-        
-        if ( !_started && start ) {
-            [self enqueueMessage:(unsigned char[1]){ totalBeats > 0.0 ? SEMIDIMessageContinue : SEMIDIMessageClockStart }
-                          length:1
-                            time:applyTime + timeUntilNextMIDIBeat - 1 /* force ordering before tick */];
-            
-            _positionAtStart = 0;
-            self.started = YES;
-            _nextTickTime = applyTime + timeUntilNextMIDIBeat;
-            
-            if ( !_thread ) {
-                [self startThread];
-            }
+    }
+    if ( overlapping ) {
+        memcpy(_tempoEvents, savedEvents, sizeof(savedEvents));
+        _tempoEventCount = savedEventCount;
+    }
+    
+    SEMIDIClockSenderEndTimelineUpdate(self);
+    SEMIDIClockSenderUnlock(self);
+    
+    return !overlapping;
+}
+
+-(void)cancelScheduledTempoChanges {
+    SEMIDIClockSenderLock(self);
+    SEMIDIClockSenderBeginTimelineUpdate(self);
+    SEMIDIClockSenderApplyTempoEvents(self, SECurrentTimeInHostTicks(), YES);
+    _tempoEventCount = 0;
+    SEMIDIClockSenderEndTimelineUpdate(self);
+    SEMIDIClockSenderPublishState(self);
+    SEMIDIClockSenderUnlock(self);
+}
+
+BOOL SEMIDIClockSenderScheduleEvent(__unsafe_unretained SEMIDIClockSender * THIS, double position, const uint8_t * data, int length) {
+    if ( length <= 0 || length > kMaxScheduledEventLength ) {
+        return NO;
+    }
+    
+    uint32_t head = THIS->_eventIntakeHead;
+    if ( head - __atomic_load_n(&THIS->_eventIntakeTail, __ATOMIC_ACQUIRE) == kEventIntakeSize ) {
+        // No room
+        return NO;
+    }
+    
+    SEMIDIClockSenderScheduledEvent * event = &THIS->_eventIntake[head & (kEventIntakeSize-1)];
+    event->position = position;
+    event->length = length;
+    memcpy(event->data, data, length);
+    
+    // Ensure the event is complete before the sender can see it
+    __atomic_store_n(&THIS->_eventIntakeHead, head + 1, __ATOMIC_RELEASE);
+    return YES;
+}
+
+-(BOOL)scheduleEvent:(const uint8_t *)data length:(int)length atTimelinePosition:(double)position {
+    if ( !_started ) {
+        // Nothing drains the intake while stopped, so move what's there into the schedule first
+        SEMIDIClockSenderLock(self);
+        SEMIDIClockSenderTakeScheduledEvents(self);
+        SEMIDIClockSenderUnlock(self);
+    }
+    return SEMIDIClockSenderScheduleEvent(self, position, data, length);
+}
+
+-(void)cancelScheduledEvents {
+    SEMIDIClockSenderLock(self);
+    SEMIDIClockSenderTakeScheduledEvents(self);
+    _scheduledEventCount = 0;
+    SEMIDIClockSenderUnlock(self);
+}
+
+-(void)setStatePublisher:(SEClockStatePublisher *)statePublisher {
+    SEMIDIClockSenderLock(self);
+    _statePublisher = statePublisher;
+    SEMIDIClockSenderPublishState(self);
+    SEMIDIClockSenderUnlock(self);
+}
+
+-(void)setRenderCallbackDriven:(BOOL)renderCallbackDriven {
+    if ( _renderCallbackDriven == renderCallbackDriven ) {
+        return;
+    }
+    
+    SEMIDIClockSenderLock(self);
+    _renderCallbackDriven = renderCallbackDriven;
+    SEMIDIClockSenderUnlock(self);
+    
+    if ( renderCallbackDriven && _thread ) {
+        // Hand over to the render callback
+        [_thread cancel];
+        self.thread = nil;
+    } else if ( !renderCallbackDriven && (_started || (_sendClockTicksWhileTimelineStopped && _tempo != 0.0)) ) {
+        // Take over from the render callback
+        [self startThread];
+    }
+}
+
+void SEMIDIClockSenderRender(__unsafe_unretained SEMIDIClockSender * THIS, const AudioTimeStamp * timestamp, UInt32 frames) {
+    if ( !THIS->_renderCallbackDriven ) {
+        return;
+    }
+    
+    if ( pthread_mutex_trylock(&THIS->_mutex) != 0 ) {
+        // The main thread is making changes; we'll catch up on the next render cycle
+        return;
+    }
+    
+    uint64_t bufferTime = timestamp && (timestamp->mFlags & kAudioTimeStampHostTimeValid) ? timestamp->mHostTime : SECurrentTimeInHostTicks();
+    uint64_t endTime = bufferTime + (uint64_t)((((double)frames / THIS->_sampleRate) + THIS->_lookAheadTime) * __hostTicksPerSecond);
+    
+    if ( THIS->_tickDuration == 0 || (!THIS->_started && !THIS->_sendClockTicksWhileTimelineStopped) ) {
+        // Not sending ticks: just dispatch messages that are due, and pick up from the current time when we next start
+        SEMIDIClockSenderSendTicks(THIS, 0, endTime);
+        THIS->_nextTickTime = 0;
+    } else {
+        uint64_t nextTickTime = THIS->_nextTickTime;
+        if ( !nextTickTime || (nextTickTime < bufferTime && bufferTime - nextTickTime > __maxRenderCatchUpTime) ) {
+            // Starting out, or resuming after render cycles stopped for a while: begin from this buffer
+            nextTickTime = bufferTime;
         }
+        THIS->_nextTickTime = SEMIDIClockSenderSendTicks(THIS, nextTickTime, endTime);
     }
     
-    return applyTime;
+    pthread_mutex_unlock(&THIS->_mutex);
 }
 
 -(void)startThread {
-    if ( !_thread ) {
-        self.thread = [SEMIDIClockSenderThread new];
-        _thread.sender = self;
+    if ( !_thread && !_renderCallbackDriven ) {
+        self.thread = [[SEMIDIClockSenderThread alloc] initWithSender:self];
+        __atomic_add_fetch(&_threadCount, 1, __ATOMIC_RELAXED);
         [_thread start];
     }
 }
 
 -(void)enqueueMessage:(const unsigned char*)message length:(int)length time:(MIDITimeStamp)timestamp {
-    if ( _thread ) {
-        // Enqueue message to be sent from sender thread, at the appropriate time
+    if ( _thread || _renderCallbackDriven ) {
+        // Enqueue message to be sent from sender thread or render callback, at the appropriate time
         for ( int i=0; i<kMaxPendingMessages; i++ ) {
             if ( _pendingMessages[i].numPackets == 0 ) {
                 MIDIPacket *packet = MIDIPacketListInit(&_pendingMessages[i]);
@@ -264,106 +902,436 @@ BOOL SEMIDIClockSenderIsStarted(__unsafe_unretained SEMIDIClockSender * THIS) {
         MIDIPacketList packetList;
         MIDIPacket *packet = MIDIPacketListInit(&packetList);
         packet = MIDIPacketListAdd(&packetList, sizeof(packetList), packet, timestamp, length, message);
-        [_senderInterface sendMIDIPacketList:&packetList];
+        SEMIDIClockSenderSend(self, &packetList);
     }
 }
 
--(MIDIPacketList *)pendingMessages {
-    return _pendingMessages;
-}
-
 -(void)sendSongPositionDelayed {
     double beatsToMIDIBeats = (double)SEMIDITicksPerBeat / (double)SEMIDITicksPerSongPositionBeat;
     int totalBeats = round(_positionAtStart * beatsToMIDIBeats);
+    SEMIDIClockSenderLock(self);
     [self enqueueMessage:(unsigned char[3]){SEMIDIMessageSongPosition, totalBeats & 0x7F, (totalBeats >> 7) & 0x7F}
                   length:3
                     time:SECurrentTimeInHostTicks()];
+    SEMIDIClockSenderUnlock(self);
 }
 
-@end
+static void SEMIDIClockSenderLock(__unsafe_unretained SEMIDIClockSender * THIS) {
+    pthread_mutex_lock(&THIS->_mutex);
+}
 
-@implementation SEMIDIClockSenderThread
+static void SEMIDIClockSenderUnlock(__unsafe_unretained SEMIDIClockSender * THIS) {
+    pthread_mutex_unlock(&THIS->_mutex);
+}
 
--(void)main {
-    [NSThread setThreadPriority:kThreadPriority];
+static void SEMIDIClockSenderSend(__unsafe_unretained SEMIDIClockSender * THIS, const MIDIPacketList * packetList) {
+    if ( THIS->_sendCallback ) {
+        THIS->_sendCallback(THIS->_sendCallbackContext, packetList);
+    } else {
+        [THIS->_senderInterface sendMIDIPacketList:packetList];
+    }
+}
+
+static void SEMIDIClockSenderPublishState(__unsafe_unretained SEMIDIClockSender * THIS) {
+    // Called with the lock held, which makes us the page's only writer, so the tick path can publish without waiting
+    if ( !THIS->_statePublisher ) {
+        return;
+    }
     
-    while ( !self.isCancelled ) {
-        uint64_t nextSendTime = 0;
+    uint64_t now = SECurrentTimeInHostTicks();
+    if ( THIS->_started && THIS->_timeBase && THIS->_tempoEventCount > 0 && THIS->_tempoEvents[0].startTime <= now ) {
+        // A scheduled change is under way. The page can only describe a constant tempo, so publish the tempo and
+        // position reached now; the sender republishes as it sends ticks along the curve, until the change completes.
+        SEMIDIClockSenderTempoSchedule schedule = SEMIDIClockSenderGetTempoSchedule(THIS);
+        SEClockStatePublisherPublishExclusive(THIS->_statePublisher,
+                                              YES,
+                                              SEMIDIClockSenderTempoScheduleTempoAtTime(&schedule, now),
+                                              now,
+                                              SEMIDIClockSenderTempoSchedulePositionAtTime(&schedule, now),
+                                              THIS->_generation);
+    } else {
+        SEClockStatePublisherPublishExclusive(THIS->_statePublisher,
+                                              THIS->_started,
+                                              THIS->_tempo,
+                                              THIS->_started ? THIS->_timeBase : 0,
+                                              THIS->_started ? 0.0 : THIS->_positionAtStart,
+                                              THIS->_generation);
+    }
+}
+
+static void SEMIDIClockSenderBeginTimelineUpdate(__unsafe_unretained SEMIDIClockSender * THIS) {
+    // Called with the lock held. Marks the timeline as being updated, for lock-free readers.
+    if ( THIS->_timelineUpdateDepth++ == 0 ) {
+        __atomic_store_n(&THIS->_timelineSequence, THIS->_timelineSequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+}
+
+static void SEMIDIClockSenderEndTimelineUpdate(__unsafe_unretained SEMIDIClockSender * THIS) {
+    if ( --THIS->_timelineUpdateDepth == 0 ) {
+        __atomic_store_n(&THIS->_timelineSequence, THIS->_timelineSequence + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void SEMIDIClockSenderSetBaseTempo(__unsafe_unretained SEMIDIClockSender * THIS, double tempo) {
+    THIS->_tempo = tempo;
+    THIS->_tickDuration = tempo != 0.0 ? SESecondsToHostTicks((60.0 / tempo) / SEMIDITicksPerBeat) : 0;
+    SETempoConversionSetTempo(&THIS->_tempoConversion, tempo);
+}
+
+static void SEMIDIClockSenderApplyTempoEvents(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t time, BOOL endRampInProgress) {
+    // Called with the lock held. Folds changes that have completed by the given time into the constant
+    // tempo and time base, leaving the timeline unchanged; optionally ends a ramp in progress there, too.
+    BOOL changed = NO;
+    SEMIDIClockSenderBeginTimelineUpdate(THIS);
+    while ( THIS->_tempoEventCount > 0 ) {
+        SEMIDIClockSenderTempoEvent * event = &THIS->_tempoEvents[0];
+        if ( event->startTime == kUnresolvedTime || event->startTime > time ) {
+            break;
+        }
         
-        @synchronized ( _sender ) {
-            uint64_t now = SECurrentTimeInHostTicks();
-            uint64_t nextTickTime = _sender.nextTickTime;
-            
-            if ( !nextTickTime ) {
-                _sender.nextTickTime = nextTickTime = now;
-            }
-            
-            // Send the next batch of ticks
-            uint64_t tickDuration = SESecondsToHostTicks((60.0 / _sender.tempo) / SEMIDITicksPerBeat);
-            uint64_t endTime = MAX(nextTickTime, now) + (tickDuration * kTicksPerSendInterval);
-            _sender.nextTickTime = nextTickTime = [self sendFromTime:nextTickTime toTime:endTime];
-            
-            // Wait half the duration of the ticks we just sent (to avoid running out of time; we'll skip the ticks we've already sent)
-            nextSendTime = nextTickTime - (tickDuration * kTicksPerSendInterval) / 2;
+        SEMIDIClockSenderTempoSchedule schedule = SEMIDIClockSenderGetTempoSchedule(THIS);
+        uint64_t endTime = event->startTime + event->duration;
+        double tempo;
+        if ( endTime <= time ) {
+            tempo = event->tempo;
+        } else if ( endRampInProgress ) {
+            tempo = SEMIDIClockSenderTempoScheduleTempoAtTime(&schedule, time);
+            endTime = time;
+        } else {
+            break;
         }
         
-        // Sleep
-        mach_wait_until(nextSendTime);
+        if ( THIS->_timeBase ) {
+            // Move the time base so that the constant tempo continues the timeline from where the change ends
+            double position = SEMIDIClockSenderTempoSchedulePositionAtTime(&schedule, endTime);
+            SETempoConversion conversion;
+            SETempoConversionSetTempo(&conversion, tempo);
+            THIS->_timeBase = endTime - SETempoConversionBeatsToHostTicks(&conversion, position);
+        }
+        SEMIDIClockSenderSetBaseTempo(THIS, tempo);
+        
+        THIS->_tempoEventCount--;
+        memmove(&THIS->_tempoEvents[0], &THIS->_tempoEvents[1], THIS->_tempoEventCount * sizeof(SEMIDIClockSenderTempoEvent));
+        changed = YES;
     }
+    SEMIDIClockSenderEndTimelineUpdate(THIS);
     
-    @synchronized ( _sender ) {
-        _sender.nextTickTime = 0;
+    if ( changed ) {
+        SEMIDIClockSenderPublishState(THIS);
     }
 }
 
--(uint64_t)sendFromTime:(uint64_t)start toTime:(uint64_t)end {
-    if ( _sender.tempo == 0 ) {
-        return start;
+static void SEMIDIClockSenderResolveTempoEvents(__unsafe_unretained SEMIDIClockSender * THIS) {
+    // Called with the lock held. Determines the start times of changes scheduled by timeline position, and
+    // orders the schedule. Each change is placed using the curve formed by the changes before it, so
+    // changes are taken in timeline order, building the schedule up as we go.
+    SEMIDIClockSenderBeginTimelineUpdate(THIS);
+    
+    SEMIDIClockSenderTempoEvent pending[kMaxTempoEvents];
+    int pendingCount = THIS->_tempoEventCount;
+    memcpy(pending, THIS->_tempoEvents, pendingCount * sizeof(SEMIDIClockSenderTempoEvent));
+    THIS->_tempoEventCount = 0;
+    
+    BOOL running = THIS->_started && THIS->_timeBase;
+    while ( pendingCount > 0 ) {
+        SEMIDIClockSenderTempoSchedule schedule = SEMIDIClockSenderGetTempoSchedule(THIS);
+        int next = -1;
+        double nextPosition = 0.0;
+        for ( int i=0; i<pendingCount; i++ ) {
+            double position;
+            if ( pending[i].scheduledByPosition ) {
+                if ( !running ) continue;
+                position = pending[i].position;
+            } else {
+                position = running ? SEMIDIClockSenderTempoSchedulePositionAtTime(&schedule, pending[i].startTime) : (double)pending[i].startTime;
+            }
+            if ( next == -1 || position < nextPosition || (position == nextPosition && !pending[i].scheduledByPosition) ) {
+                next = i;
+                nextPosition = position;
+            }
+        }
+        if ( next == -1 ) {
+            break;
+        }
+        
+        SEMIDIClockSenderTempoEvent event = pending[next];
+        pendingCount--;
+        memmove(&pending[next], &pending[next+1], (pendingCount - next) * sizeof(SEMIDIClockSenderTempoEvent));
+        
+        if ( event.scheduledByPosition ) {
+            event.startTime = SEMIDIClockSenderTempoScheduleTimeAtPosition(&schedule, event.position);
+            if ( THIS->_tempoEventCount > 0 ) {
+                // Wait for the previous change to finish
+                SEMIDIClockSenderTempoEvent * previous = &THIS->_tempoEvents[THIS->_tempoEventCount-1];
+                event.startTime = MAX(event.startTime, previous->startTime + previous->duration);
+            }
+            double startTempo = SEMIDIClockSenderTempoScheduleTempoAtTime(&schedule, event.startTime);
+            event.duration = event.curve == SEMIDIClockSenderTempoStep ? 0 :
+                SEMIDIClockSenderRampDurationForBeats(event.curve, startTempo, event.tempo, THIS->_beatsPerHostTickPerBPM, event.durationInBeats);
+        }
+        
+        THIS->_tempoEvents[THIS->_tempoEventCount++] = event;
     }
     
-    uint64_t tickDuration = SESecondsToHostTicks((60.0 / _sender.tempo) / SEMIDITicksPerBeat);
+    // Changes that can't be placed until the clock starts go last
+    for ( int i=0; i<pendingCount; i++ ) {
+        pending[i].startTime = kUnresolvedTime;
+        THIS->_tempoEvents[THIS->_tempoEventCount++] = pending[i];
+    }
     
-    uint64_t timeBase = _sender.timeBase;
-    if ( timeBase ) {
-        // Calculate distance to next scheduled tick
-        uint64_t position = start - timeBase;
-        uint64_t modulus = position % tickDuration;
-        uint64_t threshold = SESecondsToHostTicks(kTickResyncThreshold);
-        if ( modulus > threshold && tickDuration - modulus > threshold ) {
-            // Resync to the closest tick, to make sure it's a multiple of the tick duration away from the time base
-            start = timeBase + round((double)position / (double)tickDuration) * tickDuration;
+    SEMIDIClockSenderEndTimelineUpdate(THIS);
+}
+
+static void SEMIDIClockSenderDispatchPendingMessages(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t time) {
+    // Called with the lock held. Sends pending messages due before the given time.
+    MIDIPacketList * pendingMessages = THIS->_pendingMessages;
+    for ( int i=0; i<kMaxPendingMessages; i++ ) {
+        if ( pendingMessages[i].numPackets != 0 && pendingMessages[i].packet[0].timeStamp < time ) {
+            SEMIDIClockSenderSend(THIS, &pendingMessages[i]);
+            pendingMessages[i].numPackets = 0;
+        }
+    }
+}
+
+static void SEMIDIClockSenderTakeScheduledEvents(__unsafe_unretained SEMIDIClockSender * THIS) {
+    // Called with the lock held. Moves newly scheduled events into the schedule, in timeline order;
+    // events at the same position keep the order they were scheduled in.
+    SEMIDIClockSenderScheduledEvent * events = THIS->_scheduledEvents;
+    uint32_t tail = THIS->_eventIntakeTail;
+    uint32_t head = __atomic_load_n(&THIS->_eventIntakeHead, __ATOMIC_ACQUIRE);
+    for ( ; tail != head && THIS->_scheduledEventCount < kMaxScheduledEvents; tail++ ) {
+        const SEMIDIClockSenderScheduledEvent * event = &THIS->_eventIntake[tail & (kEventIntakeSize-1)];
+        int low = 0, high = THIS->_scheduledEventCount;
+        while ( low < high ) {
+            int middle = (low + high) / 2;
+            if ( events[middle].position <= event->position ) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
         }
+        memmove(&events[low+1], &events[low], (THIS->_scheduledEventCount - low) * sizeof(SEMIDIClockSenderScheduledEvent));
+        events[low] = *event;
+        THIS->_scheduledEventCount++;
+    }
+    __atomic_store_n(&THIS->_eventIntakeTail, tail, __ATOMIC_RELEASE);
+}
+
+static void SEMIDIClockSenderDropScheduledEventsBefore(__unsafe_unretained SEMIDIClockSender * THIS, double position) {
+    // Called with the lock held
+    int count = 0;
+    while ( count < THIS->_scheduledEventCount && THIS->_scheduledEvents[count].position < position ) {
+        count++;
+    }
+    THIS->_scheduledEventCount -= count;
+    memmove(&THIS->_scheduledEvents[0], &THIS->_scheduledEvents[count], THIS->_scheduledEventCount * sizeof(SEMIDIClockSenderScheduledEvent));
+}
+
+static uint64_t SEMIDIClockSenderTickTime(__unsafe_unretained SEMIDIClockSender * THIS,
+                                          const SEMIDIClockSenderTempoSchedule * schedule,
+                                          double position,
+                                          BOOL alongTempoCurve) {
+    // Called with the lock held. The time of the tick at a timeline position; both ticks and scheduled events
+    // are placed with this, so events land exactly on the ticks for the same position.
+    if ( alongTempoCurve ) {
+        return SEMIDIClockSenderTempoScheduleTimeAtPosition(schedule, position);
+    }
+    // At constant tempo, ticks are whole tick durations from the time base
+    return THIS->_timeBase + (int64_t)llround(position * SEMIDITicksPerBeat * THIS->_tickDuration);
+}
+
+static void SEMIDIClockSenderDispatchScheduledEvents(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t time, BOOL alongTempoCurve) {
+    // Called with the lock held. Sends scheduled events due before the given time, in one batch.
+    if ( !THIS->_started || !THIS->_timeBase || THIS->_scheduledEventCount == 0 ) {
+        return;
     }
     
-    MIDIPacketList * pendingMessages = _sender.pendingMessages;
+    SEMIDIClockSenderTempoSchedule schedule;
+    if ( alongTempoCurve ) {
+        schedule = SEMIDIClockSenderGetTempoSchedule(THIS);
+    }
+    
+    uint64_t now = SECurrentTimeInHostTicks();
+    uint64_t lateThreshold = __maxRenderCatchUpTime;
     
-    // Send messages for the time period from 'start', and up to (but not including) 'end'
     MIDIPacketList packetList;
-    uint8_t message = SEMIDIMessageClock;
-    uint64_t time = start;
+    MIDIPacket *packet = MIDIPacketListInit(&packetList);
     int count = 0;
-    for ( count = 0; time < end; count++, time += tickDuration ) {
-        // Dispatch pending messages
-        for ( int i=0; i<kMaxPendingMessages; i++ ) {
-            if ( pendingMessages[i].numPackets != 0 && pendingMessages[i].packet[0].timeStamp < time ) {
-                [_sender.senderInterface sendMIDIPacketList:&pendingMessages[i]];
-                pendingMessages[i].numPackets = 0;
-            }
+    for ( ; count < THIS->_scheduledEventCount; count++ ) {
+        const SEMIDIClockSenderScheduledEvent * event = &THIS->_scheduledEvents[count];
+        uint64_t eventTime = SEMIDIClockSenderTickTime(THIS, &schedule, MAX(0.0, event->position), alongTempoCurve);
+        if ( eventTime >= time ) {
+            break;
         }
-        
-        if ( time < start ) {
-            // Skip ticks we've already sent
+        if ( eventTime + lateThreshold < now ) {
+            // Missed, as with ticks; skip it rather than sending it late
             continue;
         }
         
+        MIDIPacket *added = MIDIPacketListAdd(&packetList, sizeof(packetList), packet, eventTime, event->length, event->data);
+        if ( !added ) {
+            // Packet list is full: send it, and start another
+            SEMIDIClockSenderSend(THIS, &packetList);
+            packet = MIDIPacketListInit(&packetList);
+            added = MIDIPacketListAdd(&packetList, sizeof(packetList), packet, eventTime, event->length, event->data);
+        }
+        packet = added;
+    }
+    
+    if ( packetList.numPackets > 0 ) {
+        SEMIDIClockSenderSend(THIS, &packetList);
+    }
+    
+    THIS->_scheduledEventCount -= count;
+    memmove(&THIS->_scheduledEvents[0], &THIS->_scheduledEvents[count], THIS->_scheduledEventCount * sizeof(SEMIDIClockSenderScheduledEvent));
+}
+
+static uint64_t SEMIDIClockSenderSendTicksAlongTempoCurve(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t start, uint64_t end) {
+    // Called with the lock held. Places each tick at the exact time the tempo curve reaches its position.
+    SEMIDIClockSenderTempoSchedule schedule = SEMIDIClockSenderGetTempoSchedule(THIS);
+    double tick = ceil(SEMIDIClockSenderTempoSchedulePositionAtTime(&schedule, start) * SEMIDITicksPerBeat - kTickPositionTolerance);
+    
+    MIDIPacketList packetList;
+    uint8_t message = SEMIDIMessageClock;
+    uint64_t time = SEMIDIClockSenderTickTime(THIS, &schedule, tick / SEMIDITicksPerBeat, YES);
+    while ( time < end ) {
+        SEMIDIClockSenderDispatchPendingMessages(THIS, time);
+        SEMIDIClockSenderDispatchScheduledEvents(THIS, time, YES);
+        
+        MIDIPacket *packet = MIDIPacketListInit(&packetList);
+        MIDIPacketListAdd(&packetList, sizeof(packetList), packet, time, 1, &message);
+        SEMIDIClockSenderSend(THIS, &packetList);
+        
+        tick++;
+        time = SEMIDIClockSenderTickTime(THIS, &schedule, tick / SEMIDITicksPerBeat, YES);
+    }
+    SEMIDIClockSenderDispatchScheduledEvents(THIS, end, YES);
+    
+    return time;
+}
+
+static uint64_t SEMIDIClockSenderSendTicks(__unsafe_unretained SEMIDIClockSender * THIS, uint64_t start, uint64_t end) {
+    // Called with the lock held. A zero start time dispatches due pending messages, without sending ticks.
+    if ( THIS->_tickDuration == 0 || start == 0 ) {
+        SEMIDIClockSenderDispatchPendingMessages(THIS, end);
+        return start;
+    }
+    
+    // Pick up newly scheduled events
+    SEMIDIClockSenderTakeScheduledEvents(THIS);
+    
+    // Fold in completed tempo changes, and follow the tempo curve while any are under way
+    SEMIDIClockSenderApplyTempoEvents(THIS, start, NO);
+    if ( THIS->_started && THIS->_timeBase && THIS->_tempoEventCount > 0 && THIS->_tempoEvents[0].startTime < end ) {
+        if ( THIS->_tempoEvents[0].startTime <= start ) {
+            // A ramp is under way: keep the published state following it
+            SEMIDIClockSenderPublishState(THIS);
+        }
+        return SEMIDIClockSenderSendTicksAlongTempoCurve(THIS, start, end);
+    }
+    
+    uint64_t tickDuration = THIS->_tickDuration;
+    if ( tickDuration == 0 ) {
+        SEMIDIClockSenderDispatchPendingMessages(THIS, end);
+        return start;
+    }
+    
+    // With a time base, resync to the closest tick, and place each tick the same way as events at its position
+    BOOL onTimeline = THIS->_timeBase != 0;
+    double tick = onTimeline ? round((double)(int64_t)(start - THIS->_timeBase) / (double)tickDuration) : 0.0;
+    
+    // Send messages for the time period from 'start', and up to (but not including) 'end'
+    MIDIPacketList packetList;
+    uint8_t message = SEMIDIMessageClock;
+    uint64_t time = onTimeline ? SEMIDIClockSenderTickTime(THIS, NULL, tick / SEMIDITicksPerBeat, NO) : start;
+    while ( time < end ) {
+        // Dispatch pending messages and scheduled events
+        SEMIDIClockSenderDispatchPendingMessages(THIS, time);
+        SEMIDIClockSenderDispatchScheduledEvents(THIS, time, NO);
+        
         // Send tick
         MIDIPacket *packet = MIDIPacketListInit(&packetList);
         MIDIPacketListAdd(&packetList, sizeof(packetList), packet, time, 1, &message);
-        [_sender.senderInterface sendMIDIPacketList:&packetList];
+        SEMIDIClockSenderSend(THIS, &packetList);
+        
+        tick++;
+        time = onTimeline ? SEMIDIClockSenderTickTime(THIS, NULL, tick / SEMIDITicksPerBeat, NO) : time + tickDuration;
     }
+    SEMIDIClockSenderDispatchScheduledEvents(THIS, end, NO);
     
     // Return the time the next tick should be sent
     return time;
 }
 
+static uint64_t SEMIDIClockSenderThreadSendTicks(__unsafe_unretained SEMIDIClockSender * THIS) {
+    // Called from the sender thread. Returns the time to next send, or zero if the lock was busy
+    if ( pthread_mutex_trylock(&THIS->_mutex) != 0 ) {
+        return 0;
+    }
+    
+    uint64_t now = SECurrentTimeInHostTicks();
+    uint64_t nextTickTime = THIS->_nextTickTime;
+    
+    if ( !nextTickTime ) {
+        nextTickTime = now;
+    }
+    
+    // Send the next batch of ticks
+    uint64_t tickDuration = THIS->_tickDuration;
+    uint64_t endTime = MAX(nextTickTime, now) + (tickDuration * kTicksPerSendInterval);
+    THIS->_nextTickTime = nextTickTime = SEMIDIClockSenderSendTicks(THIS, nextTickTime, endTime);
+    
+    pthread_mutex_unlock(&THIS->_mutex);
+    
+    // Wait half the duration of the ticks we just sent (to avoid running out of time; we'll skip the ticks we've already sent)
+    return MAX(1, nextTickTime - (tickDuration * kTicksPerSendInterval) / 2);
+}
+
+static void SEMIDIClockSenderThreadFinished(__unsafe_unretained SEMIDIClockSender * THIS) {
+    SEMIDIClockSenderLock(THIS);
+    THIS->_nextTickTime = 0;
+    SEMIDIClockSenderUnlock(THIS);
+    
+    // Last access: the sender may now be deallocated
+    __atomic_sub_fetch(&THIS->_threadCount, 1, __ATOMIC_RELEASE);
+}
+
+@end
+
+@implementation SEMIDIClockSenderThread {
+    __unsafe_unretained SEMIDIClockSender * _sender; // Kept alive until we finish, by the sender's thread count
+    int _cancelled;
+}
+
+-(instancetype)initWithSender:(SEMIDIClockSender *)sender {
+    if ( !(self = [super init]) ) return nil;
+    _sender = sender;
+    return self;
+}
+
+-(void)cancel {
+    __atomic_store_n(&_cancelled, 1, __ATOMIC_RELEASE);
+    [super cancel];
+}
+
+-(void)main {
+    [NSThread setThreadPriority:kThreadPriority];
+    
+    // Plain C from here on: no messaging, and no blocking on the lock, until we're cancelled
+    __unsafe_unretained SEMIDIClockSender * sender = _sender;
+    while ( !__atomic_load_n(&_cancelled, __ATOMIC_ACQUIRE) ) {
+        uint64_t nextSendTime = SEMIDIClockSenderThreadSendTicks(sender);
+        if ( !nextSendTime ) {
+            // The main thread is making changes; try again shortly
+            nextSendTime = SECurrentTimeInHostTicks() + SESecondsToHostTicks(kLockRetryInterval);
+        }
+        
+        // Sleep
+        mach_wait_until(nextSendTime);
+    }
+    
+    SEMIDIClockSenderThreadFinished(sender);
+}
+
 @end
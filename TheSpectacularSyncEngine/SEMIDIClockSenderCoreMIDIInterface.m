@@ -11,10 +11,14 @@
 #import "SEMIDIEndpoint.h"
 
 static void * kNetworkContactsChanged = &kNetworkContactsChanged;
+static const int kMaxSendEndpoints = 64; // Max number of destination endpoints to send to
 
 @interface SEMIDIClockSenderCoreMIDIInterface () {
     MIDIClientRef _midiClient;
     BOOL _portsAreOurs;
+    MIDIEndpointRef _sendEndpoints[kMaxSendEndpoints];
+    int _sendEndpointCount;
+    uint32_t _sendEndpointSequence;
 }
 @property (nonatomic, readwrite) MIDIPortRef outputPort;
 @property (nonatomic, readwrite) MIDIEndpointRef virtualSource;
@@ -129,24 +133,40 @@ static void * kNetworkContactsChanged = &kNetworkContactsChanged;
 }
 
 -(void)sendMIDIPacketList:(const MIDIPacketList *)packetList {
-    if ( _virtualSource ) {
-        SECheckResult(MIDIReceived(_virtualSource, packetList), "MIDISend");
+    SEMIDIClockSenderCoreMIDIInterfaceSend((__bridge void*)self, packetList);
+}
+
+-(SEMIDIClockSenderSendCallback)sendCallbackWithContext:(void **)context {
+    *context = (__bridge void*)self;
+    return SEMIDIClockSenderCoreMIDIInterfaceSend;
+}
+
+static void SEMIDIClockSenderCoreMIDIInterfaceSend(void * context, const MIDIPacketList * packetList) {
+    __unsafe_unretained SEMIDIClockSenderCoreMIDIInterface * THIS = (__bridge SEMIDIClockSenderCoreMIDIInterface*)context;
+    
+    if ( THIS->_virtualSource ) {
+        SECheckResult(MIDIReceived(THIS->_virtualSource, packetList), "MIDISend");
     }
-    @synchronized ( _destinations ) {
-        BOOL alreadySentToNetworkEndpoint = NO;
-        for ( SEMIDIEndpoint * destination in _destinations ) {
-            
-            // If we're connected to two network destinations, be sure to only sent to the network endpoint once
-            if ( [destination isKindOfClass:[SEMIDINetworkEndpoint class]] ) {
-                if ( alreadySentToNetworkEndpoint) {
-                    continue;
-                }
-                alreadySentToNetworkEndpoint = YES;
-            }
-            
-            SECheckResult(MIDISend(_outputPort, destination.endpoint, packetList), "MIDISend");
+    
+    // Take a consistent copy of the endpoints without locking, retrying if it overlaps an update
+    MIDIEndpointRef endpoints[kMaxSendEndpoints];
+    int endpointCount;
+    while ( 1 ) {
+        uint32_t sequence = __atomic_load_n(&THIS->_sendEndpointSequence, __ATOMIC_ACQUIRE);
+        if ( sequence & 1 ) {
+            continue;
+        }
+        endpointCount = MIN(MAX(THIS->_sendEndpointCount, 0), kMaxSendEndpoints);
+        memcpy(endpoints, THIS->_sendEndpoints, endpointCount * sizeof(MIDIEndpointRef));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&THIS->_sendEndpointSequence, __ATOMIC_RELAXED) == sequence ) {
+            break;
         }
     }
+    
+    for ( int i=0; i<endpointCount; i++ ) {
+        SECheckResult(MIDISend(THIS->_outputPort, endpoints[i], packetList), "MIDISend");
+    }
 }
 
 -(void)setDestinations:(NSArray *)destinations {
@@ -162,6 +182,8 @@ static void * kNetworkContactsChanged = &kNetworkContactsChanged;
         _destinations = [destinations copy];
     }
     
+    [self updateSendEndpoints];
+    
     if ( _destinations ) {
         for ( SEMIDIEndpoint * destination in _destinations ) {
             [destination connect];
@@ -202,6 +224,37 @@ static void * kNetworkContactsChanged = &kNetworkContactsChanged;
     return array;
 }
 
+-(void)updateSendEndpoints {
+    // Gather the endpoints to send to, so that sending needn't touch the destination objects
+    MIDIEndpointRef endpoints[kMaxSendEndpoints];
+    int endpointCount = 0;
+    BOOL alreadySentToNetworkEndpoint = NO;
+    for ( SEMIDIEndpoint * destination in _destinations ) {
+        
+        // If we're connected to two network destinations, be sure to only sent to the network endpoint once
+        if ( [destination isKindOfClass:[SEMIDINetworkEndpoint class]] ) {
+            if ( alreadySentToNetworkEndpoint) {
+                continue;
+            }
+            alreadySentToNetworkEndpoint = YES;
+        }
+        
+        if ( endpointCount == kMaxSendEndpoints ) {
+            break;
+        }
+        endpoints[endpointCount++] = destination.endpoint;
+    }
+    
+    @synchronized ( self ) {
+        // Publish for the send callback: an odd sequence number marks an update in progress
+        __atomic_store_n(&_sendEndpointSequence, _sendEndpointSequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memcpy(_sendEndpoints, endpoints, endpointCount * sizeof(MIDIEndpointRef));
+        _sendEndpointCount = endpointCount;
+        __atomic_store_n(&_sendEndpointSequence, _sendEndpointSequence + 1, __ATOMIC_RELEASE);
+    }
+}
+
 static void midiNotify(const MIDINotification * message, void * inRefCon) {
     SEMIDIClockSenderCoreMIDIInterface * THIS = (__bridge SEMIDIClockSenderCoreMIDIInterface*)inRefCon;
     
@@ -0,0 +1,120 @@
+//
+//  SEMIDIClockSenderLoopbackInterface.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import "SEMIDIClockSender.h"
+#import "SEMIDIClockReceiver.h"
+
+/*!
+ * Jitter distributions
+ */
+typedef enum {
+    SEMIDIClockLoopbackJitterGaussian,      //!< Normally-distributed jitter, with the jitter value as standard deviation
+    SEMIDIClockLoopbackJitterHeavyTailed    //!< Student's t-distributed jitter (3 degrees of freedom), with the jitter value as scale; occasional large outliers
+} SEMIDIClockLoopbackJitterDistribution;
+
+/*!
+ * In-process loopback interface for SEMIDIClockSender
+ *
+ *  This class delivers a sender's packet lists straight into one or more
+ *  SEMIDIClockReceiver instances, without Core MIDI, while simulating an
+ *  imperfect transport. Use it to test and benchmark sync end to end.
+ *
+ *  Each packet is given an arrival time: its timestamp, plus the latency, plus
+ *  random jitter (never arriving before it was sent). Arrival times may then be
+ *  rounded up to the bunching interval, as when a driver delivers messages in
+ *  batches. Clock ticks may be dropped, or delivered after the tick that follows
+ *  them. Packets are delivered to the receivers immediately, stamped with their
+ *  arrival times.
+ *
+ *  Transport messages (start, stop, continue and song position) are never dropped
+ *  or reordered, so that each simulated session remains meaningful.
+ *
+ *  Random values are drawn from a generator seeded with the randomSeed property,
+ *  so that a given configuration and seed always produce the same results. You can
+ *  also call sendMIDIPacketList: yourself, to simulate a sender with an ideal timeline.
+ */
+@interface SEMIDIClockSenderLoopbackInterface : NSObject <SEMIDIClockSenderInterface>
+
+/*!
+ * Initialise
+ *
+ * @param receivers The receivers to deliver to, an array of SEMIDIClockReceiver
+ */
+-(instancetype)initWithReceivers:(NSArray*)receivers;
+
+/*!
+ * Deliver any clock tick held back for reordering
+ */
+-(void)flush;
+
+/*!
+ * The receivers to deliver to, an array of SEMIDIClockReceiver
+ */
+@property (nonatomic, strong) NSArray * receivers;
+
+/*!
+ * Constant latency, in seconds (default 0)
+ */
+@property (nonatomic) NSTimeInterval latency;
+
+/*!
+ * Jitter, in seconds (default 0)
+ *
+ *  The standard deviation (Gaussian) or scale (heavy-tailed) of the random
+ *  variation in latency.
+ */
+@property (nonatomic) NSTimeInterval jitter;
+
+/*!
+ * Jitter distribution (default SEMIDIClockLoopbackJitterGaussian)
+ */
+@property (nonatomic) SEMIDIClockLoopbackJitterDistribution jitterDistribution;
+
+/*!
+ * Bunching interval, in seconds (default 0, for no bunching)
+ *
+ *  Arrival times are rounded up to a multiple of this interval.
+ */
+@property (nonatomic) NSTimeInterval bunchingInterval;
+
+/*!
+ * Probability of dropping a clock tick, from 0 to 1 (default 0)
+ */
+@property (nonatomic) double dropProbability;
+
+/*!
+ * Probability of delivering a clock tick after the following one, from 0 to 1 (default 0)
+ */
+@property (nonatomic) double reorderProbability;
+
+/*!
+ * Random seed (default 1)
+ *
+ *  Setting this property restarts the random sequence.
+ */
+@property (nonatomic) uint64_t randomSeed;
+
+/*!
+ * Number of clock ticks dropped so far
+ */
+@property (nonatomic, readonly) NSUInteger droppedPacketCount;
+
+/*!
+ * Number of clock ticks delivered out of order so far
+ */
+@property (nonatomic, readonly) NSUInteger reorderedPacketCount;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+//
+//  SEMIDIClockSenderLoopbackInterface.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEMIDIClockSenderLoopbackInterface.h"
+#import "SECommon.h"
+
+static const uint64_t kDefaultRandomSeed             = 1;
+static const int kHeavyTailDegreesOfFreedom          = 3;      // Degrees of freedom for the heavy-tailed (Student's t) jitter distribution
+
+@interface SEMIDIClockSenderLoopbackInterface () {
+    uint64_t _randomState;
+    MIDIPacketList _heldPacketList;
+    BOOL _holdingPacket;
+}
+@property (nonatomic, readwrite) NSUInteger droppedPacketCount;
+@property (nonatomic, readwrite) NSUInteger reorderedPacketCount;
+@end
+
+@implementation SEMIDIClockSenderLoopbackInterface
+
+-(instancetype)initWithReceivers:(NSArray *)receivers {
+    if ( !(self = [super init]) ) return nil;
+    
+    self.receivers = receivers;
+    self.randomSeed = kDefaultRandomSeed;
+    
+    return self;
+}
+
+-(void)setRandomSeed:(uint64_t)randomSeed {
+    _randomSeed = randomSeed;
+    _randomState = randomSeed ? randomSeed : kDefaultRandomSeed;
+}
+
+-(void)sendMIDIPacketList:(const MIDIPacketList *)packetList {
+    const MIDIPacket *packet = &packetList->packet[0];
+    for ( int index = 0; index < packetList->numPackets; index++, packet = MIDIPacketNext(packet) ) {
+        if ( packet->length == 0 ) {
+            continue;
+        }
+        
+        if ( packet->data[0] == SEMIDIMessageClock && _dropProbability > 0.0 && [self randomUniform] < _dropProbability ) {
+            _droppedPacketCount++;
+            continue;
+        }
+        
+        MIDIPacketList deliveredPacketList;
+        MIDIPacket *deliveredPacket = MIDIPacketListInit(&deliveredPacketList);
+        MIDIPacketListAdd(&deliveredPacketList, sizeof(deliveredPacketList), deliveredPacket,
+                          [self arrivalTimeForTimestamp:packet->timeStamp ? packet->timeStamp : SECurrentTimeInHostTicks()],
+                          packet->length, packet->data);
+        
+        BOOL isClockTick = packet->data[0] == SEMIDIMessageClock;
+        if ( _holdingPacket ) {
+            if ( isClockTick ) {
+                // Deliver this tick ahead of the one we held back
+                [self deliverPacketList:&deliveredPacketList];
+                [self flush];
+            } else {
+                // Transport messages stay in order
+                [self flush];
+                [self deliverPacketList:&deliveredPacketList];
+            }
+        } else if ( isClockTick && _reorderProbability > 0.0 && [self randomUniform] < _reorderProbability ) {
+            // Hold this tick back until after the next one
+            _heldPacketList = deliveredPacketList;
+            _holdingPacket = YES;
+            _reorderedPacketCount++;
+        } else {
+            [self deliverPacketList:&deliveredPacketList];
+        }
+    }
+}
+
+-(void)flush {
+    if ( _holdingPacket ) {
+        _holdingPacket = NO;
+        [self deliverPacketList:&_heldPacketList];
+    }
+}
+
+-(void)deliverPacketList:(const MIDIPacketList *)packetList {
+    for ( SEMIDIClockReceiver * receiver in _receivers ) {
+        SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+    }
+}
+
+-(uint64_t)arrivalTimeForTimestamp:(uint64_t)timestamp {
+    double delay = _latency;
+    
+    if ( _jitter > 0.0 ) {
+        switch ( _jitterDistribution ) {
+            case SEMIDIClockLoopbackJitterGaussian:
+                delay += _jitter * [self randomGaussian];
+                break;
+            case SEMIDIClockLoopbackJitterHeavyTailed: {
+                double chiSquared = 0.0;
+                for ( int i=0; i<kHeavyTailDegreesOfFreedom; i++ ) {
+                    double value = [self randomGaussian];
+                    chiSquared += value * value;
+                }
+                delay += _jitter * [self randomGaussian] / sqrt(chiSquared / kHeavyTailDegreesOfFreedom);
+                break;
+            }
+        }
+    }
+    
+    // Never arrive before we were sent
+    uint64_t arrivalTime = timestamp + SESecondsToHostTicks(MAX(0.0, delay));
+    
+    if ( _bunchingInterval > 0.0 ) {
+        uint64_t interval = SESecondsToHostTicks(_bunchingInterval);
+        arrivalTime = ((arrivalTime + interval - 1) / interval) * interval;
+    }
+    
+    return arrivalTime;
+}
+
+-(double)randomUniform {
+    // xorshift64*, giving a double in [0, 1)
+    _randomState ^= _randomState >> 12;
+    _randomState ^= _randomState << 25;
+    _randomState ^= _randomState >> 27;
+    return ((_randomState * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+-(double)randomGaussian {
+    // Box-Muller transform
+    double u1 = 1.0 - [self randomUniform];
+    double u2 = [self randomUniform];
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+@end
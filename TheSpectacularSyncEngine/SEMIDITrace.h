@@ -0,0 +1,167 @@
+//
+//  SEMIDITrace.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import <CoreMIDI/CoreMIDI.h>
+#import "SEMIDIClockReceiver.h"
+
+/*!
+ * MIDI trace recorder
+ *
+ *  This class records incoming MIDI messages, with their timestamps, into a compact,
+ *  append-only binary trace file, so that a misbehaving stream can be replayed
+ *  exactly later on with SEMIDITracePlayer.
+ *
+ *  To record everything a receiver sees, assign a recorder to the receiver's
+ *  traceRecorder property. Otherwise, pass messages in yourself with
+ *  SEMIDITraceRecorderRecordMessage or SEMIDITraceRecorderRecordPacketList.
+ *
+ *  Recording does not allocate memory or block: messages are written into a
+ *  preallocated ring buffer, which is drained to disk on a background queue. If
+ *  the ring buffer fills up, messages are dropped and counted in droppedMessageCount.
+ *
+ *  Trace format, all values little-endian: a 16-byte header consisting of the
+ *  characters "SEMT", a 32-bit version number, and the 32-bit numerator and denominator
+ *  of the recording host's timebase; followed by one record per message, consisting of
+ *  a 64-bit timestamp in host ticks, a 16-bit length, then the message bytes.
+ */
+@interface SEMIDITraceRecorder : NSObject
+
+/*!
+ * Initialise, and start recording
+ *
+ * @param path Path of the trace file to create; any existing file is replaced
+ * @return The recorder, or nil if the file couldn't be created
+ */
+-(instancetype)initWithPath:(NSString*)path;
+
+/*!
+ * Record a MIDI message
+ *
+ *  Use this C function from the MIDI thread. Should only be called from one thread
+ *  at a time.
+ *
+ * @param recorder The recorder
+ * @param timestamp The message timestamp, in host ticks
+ * @param data The message bytes
+ * @param length The number of bytes
+ */
+void SEMIDITraceRecorderRecordMessage(__unsafe_unretained SEMIDITraceRecorder * recorder, uint64_t timestamp, const uint8_t * data, uint16_t length);
+
+/*!
+ * Record a packet list
+ *
+ *  Records each packet in the list as a message. Packets without a timestamp
+ *  are recorded with the current time.
+ *
+ * @param recorder The recorder
+ * @param packetList The incoming MIDI packet list
+ */
+void SEMIDITraceRecorderRecordPacketList(__unsafe_unretained SEMIDITraceRecorder * recorder, const MIDIPacketList * packetList);
+
+/*!
+ * Stop recording
+ *
+ *  Writes out any remaining messages and closes the file. Called automatically
+ *  when the recorder is released.
+ */
+-(void)finish;
+
+/*!
+ * The trace file path
+ */
+@property (nonatomic, strong, readonly) NSString * path;
+
+/*!
+ * Number of messages dropped because the ring buffer was full
+ */
+@property (nonatomic, readonly) NSUInteger droppedMessageCount;
+
+@end
+
+/*!
+ * Output handler for trace replay
+ *
+ * @param timestamp The timestamp of the message just replayed, as recorded in the trace
+ * @param tempo The receiver's tempo after the message
+ * @param timelinePosition The receiver's timeline position at the time of the message
+ */
+typedef void (^SEMIDITracePlayerOutputHandler)(uint64_t timestamp, double tempo, double timelinePosition);
+
+/*!
+ * Message handler for SEMIDITracePlayer enumeration
+ *
+ * @param timestamp The message's timestamp, in this host's timebase
+ * @param message The message bytes
+ * @param length The message length
+ */
+typedef void (^SEMIDITracePlayerMessageHandler)(uint64_t timestamp, const uint8_t * message, uint16_t length);
+
+/*!
+ * MIDI trace player
+ *
+ *  This class memory-maps a trace recorded with SEMIDITraceRecorder and feeds its
+ *  messages into a receiver via SEMIDIClockReceiverReceivePacketList.
+ *
+ *  Replay may run in real time, with messages delivered at their recorded intervals,
+ *  or as fast as possible. The receiver's tempo and timeline output depends only on
+ *  the message timestamps, so it is identical in both modes, and from one build to
+ *  the next; this lets field traces serve as regression tests.
+ */
+@interface SEMIDITracePlayer : NSObject
+
+/*!
+ * Initialise
+ *
+ * @param path Path of the trace file
+ * @return The player, or nil if the file couldn't be opened or isn't a valid trace
+ */
+-(instancetype)initWithPath:(NSString*)path;
+
+/*!
+ * Replay the trace into a receiver
+ *
+ *  Blocks until the whole trace has been replayed; in real time mode, run it on a
+ *  background thread, as you would a MIDI thread.
+ *
+ *  In real time mode, timestamps are moved forward by a whole number of seconds, to start
+ *  within a second of the current time. Otherwise, recorded timestamps are passed through
+ *  unchanged. Either way, they are converted to this host's timebase if the trace was
+ *  recorded on a host with a different one.
+ *
+ * @param receiver The receiver
+ * @param realTime Whether to replay in real time, or as fast as possible
+ * @param outputHandler Block to call after each message, or nil
+ */
+-(void)replayIntoReceiver:(SEMIDIClockReceiver*)receiver realTime:(BOOL)realTime outputHandler:(SEMIDITracePlayerOutputHandler)outputHandler;
+
+/*!
+ * Enumerate the trace's messages
+ *
+ *  Passes each message to the block in order, without a receiver, with timestamps
+ *  as a fast replay would give them: converted to this host's timebase if the trace
+ *  was recorded on a host with a different one.
+ *
+ * @param block Block to call for each message
+ */
+-(void)enumerateMessagesWithBlock:(SEMIDITracePlayerMessageHandler)block;
+
+/*!
+ * Number of messages in the trace
+ */
+@property (nonatomic, readonly) NSUInteger messageCount;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
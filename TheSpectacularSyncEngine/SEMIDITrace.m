@@ -0,0 +1,326 @@
+//
+//  SEMIDITrace.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEMIDITrace.h"
+#import "SECommon.h"
+#import <libkern/OSAtomic.h>
+#import <libkern/OSByteOrder.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+static const char kTraceMagic[4]                     = { 'S', 'E', 'M', 'T' };
+static const uint32_t kTraceVersion                  = 1;
+static const size_t kTraceHeaderSize                 = 16;     // Magic, version, timebase numerator and denominator
+static const size_t kTraceRecordHeaderSize           = 10;     // Timestamp and length
+static const uint32_t kRingBufferSize                = 1 << 18; // Size of the recording ring buffer, in bytes; must be a power of two
+static const NSTimeInterval kWriteInterval           = 0.1;    // How often to drain the ring buffer to disk
+static const NSTimeInterval kRealTimeReplayLead      = 0.01;   // Delay before the first message, when replaying in real time
+
+@interface SEMIDITraceRecorder () {
+    FILE * _file;
+    uint8_t * _ring;
+    volatile uint32_t _head;
+    volatile uint32_t _tail;
+    volatile BOOL _recording;
+}
+@property (nonatomic, strong, readwrite) NSString * path;
+@property (nonatomic, readwrite) NSUInteger droppedMessageCount;
+@property (nonatomic, strong) dispatch_queue_t writerQueue;
+@property (nonatomic, strong) dispatch_source_t writerTimer;
+@end
+
+@implementation SEMIDITraceRecorder
+
+-(instancetype)initWithPath:(NSString *)path {
+    if ( !(self = [super init]) ) return nil;
+    
+    _file = fopen(path.fileSystemRepresentation, "wb");
+    if ( !_file ) {
+        NSLog(@"Couldn't create MIDI trace file %@: %s", path, strerror(errno));
+        return nil;
+    }
+    
+    // Write header
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    uint32_t header[3] = { OSSwapHostToLittleInt32(kTraceVersion), OSSwapHostToLittleInt32(timebase.numer), OSSwapHostToLittleInt32(timebase.denom) };
+    if ( fwrite(kTraceMagic, sizeof(kTraceMagic), 1, _file) != 1 || fwrite(header, sizeof(header), 1, _file) != 1 ) {
+        NSLog(@"Couldn't write MIDI trace file %@: %s", path, strerror(errno));
+        fclose(_file);
+        _file = NULL;
+        return nil;
+    }
+    
+    self.path = path;
+    _ring = malloc(kRingBufferSize);
+    
+    // Drain the ring buffer to disk periodically, on a background queue
+    self.writerQueue = dispatch_queue_create("com.atastypixel.SEMIDITraceRecorder", DISPATCH_QUEUE_SERIAL);
+    self.writerTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _writerQueue);
+    dispatch_source_set_timer(_writerTimer, DISPATCH_TIME_NOW, kWriteInterval * NSEC_PER_SEC, kWriteInterval * NSEC_PER_SEC / 10);
+    __weak SEMIDITraceRecorder * weakSelf = self;
+    dispatch_source_set_event_handler(_writerTimer, ^{
+        [weakSelf drain];
+    });
+    dispatch_resume(_writerTimer);
+    
+    OSMemoryBarrier();
+    _recording = YES;
+    
+    return self;
+}
+
+-(void)dealloc {
+    [self finish];
+    free(_ring);
+}
+
+static void SEMIDITraceRecorderWriteToRing(__unsafe_unretained SEMIDITraceRecorder * THIS, uint32_t position, const void * bytes, uint32_t length) {
+    uint32_t offset = position & (kRingBufferSize-1);
+    uint32_t firstChunk = MIN(length, kRingBufferSize - offset);
+    memcpy(THIS->_ring + offset, bytes, firstChunk);
+    if ( firstChunk < length ) {
+        memcpy(THIS->_ring, (const uint8_t*)bytes + firstChunk, length - firstChunk);
+    }
+}
+
+void SEMIDITraceRecorderRecordMessage(__unsafe_unretained SEMIDITraceRecorder * THIS, uint64_t timestamp, const uint8_t * data, uint16_t length) {
+    if ( !THIS->_recording ) {
+        return;
+    }
+    
+    uint32_t head = THIS->_head;
+    uint32_t size = (uint32_t)kTraceRecordHeaderSize + length;
+    if ( kRingBufferSize - (head - THIS->_tail) < size ) {
+        // No room - drop this message
+        THIS->_droppedMessageCount++;
+        return;
+    }
+    
+    uint64_t littleEndianTimestamp = OSSwapHostToLittleInt64(timestamp);
+    uint16_t littleEndianLength = OSSwapHostToLittleInt16(length);
+    SEMIDITraceRecorderWriteToRing(THIS, head, &littleEndianTimestamp, sizeof(littleEndianTimestamp));
+    SEMIDITraceRecorderWriteToRing(THIS, head + sizeof(littleEndianTimestamp), &littleEndianLength, sizeof(littleEndianLength));
+    SEMIDITraceRecorderWriteToRing(THIS, head + (uint32_t)kTraceRecordHeaderSize, data, length);
+    
+    // Ensure the record is complete before the writer can see it
+    OSMemoryBarrier();
+    THIS->_head = head + size;
+}
+
+void SEMIDITraceRecorderRecordPacketList(__unsafe_unretained SEMIDITraceRecorder * recorder, const MIDIPacketList * packetList) {
+    const MIDIPacket *packet = &packetList->packet[0];
+    for ( int index = 0; index < packetList->numPackets; index++, packet = MIDIPacketNext(packet) ) {
+        SEMIDITraceRecorderRecordMessage(recorder, packet->timeStamp ? packet->timeStamp : SECurrentTimeInHostTicks(), packet->data, packet->length);
+    }
+}
+
+-(void)drain {
+    if ( !_file ) {
+        return;
+    }
+    
+    uint32_t tail = _tail;
+    uint32_t head = _head;
+    OSMemoryBarrier();
+    
+    while ( tail != head ) {
+        uint32_t offset = tail & (kRingBufferSize-1);
+        uint32_t chunk = MIN(head - tail, kRingBufferSize - offset);
+        if ( fwrite(_ring + offset, 1, chunk, _file) != chunk ) {
+            NSLog(@"Couldn't write MIDI trace file %@: %s", _path, strerror(errno));
+        }
+        tail += chunk;
+    }
+    fflush(_file);
+    
+    // Ensure we're done with the data before the recorder can reuse the space
+    OSMemoryBarrier();
+    _tail = tail;
+}
+
+-(void)finish {
+    if ( !_file ) {
+        return;
+    }
+    
+    _recording = NO;
+    
+    // Stop the writer and wait for any drain in progress, then write out the rest ourselves
+    dispatch_source_cancel(_writerTimer);
+    dispatch_sync(_writerQueue, ^{});
+    [self drain];
+    
+    fclose(_file);
+    _file = NULL;
+}
+
+@end
+
+// Trace records are packed, so read values bytewise to avoid unaligned access
+static uint16_t SEMIDITraceReadUInt16(const uint8_t * bytes) {
+    uint16_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return OSSwapLittleToHostInt16(value);
+}
+
+static uint32_t SEMIDITraceReadUInt32(const uint8_t * bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return OSSwapLittleToHostInt32(value);
+}
+
+static uint64_t SEMIDITraceReadUInt64(const uint8_t * bytes) {
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return OSSwapLittleToHostInt64(value);
+}
+
+@interface SEMIDITracePlayer () {
+    const uint8_t * _data;
+    size_t _length;
+    uint32_t _timebaseNumerator;
+    uint32_t _timebaseDenominator;
+}
+@property (nonatomic, readwrite) NSUInteger messageCount;
+@end
+
+@implementation SEMIDITracePlayer
+
+-(instancetype)initWithPath:(NSString *)path {
+    if ( !(self = [super init]) ) return nil;
+    
+    int fd = open(path.fileSystemRepresentation, O_RDONLY);
+    if ( fd == -1 ) {
+        NSLog(@"Couldn't open MIDI trace file %@: %s", path, strerror(errno));
+        return nil;
+    }
+    
+    struct stat info;
+    if ( fstat(fd, &info) != 0 || info.st_size < kTraceHeaderSize ) {
+        NSLog(@"MIDI trace file %@ is invalid", path);
+        close(fd);
+        return nil;
+    }
+    
+    void * data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( data == MAP_FAILED ) {
+        NSLog(@"Couldn't map MIDI trace file %@: %s", path, strerror(errno));
+        return nil;
+    }
+    
+    _data = data;
+    _length = info.st_size;
+    
+    uint32_t version = SEMIDITraceReadUInt32(_data + 4);
+    if ( memcmp(_data, kTraceMagic, sizeof(kTraceMagic)) != 0 || version != kTraceVersion ) {
+        NSLog(@"MIDI trace file %@ is invalid", path);
+        return nil;
+    }
+    
+    _timebaseNumerator = SEMIDITraceReadUInt32(_data + 8);
+    _timebaseDenominator = SEMIDITraceReadUInt32(_data + 12);
+    if ( !_timebaseNumerator || !_timebaseDenominator ) {
+        NSLog(@"MIDI trace file %@ is invalid", path);
+        return nil;
+    }
+    
+    // Count messages, ignoring any incomplete record at the end
+    NSUInteger count = 0;
+    for ( size_t offset = kTraceHeaderSize; offset + kTraceRecordHeaderSize <= _length; count++ ) {
+        size_t recordLength = kTraceRecordHeaderSize + SEMIDITraceReadUInt16(_data + offset + 8);
+        if ( offset + recordLength > _length ) break;
+        offset += recordLength;
+    }
+    _messageCount = count;
+    
+    return self;
+}
+
+-(void)dealloc {
+    if ( _data ) {
+        munmap((void*)_data, _length);
+    }
+}
+
+-(void)replayIntoReceiver:(SEMIDIClockReceiver *)receiver realTime:(BOOL)realTime outputHandler:(SEMIDITracePlayerOutputHandler)outputHandler {
+    if ( _messageCount == 0 ) {
+        return;
+    }
+    
+    uint64_t replayStart = SEMIDITraceReadUInt64(_data + kTraceHeaderSize);
+    if ( realTime ) {
+        // Move the trace to the present by a whole number of seconds: the receiver keeps its tempo
+        // history in one-second buckets of absolute time, so this keeps output identical to a fast replay
+        uint64_t second = SESecondsToHostTicks(1.0);
+        uint64_t earliestStart = SECurrentTimeInHostTicks() + SESecondsToHostTicks(kRealTimeReplayLead);
+        if ( earliestStart > replayStart ) {
+            replayStart += ((earliestStart - replayStart + second - 1) / second) * second;
+        }
+    }
+    
+    char packetListSpace[sizeof(MIDIPacketList)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    size_t packetListSize = sizeof(packetListSpace);
+    
+    [self enumerateMessagesFromTime:replayStart block:^(uint64_t timestamp, uint64_t replayTime, const uint8_t * message, uint16_t length) {
+        if ( realTime ) {
+            mach_wait_until(replayTime);
+        }
+        
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        MIDIPacketListAdd(packetList, packetListSize, packet, replayTime, MIN(length, sizeof(packet->data)), message);
+        SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+        
+        if ( outputHandler ) {
+            outputHandler(timestamp, SEMIDIClockReceiverGetTempo(receiver), SEMIDIClockReceiverGetTimelinePosition(receiver, replayTime));
+        }
+    }];
+}
+
+-(void)enumerateMessagesWithBlock:(SEMIDITracePlayerMessageHandler)block {
+    if ( _messageCount == 0 ) {
+        return;
+    }
+    
+    [self enumerateMessagesFromTime:SEMIDITraceReadUInt64(_data + kTraceHeaderSize)
+                              block:^(uint64_t timestamp, uint64_t replayTime, const uint8_t * message, uint16_t length) {
+        block(replayTime, message, length);
+    }];
+}
+
+-(void)enumerateMessagesFromTime:(uint64_t)replayStart
+                           block:(void (^)(uint64_t timestamp, uint64_t replayTime, const uint8_t * message, uint16_t length))block {
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    BOOL convertTimebase = timebase.numer != _timebaseNumerator || timebase.denom != _timebaseDenominator;
+    
+    // Work relative to the first message, to keep timebase conversion within range
+    uint64_t traceStart = SEMIDITraceReadUInt64(_data + kTraceHeaderSize);
+    
+    size_t offset = kTraceHeaderSize;
+    for ( NSUInteger i=0; i<_messageCount; i++ ) {
+        uint64_t timestamp = SEMIDITraceReadUInt64(_data + offset);
+        uint16_t length = SEMIDITraceReadUInt16(_data + offset + 8);
+        const uint8_t * message = _data + offset + kTraceRecordHeaderSize;
+        offset += kTraceRecordHeaderSize + length;
+        
+        // Map the timestamp into this host's timebase and our replay time
+        uint64_t interval = timestamp >= traceStart ? timestamp - traceStart : 0;
+        if ( convertTimebase ) {
+            interval = ((interval * _timebaseNumerator) / _timebaseDenominator) * timebase.denom / timebase.numer;
+        }
+        
+        block(timestamp, replayStart + interval, message, length);
+    }
+}
+
+@end
@@ -0,0 +1,172 @@
+//
+//  SEPeerSession.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import "SECommon.h"
+
+extern NSString * const SEPeerSessionDidChangeStateNotification;   ///< Notification sent on main thread when a peer changed tempo, transport or position
+extern NSString * const SEPeerSessionDidChangePeersNotification;   ///< Notification sent on main thread when a peer joined or left
+
+/*!
+ * Peer-to-peer tempo and phase session
+ *
+ *  This class shares a timeline with other instances of the engine over UDP, either
+ *  via a multicast group or with a list of unicast peers, on the local machine or
+ *  across a network.
+ *
+ *  Rather than sending clock ticks, peers exchange the timeline's parameters - tempo,
+ *  time base, position and transport state - whenever they change, along with
+ *  regular clock offset measurements. Each peer then derives the shared timeline
+ *  locally, from these parameters, so network jitter never enters the tempo, and
+ *  only a few packets per second are needed.
+ *
+ *  Any peer may change the tempo, start, stop or seek; the most recent change wins.
+ *
+ *  To use it, create an instance with a port and either a multicast group or, via
+ *  addPeerWithHost:port:, a list of peers. Then use the C functions to follow the
+ *  shared timeline from the realtime audio thread, and the Objective-C interface to
+ *  change it.
+ */
+@interface SEPeerSession : NSObject
+
+/*!
+ * Initialise with a multicast group
+ *
+ *  All peers using the same group and port join the same session.
+ *
+ * @param group The multicast group address, such as "239.255.83.69"
+ * @param port The UDP port
+ * @return The session, or nil if the socket couldn't be opened
+ */
+-(instancetype)initWithMulticastGroup:(NSString*)group port:(uint16_t)port;
+
+/*!
+ * Initialise for unicast
+ *
+ *  The session listens on the given port; use addPeerWithHost:port: to add the
+ *  other peers' addresses.
+ *
+ * @param port The UDP port to listen on
+ * @return The session, or nil if the socket couldn't be opened
+ */
+-(instancetype)initWithPort:(uint16_t)port;
+
+/*!
+ * Add a unicast peer
+ *
+ * @param host The peer's IPv4 address, such as "127.0.0.1"
+ * @param port The peer's UDP port
+ * @return YES on success, NO if the address is invalid
+ */
+-(BOOL)addPeerWithHost:(NSString*)host port:(uint16_t)port;
+
+/*!
+ * Start the shared clock
+ *
+ *  Starts the timeline at its current position, on all peers.
+ *
+ * @param applyTime The global timestamp at which to start, in host ticks, or zero to
+ *      start after the start delay, giving the change time to reach the other peers
+ * @return The timestamp at which the timeline starts
+ */
+-(uint64_t)startAtTime:(uint64_t)applyTime;
+
+/*!
+ * Stop the shared clock
+ *
+ *  Stops the timeline at its current position, on all peers.
+ */
+-(void)stop;
+
+/*!
+ * Get the current timeline position, in beats
+ *
+ *  Use this C function from the realtime audio thread to determine the shared
+ *  timeline position, in beats, for the given global timestamp.
+ *
+ * @param session The session
+ * @param time The global timestamp to retrieve the corresponding timeline position for,
+ *      in host ticks, or zero for now
+ * @return The position in the shared timeline, in beats
+ */
+double SEPeerSessionGetTimelinePosition(__unsafe_unretained SEPeerSession * session, uint64_t time);
+
+/*!
+ * Get the shared tempo
+ *
+ * @param session The session
+ * @return The tempo, in beats per minute
+ */
+double SEPeerSessionGetTempo(__unsafe_unretained SEPeerSession * session);
+
+/*!
+ * Determine whether the shared clock is running
+ *
+ * @param session The session
+ * @return Whether the timeline is advancing
+ */
+BOOL SEPeerSessionIsClockRunning(__unsafe_unretained SEPeerSession * session);
+
+/*!
+ * Get the clock offset to a peer
+ *
+ *  Gives the current estimate of the difference between a peer's host clock and
+ *  ours, as measured from the lowest-latency of recent ping exchanges.
+ *
+ * @param peerID The peer's identifier, from the peers property
+ * @return The peer's clock minus ours, in seconds, or 0 if the peer is unknown
+ */
+-(NSTimeInterval)clockOffsetForPeer:(NSNumber*)peerID;
+
+/*!
+ * The shared tempo (beats per minute)
+ *
+ *  Assign a value to change the tempo on all peers. The timeline continues
+ *  from its current position.
+ */
+@property (nonatomic) double tempo;
+
+/*!
+ * The shared timeline position (beats)
+ *
+ *  Assign a value to seek on all peers. Use SEPeerSessionGetTimelinePosition
+ *  to follow the position while the clock is running.
+ */
+@property (nonatomic) double timelinePosition;
+
+/*!
+ * Whether the shared clock is running
+ */
+@property (nonatomic, readonly) BOOL clockRunning;
+
+/*!
+ * Delay before a start takes effect, in seconds, when no time is given (default: 0.1)
+ *
+ *  Allow enough time for the start to reach all peers.
+ */
+@property (nonatomic) NSTimeInterval startDelay;
+
+/*!
+ * This peer's identifier
+ */
+@property (nonatomic, readonly) uint64_t peerID;
+
+/*!
+ * Identifiers of the peers currently heard from; array of NSNumber
+ */
+@property (nonatomic, readonly) NSArray * peers;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
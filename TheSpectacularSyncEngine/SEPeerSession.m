@@ -0,0 +1,547 @@
+//
+//  SEPeerSession.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SEPeerSession.h"
+#import <libkern/OSByteOrder.h>
+#import <sys/socket.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+NSString * const SEPeerSessionDidChangeStateNotification = @"SEPeerSessionDidChangeStateNotification";
+NSString * const SEPeerSessionDidChangePeersNotification = @"SEPeerSessionDidChangePeersNotification";
+
+static const uint32_t kPacketMagic                   = 0x53455053; // "SEPS"
+static const uint8_t kProtocolVersion                = 1;
+static const size_t kHeaderSize                      = 16;     // Magic, protocol version, type, reserved, peer ID
+static const size_t kStatePacketSize                 = kHeaderSize + 48;
+static const size_t kPingPacketSize                  = kHeaderSize + 8;
+static const size_t kPongPacketSize                  = kHeaderSize + 32;
+static const size_t kMaxPacketSize                   = 128;
+static const NSTimeInterval kAnnounceInterval        = 0.25;   // How often to send state and ping peers
+static const NSTimeInterval kPeerTimeout             = 2.0;    // Time without hearing from a peer before it's dropped
+static const int kOffsetSampleCount                  = 16;     // Number of recent ping exchanges to choose the clock offset from
+static const double kDefaultTempo                    = 120.0;
+static const NSTimeInterval kDefaultStartDelay       = 0.1;
+
+typedef enum {
+    SEPeerSessionPacketState = 1,
+    SEPeerSessionPacketPing  = 2,
+    SEPeerSessionPacketPong  = 3,
+} SEPeerSessionPacketType;
+
+typedef struct {
+    BOOL running;
+    double position;        // Position at timeBase while running, or the current position while stopped
+    uint64_t timeBase;      // Local host time
+    SETempoConversion conversion;
+} SEPeerSessionTimeline;
+
+typedef struct {
+    int64_t offset;         // Remote clock minus ours, in nanoseconds
+    uint64_t roundTripTime; // In nanoseconds
+} SEPeerSessionOffsetSample;
+
+@interface SEPeerSessionPeer : NSObject {
+  @public
+    SEPeerSessionOffsetSample _samples[kOffsetSampleCount];
+    int _sampleCount;
+    int _nextSample;
+    int64_t _offset;
+}
+-(void)addSample:(SEPeerSessionOffsetSample)sample;
+@property (nonatomic) NSTimeInterval lastSeen;
+@property (nonatomic, readonly) BOOL hasOffset;
+@end
+
+@implementation SEPeerSessionPeer
+-(BOOL)hasOffset {
+    return _sampleCount > 0;
+}
+-(void)addSample:(SEPeerSessionOffsetSample)sample {
+    _samples[_nextSample] = sample;
+    _nextSample = (_nextSample + 1) % kOffsetSampleCount;
+    _sampleCount = MIN(_sampleCount + 1, kOffsetSampleCount);
+    
+    // The exchange with the shortest round trip suffered the least queuing delay, so gives the best estimate
+    int best = 0;
+    for ( int i=1; i<_sampleCount; i++ ) {
+        if ( _samples[i].roundTripTime < _samples[best].roundTripTime ) {
+            best = i;
+        }
+    }
+    _offset = _samples[best].offset;
+}
+@end
+
+@interface SEPeerSession () {
+    int _socket;
+    SEPeerSessionTimeline _timeline;
+    uint32_t _timelineSequence;
+    uint64_t _stateVersion;
+    uint64_t _stateOriginator;
+}
+@property (nonatomic, readwrite) uint64_t peerID;
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) dispatch_source_t readSource;
+@property (nonatomic, strong) dispatch_source_t announceTimer;
+@property (nonatomic, strong) NSMutableArray * destinations;
+@property (nonatomic, strong) NSMutableDictionary * peerRecords;
+@end
+
+@implementation SEPeerSession
+
+-(instancetype)initWithMulticastGroup:(NSString *)group port:(uint16_t)port {
+    struct sockaddr_in address = { .sin_len = sizeof(struct sockaddr_in), .sin_family = AF_INET, .sin_port = htons(port) };
+    if ( inet_pton(AF_INET, group.UTF8String, &address.sin_addr) != 1 || !IN_MULTICAST(ntohl(address.sin_addr.s_addr)) ) {
+        NSLog(@"Invalid multicast group %@", group);
+        return nil;
+    }
+    
+    return [self initWithPort:port multicastGroup:&address];
+}
+
+-(instancetype)initWithPort:(uint16_t)port {
+    return [self initWithPort:port multicastGroup:NULL];
+}
+
+-(instancetype)initWithPort:(uint16_t)port multicastGroup:(const struct sockaddr_in *)group {
+    if ( !(self = [super init]) ) return nil;
+    
+    _socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if ( _socket < 0 ) {
+        NSLog(@"Couldn't create peer session socket: %s", strerror(errno));
+        return nil;
+    }
+    
+    int one = 1;
+    if ( group ) {
+        // Let several peers on the same machine share the group's port
+        setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+    fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL) | O_NONBLOCK);
+    
+    struct sockaddr_in address = { .sin_len = sizeof(struct sockaddr_in), .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+    if ( bind(_socket, (struct sockaddr*)&address, sizeof(address)) != 0 ) {
+        NSLog(@"Couldn't bind peer session socket to port %d: %s", (int)port, strerror(errno));
+        close(_socket);
+        return nil;
+    }
+    
+    self.destinations = [NSMutableArray array];
+    
+    if ( group ) {
+        struct ip_mreq membership = { .imr_multiaddr = group->sin_addr, .imr_interface.s_addr = htonl(INADDR_ANY) };
+        if ( setsockopt(_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0 ) {
+            NSLog(@"Couldn't join multicast group: %s", strerror(errno));
+            close(_socket);
+            return nil;
+        }
+        unsigned char loop = 1, ttl = 1;
+        setsockopt(_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        setsockopt(_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        [_destinations addObject:[NSData dataWithBytes:group length:sizeof(*group)]];
+    }
+    
+    arc4random_buf(&_peerID, sizeof(_peerID));
+    self.peerRecords = [NSMutableDictionary dictionary];
+    self.startDelay = kDefaultStartDelay;
+    SETempoConversionSetTempo(&_timeline.conversion, kDefaultTempo);
+    
+    // Handle incoming packets and periodic announcements on a background queue
+    self.queue = dispatch_queue_create("com.atastypixel.SEPeerSession", DISPATCH_QUEUE_SERIAL);
+    __weak SEPeerSession * weakSelf = self;
+    int socket = _socket;
+    
+    self.readSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _socket, 0, _queue);
+    dispatch_source_set_event_handler(_readSource, ^{
+        [weakSelf receivePackets];
+    });
+    dispatch_source_set_cancel_handler(_readSource, ^{
+        close(socket);
+    });
+    dispatch_resume(_readSource);
+    
+    self.announceTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    dispatch_source_set_timer(_announceTimer, DISPATCH_TIME_NOW, kAnnounceInterval * NSEC_PER_SEC, kAnnounceInterval * NSEC_PER_SEC / 10);
+    dispatch_source_set_event_handler(_announceTimer, ^{
+        [weakSelf announce];
+    });
+    dispatch_resume(_announceTimer);
+    
+    return self;
+}
+
+-(void)dealloc {
+    if ( _announceTimer ) {
+        dispatch_source_cancel(_announceTimer);
+    }
+    if ( _readSource ) {
+        dispatch_source_cancel(_readSource);
+    }
+}
+
+-(BOOL)addPeerWithHost:(NSString *)host port:(uint16_t)port {
+    struct sockaddr_in address = { .sin_len = sizeof(struct sockaddr_in), .sin_family = AF_INET, .sin_port = htons(port) };
+    if ( inet_pton(AF_INET, host.UTF8String, &address.sin_addr) != 1 ) {
+        NSLog(@"Invalid peer address %@", host);
+        return NO;
+    }
+    
+    dispatch_sync(_queue, ^{
+        [_destinations addObject:[NSData dataWithBytes:&address length:sizeof(address)]];
+        [self sendPing];
+    });
+    return YES;
+}
+
+#pragma mark - Timeline
+
+static void SEPeerSessionReadTimeline(__unsafe_unretained SEPeerSession * THIS, SEPeerSessionTimeline * timeline) {
+    while ( 1 ) {
+        uint32_t sequence = __atomic_load_n(&THIS->_timelineSequence, __ATOMIC_ACQUIRE);
+        if ( sequence & 1 ) {
+            continue;
+        }
+        *timeline = THIS->_timeline;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&THIS->_timelineSequence, __ATOMIC_RELAXED) == sequence ) {
+            return;
+        }
+    }
+}
+
+static double SEPeerSessionTimelinePositionAtTime(const SEPeerSessionTimeline * timeline, uint64_t time) {
+    if ( !timeline->running || time <= timeline->timeBase ) {
+        return timeline->position;
+    }
+    return timeline->position + SETempoConversionHostTicksToBeats(&timeline->conversion, time - timeline->timeBase);
+}
+
+double SEPeerSessionGetTimelinePosition(__unsafe_unretained SEPeerSession * THIS, uint64_t time) {
+    SEPeerSessionTimeline timeline;
+    SEPeerSessionReadTimeline(THIS, &timeline);
+    return SEPeerSessionTimelinePositionAtTime(&timeline, time ? time : SECurrentTimeInHostTicks());
+}
+
+double SEPeerSessionGetTempo(__unsafe_unretained SEPeerSession * THIS) {
+    SEPeerSessionTimeline timeline;
+    SEPeerSessionReadTimeline(THIS, &timeline);
+    return timeline.conversion.tempo;
+}
+
+BOOL SEPeerSessionIsClockRunning(__unsafe_unretained SEPeerSession * THIS) {
+    SEPeerSessionTimeline timeline;
+    SEPeerSessionReadTimeline(THIS, &timeline);
+    return timeline.running;
+}
+
+-(void)setTimeline:(SEPeerSessionTimeline)timeline {
+    // Called on the queue, which is the only writer
+    __atomic_store_n(&_timelineSequence, _timelineSequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    _timeline = timeline;
+    __atomic_store_n(&_timelineSequence, _timelineSequence + 1, __ATOMIC_RELEASE);
+}
+
+-(void)applyLocalChange:(void(^)(SEPeerSessionTimeline * timeline, uint64_t now))block {
+    dispatch_sync(_queue, ^{
+        SEPeerSessionTimeline timeline = _timeline;
+        uint64_t now = SECurrentTimeInHostTicks();
+        block(&timeline, now);
+        [self setTimeline:timeline];
+        
+        // Newest change wins: order changes across peers by version, then originator
+        _stateVersion++;
+        _stateOriginator = _peerID;
+        [self sendState];
+    });
+}
+
+-(double)tempo {
+    return SEPeerSessionGetTempo(self);
+}
+
+-(void)setTempo:(double)tempo {
+    [self applyLocalChange:^(SEPeerSessionTimeline *timeline, uint64_t now) {
+        if ( timeline->running && now > timeline->timeBase ) {
+            // Continue from the current position
+            timeline->position = SEPeerSessionTimelinePositionAtTime(timeline, now);
+            timeline->timeBase = now;
+        }
+        SETempoConversionSetTempo(&timeline->conversion, tempo);
+    }];
+}
+
+-(double)timelinePosition {
+    return SEPeerSessionGetTimelinePosition(self, 0);
+}
+
+-(void)setTimelinePosition:(double)timelinePosition {
+    [self applyLocalChange:^(SEPeerSessionTimeline *timeline, uint64_t now) {
+        timeline->position = timelinePosition;
+        if ( timeline->running ) {
+            timeline->timeBase = MAX(now, timeline->timeBase);
+        }
+    }];
+}
+
+-(BOOL)clockRunning {
+    return SEPeerSessionIsClockRunning(self);
+}
+
+-(uint64_t)startAtTime:(uint64_t)applyTime {
+    if ( !applyTime ) {
+        applyTime = SECurrentTimeInHostTicks() + SESecondsToHostTicks(_startDelay);
+    }
+    
+    [self applyLocalChange:^(SEPeerSessionTimeline *timeline, uint64_t now) {
+        if ( timeline->running ) {
+            timeline->position = SEPeerSessionTimelinePositionAtTime(timeline, applyTime);
+        }
+        timeline->running = YES;
+        timeline->timeBase = applyTime;
+    }];
+    
+    return applyTime;
+}
+
+-(void)stop {
+    [self applyLocalChange:^(SEPeerSessionTimeline *timeline, uint64_t now) {
+        timeline->position = SEPeerSessionTimelinePositionAtTime(timeline, now);
+        timeline->running = NO;
+        timeline->timeBase = 0;
+    }];
+}
+
+#pragma mark - Peers
+
+-(NSArray *)peers {
+    __block NSArray * peers;
+    dispatch_sync(_queue, ^{
+        peers = [_peerRecords allKeys];
+    });
+    return peers;
+}
+
+-(NSTimeInterval)clockOffsetForPeer:(NSNumber *)peerID {
+    __block NSTimeInterval offset = 0;
+    dispatch_sync(_queue, ^{
+        SEPeerSessionPeer * peer = _peerRecords[peerID];
+        if ( peer.hasOffset ) {
+            offset = peer->_offset * 1.0e-9;
+        }
+    });
+    return offset;
+}
+
+-(void)announce {
+    [self sendPing];
+    [self sendState];
+    
+    // Drop peers we haven't heard from for a while
+    NSTimeInterval now = SECurrentTimeInSeconds();
+    NSArray * expired = [[_peerRecords keysOfEntriesPassingTest:^BOOL(id key, SEPeerSessionPeer * peer, BOOL *stop) {
+        return now - peer.lastSeen > kPeerTimeout;
+    }] allObjects];
+    if ( expired.count > 0 ) {
+        [_peerRecords removeObjectsForKeys:expired];
+        [self postNotification:SEPeerSessionDidChangePeersNotification];
+    }
+}
+
+-(void)postNotification:(NSString*)name {
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:name object:self];
+    });
+}
+
+#pragma mark - Wire format
+
+// Packets are big-endian; times are host times converted to nanoseconds, so peers needn't share a timebase
+
+static void SEPeerSessionWriteUInt64(uint8_t * bytes, uint64_t value) {
+    value = OSSwapHostToBigInt64(value);
+    memcpy(bytes, &value, sizeof(value));
+}
+
+static uint64_t SEPeerSessionReadUInt64(const uint8_t * bytes) {
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return OSSwapBigToHostInt64(value);
+}
+
+static void SEPeerSessionWriteDouble(uint8_t * bytes, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    SEPeerSessionWriteUInt64(bytes, bits);
+}
+
+static double SEPeerSessionReadDouble(const uint8_t * bytes) {
+    uint64_t bits = SEPeerSessionReadUInt64(bytes);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint64_t SEPeerSessionHostTicksToNanoseconds(uint64_t ticks) {
+    return (uint64_t)llround(SEHostTicksToSeconds(ticks) * 1.0e9);
+}
+
+static uint64_t SEPeerSessionNanosecondsToHostTicks(uint64_t nanoseconds) {
+    return SESecondsToHostTicks(nanoseconds * 1.0e-9);
+}
+
+static void SEPeerSessionWriteHeader(__unsafe_unretained SEPeerSession * THIS, uint8_t * bytes, SEPeerSessionPacketType type) {
+    uint32_t magic = OSSwapHostToBigInt32(kPacketMagic);
+    memcpy(bytes, &magic, sizeof(magic));
+    bytes[4] = kProtocolVersion;
+    bytes[5] = type;
+    bytes[6] = bytes[7] = 0;
+    SEPeerSessionWriteUInt64(bytes + 8, THIS->_peerID);
+}
+
+-(void)sendPacket:(const uint8_t *)bytes length:(size_t)length toAddress:(NSData *)address {
+    if ( sendto(_socket, bytes, length, 0, (const struct sockaddr *)address.bytes, (socklen_t)address.length) < 0 ) {
+        NSLog(@"Couldn't send peer session packet: %s", strerror(errno));
+    }
+}
+
+-(void)broadcastPacket:(const uint8_t *)bytes length:(size_t)length {
+    for ( NSData * address in _destinations ) {
+        [self sendPacket:bytes length:length toAddress:address];
+    }
+}
+
+-(void)sendPing {
+    uint8_t bytes[kPingPacketSize];
+    SEPeerSessionWriteHeader(self, bytes, SEPeerSessionPacketPing);
+    SEPeerSessionWriteUInt64(bytes + kHeaderSize, SEPeerSessionHostTicksToNanoseconds(SECurrentTimeInHostTicks()));
+    [self broadcastPacket:bytes length:sizeof(bytes)];
+}
+
+-(void)sendState {
+    if ( _stateVersion == 0 ) {
+        // Nothing has been set yet, by us or anyone else
+        return;
+    }
+    
+    SEPeerSessionTimeline timeline = _timeline;
+    uint8_t bytes[kStatePacketSize];
+    SEPeerSessionWriteHeader(self, bytes, SEPeerSessionPacketState);
+    uint8_t * payload = bytes + kHeaderSize;
+    SEPeerSessionWriteUInt64(payload, _stateVersion);
+    SEPeerSessionWriteUInt64(payload + 8, _stateOriginator);
+    memset(payload + 16, 0, 8);
+    payload[16] = timeline.running ? 1 : 0;
+    SEPeerSessionWriteDouble(payload + 24, timeline.conversion.tempo);
+    SEPeerSessionWriteUInt64(payload + 32, timeline.running ? SEPeerSessionHostTicksToNanoseconds(timeline.timeBase) : 0);
+    SEPeerSessionWriteDouble(payload + 40, timeline.position);
+    [self broadcastPacket:bytes length:sizeof(bytes)];
+}
+
+-(void)receivePackets {
+    uint8_t bytes[kMaxPacketSize];
+    struct sockaddr_in address;
+    while ( 1 ) {
+        socklen_t addressLength = sizeof(address);
+        ssize_t length = recvfrom(_socket, bytes, sizeof(bytes), 0, (struct sockaddr*)&address, &addressLength);
+        if ( length < 0 ) {
+            if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+                NSLog(@"Couldn't receive peer session packet: %s", strerror(errno));
+            }
+            return;
+        }
+        
+        uint64_t receiveTime = SECurrentTimeInHostTicks();
+        
+        uint32_t magic;
+        memcpy(&magic, bytes, sizeof(magic));
+        if ( length < kHeaderSize || OSSwapBigToHostInt32(magic) != kPacketMagic || bytes[4] != kProtocolVersion ) {
+            continue;
+        }
+        
+        uint64_t peerID = SEPeerSessionReadUInt64(bytes + 8);
+        if ( peerID == _peerID ) {
+            // Our own multicast packet, looped back
+            continue;
+        }
+        
+        SEPeerSessionPeer * peer = _peerRecords[@(peerID)];
+        if ( !peer ) {
+            peer = [SEPeerSessionPeer new];
+            _peerRecords[@(peerID)] = peer;
+            [self postNotification:SEPeerSessionDidChangePeersNotification];
+        }
+        peer.lastSeen = SECurrentTimeInSeconds();
+        
+        const uint8_t * payload = bytes + kHeaderSize;
+        switch ( (SEPeerSessionPacketType)bytes[5] ) {
+            case SEPeerSessionPacketPing: {
+                if ( length < kPingPacketSize ) break;
+                
+                // Reply straight to the sender, with our receive and send times
+                uint8_t reply[kPongPacketSize];
+                SEPeerSessionWriteHeader(self, reply, SEPeerSessionPacketPong);
+                SEPeerSessionWriteUInt64(reply + kHeaderSize, peerID);
+                memcpy(reply + kHeaderSize + 8, payload, 8);
+                SEPeerSessionWriteUInt64(reply + kHeaderSize + 16, SEPeerSessionHostTicksToNanoseconds(receiveTime));
+                SEPeerSessionWriteUInt64(reply + kHeaderSize + 24, SEPeerSessionHostTicksToNanoseconds(SECurrentTimeInHostTicks()));
+                [self sendPacket:reply length:sizeof(reply) toAddress:[NSData dataWithBytes:&address length:addressLength]];
+                break;
+            }
+            
+            case SEPeerSessionPacketPong: {
+                if ( length < kPongPacketSize || SEPeerSessionReadUInt64(payload) != _peerID ) break;
+                
+                // Standard four-timestamp offset estimate, assuming a symmetric path
+                int64_t t0 = SEPeerSessionReadUInt64(payload + 8);
+                int64_t t1 = SEPeerSessionReadUInt64(payload + 16);
+                int64_t t2 = SEPeerSessionReadUInt64(payload + 24);
+                int64_t t3 = SEPeerSessionHostTicksToNanoseconds(receiveTime);
+                int64_t roundTripTime = (t3 - t0) - (t2 - t1);
+                if ( roundTripTime < 0 ) break;
+                
+                [peer addSample:(SEPeerSessionOffsetSample){ .offset = ((t1 - t0) + (t2 - t3)) / 2, .roundTripTime = roundTripTime }];
+                break;
+            }
+            
+            case SEPeerSessionPacketState: {
+                if ( length < kStatePacketSize || !peer.hasOffset ) break;
+                
+                uint64_t version = SEPeerSessionReadUInt64(payload);
+                uint64_t originator = SEPeerSessionReadUInt64(payload + 8);
+                if ( version < _stateVersion || (version == _stateVersion && originator <= _stateOriginator) ) {
+                    // We already have this change, or a newer one
+                    break;
+                }
+                
+                SEPeerSessionTimeline timeline;
+                timeline.running = payload[16] != 0;
+                SETempoConversionSetTempo(&timeline.conversion, SEPeerSessionReadDouble(payload + 24));
+                timeline.position = SEPeerSessionReadDouble(payload + 40);
+                timeline.timeBase = 0;
+                if ( timeline.running ) {
+                    // Translate the time base from the peer's clock to ours
+                    int64_t timeBase = (int64_t)SEPeerSessionReadUInt64(payload + 32) - peer->_offset;
+                    timeline.timeBase = SEPeerSessionNanosecondsToHostTicks(MAX(0, timeBase));
+                }
+                
+                [self setTimeline:timeline];
+                _stateVersion = version;
+                _stateOriginator = originator;
+                [self postNotification:SEPeerSessionDidChangeStateNotification];
+                break;
+            }
+        }
+    }
+}
+
+@end
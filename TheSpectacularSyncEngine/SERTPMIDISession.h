@@ -0,0 +1,150 @@
+//
+//  SERTPMIDISession.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import "SEMIDIClockSender.h"
+#import "SEMIDIClockReceiver.h"
+
+extern NSString * const SERTPMIDISessionDidChangeParticipantsNotification; ///< Notification sent on main thread when a participant connected or disconnected
+
+/*!
+ * A remote participant in an RTP-MIDI session
+ */
+@interface SERTPMIDIParticipant : NSObject
+
+/*!
+ * The participant's name, as given in its invitation or acceptance
+ */
+@property (nonatomic, strong, readonly) NSString * name;
+
+/*!
+ * The participant's address
+ */
+@property (nonatomic, strong, readonly) NSString * host;
+
+/*!
+ * The participant's control port
+ */
+@property (nonatomic, readonly) uint16_t port;
+
+/*!
+ * Whether the invitation handshake has completed
+ */
+@property (nonatomic, readonly) BOOL connected;
+
+/*!
+ * Whether clock synchronisation has completed, so that incoming timestamps can be translated
+ */
+@property (nonatomic, readonly) BOOL synchronized;
+
+/*!
+ * Estimated one-way latency, in seconds
+ *
+ *  Half of the shortest of the recent round-trip times, which suffered the least
+ *  queuing delay.
+ */
+@property (nonatomic, readonly) NSTimeInterval latency;
+
+/*!
+ * The most recently measured round-trip time, in seconds
+ */
+@property (nonatomic, readonly) NSTimeInterval roundTripTime;
+
+@end
+
+/*!
+ * RTP-MIDI (AppleMIDI) session
+ *
+ *  A self-contained implementation of the RTP-MIDI network protocol (RFC 6295), with
+ *  the AppleMIDI session protocol, interoperable with MIDINetworkSession and other
+ *  implementations, but without depending on the platform's network MIDI stack.
+ *
+ *  The protocol runs on plain UDP sockets, but the session is still built on
+ *  Foundation and Grand Central Dispatch, and exchanges messages as Core MIDI packet
+ *  lists, so those (or compatible implementations) are needed wherever it's used.
+ *
+ *  Use an instance as the interface for an SEMIDIClockSender to send clock messages
+ *  to all connected participants, and assign a receiver to have incoming messages
+ *  passed to it.
+ *
+ *  Clock synchronisation exchanges run continuously with each participant, to
+ *  measure round-trip latency and the offset between the participant's clock and
+ *  ours. Incoming messages are then stamped with the time the sender gave them,
+ *  translated into local host time, rather than the time they arrived, so network
+ *  jitter doesn't reach the receiver.
+ *
+ *  The session listens on two UDP ports: the given control port, and the data port
+ *  following it. Invitations from other participants are accepted automatically,
+ *  unless you set acceptsInvitations to NO.
+ *
+ *  Outgoing packets carry no recovery journal, so lost messages are not recovered.
+ */
+@interface SERTPMIDISession : NSObject <SEMIDIClockSenderInterface>
+
+/*!
+ * Initialise
+ *
+ * @param name The session name, shown to other participants
+ * @param port The control port; the data port is the one after. Use 5004 for the
+ *      conventional RTP-MIDI port.
+ * @return The session, or nil if the ports couldn't be opened
+ */
+-(instancetype)initWithName:(NSString*)name port:(uint16_t)port;
+
+/*!
+ * Invite a participant
+ *
+ *  Starts the invitation handshake, retrying for a while if there's no response.
+ *
+ * @param host The participant's IPv4 address
+ * @param port The participant's control port
+ * @return YES if the invitation was sent, NO if the address is invalid
+ */
+-(BOOL)connectToHost:(NSString*)host port:(uint16_t)port;
+
+/*!
+ * End the session with all participants
+ */
+-(void)disconnect;
+
+/*!
+ * The session name
+ */
+@property (nonatomic, strong, readonly) NSString * name;
+
+/*!
+ * The control port
+ */
+@property (nonatomic, readonly) uint16_t port;
+
+/*!
+ * Whether to accept incoming invitations (default YES)
+ */
+@property (nonatomic) BOOL acceptsInvitations;
+
+/*!
+ * The receiver incoming messages are passed to, if any
+ *
+ *  Messages are passed from the session's network thread.
+ */
+@property (nonatomic, strong) SEMIDIClockReceiver * receiver;
+
+/*!
+ * The participants; array of SERTPMIDIParticipant
+ */
+@property (nonatomic, readonly) NSArray * participants;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
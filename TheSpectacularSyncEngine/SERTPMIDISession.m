@@ -0,0 +1,756 @@
+//
+//  SERTPMIDISession.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SERTPMIDISession.h"
+#import <libkern/OSByteOrder.h>
+#import <sys/socket.h>
+#import <netinet/in.h>
+#import <arpa/inet.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+NSString * const SERTPMIDISessionDidChangeParticipantsNotification = @"SERTPMIDISessionDidChangeParticipantsNotification";
+
+static const double kClockRate                       = 10000.0; // Session clock rate, in units per second, as used by AppleMIDI
+static const uint32_t kProtocolVersion               = 2;
+static const uint8_t kRTPVersion                     = 0x80;   // Version 2, no padding, extension or CSRCs
+static const uint8_t kRTPMIDIPayloadType             = 0x61;
+static const size_t kRTPHeaderSize                   = 12;
+static const size_t kSessionPacketSize               = 16;     // Signature, command, protocol version, initiator token, SSRC; then name
+static const size_t kClockSyncPacketSize             = 36;
+static const size_t kMaxNameLength                   = 63;
+static const size_t kMaxPacketSize                   = 1500;
+static const size_t kMaxCommandListLength            = 0x0FFF;
+static const NSTimeInterval kTimerInterval           = 0.1;
+static const NSTimeInterval kInvitationInterval      = 1.0;    // Time between invitation attempts
+static const int kMaxInvitationAttempts              = 12;
+static const int kInitialClockSyncCount              = 6;      // Clock syncs to perform in quick succession after connecting
+static const NSTimeInterval kInitialClockSyncInterval = 0.1;
+static const NSTimeInterval kClockSyncInterval       = 2.0;    // Time between clock syncs thereafter
+static const NSTimeInterval kParticipantTimeout      = 30.0;   // Time without clock syncs before a participant is dropped
+static const int kClockSampleCount                   = 16;     // Number of recent clock syncs to choose the offset from
+static const int kMaxDestinations                    = 32;     // Connected participants that MIDI messages are sent to
+
+#define SERTPMIDICommand(a,b) ((uint16_t)(((a) << 8) | (b)))
+
+typedef enum {
+    SERTPMIDIParticipantInvitingControl,
+    SERTPMIDIParticipantInvitingData,
+    SERTPMIDIParticipantConnected,
+} SERTPMIDIParticipantState;
+
+typedef struct {
+    double offset;          // Remote clock minus ours, in session clock units
+    double roundTripTime;   // In session clock units
+} SERTPMIDIClockSample;
+
+@interface SERTPMIDIParticipant () {
+  @public
+    SERTPMIDIParticipantState _state;
+    BOOL _initiator;
+    uint32_t _ssrc;
+    uint32_t _token;
+    struct sockaddr_in _controlAddress;
+    struct sockaddr_in _dataAddress;
+    int _attempts;
+    NSTimeInterval _nextActionTime;
+    NSTimeInterval _lastHeard;
+    SERTPMIDIClockSample _samples[kClockSampleCount];
+    int _sampleCount;
+    int _nextSample;
+    double _offset;
+}
+@property (nonatomic, strong, readwrite) NSString * name;
+@property (nonatomic, strong, readwrite) NSString * host;
+@property (nonatomic, readwrite) uint16_t port;
+@property (nonatomic, readwrite) BOOL connected;
+@property (nonatomic, readwrite) BOOL synchronized;
+@property (nonatomic, readwrite) NSTimeInterval latency;
+@property (nonatomic, readwrite) NSTimeInterval roundTripTime;
+@end
+
+@implementation SERTPMIDIParticipant
+
+-(instancetype)initWithControlAddress:(const struct sockaddr_in *)address {
+    if ( !(self = [super init]) ) return nil;
+    _controlAddress = *address;
+    _dataAddress = *address;
+    _dataAddress.sin_port = htons(ntohs(address->sin_port) + 1);
+    char host[INET_ADDRSTRLEN];
+    self.host = @(inet_ntop(AF_INET, &address->sin_addr, host, sizeof(host)));
+    self.port = ntohs(address->sin_port);
+    self.name = @"";
+    return self;
+}
+
+-(void)addSample:(SERTPMIDIClockSample)sample {
+    _samples[_nextSample] = sample;
+    _nextSample = (_nextSample + 1) % kClockSampleCount;
+    _sampleCount = MIN(_sampleCount + 1, kClockSampleCount);
+    
+    // The exchange with the shortest round trip suffered the least queuing delay, so gives the best estimate
+    int best = 0;
+    for ( int i=1; i<_sampleCount; i++ ) {
+        if ( _samples[i].roundTripTime < _samples[best].roundTripTime ) {
+            best = i;
+        }
+    }
+    _offset = _samples[best].offset;
+    self.latency = (_samples[best].roundTripTime / 2.0) / kClockRate;
+    self.roundTripTime = sample.roundTripTime / kClockRate;
+    self.synchronized = YES;
+}
+
+@end
+
+@interface SERTPMIDISession () {
+    int _controlSocket;
+    int _dataSocket;
+    uint32_t _ssrc;
+    uint16_t _sequenceNumber;
+    struct sockaddr_in _destinations[kMaxDestinations];
+    int _destinationCount;
+    uint32_t _destinationsSequence;
+}
+@property (nonatomic, strong, readwrite) NSString * name;
+@property (nonatomic, readwrite) uint16_t port;
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) dispatch_source_t controlSource;
+@property (nonatomic, strong) dispatch_source_t dataSource;
+@property (nonatomic, strong) dispatch_source_t timer;
+@property (nonatomic, strong) NSMutableArray * participantRecords;
+@end
+
+@implementation SERTPMIDISession
+
+static int SERTPMIDIOpenSocket(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if ( fd < 0 ) {
+        NSLog(@"Couldn't create RTP-MIDI socket: %s", strerror(errno));
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    struct sockaddr_in address = { .sin_len = sizeof(struct sockaddr_in), .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+    if ( bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ) {
+        NSLog(@"Couldn't bind RTP-MIDI socket to port %d: %s", (int)port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+-(instancetype)initWithName:(NSString *)name port:(uint16_t)port {
+    if ( !(self = [super init]) ) return nil;
+    
+    _controlSocket = SERTPMIDIOpenSocket(port);
+    if ( _controlSocket < 0 ) {
+        return nil;
+    }
+    _dataSocket = SERTPMIDIOpenSocket(port + 1);
+    if ( _dataSocket < 0 ) {
+        close(_controlSocket);
+        return nil;
+    }
+    
+    self.name = name;
+    self.port = port;
+    self.acceptsInvitations = YES;
+    self.participantRecords = [NSMutableArray array];
+    _ssrc = arc4random();
+    _sequenceNumber = arc4random_uniform(UINT16_MAX);
+    
+    // Handle the session protocol on a background queue
+    self.queue = dispatch_queue_create("com.atastypixel.SERTPMIDISession", DISPATCH_QUEUE_SERIAL);
+    __weak SERTPMIDISession * weakSelf = self;
+    int controlSocket = _controlSocket;
+    int dataSocket = _dataSocket;
+    
+    self.controlSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _controlSocket, 0, _queue);
+    dispatch_source_set_event_handler(_controlSource, ^{
+        [weakSelf receiveOnSocket:controlSocket];
+    });
+    dispatch_source_set_cancel_handler(_controlSource, ^{
+        close(controlSocket);
+    });
+    dispatch_resume(_controlSource);
+    
+    self.dataSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _dataSocket, 0, _queue);
+    dispatch_source_set_event_handler(_dataSource, ^{
+        [weakSelf receiveOnSocket:dataSocket];
+    });
+    dispatch_source_set_cancel_handler(_dataSource, ^{
+        close(dataSocket);
+    });
+    dispatch_resume(_dataSource);
+    
+    self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    dispatch_source_set_timer(_timer, DISPATCH_TIME_NOW, kTimerInterval * NSEC_PER_SEC, kTimerInterval * NSEC_PER_SEC / 10);
+    dispatch_source_set_event_handler(_timer, ^{
+        [weakSelf service];
+    });
+    dispatch_resume(_timer);
+    
+    return self;
+}
+
+-(void)dealloc {
+    if ( _timer ) {
+        dispatch_source_cancel(_timer);
+    }
+    if ( _controlSource ) {
+        dispatch_source_cancel(_controlSource);
+    }
+    if ( _dataSource ) {
+        dispatch_source_cancel(_dataSource);
+    }
+}
+
+-(BOOL)connectToHost:(NSString *)host port:(uint16_t)port {
+    struct sockaddr_in address = { .sin_len = sizeof(struct sockaddr_in), .sin_family = AF_INET, .sin_port = htons(port) };
+    if ( inet_pton(AF_INET, host.UTF8String, &address.sin_addr) != 1 ) {
+        NSLog(@"Invalid RTP-MIDI participant address %@", host);
+        return NO;
+    }
+    
+    dispatch_sync(_queue, ^{
+        SERTPMIDIParticipant * participant = [[SERTPMIDIParticipant alloc] initWithControlAddress:&address];
+        participant->_initiator = YES;
+        participant->_token = arc4random();
+        participant->_state = SERTPMIDIParticipantInvitingControl;
+        [_participantRecords addObject:participant];
+        [self service];
+    });
+    return YES;
+}
+
+-(void)disconnect {
+    dispatch_sync(_queue, ^{
+        for ( SERTPMIDIParticipant * participant in _participantRecords ) {
+            [self sendCommand:SERTPMIDICommand('B','Y') token:participant->_token toParticipant:participant onDataSocket:NO];
+        }
+        [_participantRecords removeAllObjects];
+        [self participantsChanged];
+    });
+}
+
+-(NSArray *)participants {
+    __block NSArray * participants;
+    dispatch_sync(_queue, ^{
+        participants = [_participantRecords copy];
+    });
+    return participants;
+}
+
+-(void)setReceiver:(SEMIDIClockReceiver *)receiver {
+    dispatch_sync(_queue, ^{
+        _receiver = receiver;
+    });
+}
+
+#pragma mark - Wire format
+
+// AppleMIDI packets are big-endian, and not necessarily aligned
+
+static void SERTPMIDIWriteUInt16(uint8_t * bytes, uint16_t value) {
+    value = OSSwapHostToBigInt16(value);
+    memcpy(bytes, &value, sizeof(value));
+}
+
+static void SERTPMIDIWriteUInt32(uint8_t * bytes, uint32_t value) {
+    value = OSSwapHostToBigInt32(value);
+    memcpy(bytes, &value, sizeof(value));
+}
+
+static void SERTPMIDIWriteUInt64(uint8_t * bytes, uint64_t value) {
+    value = OSSwapHostToBigInt64(value);
+    memcpy(bytes, &value, sizeof(value));
+}
+
+static uint16_t SERTPMIDIReadUInt16(const uint8_t * bytes) {
+    uint16_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return OSSwapBigToHostInt16(value);
+}
+
+static uint32_t SERTPMIDIReadUInt32(const uint8_t * bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return OSSwapBigToHostInt32(value);
+}
+
+static uint64_t SERTPMIDIReadUInt64(const uint8_t * bytes) {
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return OSSwapBigToHostInt64(value);
+}
+
+static double SERTPMIDIHostTicksToClock(uint64_t ticks) {
+    return SEHostTicksToSeconds(ticks) * kClockRate;
+}
+
+static uint64_t SERTPMIDIClockToHostTicks(double clock) {
+    return clock > 0 ? SESecondsToHostTicks(clock / kClockRate) : 0;
+}
+
+static uint64_t SERTPMIDIClockNow(void) {
+    return (uint64_t)SERTPMIDIHostTicksToClock(SECurrentTimeInHostTicks());
+}
+
+/*!
+ * Length of the MIDI message at the start of the given bytes
+ *
+ *  For data bytes with no status byte (running status), gives the number of data bytes
+ *  up to the next status byte.
+ */
+static size_t SERTPMIDIMessageLength(const uint8_t * bytes, size_t available) {
+    if ( !available ) return 0;
+    
+    uint8_t status = bytes[0];
+    size_t length;
+    if ( status < 0x80 ) {
+        length = 0;
+        while ( length < available && bytes[length] < 0x80 ) length++;
+        return length;
+    } else if ( status == 0xF0 ) {
+        length = 1;
+        while ( length < available && bytes[length] != 0xF7 ) length++;
+        length++;
+    } else if ( status == 0xF1 || status == 0xF3 ) {
+        length = 2;
+    } else if ( status == 0xF2 ) {
+        length = 3;
+    } else if ( status >= 0xF4 ) {
+        length = 1;
+    } else if ( status >= 0xC0 && status < 0xE0 ) {
+        length = 2;
+    } else {
+        length = 3;
+    }
+    return MIN(length, available);
+}
+
+#pragma mark - Session protocol
+
+-(void)sendPacket:(const uint8_t *)bytes length:(size_t)length socket:(int)socket address:(const struct sockaddr_in *)address {
+    if ( sendto(socket, bytes, length, 0, (const struct sockaddr *)address, sizeof(*address)) < 0 ) {
+        NSLog(@"Couldn't send RTP-MIDI packet: %s", strerror(errno));
+    }
+}
+
+-(void)sendCommand:(uint16_t)command token:(uint32_t)token socket:(int)socket address:(const struct sockaddr_in *)address {
+    uint8_t bytes[kSessionPacketSize + kMaxNameLength + 1];
+    SERTPMIDIWriteUInt16(bytes, 0xFFFF);
+    SERTPMIDIWriteUInt16(bytes + 2, command);
+    SERTPMIDIWriteUInt32(bytes + 4, kProtocolVersion);
+    SERTPMIDIWriteUInt32(bytes + 8, token);
+    SERTPMIDIWriteUInt32(bytes + 12, _ssrc);
+    size_t length = kSessionPacketSize;
+    if ( command != SERTPMIDICommand('B','Y') ) {
+        // Include our name, null-terminated
+        const char * name = _name.UTF8String ? _name.UTF8String : "";
+        size_t nameLength = MIN(strlen(name), kMaxNameLength);
+        memcpy(bytes + length, name, nameLength);
+        length += nameLength;
+        bytes[length++] = 0;
+    }
+    [self sendPacket:bytes length:length socket:socket address:address];
+}
+
+-(void)sendCommand:(uint16_t)command token:(uint32_t)token toParticipant:(SERTPMIDIParticipant *)participant onDataSocket:(BOOL)data {
+    [self sendCommand:command
+                token:token
+               socket:data ? _dataSocket : _controlSocket
+              address:data ? &participant->_dataAddress : &participant->_controlAddress];
+}
+
+-(void)sendClockSync:(uint8_t)count timestamps:(const uint64_t *)timestamps toParticipant:(SERTPMIDIParticipant *)participant {
+    uint8_t bytes[kClockSyncPacketSize];
+    SERTPMIDIWriteUInt16(bytes, 0xFFFF);
+    SERTPMIDIWriteUInt16(bytes + 2, SERTPMIDICommand('C','K'));
+    SERTPMIDIWriteUInt32(bytes + 4, _ssrc);
+    bytes[8] = count;
+    bytes[9] = bytes[10] = bytes[11] = 0;
+    for ( int i=0; i<3; i++ ) {
+        SERTPMIDIWriteUInt64(bytes + 12 + (i*8), timestamps[i]);
+    }
+    [self sendPacket:bytes length:sizeof(bytes) socket:_dataSocket address:&participant->_dataAddress];
+}
+
+-(SERTPMIDIParticipant *)participantWithSSRC:(uint32_t)ssrc {
+    for ( SERTPMIDIParticipant * participant in _participantRecords ) {
+        if ( participant->_ssrc == ssrc && participant->_state != SERTPMIDIParticipantInvitingControl ) {
+            return participant;
+        }
+    }
+    return nil;
+}
+
+-(SERTPMIDIParticipant *)invitedParticipantWithToken:(uint32_t)token {
+    for ( SERTPMIDIParticipant * participant in _participantRecords ) {
+        if ( participant->_initiator && participant->_token == token ) {
+            return participant;
+        }
+    }
+    return nil;
+}
+
+-(void)participantsChanged {
+    // Update the destinations table read by the MIDI send path; marked as being updated, for lock-free readers
+    __atomic_store_n(&_destinationsSequence, _destinationsSequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    int count = 0;
+    for ( SERTPMIDIParticipant * participant in _participantRecords ) {
+        participant.connected = participant->_state == SERTPMIDIParticipantConnected;
+        if ( participant.connected && count < kMaxDestinations ) {
+            _destinations[count++] = participant->_dataAddress;
+        }
+    }
+    _destinationCount = count;
+    __atomic_store_n(&_destinationsSequence, _destinationsSequence + 1, __ATOMIC_RELEASE);
+    
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:SERTPMIDISessionDidChangeParticipantsNotification object:self];
+    });
+}
+
+-(void)service {
+    NSTimeInterval now = SECurrentTimeInSeconds();
+    BOOL changed = NO;
+    
+    for ( SERTPMIDIParticipant * participant in [_participantRecords copy] ) {
+        if ( participant->_state == SERTPMIDIParticipantConnected ) {
+            if ( now - participant->_lastHeard > kParticipantTimeout ) {
+                [self sendCommand:SERTPMIDICommand('B','Y') token:participant->_token toParticipant:participant onDataSocket:NO];
+                [_participantRecords removeObject:participant];
+                changed = YES;
+            } else if ( participant->_initiator && now >= participant->_nextActionTime ) {
+                // The initiator drives clock synchronisation: start an exchange
+                uint64_t timestamps[3] = { SERTPMIDIClockNow(), 0, 0 };
+                [self sendClockSync:0 timestamps:timestamps toParticipant:participant];
+                participant->_attempts++;
+                participant->_nextActionTime = now + (participant->_attempts < kInitialClockSyncCount ? kInitialClockSyncInterval : kClockSyncInterval);
+            }
+        } else if ( participant->_initiator && now >= participant->_nextActionTime ) {
+            if ( participant->_attempts >= kMaxInvitationAttempts ) {
+                NSLog(@"No response to RTP-MIDI invitation from %@:%d", participant.host, (int)participant.port);
+                [_participantRecords removeObject:participant];
+                changed = YES;
+                continue;
+            }
+            [self sendCommand:SERTPMIDICommand('I','N')
+                        token:participant->_token
+                toParticipant:participant
+                 onDataSocket:participant->_state == SERTPMIDIParticipantInvitingData];
+            participant->_attempts++;
+            participant->_nextActionTime = now + kInvitationInterval;
+        }
+    }
+    
+    if ( changed ) {
+        [self participantsChanged];
+    }
+}
+
+-(void)receiveOnSocket:(int)socket {
+    uint8_t bytes[kMaxPacketSize];
+    struct sockaddr_in address;
+    while ( 1 ) {
+        socklen_t addressLength = sizeof(address);
+        ssize_t length = recvfrom(socket, bytes, sizeof(bytes), 0, (struct sockaddr*)&address, &addressLength);
+        if ( length < 0 ) {
+            if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+                NSLog(@"Couldn't receive RTP-MIDI packet: %s", strerror(errno));
+            }
+            return;
+        }
+        
+        uint64_t arrivalTime = SECurrentTimeInHostTicks();
+        
+        if ( length >= 4 && SERTPMIDIReadUInt16(bytes) == 0xFFFF ) {
+            [self handleSessionPacket:bytes length:length from:&address onDataSocket:socket == _dataSocket];
+        } else if ( socket == _dataSocket && length > kRTPHeaderSize
+                   && (bytes[0] & 0xC0) == kRTPVersion && (bytes[1] & 0x7F) == kRTPMIDIPayloadType ) {
+            [self handleMIDIPacket:bytes length:length arrivalTime:arrivalTime];
+        }
+    }
+}
+
+-(void)handleSessionPacket:(const uint8_t *)bytes length:(size_t)length from:(const struct sockaddr_in *)address onDataSocket:(BOOL)data {
+    uint16_t command = SERTPMIDIReadUInt16(bytes + 2);
+    
+    if ( command == SERTPMIDICommand('C','K') ) {
+        if ( length < kClockSyncPacketSize ) return;
+        SERTPMIDIParticipant * participant = [self participantWithSSRC:SERTPMIDIReadUInt32(bytes + 4)];
+        if ( !participant || participant->_state != SERTPMIDIParticipantConnected ) return;
+        
+        participant->_lastHeard = SECurrentTimeInSeconds();
+        uint8_t count = bytes[8];
+        uint64_t timestamps[3];
+        for ( int i=0; i<3; i++ ) {
+            timestamps[i] = SERTPMIDIReadUInt64(bytes + 12 + (i*8));
+        }
+        
+        // Timestamps 1 and 3 are on the initiator's clock, timestamp 2 on the responder's
+        if ( count == 0 ) {
+            timestamps[1] = SERTPMIDIClockNow();
+            [self sendClockSync:1 timestamps:timestamps toParticipant:participant];
+        } else if ( count == 1 ) {
+            timestamps[2] = SERTPMIDIClockNow();
+            [self sendClockSync:2 timestamps:timestamps toParticipant:participant];
+            double midpoint = ((double)timestamps[0] + (double)timestamps[2]) / 2.0;
+            [participant addSample:(SERTPMIDIClockSample){
+                .offset = (double)timestamps[1] - midpoint,
+                .roundTripTime = (double)timestamps[2] - (double)timestamps[0] }];
+        } else if ( count == 2 ) {
+            double midpoint = ((double)timestamps[0] + (double)timestamps[2]) / 2.0;
+            [participant addSample:(SERTPMIDIClockSample){
+                .offset = midpoint - (double)timestamps[1],
+                .roundTripTime = (double)timestamps[2] - (double)timestamps[0] }];
+        }
+        return;
+    }
+    
+    if ( length < kSessionPacketSize ) return;
+    uint32_t token = SERTPMIDIReadUInt32(bytes + 8);
+    uint32_t ssrc = SERTPMIDIReadUInt32(bytes + 12);
+    NSString * name = nil;
+    if ( length > kSessionPacketSize ) {
+        name = [[NSString alloc] initWithBytes:bytes + kSessionPacketSize
+                                        length:strnlen((const char*)bytes + kSessionPacketSize, length - kSessionPacketSize)
+                                      encoding:NSUTF8StringEncoding];
+    }
+    
+    switch ( command ) {
+        case SERTPMIDICommand('I','N'): {
+            if ( !_acceptsInvitations ) {
+                [self sendCommand:SERTPMIDICommand('N','O') token:token socket:data ? _dataSocket : _controlSocket address:address];
+                return;
+            }
+            
+            SERTPMIDIParticipant * participant = [self participantWithSSRC:ssrc];
+            if ( !data ) {
+                if ( !participant ) {
+                    participant = [[SERTPMIDIParticipant alloc] initWithControlAddress:address];
+                    participant->_ssrc = ssrc;
+                    participant->_state = SERTPMIDIParticipantInvitingData;
+                    [_participantRecords addObject:participant];
+                }
+                participant->_token = token;
+                if ( name ) participant.name = name;
+                [self sendCommand:SERTPMIDICommand('O','K') token:token socket:_controlSocket address:address];
+            } else {
+                if ( !participant ) {
+                    // Data invitations must follow a control invitation
+                    [self sendCommand:SERTPMIDICommand('N','O') token:token socket:_dataSocket address:address];
+                    return;
+                }
+                participant->_dataAddress = *address;
+                [self sendCommand:SERTPMIDICommand('O','K') token:token socket:_dataSocket address:address];
+                if ( participant->_state != SERTPMIDIParticipantConnected ) {
+                    participant->_state = SERTPMIDIParticipantConnected;
+                    participant->_lastHeard = SECurrentTimeInSeconds();
+                    [self participantsChanged];
+                }
+            }
+            break;
+        }
+        
+        case SERTPMIDICommand('O','K'): {
+            SERTPMIDIParticipant * participant = [self invitedParticipantWithToken:token];
+            if ( !participant ) return;
+            participant->_ssrc = ssrc;
+            if ( name ) participant.name = name;
+            participant->_attempts = 0;
+            participant->_nextActionTime = 0;
+            if ( !data && participant->_state == SERTPMIDIParticipantInvitingControl ) {
+                participant->_state = SERTPMIDIParticipantInvitingData;
+                [self service];
+            } else if ( data && participant->_state == SERTPMIDIParticipantInvitingData ) {
+                participant->_state = SERTPMIDIParticipantConnected;
+                participant->_lastHeard = SECurrentTimeInSeconds();
+                [self participantsChanged];
+                [self service];
+            }
+            break;
+        }
+        
+        case SERTPMIDICommand('N','O'): {
+            SERTPMIDIParticipant * participant = [self invitedParticipantWithToken:token];
+            if ( !participant ) return;
+            NSLog(@"RTP-MIDI invitation declined by %@:%d", participant.host, (int)participant.port);
+            [_participantRecords removeObject:participant];
+            [self participantsChanged];
+            break;
+        }
+        
+        case SERTPMIDICommand('B','Y'): {
+            SERTPMIDIParticipant * participant = [self participantWithSSRC:ssrc];
+            if ( !participant ) return;
+            [_participantRecords removeObject:participant];
+            [self participantsChanged];
+            break;
+        }
+    }
+}
+
+#pragma mark - MIDI
+
+static int SERTPMIDISessionCopyDestinations(__unsafe_unretained SERTPMIDISession * THIS, struct sockaddr_in * destinations) {
+    // Read a consistent copy of the destinations table, retrying if it overlaps an update
+    while ( 1 ) {
+        uint32_t sequence = __atomic_load_n(&THIS->_destinationsSequence, __ATOMIC_ACQUIRE);
+        if ( sequence & 1 ) {
+            continue;
+        }
+        int count = THIS->_destinationCount;
+        memcpy(destinations, THIS->_destinations, count * sizeof(*destinations));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ( __atomic_load_n(&THIS->_destinationsSequence, __ATOMIC_RELAXED) == sequence ) {
+            return count;
+        }
+    }
+}
+
+-(void)sendMIDIPacketList:(const MIDIPacketList *)packetList {
+    // Called on the sender's thread: avoid allocating, locking or logging here
+    struct sockaddr_in destinations[kMaxDestinations];
+    int destinationCount = SERTPMIDISessionCopyDestinations(self, destinations);
+    if ( destinationCount == 0 ) {
+        return;
+    }
+    
+    const MIDIPacket * packet = &packetList->packet[0];
+    for ( int index = 0; index < packetList->numPackets; index++, packet = MIDIPacketNext(packet) ) {
+        // Build the MIDI command list; all of a packet's messages share its timestamp, so delta times are zero
+        uint8_t commands[kMaxCommandListLength];
+        size_t commandsLength = 0;
+        for ( size_t offset = 0; offset < packet->length; ) {
+            size_t messageLength = SERTPMIDIMessageLength(packet->data + offset, packet->length - offset);
+            if ( commandsLength + messageLength + 1 > sizeof(commands) ) break;
+            if ( offset > 0 ) {
+                commands[commandsLength++] = 0;
+            }
+            memcpy(commands + commandsLength, packet->data + offset, messageLength);
+            commandsLength += messageLength;
+            offset += messageLength;
+        }
+        if ( !commandsLength ) continue;
+        
+        // Stamp the packet with the time the message is due, not the time it's sent
+        uint64_t timestamp = packet->timeStamp ? packet->timeStamp : SECurrentTimeInHostTicks();
+        
+        uint8_t bytes[kRTPHeaderSize + 2 + kMaxCommandListLength];
+        bytes[0] = kRTPVersion;
+        bytes[1] = kRTPMIDIPayloadType;
+        SERTPMIDIWriteUInt16(bytes + 2, _sequenceNumber++);
+        SERTPMIDIWriteUInt32(bytes + 4, (uint32_t)(uint64_t)llround(SERTPMIDIHostTicksToClock(timestamp)));
+        SERTPMIDIWriteUInt32(bytes + 8, _ssrc);
+        size_t length = kRTPHeaderSize;
+        if ( commandsLength <= 0x0F ) {
+            bytes[length++] = commandsLength;
+        } else {
+            // Long header
+            bytes[length++] = 0x80 | (commandsLength >> 8);
+            bytes[length++] = commandsLength & 0xFF;
+        }
+        memcpy(bytes + length, commands, commandsLength);
+        length += commandsLength;
+        
+        for ( int i=0; i<destinationCount; i++ ) {
+            // Failures are dropped silently, like lost packets, as there's no recovery journal to repair them
+            sendto(_dataSocket, bytes, length, 0, (const struct sockaddr *)&destinations[i], sizeof(destinations[i]));
+        }
+    }
+}
+
+-(uint64_t)hostTimeForRemoteTimestamp:(uint32_t)timestamp deltaTime:(uint32_t)deltaTime participant:(SERTPMIDIParticipant *)participant {
+    // Extend the 32-bit timestamp to the participant's full clock, choosing the nearest value to its current time
+    int64_t remoteNow = llround(SERTPMIDIHostTicksToClock(SECurrentTimeInHostTicks()) + participant->_offset);
+    int64_t remoteTime = remoteNow + (int32_t)(timestamp - (uint32_t)remoteNow);
+    
+    return SERTPMIDIClockToHostTicks((double)(remoteTime + deltaTime) - participant->_offset);
+}
+
+-(void)handleMIDIPacket:(const uint8_t *)bytes length:(size_t)length arrivalTime:(uint64_t)arrivalTime {
+    SERTPMIDIParticipant * participant = [self participantWithSSRC:SERTPMIDIReadUInt32(bytes + 8)];
+    SEMIDIClockReceiver * receiver = _receiver;
+    if ( !participant || participant->_state != SERTPMIDIParticipantConnected || !receiver ) {
+        return;
+    }
+    
+    uint32_t timestamp = SERTPMIDIReadUInt32(bytes + 4);
+    
+    // Parse the MIDI command section header
+    size_t position = kRTPHeaderSize;
+    uint8_t flags = bytes[position++];
+    BOOL longHeader = (flags & 0x80) != 0;
+    BOOL firstHasDeltaTime = (flags & 0x20) != 0;
+    size_t listLength = flags & 0x0F;
+    if ( longHeader ) {
+        if ( position >= length ) return;
+        listLength = (listLength << 8) | bytes[position++];
+    }
+    size_t end = MIN(length, position + listLength);
+    
+    char packetListSpace[sizeof(MIDIPacketList) + kMaxPacketSize];
+    MIDIPacketList * packetList = (MIDIPacketList*)packetListSpace;
+    MIDIPacket * packet = MIDIPacketListInit(packetList);
+    
+    uint32_t deltaTime = 0;
+    uint8_t runningStatus = 0;
+    for ( BOOL first = YES; position < end; first = NO ) {
+        if ( !first || firstHasDeltaTime ) {
+            // Variable-length delta time, up to four octets
+            uint32_t delta = 0;
+            for ( int i=0; i<4 && position < end; i++ ) {
+                uint8_t byte = bytes[position++];
+                delta = (delta << 7) | (byte & 0x7F);
+                if ( !(byte & 0x80) ) break;
+            }
+            deltaTime += delta;
+            if ( position >= end ) break;
+        }
+        
+        uint8_t message[3];
+        const uint8_t * messageBytes;
+        size_t messageLength;
+        if ( bytes[position] & 0x80 ) {
+            messageBytes = bytes + position;
+            messageLength = SERTPMIDIMessageLength(messageBytes, end - position);
+            position += messageLength;
+            if ( messageBytes[0] < 0xF0 ) {
+                runningStatus = messageBytes[0];
+            } else if ( messageBytes[0] < 0xF8 ) {
+                runningStatus = 0;
+            }
+        } else {
+            // Running status: data bytes for the last channel message
+            if ( !runningStatus ) break;
+            size_t dataLength = MIN(SERTPMIDIMessageLength(&runningStatus, 3) - 1, end - position);
+            message[0] = runningStatus;
+            memcpy(message + 1, bytes + position, dataLength);
+            messageBytes = message;
+            messageLength = dataLength + 1;
+            position += dataLength;
+        }
+        
+        // Use the sender's timing if we know its clock, otherwise fall back to the arrival time
+        uint64_t time = participant.synchronized
+            ? [self hostTimeForRemoteTimestamp:timestamp deltaTime:deltaTime participant:participant]
+            : arrivalTime;
+        
+        packet = MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, time, messageLength, messageBytes);
+        if ( !packet ) break;
+    }
+    
+    if ( packetList->numPackets > 0 ) {
+        SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+    }
+}
+
+@end
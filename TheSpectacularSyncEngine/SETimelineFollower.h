@@ -0,0 +1,117 @@
+//
+//  SETimelineFollower.h
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#import <Foundation/Foundation.h>
+#import "SEMIDIClockReceiver.h"
+
+/*!
+ * Slew-limited timeline follower
+ *
+ *  The timeline reported by SEMIDIClockReceiverGetTimelinePosition jumps a little
+ *  whenever the receiver refines its estimate. Audio that follows the timeline
+ *  directly, such as a metronome or looper, then has to skip or repeat samples,
+ *  which can be audible.
+ *
+ *  This follower provides a continuous, monotonic version of a timeline instead.
+ *  Small differences between the followed timeline and the source are absorbed by
+ *  running slightly fast or slow, within a bounded rate correction, over a
+ *  configurable window. Large differences, and deliberate discontinuities like
+ *  starts, stops and seeks, are followed with a jump as before.
+ *
+ *  The current correction ratio is available through SETimelineFollowerGetCorrectionRatio,
+ *  for use by resampling code.
+ *
+ *  The follower is a plain C structure, intended to be owned and used by a single
+ *  thread, typically the realtime audio thread. Initialise it with SETimelineFollowerInit,
+ *  adjust the configuration fields if required, then call SETimelineFollowerGetReceiverTimelinePosition
+ *  (or SETimelineFollowerUpdate, for other timeline sources) once per render, in place
+ *  of SEMIDIClockReceiverGetTimelinePosition.
+ */
+typedef struct {
+    // Configuration
+    NSTimeInterval correctionWindow;    //!< Time over which to absorb a phase error (default 0.5s)
+    double maximumCorrection;           //!< Maximum rate correction, relative to the nominal rate (default 0.01, that is 1%)
+    double jumpThreshold;               //!< Phase error, in beats, beyond which to jump instead (default 0.25)
+    
+    // Private state
+    BOOL primed;
+    uint32_t discontinuityCount;
+    uint64_t time;
+    double position;
+    double correctionRatio;
+    SETempoConversion conversion;
+} SETimelineFollower;
+
+/*!
+ * Initialise a follower with the default configuration
+ *
+ * @param follower The follower
+ */
+void SETimelineFollowerInit(SETimelineFollower * follower);
+
+/*!
+ * Reset a follower
+ *
+ *  The next update will jump straight to the source timeline.
+ *
+ * @param follower The follower
+ */
+void SETimelineFollowerReset(SETimelineFollower * follower);
+
+/*!
+ * Update the follower from a timeline source
+ *
+ *  Use this function to follow any timeline, given its position at a time. Pass
+ *  a tempo of zero when the source timeline is stopped.
+ *
+ *  Calls should be made with non-decreasing timestamps, more often than once per
+ *  correction window. Passing a timestamp earlier than the last one returns an
+ *  extrapolated position without updating the follower.
+ *
+ * @param follower The follower
+ * @param time The global timestamp, in host ticks
+ * @param sourcePosition The source timeline position at the given time, in beats
+ * @param tempo The source tempo, in beats per minute, or zero if the source timeline is stopped
+ * @param discontinuityCount A count that the source increases whenever its timeline jumps deliberately
+ * @return The followed timeline position at the given time, in beats
+ */
+double SETimelineFollowerUpdate(SETimelineFollower * follower, uint64_t time, double sourcePosition, double tempo, uint32_t discontinuityCount);
+
+/*!
+ * Get the followed timeline position for a receiver
+ *
+ *  Use this C function from the realtime audio thread in place of SEMIDIClockReceiverGetTimelinePosition.
+ *
+ * @param follower The follower
+ * @param receiver The receiver
+ * @param time The global timestamp to retrieve the corresponding timeline position for, or zero for now
+ * @return The followed timeline position for the provided global timestamp, in beats
+ */
+double SETimelineFollowerGetReceiverTimelinePosition(SETimelineFollower * follower,
+                                                     __unsafe_unretained SEMIDIClockReceiver * receiver,
+                                                     uint64_t time);
+
+/*!
+ * Get the current correction ratio
+ *
+ *  This is the rate at which the followed timeline is advancing relative to the
+ *  source tempo, from the last update onwards: 1.0 when in phase, greater than 1.0
+ *  when catching up, and less than 1.0 when letting the source catch up.
+ *
+ * @param follower The follower
+ * @return The correction ratio
+ */
+double SETimelineFollowerGetCorrectionRatio(const SETimelineFollower * follower);
+
+#ifdef __cplusplus
+}
+#endif
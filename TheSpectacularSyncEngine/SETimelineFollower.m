@@ -0,0 +1,85 @@
+//
+//  SETimelineFollower.m
+//  The Spectacular Sync Engine
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+
+#import "SETimelineFollower.h"
+#import "SECommon.h"
+
+static const NSTimeInterval kDefaultCorrectionWindow = 0.5;    // Default time over which to absorb a phase error
+static const double kDefaultMaximumCorrection        = 0.01;   // Default maximum rate correction
+static const double kDefaultJumpThreshold            = 0.25;   // Default phase error, in beats, beyond which we jump
+
+void SETimelineFollowerInit(SETimelineFollower * follower) {
+    memset(follower, 0, sizeof(SETimelineFollower));
+    follower->correctionWindow = kDefaultCorrectionWindow;
+    follower->maximumCorrection = kDefaultMaximumCorrection;
+    follower->jumpThreshold = kDefaultJumpThreshold;
+    follower->correctionRatio = 1.0;
+}
+
+void SETimelineFollowerReset(SETimelineFollower * follower) {
+    follower->primed = NO;
+    follower->correctionRatio = 1.0;
+}
+
+double SETimelineFollowerUpdate(SETimelineFollower * follower, uint64_t time, double sourcePosition, double tempo, uint32_t discontinuityCount) {
+    if ( tempo != follower->conversion.tempo ) {
+        SETempoConversionSetTempo(&follower->conversion, tempo);
+    }
+    
+    if ( follower->primed && time < follower->time ) {
+        // Earlier than the last update: extrapolate back, leaving our state alone
+        return follower->position - SETempoConversionHostTicksToBeats(&follower->conversion, follower->time - time) * follower->correctionRatio;
+    }
+    
+    if ( !follower->primed || tempo == 0.0 || discontinuityCount != follower->discontinuityCount ) {
+        // First update, stopped timeline, or deliberate jump: follow the source exactly
+        follower->primed = YES;
+        follower->discontinuityCount = discontinuityCount;
+        follower->time = time;
+        follower->position = sourcePosition;
+        follower->correctionRatio = 1.0;
+        return sourcePosition;
+    }
+    
+    // Advance at the rate we committed to at the last update
+    double position = follower->position + SETempoConversionHostTicksToBeats(&follower->conversion, time - follower->time) * follower->correctionRatio;
+    double error = sourcePosition - position;
+    
+    if ( fabs(error) > follower->jumpThreshold ) {
+        // Too far out to correct smoothly: jump
+        position = sourcePosition;
+        follower->correctionRatio = 1.0;
+    } else {
+        // Choose a rate that absorbs the error over the correction window
+        double correction = error / (follower->correctionWindow * follower->conversion.tempo / 60.0);
+        follower->correctionRatio = 1.0 + MAX(-follower->maximumCorrection, MIN(follower->maximumCorrection, correction));
+    }
+    
+    follower->time = time;
+    follower->position = position;
+    
+    return position;
+}
+
+double SETimelineFollowerGetReceiverTimelinePosition(SETimelineFollower * follower,
+                                                     __unsafe_unretained SEMIDIClockReceiver * receiver,
+                                                     uint64_t time) {
+    if ( !time ) {
+        time = SECurrentTimeInHostTicks();
+    }
+    
+    uint32_t discontinuityCount = SEMIDIClockReceiverGetDiscontinuityCount(receiver);
+    double tempo = SEMIDIClockReceiverIsClockRunning(receiver) ? SEMIDIClockReceiverGetTempo(receiver) : 0.0;
+    double position = SEMIDIClockReceiverGetTimelinePosition(receiver, time);
+    
+    return SETimelineFollowerUpdate(follower, time, position, tempo, discontinuityCount);
+}
+
+double SETimelineFollowerGetCorrectionRatio(const SETimelineFollower * follower) {
+    return follower->correctionRatio;
+}
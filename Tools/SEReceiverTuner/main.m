@@ -0,0 +1,544 @@
+//
+//  main.m
+//  SEReceiverTuner
+//
+//  Created by agent on 18/10/2026.
+//  Copyright (c) 2026 A Tasty Pixel. All rights reserved.
+//
+//  Searches for SEMIDIClockReceiver parameters suited to a corpus of clock traces.
+//
+//  Each parameter set is evaluated by replaying every trace into a fresh receiver, and
+//  comparing its output with the reference timeline for the trace. Runs are scored on
+//  the time taken to lock on to tempo and phase, the steady-state position error once
+//  locked, and the number of times the output leaves tolerance after locking. The
+//  configurations that no other configuration beats on all three are printed.
+//
+//  Traces recorded with SEMIDITraceRecorder are referenced against a least-squares fit
+//  of the ticks in each Start-to-Stop segment, so they should hold a steady tempo within
+//  each segment. A set of synthetic traces with known timelines is built in.
+//
+//  Build on macOS, from the repository root:
+//
+//    clang -fobjc-arc -O2 -framework Foundation -framework CoreMIDI -framework AudioToolbox \
+//        -ITheSpectacularSyncEngine Tools/SEReceiverTuner/main.m TheSpectacularSyncEngine/SECommon.m \
+//        TheSpectacularSyncEngine/SEMIDIClockReceiver.m TheSpectacularSyncEngine/SEMIDITrace.m \
+//        TheSpectacularSyncEngine/SEClockStatePublisher.m -framework Accelerate -o SEReceiverTuner
+//
+//  Usage: SEReceiverTuner [-r count] [-s seed] [-n] [trace.semt ...]
+//
+//    -r count  Evaluate this many random parameter sets, rather than the parameter grid
+//    -s seed   Random seed for the synthetic traces and random search (default 1)
+//    -n        Leave out the synthetic traces
+//
+
+#import <Foundation/Foundation.h>
+#import "SEMIDIClockReceiver.h"
+#import "SEMIDITrace.h"
+
+static const double kTempoTolerance                  = 1.0e-3; // Relative tempo error within which output is considered locked
+static const double kPhaseTolerance                  = 2.0e-3; // Position error, in seconds, within which output is considered locked
+static const int    kTicksToLock                     = SEMIDITicksPerBeat; // Consecutive ticks within tolerance required to lock
+static const int    kMinTicksPerSegment              = 2 * SEMIDITicksPerBeat; // Shorter recorded segments aren't scored
+static const double kSyntheticDuration               = 40.0;   // Length of each synthetic trace, in seconds
+
+typedef struct {
+    uint64_t timestamp;     // Timestamp, in host ticks
+    uint8_t bytes[3];
+    uint8_t length;
+    int32_t reference;      // Index of the reference for this tick, or -1
+} SETunerMessage;
+
+typedef struct {
+    uint64_t time;          // Time the tick should describe, in host ticks
+    double position;        // Timeline position at that time, in beats; NAN if the clock is stopped
+    double tempo;           // Tempo at that time
+    BOOL relock;            // Whether the receiver has to acquire lock again from here
+} SETunerReference;
+
+typedef struct {
+    double lockTime;        // Total time taken to lock, in seconds
+    int segments;           // Number of segments scored
+    double squaredError;    // Sum of squared position errors after lock, in seconds
+    int errorCount;         // Number of position errors summed
+    int resets;             // Number of times output left tolerance after lock
+} SETunerScore;
+
+typedef struct {
+    SEMIDIClockReceiverParameters parameters;
+    double lockTime;        // Mean time to lock, in seconds
+    double error;           // RMS position error after lock, in seconds
+    int resets;
+} SETunerResult;
+
+#pragma mark - Traces
+
+@interface SETunerTrace : NSObject
+@property (nonatomic, strong) NSString * name;
+@property (nonatomic, strong) NSMutableData * messages;
+@property (nonatomic, strong) NSMutableData * references;
+@end
+
+@implementation SETunerTrace
+
+-(instancetype)initWithName:(NSString*)name {
+    if ( !(self = [super init]) ) return nil;
+    self.name = name;
+    self.messages = [NSMutableData data];
+    self.references = [NSMutableData data];
+    return self;
+}
+
+-(NSUInteger)messageCount {
+    return _messages.length / sizeof(SETunerMessage);
+}
+
+-(NSUInteger)referenceCount {
+    return _references.length / sizeof(SETunerReference);
+}
+
+-(void)addMessage:(const uint8_t*)bytes length:(int)length timestamp:(uint64_t)timestamp {
+    SETunerMessage message = { .timestamp = timestamp, .length = length, .reference = -1 };
+    memcpy(message.bytes, bytes, length);
+    [_messages appendBytes:&message length:sizeof(message)];
+}
+
+-(void)addTickAtTimestamp:(uint64_t)timestamp reference:(SETunerReference)reference {
+    SETunerMessage message = { .timestamp = timestamp, .bytes = { SEMIDIMessageClock }, .length = 1, .reference = (int32_t)self.referenceCount };
+    [_messages appendBytes:&message length:sizeof(message)];
+    [_references appendBytes:&reference length:sizeof(reference)];
+}
+
+@end
+
+/*!
+ * Reference a segment of recorded ticks against their least-squares fit
+ */
+static void SETunerReferenceSegment(SETunerTrace * trace, NSMutableArray * ticks, double startPosition, BOOL running) {
+    NSUInteger count = ticks.count;
+    if ( count < kMinTicksPerSegment ) {
+        [ticks removeAllObjects];
+        return;
+    }
+    
+    // Fit time = intercept + period * index, relative to the first tick to keep precision
+    SETunerMessage * messages = trace.messages.mutableBytes;
+    uint64_t origin = messages[[ticks[0] integerValue]].timestamp;
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for ( NSUInteger i=0; i<count; i++ ) {
+        double y = (double)(int64_t)(messages[[ticks[i] integerValue]].timestamp - origin);
+        sumX += i;
+        sumY += y;
+        sumXX += (double)i * i;
+        sumXY += i * y;
+    }
+    double period = (count * sumXY - sumX * sumY) / (count * sumXX - sumX * sumX);
+    double intercept = (sumY - period * sumX) / count;
+    double tempo = 60.0 / (SEHostTicksToSeconds(1) * period * SEMIDITicksPerBeat);
+    
+    for ( NSUInteger i=0; i<count; i++ ) {
+        SETunerReference reference = {
+            .time = origin + (int64_t)llround(intercept + period * i),
+            .position = running ? startPosition + (double)i / SEMIDITicksPerBeat : NAN,
+            .tempo = tempo,
+            .relock = i == 0,
+        };
+        messages[[ticks[i] integerValue]].reference = (int32_t)trace.referenceCount;
+        [trace.references appendBytes:&reference length:sizeof(reference)];
+    }
+    
+    [ticks removeAllObjects];
+}
+
+static SETunerTrace * SETunerLoadTrace(NSString * path) {
+    // The player checks the trace's header and version, and maps timestamps into this host's timebase
+    SEMIDITracePlayer * player = [[SEMIDITracePlayer alloc] initWithPath:path];
+    if ( !player ) {
+        fprintf(stderr, "%s is not a MIDI trace\n", path.UTF8String);
+        return nil;
+    }
+    
+    SETunerTrace * trace = [[SETunerTrace alloc] initWithName:path.lastPathComponent];
+    NSMutableArray * ticks = [NSMutableArray array];
+    __block BOOL running = NO;
+    __block double startPosition = 0;
+    __block double songPosition = 0;
+    
+    [player enumerateMessagesWithBlock:^(uint64_t timestamp, const uint8_t * message, uint16_t length) {
+        if ( length == 0 || length > 3 ) return;
+        
+        switch ( message[0] ) {
+            case SEMIDIMessageClockStart:
+            case SEMIDIMessageContinue:
+                SETunerReferenceSegment(trace, ticks, startPosition, running);
+                running = YES;
+                startPosition = message[0] == SEMIDIMessageClockStart ? 0 : songPosition;
+                break;
+            case SEMIDIMessageClockStop:
+                SETunerReferenceSegment(trace, ticks, startPosition, running);
+                running = NO;
+                break;
+            case SEMIDIMessageSongPosition:
+                if ( length == 3 ) {
+                    songPosition = (double)(((int)message[2] << 7) | message[1]) / 4.0;
+                }
+                break;
+            case SEMIDIMessageClock:
+                [ticks addObject:@(trace.messageCount)];
+                break;
+        }
+        
+        [trace addMessage:message length:length timestamp:timestamp];
+    }];
+    
+    SETunerReferenceSegment(trace, ticks, startPosition, running);
+    
+    if ( trace.referenceCount == 0 ) {
+        fprintf(stderr, "%s has no clock segments long enough to score\n", path.UTF8String);
+        return nil;
+    }
+    
+    return trace;
+}
+
+#pragma mark - Synthetic traces
+
+typedef enum {
+    SETunerSyntheticSteady,
+    SETunerSyntheticHeavyTailed,
+    SETunerSyntheticBunched,
+    SETunerSyntheticTempoStep,
+    SETunerSyntheticWander,
+    SETunerSyntheticFreeRunning,
+    SETunerSyntheticCount
+} SETunerSynthetic;
+
+static double SETunerGaussian(unsigned short * state) {
+    double u = erand48(state);
+    double v = erand48(state);
+    return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+static SETunerTrace * SETunerSyntheticTrace(SETunerSynthetic kind, unsigned short * state) {
+    static NSString * const names[] = {
+        @"steady (120 BPM, 0.5ms jitter)",
+        @"heavy-tailed (128 BPM, 2% late by ~6ms)",
+        @"bunched (100 BPM, delivered 4 ticks at a time)",
+        @"tempo step (120 to 96 BPM)",
+        @"wander (132 BPM, 1.5ms latency swing)",
+        @"free-running (110 BPM, no start)",
+    };
+    SETunerTrace * trace = [[SETunerTrace alloc] initWithName:names[kind]];
+    
+    double tempo = kind == SETunerSyntheticHeavyTailed ? 128.0
+                 : kind == SETunerSyntheticBunched ? 100.0
+                 : kind == SETunerSyntheticWander ? 132.0
+                 : kind == SETunerSyntheticFreeRunning ? 110.0
+                 : 120.0;
+    
+    double startTime = 1000.0;
+    double time = startTime;
+    double position = 0.0;
+    double lastStamp = 0.0;
+    BOOL running = kind != SETunerSyntheticFreeRunning;
+    
+    if ( running ) {
+        uint8_t start = SEMIDIMessageClockStart;
+        [trace addMessage:&start length:1 timestamp:SESecondsToHostTicks(time - 0.001)];
+    }
+    
+    for ( int tick=0; time < startTime + kSyntheticDuration; tick++ ) {
+        BOOL relock = tick == 0;
+        if ( kind == SETunerSyntheticTempoStep && tempo == 120.0 && time >= startTime + kSyntheticDuration/2 ) {
+            tempo = 96.0;
+            relock = YES;
+        }
+        double period = 60.0 / (tempo * SEMIDITicksPerBeat);
+        
+        // The delay each tick is stamped with, and the mean of that delay, which the receiver can't know
+        double delay = 0, expectedDelay = 0;
+        switch ( kind ) {
+            case SETunerSyntheticSteady:
+            case SETunerSyntheticFreeRunning:
+                delay = 0.5e-3 * SETunerGaussian(state);
+                break;
+            case SETunerSyntheticHeavyTailed:
+                delay = 0.3e-3 * SETunerGaussian(state) + (erand48(state) < 0.02 ? -6.0e-3 * log(1.0 - erand48(state)) : 0);
+                expectedDelay = 0.02 * 6.0e-3;
+                break;
+            case SETunerSyntheticBunched:
+                delay = (3 - (tick % 4)) * period + 1.0e-3 + 0.1e-3 * SETunerGaussian(state);
+                expectedDelay = 1.5 * period + 1.0e-3;
+                break;
+            case SETunerSyntheticTempoStep:
+                delay = 0.3e-3 * SETunerGaussian(state);
+                break;
+            case SETunerSyntheticWander:
+                delay = 1.5e-3 * sin(2.0 * M_PI * (time - startTime) / 7.0) + 0.2e-3 * SETunerGaussian(state);
+                break;
+            case SETunerSyntheticCount:
+                break;
+        }
+        
+        double stamp = MAX(lastStamp, time + delay);
+        lastStamp = stamp;
+        
+        SETunerReference reference = {
+            .time = SESecondsToHostTicks(time + expectedDelay),
+            .position = running ? position : NAN,
+            .tempo = tempo,
+            .relock = relock,
+        };
+        [trace addTickAtTimestamp:SESecondsToHostTicks(stamp) reference:reference];
+        
+        time += period;
+        position += 1.0 / SEMIDITicksPerBeat;
+    }
+    
+    return trace;
+}
+
+#pragma mark - Evaluation
+
+static void SETunerCloseSegment(SETunerScore * score, BOOL locked, uint64_t segmentStart, uint64_t segmentEnd) {
+    if ( !segmentStart ) return;
+    score->segments++;
+    if ( !locked ) {
+        // Never locked: penalise with the length of the segment
+        score->lockTime += SEHostTicksToSeconds(segmentEnd - segmentStart);
+    }
+}
+
+static SETunerScore SETunerEvaluate(SETunerTrace * trace, SEMIDIClockReceiverParameters parameters) {
+    SETunerScore score = {};
+    SEMIDIClockReceiver * receiver = [[SEMIDIClockReceiver alloc] initWithParameters:parameters eventPollTimer:NO];
+    
+    const SETunerMessage * messages = trace.messages.bytes;
+    const SETunerReference * references = trace.references.bytes;
+    NSUInteger messageCount = trace.messageCount;
+    
+    char packetListSpace[sizeof(MIDIPacketList)];
+    MIDIPacketList *packetList = (MIDIPacketList*)packetListSpace;
+    
+    uint64_t segmentStart = 0, segmentEnd = 0, runStart = 0;
+    int consecutive = 0;
+    BOOL locked = NO, wasInTolerance = NO;
+    
+    for ( NSUInteger i=0; i<messageCount; i++ ) {
+        MIDIPacket *packet = MIDIPacketListInit(packetList);
+        MIDIPacketListAdd(packetList, sizeof(packetListSpace), packet, messages[i].timestamp, messages[i].length, messages[i].bytes);
+        SEMIDIClockReceiverReceivePacketList(receiver, packetList);
+        
+        if ( messages[i].reference < 0 ) continue;
+        const SETunerReference * reference = &references[messages[i].reference];
+        
+        if ( reference->relock ) {
+            SETunerCloseSegment(&score, locked, segmentStart, segmentEnd);
+            segmentStart = reference->time;
+            consecutive = 0;
+            locked = NO;
+        }
+        segmentEnd = reference->time;
+        
+        double tempo = SEMIDIClockReceiverGetTempo(receiver);
+        BOOL inTolerance = tempo > 0 && fabs(tempo - reference->tempo) / reference->tempo <= kTempoTolerance;
+        double error = 0;
+        if ( !isnan(reference->position) ) {
+            double position = SEMIDIClockReceiverGetTimelinePosition(receiver, reference->time);
+            error = (position - reference->position) * (60.0 / reference->tempo);
+            inTolerance = inTolerance && SEMIDIClockReceiverIsClockRunning(receiver) && fabs(error) <= kPhaseTolerance;
+        }
+        
+        if ( !locked ) {
+            if ( !inTolerance ) {
+                consecutive = 0;
+                continue;
+            }
+            if ( consecutive++ == 0 ) {
+                runStart = reference->time;
+            }
+            if ( consecutive == kTicksToLock ) {
+                locked = YES;
+                wasInTolerance = YES;
+                score.lockTime += SEHostTicksToSeconds(runStart - segmentStart);
+            }
+            continue;
+        }
+        
+        if ( !isnan(reference->position) ) {
+            score.squaredError += error * error;
+            score.errorCount++;
+        }
+        if ( wasInTolerance && !inTolerance ) {
+            score.resets++;
+        }
+        wasInTolerance = inTolerance;
+    }
+    
+    SETunerCloseSegment(&score, locked, segmentStart, segmentEnd);
+    
+    return score;
+}
+
+#pragma mark - Search
+
+static NSData * SETunerGridParameters() {
+    static const int bufferSizes[] = { 48, 96, 192, 384 };
+    static const double thresholdRatios[] = { 2.0, 2.5, 3.0, 4.0 };
+    static const int outliersBeforeReset[] = { 2, 3, 5 };
+    static const int minContiguousSamples[] = { 8, 15, 30 };
+    static const double roundings[] = { 0.01, 0.1, 1.0 };
+    static const BOOL robust[] = { NO, YES };
+    
+    NSMutableData * sets = [NSMutableData data];
+    for ( int a=0; a<sizeof(bufferSizes)/sizeof(int); a++ )
+    for ( int b=0; b<sizeof(thresholdRatios)/sizeof(double); b++ )
+    for ( int c=0; c<sizeof(outliersBeforeReset)/sizeof(int); c++ )
+    for ( int d=0; d<sizeof(minContiguousSamples)/sizeof(int); d++ )
+    for ( int e=0; e<sizeof(roundings)/sizeof(double); e++ )
+    for ( int f=0; f<sizeof(robust)/sizeof(BOOL); f++ ) {
+        SEMIDIClockReceiverParameters parameters = SEMIDIClockReceiverDefaultParameters;
+        parameters.sampleBufferSize = bufferSizes[a];
+        parameters.outlierThresholdRatio = thresholdRatios[b];
+        parameters.outliersBeforeReset = outliersBeforeReset[c];
+        parameters.minContiguousSamplesBeforeReportingTempo = minContiguousSamples[d];
+        parameters.coarsestTempoRounding = roundings[e];
+        parameters.robustOutlierDetection = robust[f];
+        [sets appendBytes:&parameters length:sizeof(parameters)];
+    }
+    return sets;
+}
+
+static NSData * SETunerRandomParameters(int count, unsigned short * state) {
+    static const double roundings[] = { 0.0001, 0.001, 0.01, 0.1, 0.5, 1.0 };
+    
+    NSMutableData * sets = [NSMutableData data];
+    for ( int i=0; i<count; i++ ) {
+        SEMIDIClockReceiverParameters parameters = SEMIDIClockReceiverDefaultParameters;
+        parameters.sampleBufferSize = 24 + (int)(erand48(state) * (384 - 24));
+        parameters.outlierThresholdRatio = 1.5 + erand48(state) * 3.5;
+        parameters.outliersBeforeReset = 1 + (int)(erand48(state) * 8);
+        parameters.minContiguousSamplesBeforeReportingTempo = 4 + (int)(erand48(state) * 44);
+        parameters.coarsestTempoRounding = roundings[(int)(erand48(state) * 6)];
+        parameters.robustOutlierDetection = erand48(state) < 0.5;
+        [sets appendBytes:&parameters length:sizeof(parameters)];
+    }
+    return sets;
+}
+
+static BOOL SETunerDominates(const SETunerResult * a, const SETunerResult * b) {
+    return a->lockTime <= b->lockTime && a->error <= b->error && a->resets <= b->resets
+        && (a->lockTime < b->lockTime || a->error < b->error || a->resets < b->resets);
+}
+
+static int SETunerCompareResults(const void * a, const void * b) {
+    double difference = ((const SETunerResult*)a)->lockTime - ((const SETunerResult*)b)->lockTime;
+    return difference < 0 ? -1 : difference > 0 ? 1 : 0;
+}
+
+static void SETunerPrintResult(const SETunerResult * result, BOOL isDefault) {
+    printf("%7d %9.2f %6d %11d %9g %7s %10.3f %10.3f %7d%s\n",
+           result->parameters.sampleBufferSize,
+           result->parameters.outlierThresholdRatio,
+           result->parameters.outliersBeforeReset,
+           result->parameters.minContiguousSamplesBeforeReportingTempo,
+           result->parameters.coarsestTempoRounding,
+           result->parameters.robustOutlierDetection ? "yes" : "no",
+           result->lockTime,
+           result->error * 1000.0,
+           result->resets,
+           isDefault ? "  (defaults)" : "");
+}
+
+int main(int argc, char * argv[]) {
+    @autoreleasepool {
+        int randomCount = 0;
+        long seed = 1;
+        BOOL synthetic = YES;
+        int option;
+        while ( (option = getopt(argc, argv, "r:s:n")) != -1 ) {
+            switch ( option ) {
+                case 'r': randomCount = atoi(optarg); break;
+                case 's': seed = atol(optarg); break;
+                case 'n': synthetic = NO; break;
+                default:
+                    fprintf(stderr, "Usage: %s [-r count] [-s seed] [-n] [trace.semt ...]\n", argv[0]);
+                    return 1;
+            }
+        }
+        
+        unsigned short state[3] = { 0x330E, (unsigned short)seed, (unsigned short)(seed >> 16) };
+        
+        NSMutableArray * traces = [NSMutableArray array];
+        for ( int i=optind; i<argc; i++ ) {
+            SETunerTrace * trace = SETunerLoadTrace(@(argv[i]));
+            if ( !trace ) return 1;
+            [traces addObject:trace];
+        }
+        if ( synthetic ) {
+            for ( int kind=0; kind<SETunerSyntheticCount; kind++ ) {
+                [traces addObject:SETunerSyntheticTrace(kind, state)];
+            }
+        }
+        if ( traces.count == 0 ) {
+            fprintf(stderr, "No traces to evaluate\n");
+            return 1;
+        }
+        
+        // The defaults go first, for comparison
+        NSMutableData * sets = [NSMutableData dataWithBytes:&SEMIDIClockReceiverDefaultParameters length:sizeof(SEMIDIClockReceiverParameters)];
+        [sets appendData:randomCount > 0 ? SETunerRandomParameters(randomCount, state) : SETunerGridParameters()];
+        size_t setCount = sets.length / sizeof(SEMIDIClockReceiverParameters);
+        const SEMIDIClockReceiverParameters * parameterSets = sets.bytes;
+        
+        for ( SETunerTrace * trace in traces ) {
+            printf("Trace: %s, %lu ticks\n", trace.name.UTF8String, (unsigned long)trace.referenceCount);
+        }
+        printf("Evaluating %lu parameter sets on %lu cores\n\n", (unsigned long)setCount, (unsigned long)[NSProcessInfo processInfo].activeProcessorCount);
+        
+        // Each parameter set is independent, with its own receivers; let libdispatch spread them across all cores
+        NSMutableData * resultData = [NSMutableData dataWithLength:setCount * sizeof(SETunerResult)];
+        SETunerResult * results = resultData.mutableBytes;
+        NSArray * corpus = [traces copy];
+        dispatch_apply(setCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+            @autoreleasepool {
+                SETunerScore total = {};
+                for ( SETunerTrace * trace in corpus ) {
+                    SETunerScore score = SETunerEvaluate(trace, parameterSets[index]);
+                    total.lockTime += score.lockTime;
+                    total.segments += score.segments;
+                    total.squaredError += score.squaredError;
+                    total.errorCount += score.errorCount;
+                    total.resets += score.resets;
+                }
+                results[index] = (SETunerResult) {
+                    .parameters = parameterSets[index],
+                    .lockTime = total.segments ? total.lockTime / total.segments : 0,
+                    .error = total.errorCount ? sqrt(total.squaredError / total.errorCount) : 0,
+                    .resets = total.resets,
+                };
+            }
+        });
+        
+        // Keep the configurations no other beats on lock time, error and resets alike
+        NSMutableData * frontData = [NSMutableData data];
+        for ( size_t i=1; i<setCount; i++ ) {
+            BOOL dominated = NO;
+            for ( size_t j=1; j<setCount && !dominated; j++ ) {
+                dominated = j != i && SETunerDominates(&results[j], &results[i]);
+            }
+            if ( !dominated ) {
+                [frontData appendBytes:&results[i] length:sizeof(SETunerResult)];
+            }
+        }
+        SETunerResult * front = frontData.mutableBytes;
+        size_t frontCount = frontData.length / sizeof(SETunerResult);
+        qsort(front, frontCount, sizeof(SETunerResult), SETunerCompareResults);
+        
+        printf(" buffer threshold  reset  contiguous  rounding  robust  lock (s)  err (ms)  resets\n");
+        SETunerPrintResult(&results[0], YES);
+        for ( size_t i=0; i<frontCount; i++ ) {
+            SETunerPrintResult(&front[i], NO);
+        }
+    }
+    return 0;
+}